@@ -36,7 +36,9 @@ uniform sampler2D Mask;
 //HardMix = 23
 //Exclusion = 24
 
+#ifndef blendMode
 uniform int blendMode = 1;
+#endif
 uniform float alpha = 1;
 
 ///alpha modes
@@ -47,7 +49,9 @@ uniform float alpha = 1;
 //Average = 4
 //Add = 5
 
+#ifndef alphaMode
 uniform int alphaMode = 0;
+#endif
 
 ///HSL HELPERS
 vec3 ToHSL(vec3 c) {
@@ -243,10 +247,10 @@ float PinLight(float a, float b) {
 
 float HardMix(float a, float b) {
     if (a < 1 - b) {
-        return 0;
+        return 0.0;
     }
     else {
-        return 1;
+        return 1.0;
     }
 }
 
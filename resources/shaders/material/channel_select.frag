@@ -5,10 +5,18 @@ in vec2 UV;
 uniform sampler2D input1;
 uniform sampler2D input2;
 
+#ifndef channel_red
 uniform int channel_red = 0;
+#endif
+#ifndef channel_green
 uniform int channel_green = 1;
+#endif
+#ifndef channel_blue
 uniform int channel_blue = 2;
+#endif
+#ifndef channel_alpha
 uniform int channel_alpha = 3;
+#endif
 
 float get_channel(vec4 c1, vec4 c2, int channel) {
     switch (channel) {
@@ -29,7 +37,7 @@ float get_channel(vec4 c1, vec4 c2, int channel) {
         case 7:
         return c2.a;
     }
-    return 0;
+    return 0.0;
 }
 
 void main() {
@@ -4,7 +4,9 @@ in vec2 UV;
 
 uniform sampler2D MainTex;
 uniform sampler2D Background;
+#ifndef blendMode
 uniform int blendMode;
+#endif
 
 float AddSub(float a, float b) {
     if(a >= 0.5) {
@@ -1,12 +1,11 @@
 #version 330 core
-layout (location = 0) in vec3 pos;
-layout (location = 1) in vec2 uv0;
-
 out vec2 UV;
 
 uniform vec2 tiling = vec2(1);
 
+// A triangle covering the viewport, drawn without vertex buffers.
 void main() {
+    vec2 uv0 = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
     UV = uv0 * tiling;
-    gl_Position = vec4(pos.x,pos.y, 0, 1);
-}
\ No newline at end of file
+    gl_Position = vec4(uv0 * 2.0 - 1.0, 0, 1);
+}
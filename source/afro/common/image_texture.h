@@ -6,51 +6,104 @@
 
 #pragma once
 
-#include <core/uuid.h>
-
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
 
-#include "core/image_texture.h"
-#include "packed_file.h"
+#include "common/data/uuid.h"
+#include "common/packed_file.h"
+#include "common/pixel_format.h"
+#include "common/pixel_storage.h"
 
 namespace afro::core {
 
 /**
- * @brief Enumeration of image format. Can be casted to size_t to get the size
- * of each pixel in bytes.
+ * @brief A view of pixels in a PixelStorage. Copies share the storage, so
+ * images are passed around without copying pixels. Writing through
+ * get_mutable_data() first copies the viewed pixels into storage of the
+ * image's own if the storage is shared or read only.
  *
+ * Rows are get_stride() bytes apart, which is more than their pixels for
+ * regions of a larger image.
  */
-enum class ImageTextureFormat : size_t {
-  r8 = 1,
-  rgb8 = 3,
-  rgba8 = 4,
-  r16 = 2,
-  rgb16 = 6,
-  rgba16 = 12,
-  r16f = 2,
-  rgb16f = 6,
-  rgba16f = 12,
-  r32f = 4,
-  rgb32f = 12,
-  rgba32f = 16
-};
+class ImageBuffer {
+ private:
+  std::shared_ptr<PixelStorage> storage_;
+  size_t offset_ = 0;
+  size_t stride_ = 0;
+  int width_ = 0;
+  int height_ = 0;
+  PixelFormat format_;
+
+ public:
+  ImageBuffer() = default;
+  /**
+   * @brief Uninitialized pixels in new AlignedStorage.
+   */
+  ImageBuffer(PixelFormat format, int width, int height);
+  /**
+   * @brief Views the pixels at @a offset in @a storage, rows are packed if
+   * @a stride is 0.
+   */
+  ImageBuffer(PixelFormat format, int width, int height,
+              std::shared_ptr<PixelStorage> storage, size_t offset = 0,
+              size_t stride = 0);
+
+  [[nodiscard]] auto get_width() const -> int { return width_; }
+  [[nodiscard]] auto get_height() const -> int { return height_; }
+  [[nodiscard]] auto get_format() const -> const PixelFormat& {
+    return format_;
+  }
+  [[nodiscard]] auto get_stride() const -> size_t { return stride_; }
+  /**
+   * @brief Bytes of the pixels of a row, without padding.
+   */
+  [[nodiscard]] auto get_row_size() const -> size_t {
+    return static_cast<size_t>(width_) * format_.get_pixel_size();
+  }
+  /**
+   * @brief Bytes of all pixels, without padding.
+   */
+  [[nodiscard]] auto get_byte_size() const -> size_t {
+    return get_row_size() * height_;
+  }
+  [[nodiscard]] auto is_empty() const -> bool {
+    return width_ == 0 || height_ == 0;
+  }
+  /**
+   * @brief Whether rows follow each other without padding, so the pixels
+   * are get_byte_size() contiguous bytes.
+   */
+  [[nodiscard]] auto is_packed() const -> bool {
+    return stride_ == get_row_size();
+  }
+  [[nodiscard]] auto get_storage() const
+      -> const std::shared_ptr<PixelStorage>& {
+    return storage_;
+  }
+
+  [[nodiscard]] auto get_data() const -> const uint8_t*;
+  [[nodiscard]] auto get_row(int y) const -> const uint8_t*;
+  /**
+   * @brief Pixels that may be written, copied first unless this is the
+   * only image viewing writable storage.
+   */
+  auto get_mutable_data() -> uint8_t*;
+  auto get_mutable_row(int y) -> uint8_t*;
 
-struct ImageBuffer {
-  const int width, height;
-  const ImageTextureFormat format;
-  const std::vector<uint8_t> bytes;
-  ImageBuffer(ImageTextureFormat format, int width, int height);
-  ImageBuffer(ImageTextureFormat format, int width, int height,
-              std::vector<uint8_t> bytes);
-  ImageBuffer(ImageBuffer&& other) noexcept = default;
-  ImageBuffer(const ImageBuffer& other) noexcept = default;
-  auto operator=(ImageBuffer&& other) = delete;
-  auto operator=(const ImageBuffer& other) = delete;
-  ~ImageBuffer() = default;
+  /**
+   * @brief A view of a rectangle of the pixels, sharing them.
+   */
+  [[nodiscard]] auto get_region(int x, int y, int width, int height) const
+      -> ImageBuffer;
+  /**
+   * @brief The pixels copied into new AlignedStorage with packed rows.
+   */
+  [[nodiscard]] auto copy() const -> ImageBuffer;
 };
 
 struct ImageTexture {
@@ -61,7 +114,7 @@ struct ImageTexture {
   std::optional<PackedFile> packed_file;
   // Path to the original file
   std::optional<std::string> file_path;
-  ImageTexture(UUID uid, ImageTextureFormat format, int width, int height);
+  ImageTexture(UUID uid, PixelFormat format, int width, int height);
   ImageTexture(UUID uid, ImageBuffer buffer);
   ImageTexture(ImageTexture&& other) = default;
   auto operator=(ImageTexture&&) -> ImageTexture& = delete;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <functional>
 #include <stdexcept>
 #include <string>
@@ -32,6 +33,20 @@ class Command {
    * @return DrawResult in the set {DRAWING_UI, FINISHED_UI, CANCELED}
    */
   virtual auto draw() -> CommandResult { return CommandResult::FINISHED_UI; };
+  /**
+   * @brief Bytes kept alive by the command, the undo history is trimmed by
+   * their sum. Objects it shares with the document aren't counted.
+   */
+  [[nodiscard]] virtual auto get_memory_usage() const -> size_t {
+    return sizeof(Command);
+  }
+  /**
+   * @brief Absorbs @a next, which was executed right after this command, so
+   * that undoing this command undoes both.
+   *
+   * @return false if the commands can't be merged.
+   */
+  virtual auto merge(Command & /*next*/) -> bool { return false; }
   Command(Command &&) = default;
   Command(Command &) = delete;
   auto operator=(Command &&) -> Command & = delete;
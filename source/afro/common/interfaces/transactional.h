@@ -0,0 +1,21 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+namespace afro {
+/**
+ * @brief Something whose edits can be grouped, e.g. to be applied in bulk
+ * and notified once. Transactions can be nested, the changes are committed
+ * with the outermost one.
+ */
+class Transactional {
+ public:
+  virtual auto begin_transaction() -> void = 0;
+  virtual auto commit_transaction() -> void = 0;
+  virtual ~Transactional() = default;
+};
+}  // namespace afro
@@ -4,23 +4,81 @@
  * found in the LICENSE file.
  */
 
-#include "core/image_texture.h"
+#include "common/image_texture.h"
 
+#include <algorithm>
 #include <string_view>
 #include <utility>
 
+#include "utils/assert.h"
+
 namespace afro::core {
-ImageBuffer::ImageBuffer(ImageTextureFormat format, int width, int height)
-    : width(width),
-      height(height),
-      format(format),
-      bytes(std::vector<uint8_t>(width * height * (int)format)) {}
+ImageBuffer::ImageBuffer(PixelFormat format, int width, int height)
+    : ImageBuffer(format, width, height,
+                  std::make_shared<AlignedStorage>(
+                      static_cast<size_t>(width) * height *
+                      format.get_pixel_size())) {}
+
+ImageBuffer::ImageBuffer(PixelFormat format, int width, int height,
+                         std::shared_ptr<PixelStorage> storage,
+                         size_t offset, size_t stride)
+    : storage_(std::move(storage)),
+      offset_(offset),
+      width_(width),
+      height_(height),
+      format_(format) {
+  stride_ = stride == 0 ? get_row_size() : stride;
+  AF_ASSERT_MSG(stride_ >= get_row_size(), "Rows overlap")
+  AF_ASSERT_MSG(is_empty() || (storage_ != nullptr &&
+                               offset_ + stride_ * (height_ - 1) +
+                                       get_row_size() <=
+                                   storage_->get_size()),
+                "Pixels are outside of the storage")
+}
+
+auto ImageBuffer::get_data() const -> const uint8_t* {
+  return storage_ == nullptr ? nullptr : storage_->get_data() + offset_;
+}
+
+auto ImageBuffer::get_row(int y) const -> const uint8_t* {
+  return get_data() + stride_ * y;
+}
+
+auto ImageBuffer::get_mutable_data() -> uint8_t* {
+  if (storage_ != nullptr &&
+      (storage_.use_count() > 1 || !storage_->is_writable())) {
+    *this = copy();
+  }
+  return storage_ == nullptr ? nullptr : storage_->get_data() + offset_;
+}
+
+auto ImageBuffer::get_mutable_row(int y) -> uint8_t* {
+  return get_mutable_data() + stride_ * y;
+}
+
+auto ImageBuffer::get_region(int x, int y, int width, int height) const
+    -> ImageBuffer {
+  AF_ASSERT_MSG(x >= 0 && y >= 0 && width >= 0 && height >= 0 &&
+                    x + width <= width_ && y + height <= height_,
+                "Region is outside of the image")
+  return {format_, width, height, storage_,
+          offset_ + stride_ * y + format_.get_pixel_size() * x, stride_};
+}
 
-ImageBuffer::ImageBuffer(ImageTextureFormat format, int width, int height,
-                         std::vector<uint8_t> bytes)
-    : width(width), height(height), format(format), bytes(std::move(bytes)) {}
+auto ImageBuffer::copy() const -> ImageBuffer {
+  auto result = ImageBuffer(format_, width_, height_);
+  auto* data = result.storage_->get_data();
+  if (is_packed()) {
+    std::copy_n(get_data(), get_byte_size(), data);
+    return result;
+  }
+  for (int y = 0; y < height_; ++y) {
+    std::copy_n(get_row(y), get_row_size(), data + get_row_size() * y);
+  }
+  return result;
+}
 
-ImageTexture::ImageTexture(UUID uid, ImageTextureFormat format, int width,
+ImageTexture::ImageTexture(UUID uid, PixelFormat format, int width,
                            int height)
     : uid(uid), buffer(ImageBuffer(format, width, height)) {}
 
@@ -0,0 +1,246 @@
+/**
+ * Copyright 2021 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "common/packed_file.h"
+
+#include <OpenImageIO/parallel.h>
+#include <fmt/format.h>
+#include <zstd.h>
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace afro::core {
+namespace {
+auto hash_bytes(std::span<const uint8_t> bytes) -> uint64_t {
+  return std::hash<std::string_view>()(std::string_view(
+      reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+}
+
+// Runs @a task for each index on OpenImageIO's thread pool and rethrows
+// the first exception it threw.
+auto run_parallel(size_t begin, size_t end,
+                  const std::function<void(size_t)>& task) -> void {
+  auto mutex = std::mutex();
+  auto error = std::exception_ptr();
+  OIIO::parallel_for(static_cast<int64_t>(begin), static_cast<int64_t>(end),
+                     [&](int64_t i) {
+                       try {
+                         task(static_cast<size_t>(i));
+                       } catch (...) {
+                         auto lock = std::scoped_lock(mutex);
+                         if (error == nullptr) {
+                           error = std::current_exception();
+                         }
+                       }
+                     });
+  if (error != nullptr) {
+    std::rethrow_exception(error);
+  }
+}
+}  // namespace
+
+PackedChunk::PackedChunk(uint64_t id, uint64_t hash, size_t size,
+                         std::vector<uint8_t> compressed)
+    : id_(id), hash_(hash), size_(size), compressed_(std::move(compressed)) {}
+
+PackedChunk::~PackedChunk() { PackedChunkStore::get().remove(*this); }
+
+auto PackedChunkStore::get() -> PackedChunkStore& {
+  static PackedChunkStore store;
+  return store;
+}
+
+auto PackedChunkStore::add(std::span<const uint8_t> bytes) -> PackedChunkPtr {
+  auto compressed =
+      std::vector<uint8_t>(ZSTD_compressBound(bytes.size()));
+  const auto compressed_size =
+      ZSTD_compress(compressed.data(), compressed.size(), bytes.data(),
+                    bytes.size(), COMPRESSION_LEVEL);
+  if (ZSTD_isError(compressed_size) != 0) {
+    throw std::runtime_error(fmt::format("Can't compress a chunk: {}",
+                                         ZSTD_getErrorName(compressed_size)));
+  }
+  compressed.resize(compressed_size);
+  compressed.shrink_to_fit();
+  return add_compressed(std::move(compressed), bytes.size());
+}
+
+auto PackedChunkStore::add_compressed(std::vector<uint8_t> compressed,
+                                      size_t size) -> PackedChunkPtr {
+  const auto hash = hash_bytes(compressed);
+  // Destroyed after the lock is released, as the last reference to a chunk
+  // removes it from the store.
+  auto candidates = std::vector<PackedChunkPtr>();
+  auto lock = std::scoped_lock(mutex_);
+  const auto [begin, end] = chunks_.equal_range(hash);
+  for (auto iter = begin; iter != end; ++iter) {
+    auto& chunk = candidates.emplace_back(iter->second.lock());
+    if (chunk != nullptr && chunk->get_size() == size &&
+        std::ranges::equal(chunk->get_compressed(), compressed)) {
+      return chunk;
+    }
+  }
+  auto chunk =
+      std::make_shared<PackedChunk>(next_id_++, hash, size,
+                                    std::move(compressed));
+  chunks_.emplace(hash, chunk);
+  return chunk;
+}
+
+auto PackedChunkStore::remove(const PackedChunk& chunk) -> void {
+  auto lock = std::scoped_lock(mutex_);
+  const auto [begin, end] = chunks_.equal_range(chunk.get_hash());
+  for (auto iter = begin; iter != end; ++iter) {
+    // The weak pointer of a chunk being destroyed has already expired.
+    if (iter->second.expired()) {
+      chunks_.erase(iter);
+      break;
+    }
+  }
+  auto iter = decompressed_.find(chunk.get_id());
+  if (iter != decompressed_.end()) {
+    memory_usage_ -= iter->second.bytes->size();
+    uses_.erase(iter->second.use);
+    decompressed_.erase(iter);
+  }
+}
+
+auto PackedChunkStore::decompress(const PackedChunk& chunk) -> Bytes {
+  {
+    auto lock = std::scoped_lock(mutex_);
+    auto iter = decompressed_.find(chunk.get_id());
+    if (iter != decompressed_.end()) {
+      uses_.splice(uses_.begin(), uses_, iter->second.use);
+      return iter->second.bytes;
+    }
+  }
+
+  // Decompressed without the lock, so chunks are decompressed in parallel.
+  auto bytes = std::make_shared<std::vector<uint8_t>>(chunk.get_size());
+  const auto compressed = chunk.get_compressed();
+  const auto size = ZSTD_decompress(bytes->data(), bytes->size(),
+                                    compressed.data(), compressed.size());
+  if (ZSTD_isError(size) != 0 || size != chunk.get_size()) {
+    throw std::runtime_error(fmt::format(
+        "Chunk {} is corrupt: {}", chunk.get_id(),
+        ZSTD_isError(size) != 0 ? ZSTD_getErrorName(size) : "wrong size"));
+  }
+
+  auto lock = std::scoped_lock(mutex_);
+  // Another thread may have decompressed it meanwhile.
+  const auto [iter, inserted] =
+      decompressed_.try_emplace(chunk.get_id(), Entry{bytes, {}});
+  if (inserted) {
+    uses_.push_front(chunk.get_id());
+    iter->second.use = uses_.begin();
+    memory_usage_ += bytes->size();
+    evict();
+  }
+  return iter->second.bytes;
+}
+
+auto PackedChunkStore::evict() -> void {
+  // The most recently used chunk is kept even if it's over budget.
+  while (memory_usage_ > memory_budget_ && uses_.size() > 1) {
+    auto iter = decompressed_.find(uses_.back());
+    memory_usage_ -= iter->second.bytes->size();
+    decompressed_.erase(iter);
+    uses_.pop_back();
+  }
+}
+
+auto PackedChunkStore::set_memory_budget(size_t bytes) -> void {
+  auto lock = std::scoped_lock(mutex_);
+  memory_budget_ = bytes;
+  evict();
+}
+
+auto PackedChunkStore::get_memory_usage() -> size_t {
+  auto lock = std::scoped_lock(mutex_);
+  return memory_usage_;
+}
+
+auto PackedChunkStore::get_chunk_count() -> size_t {
+  auto lock = std::scoped_lock(mutex_);
+  return chunks_.size();
+}
+
+auto PackedChunkStore::clear() -> void {
+  auto lock = std::scoped_lock(mutex_);
+  decompressed_.clear();
+  uses_.clear();
+  memory_usage_ = 0;
+}
+
+PackedFile::PackedFile(std::span<const uint8_t> bytes)
+    : size_(bytes.size()),
+      chunks_((bytes.size() + CHUNK_SIZE - 1) / CHUNK_SIZE) {
+  run_parallel(0, chunks_.size(), [&](size_t i) {
+    const auto offset = i * CHUNK_SIZE;
+    chunks_[i] = PackedChunkStore::get().add(
+        bytes.subspan(offset, std::min(CHUNK_SIZE, size_ - offset)));
+  });
+}
+
+PackedFile::PackedFile(std::vector<PackedChunkPtr> chunks)
+    : chunks_(std::move(chunks)) {
+  for (size_t i = 0; i < chunks_.size(); ++i) {
+    if (chunks_[i]->get_size() == 0 || chunks_[i]->get_size() > CHUNK_SIZE) {
+      throw std::runtime_error(fmt::format("Chunk {} has {} bytes", i,
+                                           chunks_[i]->get_size()));
+    }
+    if (i + 1 < chunks_.size() && chunks_[i]->get_size() != CHUNK_SIZE) {
+      throw std::runtime_error(
+          fmt::format("Chunk {} has {} bytes instead of {}", i,
+                      chunks_[i]->get_size(), CHUNK_SIZE));
+    }
+    size_ += chunks_[i]->get_size();
+  }
+}
+
+auto PackedFile::get_compressed_size() const -> size_t {
+  auto size = size_t{0};
+  for (const auto& chunk : chunks_) {
+    size += chunk->get_compressed().size();
+  }
+  return size;
+}
+
+auto PackedFile::read(size_t offset, std::span<uint8_t> bytes) const
+    -> void {
+  if (offset > size_ || bytes.size() > size_ - offset) {
+    throw std::out_of_range(
+        fmt::format("Can't read {} bytes at {} of {}", bytes.size(), offset,
+                    size_));
+  }
+  if (bytes.empty()) {
+    return;
+  }
+  const auto first = offset / CHUNK_SIZE;
+  const auto last = (offset + bytes.size() - 1) / CHUNK_SIZE;
+  run_parallel(first, last + 1, [&](size_t i) {
+    const auto chunk = PackedChunkStore::get().decompress(*chunks_[i]);
+    const auto chunk_offset = i * CHUNK_SIZE;
+    const auto begin = std::max(offset, chunk_offset);
+    const auto end =
+        std::min(offset + bytes.size(), chunk_offset + chunk->size());
+    std::copy_n(chunk->data() + (begin - chunk_offset), end - begin,
+                bytes.data() + (begin - offset));
+  });
+}
+
+auto PackedFile::unpack() const -> std::vector<uint8_t> {
+  auto bytes = std::vector<uint8_t>(size_);
+  read(0, bytes);
+  return bytes;
+}
+}  // namespace afro::core
@@ -0,0 +1,1012 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "common/pixel_convert.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "utils/assert.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#define AF_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// Compiles a function for an instruction set the rest of the file isn't
+// built for. MSVC allows the intrinsics of every set without it.
+#if defined(__GNUC__) || defined(__clang__)
+#define AF_TARGET(isa) __attribute__((target(isa)))
+#else
+#define AF_TARGET(isa)
+#endif
+
+namespace afro::core {
+namespace {
+// Pixels converted at a time through a float RGBA block on the stack.
+constexpr size_t BLOCK_SIZE = 256;
+// Segments of the sRGB tables, which are interpolated linearly.
+constexpr int SRGB_TABLE_SIZE = 4096;
+
+struct Kernels {
+  // Convert @a count values.
+  void (*u8_to_float)(const uint8_t*, float*, size_t count);
+  void (*u16_to_float)(const uint16_t*, float*, size_t count);
+  void (*half_to_float)(const uint16_t*, float*, size_t count);
+  void (*float_to_u8)(const float*, uint8_t*, size_t count);
+  void (*float_to_u16)(const float*, uint16_t*, size_t count);
+  void (*float_to_half)(const float*, uint16_t*, size_t count);
+  // Modify @a count RGBA pixels in place, alpha is kept.
+  void (*srgb_to_linear)(float* rgba, size_t count);
+  void (*linear_to_srgb)(float* rgba, size_t count);
+  void (*premultiply)(float* rgba, size_t count);
+  void (*unpremultiply)(float* rgba, size_t count);
+  // Convert @a count pixels between 1 to 3 channels and RGBA.
+  void (*expand)(const float*, int channels, float* rgba, size_t count);
+  void (*contract)(const float* rgba, float*, int channels, size_t count);
+};
+
+struct SrgbTables {
+  // The transfer functions sampled at SRGB_TABLE_SIZE + 1 points of [0, 1].
+  std::array<float, SRGB_TABLE_SIZE + 1> to_linear;
+  std::array<float, SRGB_TABLE_SIZE + 1> to_srgb;
+};
+
+auto get_srgb_tables() -> const SrgbTables& {
+  static const auto tables = [] {
+    auto result = SrgbTables();
+    for (int i = 0; i <= SRGB_TABLE_SIZE; ++i) {
+      const auto value = static_cast<double>(i) / SRGB_TABLE_SIZE;
+      result.to_linear[i] = static_cast<float>(
+          value <= 0.04045 ? value / 12.92
+                           : std::pow((value + 0.055) / 1.055, 2.4));
+      result.to_srgb[i] = static_cast<float>(
+          value <= 0.0031308 ? value * 12.92
+                             : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055);
+    }
+    return result;
+  }();
+  return tables;
+}
+
+// NaN is clamped to 0 like the max instructions of the SIMD kernels do.
+auto clamp_unit(float value) -> float {
+  return value > 0.0F ? std::min(value, 1.0F) : 0.0F;
+}
+
+auto lookup(const float* table, float value) -> float {
+  const auto position = clamp_unit(value) * SRGB_TABLE_SIZE;
+  const auto index =
+      std::min(static_cast<int>(position), SRGB_TABLE_SIZE - 1);
+  const auto fraction = position - static_cast<float>(index);
+  return table[index] + fraction * (table[index + 1] - table[index]);
+}
+
+// Scalar kernels, which the others use for the values left over after
+// their last full vector.
+
+auto u8_to_float_scalar(const uint8_t* source, float* destination,
+                        size_t count) -> void {
+  for (size_t i = 0; i < count; ++i) {
+    destination[i] = static_cast<float>(source[i]) * (1.0F / 255.0F);
+  }
+}
+
+auto u16_to_float_scalar(const uint16_t* source, float* destination,
+                         size_t count) -> void {
+  for (size_t i = 0; i < count; ++i) {
+    destination[i] = static_cast<float>(source[i]) * (1.0F / 65535.0F);
+  }
+}
+
+auto half_to_float_scalar(const uint16_t* source, float* destination,
+                          size_t count) -> void {
+  for (size_t i = 0; i < count; ++i) {
+    destination[i] = half_to_float(source[i]);
+  }
+}
+
+auto float_to_u8_scalar(const float* source, uint8_t* destination,
+                        size_t count) -> void {
+  for (size_t i = 0; i < count; ++i) {
+    destination[i] =
+        static_cast<uint8_t>(std::lrint(clamp_unit(source[i]) * 255.0F));
+  }
+}
+
+auto float_to_u16_scalar(const float* source, uint16_t* destination,
+                         size_t count) -> void {
+  for (size_t i = 0; i < count; ++i) {
+    destination[i] =
+        static_cast<uint16_t>(std::lrint(clamp_unit(source[i]) * 65535.0F));
+  }
+}
+
+auto float_to_half_scalar(const float* source, uint16_t* destination,
+                          size_t count) -> void {
+  for (size_t i = 0; i < count; ++i) {
+    destination[i] = float_to_half(source[i]);
+  }
+}
+
+auto apply_table_scalar(const float* table, float* rgba, size_t count)
+    -> void {
+  for (size_t i = 0; i < count * 4; i += 4) {
+    for (size_t c = 0; c < 3; ++c) {
+      rgba[i + c] = lookup(table, rgba[i + c]);
+    }
+  }
+}
+
+auto srgb_to_linear_scalar(float* rgba, size_t count) -> void {
+  apply_table_scalar(get_srgb_tables().to_linear.data(), rgba, count);
+}
+
+auto linear_to_srgb_scalar(float* rgba, size_t count) -> void {
+  apply_table_scalar(get_srgb_tables().to_srgb.data(), rgba, count);
+}
+
+auto premultiply_scalar(float* rgba, size_t count) -> void {
+  for (size_t i = 0; i < count * 4; i += 4) {
+    for (size_t c = 0; c < 3; ++c) {
+      rgba[i + c] *= rgba[i + 3];
+    }
+  }
+}
+
+auto unpremultiply_scalar(float* rgba, size_t count) -> void {
+  for (size_t i = 0; i < count * 4; i += 4) {
+    const auto alpha = rgba[i + 3];
+    for (size_t c = 0; c < 3; ++c) {
+      rgba[i + c] = alpha > 0.0F ? rgba[i + c] / alpha : 0.0F;
+    }
+  }
+}
+
+auto expand_scalar(const float* source, int channels, float* rgba,
+                   size_t count) -> void {
+  for (size_t i = 0; i < count; ++i) {
+    const auto* pixel = source + i * channels;
+    auto* out = rgba + i * 4;
+    if (channels < 3) {
+      std::fill_n(out, 3, pixel[0]);
+      out[3] = channels == 2 ? pixel[1] : 1.0F;
+    } else {
+      std::copy_n(pixel, 3, out);
+      out[3] = 1.0F;
+    }
+  }
+}
+
+auto contract_scalar(const float* rgba, float* destination, int channels,
+                     size_t count) -> void {
+  for (size_t i = 0; i < count; ++i) {
+    const auto* pixel = rgba + i * 4;
+    auto* out = destination + i * channels;
+    if (channels == 2) {
+      out[0] = pixel[0];
+      out[1] = pixel[3];
+    } else {
+      std::copy_n(pixel, channels, out);
+    }
+  }
+}
+
+constexpr auto SCALAR_KERNELS = Kernels{
+    u8_to_float_scalar,    u16_to_float_scalar,   half_to_float_scalar,
+    float_to_u8_scalar,    float_to_u16_scalar,   float_to_half_scalar,
+    srgb_to_linear_scalar, linear_to_srgb_scalar, premultiply_scalar,
+    unpremultiply_scalar,  expand_scalar,         contract_scalar};
+
+#if defined(AF_X86)
+// SSE4.1 kernels, four values or one pixel at a time. Halfs are converted
+// by the scalar kernels as the set has no instructions for them.
+
+AF_TARGET("sse4.1")
+auto u8_to_float_sse4(const uint8_t* source, float* destination,
+                      size_t count) -> void {
+  const auto scale = _mm_set1_ps(1.0F / 255.0F);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    int32_t bytes = 0;
+    std::memcpy(&bytes, source + i, sizeof(bytes));
+    const auto values = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes));
+    _mm_storeu_ps(destination + i,
+                  _mm_mul_ps(_mm_cvtepi32_ps(values), scale));
+  }
+  u8_to_float_scalar(source + i, destination + i, count - i);
+}
+
+AF_TARGET("sse4.1")
+auto u16_to_float_sse4(const uint16_t* source, float* destination,
+                       size_t count) -> void {
+  const auto scale = _mm_set1_ps(1.0F / 65535.0F);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const auto values = _mm_cvtepu16_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + i)));
+    _mm_storeu_ps(destination + i,
+                  _mm_mul_ps(_mm_cvtepi32_ps(values), scale));
+  }
+  u16_to_float_scalar(source + i, destination + i, count - i);
+}
+
+AF_TARGET("sse4.1")
+auto to_unit_integers_sse4(const float* source, float scale) -> __m128i {
+  const auto clamped = _mm_min_ps(
+      _mm_max_ps(_mm_loadu_ps(source), _mm_setzero_ps()), _mm_set1_ps(1.0F));
+  return _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(scale)));
+}
+
+AF_TARGET("sse4.1")
+auto float_to_u8_sse4(const float* source, uint8_t* destination,
+                      size_t count) -> void {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const auto words = _mm_packus_epi32(
+        to_unit_integers_sse4(source + i, 255.0F), _mm_setzero_si128());
+    const auto bytes =
+        _mm_cvtsi128_si32(_mm_packus_epi16(words, _mm_setzero_si128()));
+    std::memcpy(destination + i, &bytes, sizeof(bytes));
+  }
+  float_to_u8_scalar(source + i, destination + i, count - i);
+}
+
+AF_TARGET("sse4.1")
+auto float_to_u16_sse4(const float* source, uint16_t* destination,
+                       size_t count) -> void {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    _mm_storel_epi64(
+        reinterpret_cast<__m128i*>(destination + i),
+        _mm_packus_epi32(to_unit_integers_sse4(source + i, 65535.0F),
+                         _mm_setzero_si128()));
+  }
+  float_to_u16_scalar(source + i, destination + i, count - i);
+}
+
+// Looks up the color channels of one pixel, the table is gathered with
+// scalar loads.
+AF_TARGET("sse4.1")
+auto lookup_sse4(const float* table, __m128 pixel) -> __m128 {
+  const auto clamped =
+      _mm_min_ps(_mm_max_ps(pixel, _mm_setzero_ps()), _mm_set1_ps(1.0F));
+  const auto position = _mm_mul_ps(clamped, _mm_set1_ps(SRGB_TABLE_SIZE));
+  const auto index = _mm_min_epi32(_mm_cvttps_epi32(position),
+                                   _mm_set1_epi32(SRGB_TABLE_SIZE - 1));
+  const auto fraction = _mm_sub_ps(position, _mm_cvtepi32_ps(index));
+  alignas(16) auto indices = std::array<int32_t, 4>();
+  _mm_store_si128(reinterpret_cast<__m128i*>(indices.data()), index);
+  const auto low = _mm_setr_ps(table[indices[0]], table[indices[1]],
+                               table[indices[2]], 0.0F);
+  const auto high = _mm_setr_ps(table[indices[0] + 1], table[indices[1] + 1],
+                                table[indices[2] + 1], 0.0F);
+  const auto result =
+      _mm_add_ps(low, _mm_mul_ps(fraction, _mm_sub_ps(high, low)));
+  return _mm_blend_ps(result, pixel, 0b1000);
+}
+
+AF_TARGET("sse4.1")
+auto apply_table_sse4(const float* table, float* rgba, size_t count)
+    -> void {
+  for (size_t i = 0; i < count * 4; i += 4) {
+    _mm_storeu_ps(rgba + i, lookup_sse4(table, _mm_loadu_ps(rgba + i)));
+  }
+}
+
+AF_TARGET("sse4.1")
+auto srgb_to_linear_sse4(float* rgba, size_t count) -> void {
+  apply_table_sse4(get_srgb_tables().to_linear.data(), rgba, count);
+}
+
+AF_TARGET("sse4.1")
+auto linear_to_srgb_sse4(float* rgba, size_t count) -> void {
+  apply_table_sse4(get_srgb_tables().to_srgb.data(), rgba, count);
+}
+
+AF_TARGET("sse4.1")
+auto premultiply_sse4(float* rgba, size_t count) -> void {
+  for (size_t i = 0; i < count * 4; i += 4) {
+    const auto pixel = _mm_loadu_ps(rgba + i);
+    const auto alpha = _mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(3, 3, 3, 3));
+    _mm_storeu_ps(rgba + i,
+                  _mm_blend_ps(_mm_mul_ps(pixel, alpha), pixel, 0b1000));
+  }
+}
+
+AF_TARGET("sse4.1")
+auto unpremultiply_sse4(float* rgba, size_t count) -> void {
+  for (size_t i = 0; i < count * 4; i += 4) {
+    const auto pixel = _mm_loadu_ps(rgba + i);
+    const auto alpha = _mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(3, 3, 3, 3));
+    const auto color =
+        _mm_and_ps(_mm_div_ps(pixel, alpha),
+                   _mm_cmpgt_ps(alpha, _mm_setzero_ps()));
+    _mm_storeu_ps(rgba + i, _mm_blend_ps(color, pixel, 0b1000));
+  }
+}
+
+AF_TARGET("sse4.1")
+auto expand_sse4(const float* source, int channels, float* rgba,
+                 size_t count) -> void {
+  const auto opaque = _mm_set1_ps(1.0F);
+  size_t i = 0;
+  switch (channels) {
+    case 1:
+      for (; i < count; ++i) {
+        _mm_storeu_ps(rgba + i * 4,
+                      _mm_blend_ps(_mm_set1_ps(source[i]), opaque, 0b1000));
+      }
+      break;
+    case 2:
+      for (; i < count; ++i) {
+        const auto pixel = _mm_castsi128_ps(_mm_loadl_epi64(
+            reinterpret_cast<const __m128i*>(source + i * 2)));
+        _mm_storeu_ps(rgba + i * 4,
+                      _mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(1, 0, 0, 0)));
+      }
+      break;
+    default:
+      // The last pixel is expanded on its own so no load reads past the
+      // end of the source.
+      for (; i + 1 < count; ++i) {
+        _mm_storeu_ps(rgba + i * 4,
+                      _mm_blend_ps(_mm_loadu_ps(source + i * 3), opaque,
+                                   0b1000));
+      }
+      break;
+  }
+  expand_scalar(source + i * channels, channels, rgba + i * 4, count - i);
+}
+
+AF_TARGET("sse4.1")
+auto contract_sse4(const float* rgba, float* destination, int channels,
+                   size_t count) -> void {
+  size_t i = 0;
+  switch (channels) {
+    case 1:
+      for (; i + 4 <= count; i += 4) {
+        const auto* pixels = rgba + i * 4;
+        const auto low = _mm_shuffle_ps(_mm_loadu_ps(pixels),
+                                        _mm_loadu_ps(pixels + 4),
+                                        _MM_SHUFFLE(0, 0, 0, 0));
+        const auto high = _mm_shuffle_ps(_mm_loadu_ps(pixels + 8),
+                                         _mm_loadu_ps(pixels + 12),
+                                         _MM_SHUFFLE(0, 0, 0, 0));
+        _mm_storeu_ps(destination + i,
+                      _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+      }
+      break;
+    case 2:
+      for (; i < count; ++i) {
+        const auto pixel = _mm_loadu_ps(rgba + i * 4);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + i * 2),
+                         _mm_castps_si128(_mm_shuffle_ps(
+                             pixel, pixel, _MM_SHUFFLE(3, 3, 3, 0))));
+      }
+      break;
+    default:
+      // Each store also writes the first channel of the next pixel, which
+      // its own store overwrites, so the last pixel is written on its own.
+      for (; i + 1 < count; ++i) {
+        _mm_storeu_ps(destination + i * 3, _mm_loadu_ps(rgba + i * 4));
+      }
+      break;
+  }
+  contract_scalar(rgba + i * 4, destination + i * channels, channels,
+                  count - i);
+}
+
+constexpr auto SSE4_KERNELS = Kernels{
+    u8_to_float_sse4,    u16_to_float_sse4,   half_to_float_scalar,
+    float_to_u8_sse4,    float_to_u16_sse4,   float_to_half_scalar,
+    srgb_to_linear_sse4, linear_to_srgb_sse4, premultiply_sse4,
+    unpremultiply_sse4,  expand_sse4,         contract_sse4};
+
+// AVX2 kernels, eight values or two pixels at a time. Every CPU with AVX2
+// also has F16C.
+
+AF_TARGET("avx2,f16c")
+auto u8_to_float_avx2(const uint8_t* source, float* destination,
+                      size_t count) -> void {
+  const auto scale = _mm256_set1_ps(1.0F / 255.0F);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const auto values = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + i)));
+    _mm256_storeu_ps(destination + i,
+                     _mm256_mul_ps(_mm256_cvtepi32_ps(values), scale));
+  }
+  u8_to_float_scalar(source + i, destination + i, count - i);
+}
+
+AF_TARGET("avx2,f16c")
+auto u16_to_float_avx2(const uint16_t* source, float* destination,
+                       size_t count) -> void {
+  const auto scale = _mm256_set1_ps(1.0F / 65535.0F);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const auto values = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)));
+    _mm256_storeu_ps(destination + i,
+                     _mm256_mul_ps(_mm256_cvtepi32_ps(values), scale));
+  }
+  u16_to_float_scalar(source + i, destination + i, count - i);
+}
+
+AF_TARGET("avx2,f16c")
+auto half_to_float_avx2(const uint16_t* source, float* destination,
+                        size_t count) -> void {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm256_storeu_ps(destination + i,
+                     _mm256_cvtph_ps(_mm_loadu_si128(
+                         reinterpret_cast<const __m128i*>(source + i))));
+  }
+  half_to_float_scalar(source + i, destination + i, count - i);
+}
+
+// Packs eight clamped and scaled values into the 16 bit lanes of a 128
+// bit vector.
+AF_TARGET("avx2,f16c")
+auto to_unit_words_avx2(const float* source, float scale) -> __m128i {
+  const auto clamped =
+      _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(source), _mm256_setzero_ps()),
+                    _mm256_set1_ps(1.0F));
+  const auto values =
+      _mm256_cvtps_epi32(_mm256_mul_ps(clamped, _mm256_set1_ps(scale)));
+  return _mm_packus_epi32(_mm256_castsi256_si128(values),
+                          _mm256_extracti128_si256(values, 1));
+}
+
+AF_TARGET("avx2,f16c")
+auto float_to_u8_avx2(const float* source, uint8_t* destination,
+                      size_t count) -> void {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const auto words = to_unit_words_avx2(source + i, 255.0F);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + i),
+                     _mm_packus_epi16(words, words));
+  }
+  float_to_u8_scalar(source + i, destination + i, count - i);
+}
+
+AF_TARGET("avx2,f16c")
+auto float_to_u16_avx2(const float* source, uint16_t* destination,
+                       size_t count) -> void {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i),
+                     to_unit_words_avx2(source + i, 65535.0F));
+  }
+  float_to_u16_scalar(source + i, destination + i, count - i);
+}
+
+AF_TARGET("avx2,f16c")
+auto float_to_half_avx2(const float* source, uint16_t* destination,
+                        size_t count) -> void {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i),
+                     _mm256_cvtps_ph(_mm256_loadu_ps(source + i),
+                                     _MM_FROUND_TO_NEAREST_INT));
+  }
+  float_to_half_scalar(source + i, destination + i, count - i);
+}
+
+AF_TARGET("avx2,f16c")
+auto apply_table_avx2(const float* table, float* rgba, size_t count)
+    -> void {
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const auto pixels = _mm256_loadu_ps(rgba + i * 4);
+    const auto clamped = _mm256_min_ps(
+        _mm256_max_ps(pixels, _mm256_setzero_ps()), _mm256_set1_ps(1.0F));
+    const auto position =
+        _mm256_mul_ps(clamped, _mm256_set1_ps(SRGB_TABLE_SIZE));
+    const auto index = _mm256_min_epi32(
+        _mm256_cvttps_epi32(position), _mm256_set1_epi32(SRGB_TABLE_SIZE - 1));
+    const auto fraction = _mm256_sub_ps(position, _mm256_cvtepi32_ps(index));
+    const auto low = _mm256_i32gather_ps(table, index, 4);
+    const auto high = _mm256_i32gather_ps(table + 1, index, 4);
+    const auto result =
+        _mm256_add_ps(low, _mm256_mul_ps(fraction, _mm256_sub_ps(high, low)));
+    _mm256_storeu_ps(rgba + i * 4,
+                     _mm256_blend_ps(result, pixels, 0b10001000));
+  }
+  apply_table_scalar(table, rgba + i * 4, count - i);
+}
+
+AF_TARGET("avx2,f16c")
+auto srgb_to_linear_avx2(float* rgba, size_t count) -> void {
+  apply_table_avx2(get_srgb_tables().to_linear.data(), rgba, count);
+}
+
+AF_TARGET("avx2,f16c")
+auto linear_to_srgb_avx2(float* rgba, size_t count) -> void {
+  apply_table_avx2(get_srgb_tables().to_srgb.data(), rgba, count);
+}
+
+AF_TARGET("avx2,f16c")
+auto premultiply_avx2(float* rgba, size_t count) -> void {
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const auto pixels = _mm256_loadu_ps(rgba + i * 4);
+    const auto alpha = _mm256_permute_ps(pixels, _MM_SHUFFLE(3, 3, 3, 3));
+    _mm256_storeu_ps(rgba + i * 4,
+                     _mm256_blend_ps(_mm256_mul_ps(pixels, alpha), pixels,
+                                     0b10001000));
+  }
+  premultiply_scalar(rgba + i * 4, count - i);
+}
+
+AF_TARGET("avx2,f16c")
+auto unpremultiply_avx2(float* rgba, size_t count) -> void {
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const auto pixels = _mm256_loadu_ps(rgba + i * 4);
+    const auto alpha = _mm256_permute_ps(pixels, _MM_SHUFFLE(3, 3, 3, 3));
+    const auto color = _mm256_and_ps(
+        _mm256_div_ps(pixels, alpha),
+        _mm256_cmp_ps(alpha, _mm256_setzero_ps(), _CMP_GT_OQ));
+    _mm256_storeu_ps(rgba + i * 4,
+                     _mm256_blend_ps(color, pixels, 0b10001000));
+  }
+  unpremultiply_scalar(rgba + i * 4, count - i);
+}
+
+// Channels are rearranged within a pixel, which 128 bit vectors already
+// cover, so the wider sets use the SSE4.1 kernels for them.
+constexpr auto AVX2_KERNELS = Kernels{
+    u8_to_float_avx2,    u16_to_float_avx2,   half_to_float_avx2,
+    float_to_u8_avx2,    float_to_u16_avx2,   float_to_half_avx2,
+    srgb_to_linear_avx2, linear_to_srgb_avx2, premultiply_avx2,
+    unpremultiply_avx2,  expand_sse4,         contract_sse4};
+
+// AVX-512 kernels, sixteen values or four pixels at a time.
+
+AF_TARGET("avx512f")
+auto u8_to_float_avx512(const uint8_t* source, float* destination,
+                        size_t count) -> void {
+  const auto scale = _mm512_set1_ps(1.0F / 255.0F);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const auto values = _mm512_cvtepu8_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)));
+    _mm512_storeu_ps(destination + i,
+                     _mm512_mul_ps(_mm512_cvtepi32_ps(values), scale));
+  }
+  u8_to_float_scalar(source + i, destination + i, count - i);
+}
+
+AF_TARGET("avx512f")
+auto u16_to_float_avx512(const uint16_t* source, float* destination,
+                         size_t count) -> void {
+  const auto scale = _mm512_set1_ps(1.0F / 65535.0F);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const auto values = _mm512_cvtepu16_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i)));
+    _mm512_storeu_ps(destination + i,
+                     _mm512_mul_ps(_mm512_cvtepi32_ps(values), scale));
+  }
+  u16_to_float_scalar(source + i, destination + i, count - i);
+}
+
+AF_TARGET("avx512f")
+auto half_to_float_avx512(const uint16_t* source, float* destination,
+                          size_t count) -> void {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    _mm512_storeu_ps(destination + i,
+                     _mm512_cvtph_ps(_mm256_loadu_si256(
+                         reinterpret_cast<const __m256i*>(source + i))));
+  }
+  half_to_float_scalar(source + i, destination + i, count - i);
+}
+
+AF_TARGET("avx512f")
+auto to_unit_integers_avx512(const float* source, float scale) -> __m512i {
+  const auto clamped =
+      _mm512_min_ps(_mm512_max_ps(_mm512_loadu_ps(source), _mm512_setzero_ps()),
+                    _mm512_set1_ps(1.0F));
+  return _mm512_cvtps_epi32(_mm512_mul_ps(clamped, _mm512_set1_ps(scale)));
+}
+
+AF_TARGET("avx512f")
+auto float_to_u8_avx512(const float* source, uint8_t* destination,
+                        size_t count) -> void {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(destination + i),
+        _mm512_cvtepi32_epi8(to_unit_integers_avx512(source + i, 255.0F)));
+  }
+  float_to_u8_scalar(source + i, destination + i, count - i);
+}
+
+AF_TARGET("avx512f")
+auto float_to_u16_avx512(const float* source, uint16_t* destination,
+                         size_t count) -> void {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(destination + i),
+        _mm512_cvtepi32_epi16(to_unit_integers_avx512(source + i, 65535.0F)));
+  }
+  float_to_u16_scalar(source + i, destination + i, count - i);
+}
+
+AF_TARGET("avx512f")
+auto float_to_half_avx512(const float* source, uint16_t* destination,
+                          size_t count) -> void {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(destination + i),
+        _mm512_cvtps_ph(_mm512_loadu_ps(source + i),
+                        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+  }
+  float_to_half_scalar(source + i, destination + i, count - i);
+}
+
+// Selects the alpha lanes of four RGBA pixels.
+constexpr __mmask16 ALPHA_LANES = 0x8888;
+
+AF_TARGET("avx512f")
+auto apply_table_avx512(const float* table, float* rgba, size_t count)
+    -> void {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const auto pixels = _mm512_loadu_ps(rgba + i * 4);
+    const auto clamped = _mm512_min_ps(
+        _mm512_max_ps(pixels, _mm512_setzero_ps()), _mm512_set1_ps(1.0F));
+    const auto position =
+        _mm512_mul_ps(clamped, _mm512_set1_ps(SRGB_TABLE_SIZE));
+    const auto index = _mm512_min_epi32(
+        _mm512_cvttps_epi32(position), _mm512_set1_epi32(SRGB_TABLE_SIZE - 1));
+    const auto fraction = _mm512_sub_ps(position, _mm512_cvtepi32_ps(index));
+    const auto low = _mm512_i32gather_ps(index, table, 4);
+    const auto high = _mm512_i32gather_ps(index, table + 1, 4);
+    const auto result =
+        _mm512_add_ps(low, _mm512_mul_ps(fraction, _mm512_sub_ps(high, low)));
+    _mm512_storeu_ps(rgba + i * 4,
+                     _mm512_mask_blend_ps(ALPHA_LANES, result, pixels));
+  }
+  apply_table_scalar(table, rgba + i * 4, count - i);
+}
+
+AF_TARGET("avx512f")
+auto srgb_to_linear_avx512(float* rgba, size_t count) -> void {
+  apply_table_avx512(get_srgb_tables().to_linear.data(), rgba, count);
+}
+
+AF_TARGET("avx512f")
+auto linear_to_srgb_avx512(float* rgba, size_t count) -> void {
+  apply_table_avx512(get_srgb_tables().to_srgb.data(), rgba, count);
+}
+
+AF_TARGET("avx512f")
+auto premultiply_avx512(float* rgba, size_t count) -> void {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const auto pixels = _mm512_loadu_ps(rgba + i * 4);
+    const auto alpha = _mm512_permute_ps(pixels, _MM_SHUFFLE(3, 3, 3, 3));
+    _mm512_storeu_ps(rgba + i * 4,
+                     _mm512_mask_blend_ps(ALPHA_LANES,
+                                          _mm512_mul_ps(pixels, alpha),
+                                          pixels));
+  }
+  premultiply_scalar(rgba + i * 4, count - i);
+}
+
+AF_TARGET("avx512f")
+auto unpremultiply_avx512(float* rgba, size_t count) -> void {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const auto pixels = _mm512_loadu_ps(rgba + i * 4);
+    const auto alpha = _mm512_permute_ps(pixels, _MM_SHUFFLE(3, 3, 3, 3));
+    const auto visible =
+        _mm512_cmp_ps_mask(alpha, _mm512_setzero_ps(), _CMP_GT_OQ);
+    const auto color = _mm512_maskz_div_ps(visible, pixels, alpha);
+    _mm512_storeu_ps(rgba + i * 4,
+                     _mm512_mask_blend_ps(ALPHA_LANES, color, pixels));
+  }
+  unpremultiply_scalar(rgba + i * 4, count - i);
+}
+
+constexpr auto AVX512_KERNELS = Kernels{
+    u8_to_float_avx512,    u16_to_float_avx512,   half_to_float_avx512,
+    float_to_u8_avx512,    float_to_u16_avx512,   float_to_half_avx512,
+    srgb_to_linear_avx512, linear_to_srgb_avx512, premultiply_avx512,
+    unpremultiply_avx512,  expand_sse4,           contract_sse4};
+#endif
+
+auto detect_simd_level() -> SimdLevel {
+#if defined(AF_X86) && defined(_MSC_VER) && !defined(__clang__)
+  auto info = std::array<int, 4>();
+  __cpuid(info.data(), 0);
+  const auto max_leaf = info[0];
+  __cpuidex(info.data(), 1, 0);
+  const auto sse4 = (info[2] & (1 << 19)) != 0;
+  const auto os_saves_avx = (info[2] & (1 << 27)) != 0;
+  const auto f16c = (info[2] & (1 << 29)) != 0;
+  // Whether the OS saves the YMM and ZMM registers on context switches.
+  const auto xcr0 = os_saves_avx ? _xgetbv(0) : 0;
+  const auto has_ymm = (xcr0 & 0x6) == 0x6;
+  const auto has_zmm = (xcr0 & 0xe6) == 0xe6;
+  auto avx2 = false;
+  auto avx512 = false;
+  if (max_leaf >= 7) {
+    __cpuidex(info.data(), 7, 0);
+    avx2 = (info[1] & (1 << 5)) != 0;
+    avx512 = (info[1] & (1 << 16)) != 0;
+  }
+  if (avx512 && f16c && has_zmm) {
+    return SimdLevel::AVX512;
+  }
+  if (avx2 && f16c && has_ymm) {
+    return SimdLevel::AVX2;
+  }
+  if (sse4) {
+    return SimdLevel::SSE4;
+  }
+#elif defined(AF_X86)
+  // Also checks that the OS saves the wider registers.
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return SimdLevel::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return SimdLevel::AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return SimdLevel::SSE4;
+  }
+#endif
+  return SimdLevel::SCALAR;
+}
+
+auto get_kernels(SimdLevel level) -> const Kernels* {
+#if defined(AF_X86)
+  switch (level) {
+    case SimdLevel::AVX512:
+      return &AVX512_KERNELS;
+    case SimdLevel::AVX2:
+      return &AVX2_KERNELS;
+    case SimdLevel::SSE4:
+      return &SSE4_KERNELS;
+    case SimdLevel::SCALAR:
+      break;
+  }
+#endif
+  return &SCALAR_KERNELS;
+}
+
+struct Dispatch {
+  std::atomic<SimdLevel> level{get_supported_simd_level()};
+  std::atomic<const Kernels*> kernels{get_kernels(get_supported_simd_level())};
+};
+
+auto get_dispatch() -> Dispatch& {
+  static auto dispatch = Dispatch();
+  return dispatch;
+}
+
+auto to_float(const Kernels& kernels, const uint8_t* source, ChannelType type,
+              float* destination, size_t count) -> void {
+  switch (type) {
+    case ChannelType::UINT8:
+      kernels.u8_to_float(source, destination, count);
+      break;
+    case ChannelType::UINT16:
+      kernels.u16_to_float(reinterpret_cast<const uint16_t*>(source),
+                           destination, count);
+      break;
+    case ChannelType::FLOAT16:
+      kernels.half_to_float(reinterpret_cast<const uint16_t*>(source),
+                            destination, count);
+      break;
+    case ChannelType::FLOAT32:
+      std::memcpy(destination, source, count * sizeof(float));
+      break;
+  }
+}
+
+auto from_float(const Kernels& kernels, const float* source,
+                ChannelType type, uint8_t* destination, size_t count)
+    -> void {
+  switch (type) {
+    case ChannelType::UINT8:
+      kernels.float_to_u8(source, destination, count);
+      break;
+    case ChannelType::UINT16:
+      kernels.float_to_u16(source, reinterpret_cast<uint16_t*>(destination),
+                           count);
+      break;
+    case ChannelType::FLOAT16:
+      kernels.float_to_half(source, reinterpret_cast<uint16_t*>(destination),
+                            count);
+      break;
+    case ChannelType::FLOAT32:
+      std::memcpy(destination, source, count * sizeof(float));
+      break;
+  }
+}
+}  // namespace
+
+auto get_supported_simd_level() -> SimdLevel {
+  static const auto level = detect_simd_level();
+  return level;
+}
+
+auto get_simd_level() -> SimdLevel {
+  return get_dispatch().level.load(std::memory_order_relaxed);
+}
+
+auto set_simd_level(SimdLevel level) -> void {
+  level = std::min(level, get_supported_simd_level());
+  auto& dispatch = get_dispatch();
+  dispatch.level.store(level, std::memory_order_relaxed);
+  dispatch.kernels.store(get_kernels(level), std::memory_order_relaxed);
+}
+
+auto convert_pixels(const void* source, const PixelFormat& source_format,
+                    void* destination, const PixelFormat& destination_format,
+                    size_t count) -> void {
+  AF_ASSERT_MSG(source_format.channels >= 1 && source_format.channels <= 4 &&
+                    destination_format.channels >= 1 &&
+                    destination_format.channels <= 4,
+                "Pixels have one to four channels")
+  const auto* input = static_cast<const uint8_t*>(source);
+  auto* output = static_cast<uint8_t*>(destination);
+  if (source_format == destination_format) {
+    std::memcpy(output, input, count * source_format.get_pixel_size());
+    return;
+  }
+
+  const auto& kernels =
+      *get_dispatch().kernels.load(std::memory_order_relaxed);
+  const auto has_alpha = source_format.has_alpha();
+  const auto unpremultiply = has_alpha && source_format.premultiplied &&
+                             !destination_format.premultiplied;
+  const auto premultiply = has_alpha && !source_format.premultiplied &&
+                           destination_format.premultiplied;
+  // Values stay encoded when only the type or channels change, so sRGB
+  // images convert without the error of the tables.
+  const auto transfer = source_format.color_space !=
+                            destination_format.color_space ||
+                        unpremultiply || premultiply;
+  const auto linearize =
+      transfer && source_format.color_space == ColorSpace::SRGB;
+  const auto encode =
+      transfer && destination_format.color_space == ColorSpace::SRGB;
+  // Only the type changes, every value is converted on its own.
+  const auto is_per_value =
+      !transfer && source_format.channels == destination_format.channels;
+
+  alignas(64) auto rgba = std::array<float, BLOCK_SIZE * 4>();
+  alignas(64) auto channels = std::array<float, BLOCK_SIZE * 4>();
+  for (size_t begin = 0; begin < count; begin += BLOCK_SIZE) {
+    const auto size = std::min(BLOCK_SIZE, count - begin);
+    const auto* block_input = input + begin * source_format.get_pixel_size();
+    auto* block_output =
+        output + begin * destination_format.get_pixel_size();
+    if (is_per_value) {
+      const auto values = size * static_cast<size_t>(source_format.channels);
+      to_float(kernels, block_input, source_format.type, rgba.data(),
+               values);
+      from_float(kernels, rgba.data(), destination_format.type, block_output,
+                 values);
+      continue;
+    }
+
+    if (source_format.channels == 4) {
+      to_float(kernels, block_input, source_format.type, rgba.data(),
+               size * 4);
+    } else {
+      to_float(kernels, block_input, source_format.type, channels.data(),
+               size * source_format.channels);
+      kernels.expand(channels.data(), source_format.channels, rgba.data(),
+                     size);
+    }
+    if (linearize) {
+      kernels.srgb_to_linear(rgba.data(), size);
+    }
+    if (unpremultiply) {
+      kernels.unpremultiply(rgba.data(), size);
+    }
+    if (premultiply) {
+      kernels.premultiply(rgba.data(), size);
+    }
+    if (encode) {
+      kernels.linear_to_srgb(rgba.data(), size);
+    }
+    if (destination_format.channels == 4) {
+      from_float(kernels, rgba.data(), destination_format.type, block_output,
+                 size * 4);
+    } else {
+      kernels.contract(rgba.data(), channels.data(),
+                       destination_format.channels, size);
+      from_float(kernels, channels.data(), destination_format.type,
+                 block_output, size * destination_format.channels);
+    }
+  }
+}
+
+auto convert_image(const ImageBuffer& image, const PixelFormat& format)
+    -> ImageBuffer {
+  // Shares the pixels instead of copying them.
+  if (image.get_format() == format) {
+    return image;
+  }
+  auto result = ImageBuffer(format, image.get_width(), image.get_height());
+  auto* data = result.get_mutable_data();
+  if (image.is_packed()) {
+    convert_pixels(image.get_data(), image.get_format(), data, format,
+                   static_cast<size_t>(image.get_width()) *
+                       image.get_height());
+    return result;
+  }
+  for (int y = 0; y < image.get_height(); ++y) {
+    convert_pixels(image.get_row(y), image.get_format(),
+                   data + result.get_stride() * y, format,
+                   static_cast<size_t>(image.get_width()));
+  }
+  return result;
+}
+
+auto float_to_half(float value) -> uint16_t {
+  auto bits = std::bit_cast<uint32_t>(value);
+  const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  bits &= 0x7fffffff;
+  if (bits >= 0x7f800000) {
+    // Infinity stays infinite and NaN stays a quiet NaN.
+    const auto nan_bits =
+        bits > 0x7f800000 ? 0x200 | ((bits >> 13) & 0x3ff) : 0;
+    return static_cast<uint16_t>(sign | 0x7c00 | nan_bits);
+  }
+  // 65520 and above round to infinity.
+  if (bits >= 0x477ff000) {
+    return static_cast<uint16_t>(sign | 0x7c00);
+  }
+  // Below 2^-14 is subnormal, multiples of 2^-24, which lrint rounds to
+  // nearest even.
+  if (bits < 0x38800000) {
+    const auto magnitude = std::bit_cast<float>(bits) * 0x1p24F;
+    return static_cast<uint16_t>(sign | std::lrint(magnitude));
+  }
+  // Rebiases the exponent and rounds the mantissa to nearest even, a carry
+  // moves into the exponent.
+  const auto rounded = bits + 0xfff + ((bits >> 13) & 1);
+  return static_cast<uint16_t>(sign | ((rounded - 0x38000000) >> 13));
+}
+
+auto half_to_float(uint16_t value) -> float {
+  const auto sign = static_cast<uint32_t>(value & 0x8000) << 16;
+  const auto exponent = static_cast<uint32_t>(value >> 10) & 0x1f;
+  const auto mantissa = static_cast<uint32_t>(value) & 0x3ff;
+  if (exponent == 0) {
+    const auto magnitude = static_cast<float>(mantissa) * 0x1p-24F;
+    return sign != 0 ? -magnitude : magnitude;
+  }
+  if (exponent == 0x1f) {
+    return std::bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+  }
+  return std::bit_cast<float>(sign | ((exponent + 112) << 23) |
+                              (mantissa << 13));
+}
+}  // namespace afro::core
@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "common/pixel_storage.h"
+
+#include <fmt/format.h>
+
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace afro::core {
+AlignedStorage::AlignedStorage(size_t size)
+    : data_(static_cast<uint8_t*>(
+          ::operator new(size > 0 ? size : 1, std::align_val_t(ALIGNMENT)))),
+      size_(size) {}
+
+AlignedStorage::~AlignedStorage() {
+  ::operator delete(data_, std::align_val_t(ALIGNMENT));
+}
+
+#if defined(_WIN32)
+MappedFileStorage::MappedFileStorage(const std::filesystem::path& path) {
+  // Like on POSIX, the file may be renamed or deleted while it's mapped.
+  auto* file = CreateFileW(path.c_str(), GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error(fmt::format("Can't open {}", path.string()));
+  }
+  auto file_size = LARGE_INTEGER();
+  GetFileSizeEx(file, &file_size);
+  size_ = static_cast<size_t>(file_size.QuadPart);
+  // Empty files can't be mapped.
+  if (size_ > 0) {
+    mapping_ = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_ != nullptr) {
+      data_ = static_cast<uint8_t*>(
+          MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    }
+  }
+  // The mapping keeps the file open.
+  CloseHandle(file);
+  if (size_ > 0 && data_ == nullptr) {
+    if (mapping_ != nullptr) {
+      CloseHandle(mapping_);
+    }
+    throw std::runtime_error(fmt::format("Can't map {}", path.string()));
+  }
+}
+
+MappedFileStorage::~MappedFileStorage() {
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_ != nullptr) {
+    CloseHandle(mapping_);
+  }
+}
+#else
+MappedFileStorage::MappedFileStorage(const std::filesystem::path& path) {
+  const auto file = open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    throw std::runtime_error(fmt::format("Can't open {}", path.string()));
+  }
+  struct stat status {};
+  if (fstat(file, &status) != 0) {
+    close(file);
+    throw std::runtime_error(fmt::format("Can't stat {}", path.string()));
+  }
+  size_ = static_cast<size_t>(status.st_size);
+  // Empty files can't be mapped.
+  if (size_ > 0) {
+    auto* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+    if (data == MAP_FAILED) {
+      close(file);
+      throw std::runtime_error(fmt::format("Can't map {}", path.string()));
+    }
+    data_ = static_cast<uint8_t*>(data);
+  }
+  // The mapping stays valid after the file is closed.
+  close(file);
+}
+
+MappedFileStorage::~MappedFileStorage() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+}
+#endif
+
+ExternalStorage::ExternalStorage(uint8_t* data, size_t size, bool writable,
+                                 std::function<void()> release)
+    : data_(data),
+      size_(size),
+      writable_(writable),
+      release_(std::move(release)) {}
+
+ExternalStorage::~ExternalStorage() {
+  if (release_) {
+    release_();
+  }
+}
+}  // namespace afro::core
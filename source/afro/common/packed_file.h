@@ -6,12 +6,161 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
 #include <vector>
 
 namespace afro::core {
+/**
+ * @brief Up to PackedFile::CHUNK_SIZE bytes of a packed file compressed on
+ * their own. Chunks are created by PackedChunkStore, which shares identical
+ * ones between all packed files.
+ */
+class PackedChunk {
+ private:
+  uint64_t id_;
+  uint64_t hash_;
+  size_t size_;
+  std::vector<uint8_t> compressed_;
+
+ public:
+  PackedChunk(uint64_t id, uint64_t hash, size_t size,
+              std::vector<uint8_t> compressed);
+  PackedChunk(const PackedChunk&) = delete;
+  auto operator=(const PackedChunk&) -> PackedChunk& = delete;
+  ~PackedChunk();
 
-struct PackedFile {
-  std::vector<uint8_t> bytes;
+  [[nodiscard]] auto get_id() const -> uint64_t { return id_; }
+  [[nodiscard]] auto get_hash() const -> uint64_t { return hash_; }
+  /**
+   * @brief Bytes once decompressed.
+   */
+  [[nodiscard]] auto get_size() const -> size_t { return size_; }
+  [[nodiscard]] auto get_compressed() const -> std::span<const uint8_t> {
+    return compressed_;
+  }
 };
 
-}  // namespace afro::core
\ No newline at end of file
+using PackedChunkPtr = std::shared_ptr<const PackedChunk>;
+
+/**
+ * @brief Compresses chunks with zstd, shares identical ones and keeps the
+ * most recently decompressed ones in memory. The least recently used are
+ * dropped once they take more than the memory budget.
+ */
+class PackedChunkStore {
+ public:
+  static constexpr int COMPRESSION_LEVEL = 3;
+  static constexpr size_t DEFAULT_MEMORY_BUDGET = size_t{256} << 20;
+
+ private:
+  using Bytes = std::shared_ptr<const std::vector<uint8_t>>;
+
+  struct Entry {
+    Bytes bytes;
+    std::list<uint64_t>::iterator use;
+  };
+
+  std::mutex mutex_;
+  uint64_t next_id_ = 1;
+  // Chunks by the hash of their compressed bytes, which are the same for
+  // the same bytes.
+  std::unordered_multimap<uint64_t, std::weak_ptr<const PackedChunk>>
+      chunks_;
+  // Decompressed chunks by id, uses_ starts with the most recently used.
+  std::unordered_map<uint64_t, Entry> decompressed_;
+  std::list<uint64_t> uses_;
+  size_t memory_usage_ = 0;
+  size_t memory_budget_ = DEFAULT_MEMORY_BUDGET;
+
+  // Called with mutex_ held.
+  auto evict() -> void;
+
+  friend PackedChunk;
+  // Forgets a chunk that's being destroyed.
+  auto remove(const PackedChunk& chunk) -> void;
+
+ public:
+  static auto get() -> PackedChunkStore&;
+
+  /**
+   * @brief Compresses @a bytes, or returns an identical chunk.
+   */
+  auto add(std::span<const uint8_t> bytes) -> PackedChunkPtr;
+  /**
+   * @brief Chunk of @a compressed bytes, e.g. read from a project, which
+   * are @a size bytes once decompressed.
+   */
+  auto add_compressed(std::vector<uint8_t> compressed, size_t size)
+      -> PackedChunkPtr;
+  /**
+   * @brief Bytes of @a chunk, which are decompressed unless cached.
+   *
+   * @throw std::runtime_error if the chunk is corrupt.
+   */
+  auto decompress(const PackedChunk& chunk) -> Bytes;
+
+  auto set_memory_budget(size_t bytes) -> void;
+  [[nodiscard]] auto get_memory_usage() -> size_t;
+  /**
+   * @brief Chunks alive in all packed files, shared ones counted once.
+   */
+  [[nodiscard]] auto get_chunk_count() -> size_t;
+  /**
+   * @brief Drops every decompressed chunk.
+   */
+  auto clear() -> void;
+};
+
+/**
+ * @brief The bytes of a file embedded in a project, stored as chunks of
+ * CHUNK_SIZE bytes that are decompressed when read. Copies share chunks.
+ */
+class PackedFile {
+ public:
+  static constexpr size_t CHUNK_SIZE = size_t{256} << 10;
+
+ private:
+  size_t size_ = 0;
+  std::vector<PackedChunkPtr> chunks_;
+
+ public:
+  PackedFile() = default;
+  /**
+   * @brief Compresses @a bytes, the chunks in parallel.
+   */
+  explicit PackedFile(std::span<const uint8_t> bytes);
+  /**
+   * @brief Packed file of @a chunks, all but the last of CHUNK_SIZE bytes.
+   *
+   * @throw std::runtime_error if a chunk is empty or doesn't fit that.
+   */
+  explicit PackedFile(std::vector<PackedChunkPtr> chunks);
+
+  [[nodiscard]] auto get_size() const -> size_t { return size_; }
+  [[nodiscard]] auto get_compressed_size() const -> size_t;
+  [[nodiscard]] auto get_chunks() const -> const std::vector<PackedChunkPtr>& {
+    return chunks_;
+  }
+
+  /**
+   * @brief Copies the bytes from @a offset into @a bytes, decompressing the
+   * chunks they're in in parallel.
+   *
+   * @throw std::out_of_range if the bytes are past the end.
+   * @throw std::runtime_error if a chunk is corrupt.
+   */
+  auto read(size_t offset, std::span<uint8_t> bytes) const -> void;
+  /**
+   * @brief All bytes.
+   *
+   * @throw std::runtime_error if a chunk is corrupt.
+   */
+  [[nodiscard]] auto unpack() const -> std::vector<uint8_t>;
+};
+}  // namespace afro::core
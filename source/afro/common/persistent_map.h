@@ -0,0 +1,286 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace afro::core {
+/**
+ * @brief An immutable hash map, set() and erase() return a new map that
+ * shares everything but the path to the changed key with the old one.
+ *
+ * It's a hash array mapped trie: each level picks one of 32 children by 5
+ * bits of the hash and only stores the children that exist. Changing a key
+ * copies at most 13 small nodes, copying the map copies a pointer. Nodes
+ * are never modified once shared, so maps can be read from any thread while
+ * others derive new maps from them.
+ */
+template <typename K, typename V, typename Hash = std::hash<K>>
+class PersistentMap {
+ private:
+  static constexpr unsigned BITS = 5;
+  static constexpr uint64_t MASK = (1U << BITS) - 1;
+  static constexpr unsigned HASH_BITS = 64;
+
+  struct Node;
+  using NodePtr = std::shared_ptr<const Node>;
+
+  struct Leaf {
+    uint64_t hash;
+    K key;
+    V value;
+  };
+
+  // Children are ordered by their bit in bitmap. Once the hash is used up,
+  // keys with the same hash are kept as leaves of a collision node.
+  struct Node {
+    uint32_t bitmap = 0;
+    bool collision = false;
+    std::vector<std::variant<Leaf, NodePtr>> children;
+  };
+
+  NodePtr root_;
+  size_t size_ = 0;
+
+  PersistentMap(NodePtr root, size_t size)
+      : root_(std::move(root)), size_(size) {}
+
+  static auto hash(const K& key) -> uint64_t {
+    // Hashes of integers are often the integer, mixed so keys that only
+    // differ in high bits don't share a long path.
+    auto value = static_cast<uint64_t>(Hash()(key));
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    return value;
+  }
+  static auto bit_of(uint64_t hash, unsigned shift) -> uint32_t {
+    return uint32_t{1} << ((hash >> shift) & MASK);
+  }
+  static auto index_of(const Node& node, uint32_t bit) -> size_t {
+    return std::popcount(node.bitmap & (bit - 1));
+  }
+
+  // A node holding @a a and @a b, which differ in their keys.
+  static auto merge(Leaf a, Leaf b, unsigned shift) -> NodePtr {
+    auto node = std::make_shared<Node>();
+    if (shift >= HASH_BITS) {
+      node->collision = true;
+      node->children.emplace_back(std::move(a));
+      node->children.emplace_back(std::move(b));
+      return node;
+    }
+    const auto bit_a = bit_of(a.hash, shift);
+    const auto bit_b = bit_of(b.hash, shift);
+    node->bitmap = bit_a | bit_b;
+    if (bit_a == bit_b) {
+      node->children.emplace_back(
+          merge(std::move(a), std::move(b), shift + BITS));
+    } else if (bit_a < bit_b) {
+      node->children.emplace_back(std::move(a));
+      node->children.emplace_back(std::move(b));
+    } else {
+      node->children.emplace_back(std::move(b));
+      node->children.emplace_back(std::move(a));
+    }
+    return node;
+  }
+
+  static auto set(const NodePtr& node, unsigned shift, Leaf leaf,
+                  bool& added) -> NodePtr {
+    if (node == nullptr) {
+      added = true;
+      auto created = std::make_shared<Node>();
+      created->bitmap = bit_of(leaf.hash, shift);
+      created->children.emplace_back(std::move(leaf));
+      return created;
+    }
+    auto copy = std::make_shared<Node>(*node);
+    if (node->collision) {
+      for (auto& child : copy->children) {
+        auto& existing = std::get<Leaf>(child);
+        if (existing.key == leaf.key) {
+          existing.value = std::move(leaf.value);
+          return copy;
+        }
+      }
+      added = true;
+      copy->children.emplace_back(std::move(leaf));
+      return copy;
+    }
+
+    const auto bit = bit_of(leaf.hash, shift);
+    const auto index = index_of(*node, bit);
+    if ((node->bitmap & bit) == 0) {
+      added = true;
+      copy->bitmap |= bit;
+      copy->children.emplace(copy->children.begin() + index, std::move(leaf));
+      return copy;
+    }
+    auto& child = copy->children[index];
+    if (auto* child_node = std::get_if<NodePtr>(&child)) {
+      child = set(*child_node, shift + BITS, std::move(leaf), added);
+    } else if (auto& existing = std::get<Leaf>(child);
+               existing.key == leaf.key) {
+      existing.value = std::move(leaf.value);
+    } else {
+      added = true;
+      child = merge(existing, std::move(leaf), shift + BITS);
+    }
+    return copy;
+  }
+
+  // The node without @a key, nullptr if it's left empty.
+  static auto erase(const NodePtr& node, unsigned shift, uint64_t hash,
+                    const K& key, bool& removed) -> NodePtr {
+    auto index = size_t{0};
+    if (node->collision) {
+      while (index < node->children.size() &&
+             std::get<Leaf>(node->children[index]).key != key) {
+        ++index;
+      }
+      if (index == node->children.size()) {
+        return node;
+      }
+    } else {
+      const auto bit = bit_of(hash, shift);
+      if ((node->bitmap & bit) == 0) {
+        return node;
+      }
+      index = index_of(*node, bit);
+      const auto& child = node->children[index];
+      if (const auto* child_node = std::get_if<NodePtr>(&child)) {
+        auto erased = erase(*child_node, shift + BITS, hash, key, removed);
+        if (erased == *child_node) {
+          return node;
+        }
+        if (erased != nullptr) {
+          auto copy = std::make_shared<Node>(*node);
+          // A lone leaf moves up, so lookups don't walk through chains.
+          if (erased->children.size() == 1 &&
+              std::holds_alternative<Leaf>(erased->children.front())) {
+            copy->children[index] = erased->children.front();
+          } else {
+            copy->children[index] = std::move(erased);
+          }
+          return copy;
+        }
+      } else if (std::get<Leaf>(child).key != key) {
+        return node;
+      }
+    }
+
+    removed = true;
+    if (node->children.size() == 1) {
+      return nullptr;
+    }
+    auto copy = std::make_shared<Node>(*node);
+    if (!node->collision) {
+      copy->bitmap &= ~bit_of(hash, shift);
+    }
+    copy->children.erase(copy->children.begin() + index);
+    return copy;
+  }
+
+  template <typename F>
+  static auto for_each(const Node& node, F& function) -> void {
+    for (const auto& child : node.children) {
+      if (const auto* leaf = std::get_if<Leaf>(&child)) {
+        function(leaf->key, leaf->value);
+      } else {
+        for_each(*std::get<NodePtr>(child), function);
+      }
+    }
+  }
+
+ public:
+  PersistentMap() = default;
+
+  [[nodiscard]] auto size() const -> size_t { return size_; }
+  [[nodiscard]] auto empty() const -> bool { return size_ == 0; }
+
+  /**
+   * @brief The value of @a key, nullptr if there's none. It lives as long as
+   * any map that holds it.
+   */
+  [[nodiscard]] auto find(const K& key) const -> const V* {
+    const auto key_hash = hash(key);
+    const auto* node = root_.get();
+    for (unsigned shift = 0; node != nullptr; shift += BITS) {
+      if (node->collision) {
+        for (const auto& child : node->children) {
+          const auto& leaf = std::get<Leaf>(child);
+          if (leaf.key == key) {
+            return &leaf.value;
+          }
+        }
+        return nullptr;
+      }
+      const auto bit = bit_of(key_hash, shift);
+      if ((node->bitmap & bit) == 0) {
+        return nullptr;
+      }
+      const auto& child = node->children[index_of(*node, bit)];
+      if (const auto* leaf = std::get_if<Leaf>(&child)) {
+        return leaf->key == key ? &leaf->value : nullptr;
+      }
+      node = std::get<NodePtr>(child).get();
+    }
+    return nullptr;
+  }
+  [[nodiscard]] auto contains(const K& key) const -> bool {
+    return find(key) != nullptr;
+  }
+
+  /**
+   * @brief A map where @a key is @a value.
+   */
+  [[nodiscard]] auto set(const K& key, V value) const -> PersistentMap {
+    auto added = false;
+    auto root = set(root_, 0, Leaf{hash(key), key, std::move(value)}, added);
+    return {std::move(root), size_ + (added ? 1 : 0)};
+  }
+  /**
+   * @brief A map without @a key, which shares everything with this one if
+   * there's no @a key.
+   */
+  [[nodiscard]] auto erase(const K& key) const -> PersistentMap {
+    if (root_ == nullptr) {
+      return *this;
+    }
+    auto removed = false;
+    auto root = erase(root_, 0, hash(key), key, removed);
+    return {std::move(root), size_ - (removed ? 1 : 0)};
+  }
+
+  /**
+   * @brief Calls @a function with each key and value in no particular
+   * order.
+   */
+  template <typename F>
+  auto for_each(F function) const -> void {
+    if (root_ != nullptr) {
+      for_each(*root_, function);
+    }
+  }
+
+  /**
+   * @brief Whether both maps are the same version, which is cheaper than
+   * comparing them and enough to tell that nothing changed.
+   */
+  [[nodiscard]] auto is_same(const PersistentMap& other) const -> bool {
+    return root_ == other.root_;
+  }
+};
+}  // namespace afro::core
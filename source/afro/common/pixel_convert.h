@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "common/image_texture.h"
+#include "common/pixel_format.h"
+
+namespace afro::core {
+/**
+ * @brief Instruction sets the converters have kernels for, in increasing
+ * order. AVX2 kernels also use F16C.
+ */
+enum class SimdLevel { SCALAR, SSE4, AVX2, AVX512 };
+
+/**
+ * @brief The best level the CPU and OS support.
+ */
+auto get_supported_simd_level() -> SimdLevel;
+auto get_simd_level() -> SimdLevel;
+/**
+ * @brief Makes the converters use the kernels of @a level, lowered to the
+ * supported level. Meant for tests and benchmarks, the supported level is
+ * used by default.
+ */
+auto set_simd_level(SimdLevel level) -> void;
+
+/**
+ * @brief Converts @a count pixels between any two formats.
+ *
+ * Missing channels are filled in, gray is copied to RGB and alpha is opaque.
+ * Dropped channels are discarded, gray takes the red channel. Integers map
+ * to [0, 1] and values are clamped to that range when written as integers.
+ * The sRGB transfer function is applied through tables, which are exact to
+ * 8 bits and to within one step at 16 bits, and clamps to [0, 1].
+ * Premultiplication happens in linear space.
+ *
+ * The kernels of every SimdLevel give the same integers and floats within
+ * rounding.
+ */
+auto convert_pixels(const void* source, const PixelFormat& source_format,
+                    void* destination, const PixelFormat& destination_format,
+                    size_t count) -> void;
+
+/**
+ * @brief @a image converted to @a format, sharing its pixels if it already
+ * has that format.
+ */
+auto convert_image(const ImageBuffer& image, const PixelFormat& format)
+    -> ImageBuffer;
+
+auto float_to_half(float value) -> uint16_t;
+auto half_to_float(uint16_t value) -> float;
+}  // namespace afro::core
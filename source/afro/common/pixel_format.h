@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace afro::core {
+enum class ChannelType : uint8_t { UINT8, UINT16, FLOAT16, FLOAT32 };
+
+enum class ColorSpace : uint8_t {
+  LINEAR,
+  // The sRGB transfer function applies to the color channels, alpha is
+  // always linear.
+  SRGB
+};
+
+/**
+ * @brief Layout and meaning of the pixels of an image. Channels are
+ * interleaved in R, G, B, A order, so one channel is gray and two are gray
+ * and alpha.
+ */
+struct PixelFormat {
+  int channels = 4;
+  ChannelType type = ChannelType::UINT8;
+  ColorSpace color_space = ColorSpace::LINEAR;
+  // Whether the color channels are multiplied by alpha.
+  bool premultiplied = false;
+
+  [[nodiscard]] constexpr auto get_channel_size() const -> size_t {
+    switch (type) {
+      case ChannelType::UINT8:
+        return 1;
+      case ChannelType::UINT16:
+      case ChannelType::FLOAT16:
+        return 2;
+      case ChannelType::FLOAT32:
+        return 4;
+    }
+    return 0;
+  }
+  [[nodiscard]] constexpr auto get_bit_depth() const -> int {
+    return static_cast<int>(get_channel_size()) * 8;
+  }
+  [[nodiscard]] constexpr auto get_pixel_size() const -> size_t {
+    return get_channel_size() * static_cast<size_t>(channels);
+  }
+  [[nodiscard]] constexpr auto is_float() const -> bool {
+    return type == ChannelType::FLOAT16 || type == ChannelType::FLOAT32;
+  }
+  [[nodiscard]] constexpr auto has_alpha() const -> bool {
+    return channels == 2 || channels == 4;
+  }
+
+  constexpr auto operator==(const PixelFormat& other) const -> bool = default;
+};
+
+namespace formats {
+inline constexpr PixelFormat r8{1, ChannelType::UINT8};
+inline constexpr PixelFormat rgb8{3, ChannelType::UINT8};
+inline constexpr PixelFormat rgba8{4, ChannelType::UINT8};
+inline constexpr PixelFormat srgb8{3, ChannelType::UINT8, ColorSpace::SRGB};
+inline constexpr PixelFormat srgba8{4, ChannelType::UINT8, ColorSpace::SRGB};
+inline constexpr PixelFormat r16{1, ChannelType::UINT16};
+inline constexpr PixelFormat rgb16{3, ChannelType::UINT16};
+inline constexpr PixelFormat rgba16{4, ChannelType::UINT16};
+inline constexpr PixelFormat r16f{1, ChannelType::FLOAT16};
+inline constexpr PixelFormat rgb16f{3, ChannelType::FLOAT16};
+inline constexpr PixelFormat rgba16f{4, ChannelType::FLOAT16};
+inline constexpr PixelFormat r32f{1, ChannelType::FLOAT32};
+inline constexpr PixelFormat rgb32f{3, ChannelType::FLOAT32};
+inline constexpr PixelFormat rgba32f{4, ChannelType::FLOAT32};
+}  // namespace formats
+}  // namespace afro::core
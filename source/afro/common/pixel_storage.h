@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+
+namespace afro::core {
+/**
+ * @brief Memory holding pixels, shared by every ImageBuffer viewing it and
+ * freed with the last one.
+ */
+class PixelStorage {
+ public:
+  PixelStorage() = default;
+  PixelStorage(const PixelStorage&) = delete;
+  auto operator=(const PixelStorage&) -> PixelStorage& = delete;
+  virtual ~PixelStorage() = default;
+
+  [[nodiscard]] virtual auto get_data() const -> uint8_t* = 0;
+  [[nodiscard]] virtual auto get_size() const -> size_t = 0;
+  /**
+   * @brief Whether the pixels may be changed in place, ImageBuffer copies
+   * them before writing otherwise.
+   */
+  [[nodiscard]] virtual auto is_writable() const -> bool = 0;
+};
+
+/**
+ * @brief Heap memory aligned to ALIGNMENT bytes, so SIMD kernels can use
+ * aligned loads from the start of every image.
+ */
+class AlignedStorage : public PixelStorage {
+ public:
+  static constexpr size_t ALIGNMENT = 64;
+
+ private:
+  uint8_t* data_;
+  size_t size_;
+
+ public:
+  /**
+   * @brief Uninitialized memory of @a size bytes.
+   */
+  explicit AlignedStorage(size_t size);
+  ~AlignedStorage() override;
+
+  [[nodiscard]] auto get_data() const -> uint8_t* override { return data_; }
+  [[nodiscard]] auto get_size() const -> size_t override { return size_; }
+  [[nodiscard]] auto is_writable() const -> bool override { return true; }
+};
+
+/**
+ * @brief A file mapped into memory read only, pages are read from disk
+ * when first accessed.
+ */
+class MappedFileStorage : public PixelStorage {
+ private:
+  uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+#if defined(_WIN32)
+  void* mapping_ = nullptr;
+#endif
+
+ public:
+  /**
+   * @throw std::runtime_error if the file can't be mapped.
+   */
+  explicit MappedFileStorage(const std::filesystem::path& path);
+  ~MappedFileStorage() override;
+
+  [[nodiscard]] auto get_data() const -> uint8_t* override { return data_; }
+  [[nodiscard]] auto get_size() const -> size_t override { return size_; }
+  [[nodiscard]] auto is_writable() const -> bool override { return false; }
+};
+
+/**
+ * @brief Memory owned by someone else, e.g. a mapped GPU buffer. @a release
+ * is called once no image views it anymore.
+ */
+class ExternalStorage : public PixelStorage {
+ private:
+  uint8_t* data_;
+  size_t size_;
+  bool writable_;
+  std::function<void()> release_;
+
+ public:
+  ExternalStorage(uint8_t* data, size_t size, bool writable,
+                  std::function<void()> release = nullptr);
+  ~ExternalStorage() override;
+
+  [[nodiscard]] auto get_data() const -> uint8_t* override { return data_; }
+  [[nodiscard]] auto get_size() const -> size_t override { return size_; }
+  [[nodiscard]] auto is_writable() const -> bool override {
+    return writable_;
+  }
+};
+}  // namespace afro::core
@@ -90,8 +90,9 @@ auto draw_color_curve_editor(ColorCurve& color_curve) -> bool {
   const auto curve_thickness = 2.0F;
   bool has_any_curve_changed = false;
 
-  // Start the color curve editor.
-  PushID(&color_curve);
+  // Start the color curve editor. The curve may be a copy, so its address
+  // isn't a stable id.
+  PushID("color_curve");
 
   auto const [cr, col] = draw_curve_selector(color_curve, curve_colors);
   BezierSpline* curve = cr;
@@ -18,7 +18,8 @@ namespace afro {
 auto get_root_component()
     -> fruit::Component<undo::UndoStack, undo::DebugWindow, store::Data,
                         store::Outliner, ui::Window, property::PropertyEditor,
-                        graph::material::MaterialEditor> {
+                        graph::material::MaterialEditor,
+                        graph::material::NodeDefinitions> {
   return fruit::createComponent()
       .install(undo::getUndoComponent)
       .install(store::getStoreComponent)
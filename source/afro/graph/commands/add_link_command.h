@@ -24,6 +24,9 @@ class AddLinkCommand : public Command {
 
   auto execute() -> void override { graph_->add_link(link); }
   auto undo() -> void override { graph_->remove_link(link); }
+  [[nodiscard]] auto get_memory_usage() const -> size_t override {
+    return sizeof(*this);
+  }
   ~AddLinkCommand() override = default;
 };
 
@@ -32,6 +32,11 @@ class AddNode : public Command {
 
   auto execute() -> void override { graph->add_node(node); }
   auto undo() -> void override { graph->remove_node_by_uuid(node->get_uuid()); }
+  // The node is shared with the graph, only the copy of its definition is
+  // the command's own.
+  [[nodiscard]] auto get_memory_usage() const -> size_t override {
+    return sizeof(*this) + node_definition.get_shader_code().capacity();
+  }
   ~AddNode() override = default;
 };
 
@@ -27,6 +27,9 @@ class DeleteLinks : public Command {
 
   auto execute() -> void override { graph_->remove_links(links_); }
   auto undo() -> void override { graph_->add_links(links_); }
+  [[nodiscard]] auto get_memory_usage() const -> size_t override {
+    return sizeof(*this) + links_.capacity() * sizeof(Link);
+  }
   ~DeleteLinks() override = default;
 };
 
@@ -7,54 +7,109 @@
 #include "graph.h"
 
 #include <algorithm>
-#include <ranges>
+#include <stdexcept>
+#include <utility>
 
-namespace views = std::ranges::views;
+#include "utils/assert.h"
 
 namespace afro::graph {
 
 auto Graph::add_node(std::shared_ptr<Node> node) -> void {
   nodes.push_back(node);
-  node_added(std::move(node));
+  const auto uuid = node->get_uuid();
+  nodes_by_uuid[uuid] = node;
+  auto& connections = node_connections[uuid];
+  connections[0] = node->on_invalidate.connect([this, uuid]() {
+    node_changed(uuid);
+    bump_version();
+    if (!pending_added_nodes.contains(uuid)) {
+      pending_changed_nodes.insert(uuid);
+    }
+    end_edit();
+  });
+  connections[1] =
+      node->on_moved.connect([this, uuid]() { node_changed(uuid); });
+  node_changed(uuid);
+  bump_structure_version();
+  // Adding back a node removed in the same transaction is a change.
+  if (pending_removed_nodes.erase(uuid) == 0) {
+    pending_added_nodes[uuid] = std::move(node);
+  } else {
+    pending_changed_nodes.insert(uuid);
+  }
+  end_edit();
 }
 
 auto Graph::remove_node_by_uuid(const UUID& uuid) -> void {
-  auto iter = std::remove_if(nodes.begin(), nodes.end(),
-                             [&uuid](const std::shared_ptr<Node>& node) {
-                               return node->get_uuid() == uuid;
-                             });
-  std::shared_ptr<Node> node = *iter;
-  nodes.erase(iter);
-  node_removed(std::move(node));
-  // TODO: Remove links
+  auto found = nodes_by_uuid.find(uuid);
+  if (found == nodes_by_uuid.end()) {
+    return;
+  }
+  // The links go with the node, observers see both in one change.
+  begin_transaction();
+  auto node_links = get_links_to_node(uuid);
+  for (const auto& link : get_links_from_node(uuid)) {
+    // A link from the node to itself is in both lists.
+    if (link.get_to_node() != uuid) {
+      node_links.push_back(link);
+    }
+  }
+  for (const auto& link : node_links) {
+    remove_link(link);
+  }
+  // Taken before remove_if, which leaves moved from pointers behind.
+  auto node = std::move(found->second);
+  nodes_by_uuid.erase(found);
+  std::erase(nodes, node);
+  node_connections.erase(uuid);
+  node_changed(uuid, true);
+  bump_structure_version();
+  if (pending_added_nodes.erase(uuid) == 0) {
+    pending_removed_nodes[uuid] = std::move(node);
+  }
+  pending_changed_nodes.erase(uuid);
+  commit_transaction();
 }
 
 auto Graph::get_nodes() -> std::vector<std::shared_ptr<Node>>& { return nodes; }
 
 auto Graph::get_node_by_uuid(const UUID& uuid) -> std::shared_ptr<Node> {
-  auto it = std::find_if(nodes.begin(), nodes.end(),
-                         [&uuid](const std::shared_ptr<Node>& node) {
-                           return node->get_uuid() == uuid;
-                         });
-  return (it != nodes.end()) ? *it : nullptr;
+  auto it = nodes_by_uuid.find(uuid);
+  return (it != nodes_by_uuid.end()) ? it->second : nullptr;
 }
 
-auto Graph::get_links() const -> const std::vector<Link>& {
+auto Graph::get_links() -> const std::vector<Link>& {
+  erase_removed_links();
   return this->links;
 }
 
 auto Graph::add_link(Link link) -> void {
-  this->links.push_back(link);
-  link_added(link);
+  // A link removed in the same transaction is still in links.
+  if (unerased_links.erase(link.get_uuid()) == 0) {
+    this->links.push_back(link);
+  }
+  index_link(link);
+  link_changed(link, false);
+  bump_structure_version();
+  if (pending_removed_links.erase(link.get_uuid()) == 0) {
+    pending_added_links.insert_or_assign(link.get_uuid(), link);
+  }
+  end_edit();
 }
 
 auto Graph::remove_link(const Link& link) -> void {
-  auto it = std::remove(links.begin(), links.end(), link.get_uuid());
-  links.erase(it);
-  link_removed(link);
+  unerased_links.insert(link.get_uuid());
+  unindex_link(link);
+  link_changed(link, true);
+  bump_structure_version();
+  if (pending_added_links.erase(link.get_uuid()) == 0) {
+    pending_removed_links.insert_or_assign(link.get_uuid(), link);
+  }
+  end_edit();
 }
 
 auto Graph::get_link_by_uuid(const UUID uuid) -> Link {
+  erase_removed_links();
   auto it = std::find(links.begin(), links.end(), uuid);
 
   if (it != links.end()) {
@@ -65,16 +120,106 @@ auto Graph::get_link_by_uuid(const UUID uuid) -> Link {
 }
 
 auto Graph::get_links_to_node(const UUID uuid) -> std::vector<Link> {
-  auto res = links | views::filter(
-                         [&](Link link) { return link.get_to_node() == uuid; });
-  return {res.begin(), res.end()};
+  auto it = links_to_node.find(uuid);
+  return (it != links_to_node.end()) ? it->second : std::vector<Link>();
 }
 
 auto Graph::get_links_from_node(const UUID uuid) -> std::vector<Link> {
-  auto res = links | views::filter([&](Link link) {
-               return link.get_from_node() == uuid;
-             });
-  return {res.begin(), res.end()};
+  auto it = links_from_node.find(uuid);
+  return (it != links_from_node.end()) ? it->second : std::vector<Link>();
+}
+
+auto Graph::index_link(const Link& link) -> void {
+  links_to_node[link.get_to_node()].push_back(link);
+  links_from_node[link.get_from_node()].push_back(link);
+}
+
+auto Graph::unindex_link(const Link& link) -> void {
+  auto unindex = [&link](std::unordered_map<UUID, std::vector<Link>>& index,
+                         UUID node) {
+    auto it = index.find(node);
+    if (it == index.end()) {
+      return;
+    }
+    std::erase(it->second, link);
+    if (it->second.empty()) {
+      index.erase(it);
+    }
+  };
+  unindex(links_to_node, link.get_to_node());
+  unindex(links_from_node, link.get_from_node());
+}
+
+auto Graph::node_changed(UUID uuid, bool removed) -> void {
+  if (last_snapshot == nullptr) {
+    return;
+  }
+  if (removed && last_snapshot->get_node(uuid) == nullptr) {
+    // Added since the last snapshot.
+    unsnapshotted_nodes.erase(uuid);
+  } else {
+    unsnapshotted_nodes.insert(uuid);
+  }
+}
+
+auto Graph::link_changed(const Link& link, bool removed) -> void {
+  if (last_snapshot == nullptr) {
+    return;
+  }
+  if (!removed) {
+    unsnapshotted_links.insert_or_assign(link.get_uuid(), link);
+  } else if (last_snapshot->get_links().contains(link.get_uuid())) {
+    unsnapshotted_links.insert_or_assign(link.get_uuid(), std::nullopt);
+  } else {
+    unsnapshotted_links.erase(link.get_uuid());
+  }
+}
+
+auto Graph::snapshot() -> std::shared_ptr<const GraphSnapshot> {
+  if (last_snapshot == nullptr) {
+    // Everything is new to the first snapshot.
+    last_snapshot = std::make_shared<GraphSnapshot>(get_uuid());
+    for (const auto& node : nodes) {
+      unsnapshotted_nodes.insert(node->get_uuid());
+    }
+    for (const auto& link : links) {
+      unsnapshotted_links.insert_or_assign(link.get_uuid(), link);
+    }
+  }
+  if (unsnapshotted_nodes.empty() && unsnapshotted_links.empty()) {
+    return last_snapshot;
+  }
+
+  auto snapshot = std::make_shared<GraphSnapshot>(*last_snapshot);
+  snapshot->version_ = version;
+  snapshot->structure_version_ = structure_version;
+  for (const auto uuid : unsnapshotted_nodes) {
+    const auto node = get_node_by_uuid(uuid);
+    if (node == nullptr) {
+      snapshot->nodes_ = snapshot->nodes_.erase(uuid);
+      continue;
+    }
+    auto state = std::make_shared<NodeSnapshot>(
+        NodeSnapshot{uuid, std::string(node->get_name()), node->position, {}});
+    state->values.reserve(node->get_properties().size());
+    for (const auto& property : node->get_properties()) {
+      state->values.push_back(property.get_value());
+    }
+    snapshot->nodes_ = snapshot->nodes_.set(uuid, std::move(state));
+  }
+  for (const auto& [uuid, link] : unsnapshotted_links) {
+    if (link.has_value()) {
+      snapshot->add_link(*link);
+    } else if (const auto* removed = snapshot->links_.find(uuid)) {
+      snapshot->remove_link(*removed);
+    }
+  }
+  // Rather than clear(), which keeps the buckets of the first snapshot and
+  // would go through all of them every time.
+  unsnapshotted_nodes = std::unordered_set<UUID>();
+  unsnapshotted_links = std::unordered_map<UUID, std::optional<Link>>();
+  last_snapshot = snapshot;
+  return snapshot;
 }
 
 auto Graph::add_item(std::shared_ptr<GraphItem> item) -> void {
@@ -98,20 +243,114 @@ auto Graph::remove_item_by_uuid(UUID uuid) -> void {
 }
 
 auto Graph::add_links(const std::vector<Link>& links) -> void {
-  this->links.insert(this->links.end(), links.begin(), links.end());
+  begin_transaction();
+  for (const auto& link : links) {
+    add_link(link);
+  }
+  commit_transaction();
 }
+
 auto Graph::remove_links(const std::vector<Link>& links) -> void {
+  begin_transaction();
   for (const auto& link : links) {
-    this->remove_link(link);
+    remove_link(link);
   }
+  commit_transaction();
 }
+
 auto Graph::get_links_by_uuids(const std::vector<UUID>& uuids)
     -> std::vector<Link> {
+  erase_removed_links();
+  auto links_by_uuid = std::unordered_map<UUID, const Link*>();
+  links_by_uuid.reserve(links.size());
+  for (const auto& link : links) {
+    links_by_uuid.emplace(link.get_uuid(), &link);
+  }
   std::vector<Link> res;
+  res.reserve(uuids.size());
   for (const auto& uuid : uuids) {
-    res.push_back(this->get_link_by_uuid(uuid));
+    auto it = links_by_uuid.find(uuid);
+    if (it == links_by_uuid.end()) {
+      throw std::runtime_error("Link not found");
+    }
+    res.push_back(*it->second);
   }
   return res;
 }
 
+auto Graph::begin_transaction() -> void { ++transaction_depth; }
+
+auto Graph::commit_transaction() -> void {
+  AF_ASSERT_MSG(transaction_depth > 0, "No transaction to commit")
+  --transaction_depth;
+  end_edit();
+}
+
+auto Graph::erase_removed_links() -> void {
+  if (unerased_links.empty()) {
+    return;
+  }
+  std::erase_if(links, [this](const Link& link) {
+    return unerased_links.contains(link.get_uuid());
+  });
+  unerased_links = std::unordered_set<UUID>();
+}
+
+auto Graph::end_edit() -> void {
+  if (transaction_depth > 0) {
+    return;
+  }
+  erase_removed_links();
+  if (pending_added_nodes.empty() && pending_removed_nodes.empty() &&
+      pending_changed_nodes.empty() && pending_added_links.empty() &&
+      pending_removed_links.empty()) {
+    return;
+  }
+
+  // Taken out first, so slots can edit the graph again.
+  auto added_nodes = std::exchange(
+      pending_added_nodes, std::unordered_map<UUID, std::shared_ptr<Node>>());
+  auto removed_nodes = std::exchange(
+      pending_removed_nodes, std::unordered_map<UUID, std::shared_ptr<Node>>());
+  auto changed_nodes =
+      std::exchange(pending_changed_nodes, std::unordered_set<UUID>());
+  auto added_links =
+      std::exchange(pending_added_links, std::unordered_map<UUID, Link>());
+  auto removed_links =
+      std::exchange(pending_removed_links, std::unordered_map<UUID, Link>());
+
+  auto changes = GraphChanges();
+  for (auto& [uuid, node] : added_nodes) {
+    changes.added_nodes.push_back(std::move(node));
+  }
+  for (auto& [uuid, node] : removed_nodes) {
+    changes.removed_nodes.push_back(std::move(node));
+  }
+  for (const auto uuid : changed_nodes) {
+    if (auto node = get_node_by_uuid(uuid)) {
+      changes.changed_nodes.push_back(std::move(node));
+    }
+  }
+  for (auto& [uuid, link] : added_links) {
+    changes.added_links.push_back(std::move(link));
+  }
+  for (auto& [uuid, link] : removed_links) {
+    changes.removed_links.push_back(std::move(link));
+  }
+
+  for (const auto& link : changes.removed_links) {
+    link_removed(link);
+  }
+  for (const auto& node : changes.removed_nodes) {
+    node_removed(node);
+  }
+  for (const auto& node : changes.added_nodes) {
+    node_added(node);
+  }
+  for (const auto& link : changes.added_links) {
+    link_added(link);
+  }
+  changed(changes);
+}
+
 }  // namespace afro::graph
\ No newline at end of file
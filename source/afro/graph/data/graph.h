@@ -6,28 +6,96 @@
 
 #pragma once
 
+#include <array>
+#include <boost/signals2/connection.hpp>
 #include <boost/signals2/signal.hpp>
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "common/interfaces/object.h"
+#include "common/interfaces/transactional.h"
 #include "graph_item.h"
+#include "graph_snapshot.h"
 #include "link.h"
 #include "node.h"
 
 namespace afro::graph {
 
-class Graph : AfObject {
+/**
+ * @brief What a transaction changed in a graph. Edits it undid itself, like
+ * a link that was added and removed again, are left out.
+ */
+struct GraphChanges {
+  std::vector<std::shared_ptr<Node>> added_nodes;
+  std::vector<std::shared_ptr<Node>> removed_nodes;
+  // Nodes whose inputs changed, other than the added ones.
+  std::vector<std::shared_ptr<Node>> changed_nodes;
+  std::vector<Link> added_links;
+  std::vector<Link> removed_links;
+};
+
+class Graph : public AfObject, public Transactional {
+ private:
+  uint64_t version = 0;
+  uint64_t structure_version = 0;
+  // Changes and moves of each node.
+  std::unordered_map<UUID, std::array<boost::signals2::scoped_connection, 2>>
+      node_connections;
+  // Nodes and links by node, so lookups don't scan the whole graph.
+  std::unordered_map<UUID, std::shared_ptr<Node>> nodes_by_uuid;
+  std::unordered_map<UUID, std::vector<Link>> links_to_node;
+  std::unordered_map<UUID, std::vector<Link>> links_from_node;
+
+  // What changed since the last snapshot, only tracked once one was taken.
+  // Links that were removed are nullopt.
+  std::shared_ptr<const GraphSnapshot> last_snapshot;
+  std::unordered_set<UUID> unsnapshotted_nodes;
+  std::unordered_map<UUID, std::optional<Link>> unsnapshotted_links;
+
+  // Changes of the open transaction, an edit outside of one is committed
+  // right away.
+  int transaction_depth = 0;
+  std::unordered_map<UUID, std::shared_ptr<Node>> pending_added_nodes;
+  std::unordered_map<UUID, std::shared_ptr<Node>> pending_removed_nodes;
+  std::unordered_set<UUID> pending_changed_nodes;
+  std::unordered_map<UUID, Link> pending_added_links;
+  std::unordered_map<UUID, Link> pending_removed_links;
+  // Removed links that are still in links, they're erased in one pass.
+  std::unordered_set<UUID> unerased_links;
+
+  auto erase_removed_links() -> void;
+  auto end_edit() -> void;
+  auto index_link(const Link& link) -> void;
+  auto unindex_link(const Link& link) -> void;
+  auto node_changed(UUID uuid, bool removed = false) -> void;
+  auto link_changed(const Link& link, bool removed) -> void;
+
  protected:
   std::vector<std::shared_ptr<Node>> nodes;
   std::vector<std::shared_ptr<GraphItem>> items;
   std::vector<Link> links;
 
+  auto bump_version() -> void { ++version; }
+  auto bump_structure_version() -> void {
+    ++structure_version;
+    bump_version();
+  }
+
  public:
   // Signals
   boost::signals2::signal<void(std::shared_ptr<Node>)> node_added;
   boost::signals2::signal<void(std::shared_ptr<Node>)> node_removed;
   boost::signals2::signal<void(Link)> link_added;
   boost::signals2::signal<void(Link)> link_removed;
+  /**
+   * @brief Emitted once per transaction after the signals of the single
+   * changes, with all of them. An edit outside of a transaction is one.
+   */
+  boost::signals2::signal<void(const GraphChanges&)> changed;
 
   Graph() = default;
 
@@ -37,17 +105,51 @@ class Graph : AfObject {
   Graph(UUID uuid, std::vector<property::Property> properties)
       : AfObject(uuid, std::move(properties)) {}
 
+  /**
+   * @brief Changes whenever a node, link or node property changes.
+   */
+  [[nodiscard]] auto get_version() const -> uint64_t { return version; }
+  /**
+   * @brief Changes whenever a node or link is added or removed.
+   */
+  [[nodiscard]] auto get_structure_version() const -> uint64_t {
+    return structure_version;
+  }
+
+  /**
+   * @brief Starts grouping edits. Nodes and links are changed right away,
+   * but removed links are only erased from get_links() in bulk and the
+   * signals are emitted when the outermost transaction is committed.
+   */
+  auto begin_transaction() -> void override;
+  auto commit_transaction() -> void override;
+
+  /**
+   * @brief An immutable snapshot of the graph as it is now, which can be
+   * read from any thread. Only what changed since the last snapshot is
+   * copied and the last snapshot is returned if nothing did, so it can be
+   * taken every frame. Must be called on the thread that edits the graph.
+   */
+  auto snapshot() -> std::shared_ptr<const GraphSnapshot>;
+
   // Nodes
   auto add_node(std::shared_ptr<Node> node) -> void;
+  /**
+   * @brief Removes the node and the links to and from it in one transaction.
+   */
   auto remove_node_by_uuid(const UUID& uuid) -> void;
   auto get_nodes() -> std::vector<std::shared_ptr<Node>>&;
   auto get_node_by_uuid(const UUID& uuid) -> std::shared_ptr<Node>;
 
   // Links
-  [[nodiscard]] auto get_links() const -> const std::vector<Link>&;
+  [[nodiscard]] auto get_links() -> const std::vector<Link>&;
   auto add_link(Link link) -> void;
   auto add_links(const std::vector<Link>& links) -> void;
   auto remove_link(const Link& link) -> void;
+  /**
+   * @brief Removes @a links in one transaction, in O(links of the graph)
+   * rather than that for each of them.
+   */
   auto remove_links(const std::vector<Link>& links) -> void;
   [[nodiscard]] auto get_link_by_uuid(UUID uuid) -> Link;
   [[nodiscard]] auto get_links_by_uuids(const std::vector<UUID>& uuids)
@@ -0,0 +1,54 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "graph_snapshot.h"
+
+namespace afro::graph {
+namespace {
+using Index = core::PersistentMap<UUID, GraphSnapshot::Links>;
+
+auto find_links(const Index& index, UUID node) -> GraphSnapshot::Links {
+  const auto* links = index.find(node);
+  return links != nullptr ? *links : GraphSnapshot::Links();
+}
+
+auto index_link(const Index& index, UUID node, const Link& link) -> Index {
+  return index.set(node, find_links(index, node).set(link.get_uuid(), link));
+}
+
+auto unindex_link(const Index& index, UUID node, const Link& link) -> Index {
+  auto links = find_links(index, node).erase(link.get_uuid());
+  return links.empty() ? index.erase(node) : index.set(node, links);
+}
+}  // namespace
+
+auto GraphSnapshot::get_node(UUID uuid) const
+    -> std::shared_ptr<const NodeSnapshot> {
+  const auto* node = nodes_.find(uuid);
+  return node != nullptr ? *node : nullptr;
+}
+
+auto GraphSnapshot::get_links_to_node(UUID uuid) const -> Links {
+  return find_links(links_to_node_, uuid);
+}
+
+auto GraphSnapshot::get_links_from_node(UUID uuid) const -> Links {
+  return find_links(links_from_node_, uuid);
+}
+
+auto GraphSnapshot::add_link(const Link& link) -> void {
+  links_ = links_.set(link.get_uuid(), link);
+  links_to_node_ = index_link(links_to_node_, link.get_to_node(), link);
+  links_from_node_ = index_link(links_from_node_, link.get_from_node(), link);
+}
+
+auto GraphSnapshot::remove_link(const Link& link) -> void {
+  links_ = links_.erase(link.get_uuid());
+  links_to_node_ = unindex_link(links_to_node_, link.get_to_node(), link);
+  links_from_node_ =
+      unindex_link(links_from_node_, link.get_from_node(), link);
+}
+}  // namespace afro::graph
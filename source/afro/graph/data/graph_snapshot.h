@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/data/uuid.h"
+#include "common/persistent_map.h"
+#include "link.h"
+#include "property/data/property_value.h"
+#include "utils/math.h"
+
+namespace afro::graph {
+class Graph;
+
+/**
+ * @brief A node as it was when its graph's snapshot was taken.
+ */
+struct NodeSnapshot {
+  UUID uuid;
+  std::string name;
+  FVec2 position;
+  // In the order of the node's properties.
+  std::vector<property::PropertyValue> values;
+};
+
+/**
+ * @brief An immutable version of a Graph, see Graph::snapshot().
+ *
+ * Snapshots share what didn't change with the snapshot they were made
+ * from: unchanged nodes are the same NodeSnapshot and comparing the maps
+ * with is_same() tells whether anything changed. A snapshot can be read
+ * from any thread while the graph is edited.
+ */
+class GraphSnapshot {
+ public:
+  using Nodes =
+      core::PersistentMap<UUID, std::shared_ptr<const NodeSnapshot>>;
+  using Links = core::PersistentMap<UUID, Link>;
+
+ private:
+  UUID uuid_;
+  uint64_t version_ = 0;
+  uint64_t structure_version_ = 0;
+  Nodes nodes_;
+  Links links_;
+  // Links by node, as in the graph.
+  core::PersistentMap<UUID, Links> links_to_node_;
+  core::PersistentMap<UUID, Links> links_from_node_;
+
+  friend class Graph;
+
+ public:
+  explicit GraphSnapshot(UUID uuid) : uuid_(uuid) {}
+
+  [[nodiscard]] auto get_uuid() const -> UUID { return uuid_; }
+  /**
+   * @brief The versions of the graph when the snapshot was taken.
+   */
+  [[nodiscard]] auto get_version() const -> uint64_t { return version_; }
+  [[nodiscard]] auto get_structure_version() const -> uint64_t {
+    return structure_version_;
+  }
+
+  [[nodiscard]] auto get_nodes() const -> const Nodes& { return nodes_; }
+  /**
+   * @brief The node with @a uuid, nullptr if there's none.
+   */
+  [[nodiscard]] auto get_node(UUID uuid) const
+      -> std::shared_ptr<const NodeSnapshot>;
+
+  [[nodiscard]] auto get_links() const -> const Links& { return links_; }
+  [[nodiscard]] auto get_links_to_node(UUID uuid) const -> Links;
+  [[nodiscard]] auto get_links_from_node(UUID uuid) const -> Links;
+
+ private:
+  auto add_link(const Link& link) -> void;
+  auto remove_link(const Link& link) -> void;
+};
+}  // namespace afro::graph
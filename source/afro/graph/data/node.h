@@ -23,6 +23,8 @@ class Node : public AfObject {
  public:
   FVec2 position = {0, 0};
   boost::signals2::signal<void()> on_invalidate;
+  // Emitted by set_position.
+  boost::signals2::signal<void()> on_moved;
 
   Node(UUID uuid, std::vector<property::Property> properties, std::string name)
       : AfObject(uuid, std::move(properties)), name(std::move(name)) {
@@ -52,6 +54,15 @@ class Node : public AfObject {
 
   auto get_name() -> std::string_view { return name; }
 
+  /**
+   * @brief Moves the node. Unlike writing position, listeners like autosave
+   * are told about it.
+   */
+  auto set_position(FVec2 new_position) -> void {
+    position = new_position;
+    on_moved();
+  }
+
   ~Node() override = default;
 };
 
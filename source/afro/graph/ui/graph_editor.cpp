@@ -62,6 +62,7 @@ auto GraphEditor::draw() -> void {
   check_for_new_links();
   check_for_deleted_links();
   check_for_deleted_nodes();
+  check_for_moved_nodes();
 
   ImGui::End();
 }
@@ -157,6 +158,27 @@ auto GraphEditor::check_for_deleted_nodes() -> void {
   }
 }
 
+auto GraphEditor::check_for_moved_nodes() -> void {
+  // Dragged nodes are selected, they're moved once the drag ends.
+  if (!ImGui::IsMouseReleased(ImGuiMouseButton_Left)) {
+    return;
+  }
+  auto sel_nodes = std::vector<int>(ImNodes::NumSelectedNodes(), 0);
+  if (sel_nodes.empty()) {
+    return;
+  }
+
+  ImNodes::GetSelectedNodes(sel_nodes.data());
+  for (const auto node_id : sel_nodes) {
+    auto node = graph->get_node_by_uuid(node_id_map.get_uuid(node_id));
+    const auto node_pos = ImNodes::GetNodeGridSpacePos(node_id);
+    if (node != nullptr && (node->position.x != node_pos.x ||
+                            node->position.y != node_pos.y)) {
+      node->set_position({node_pos.x, node_pos.y});
+    }
+  }
+}
+
 auto GraphEditor::set_graph(std::shared_ptr<Graph> new_graph) -> void {
   AF_ASSERT(new_graph != nullptr)
 
@@ -183,8 +205,7 @@ auto GraphEditor::clear_graph() -> void {
   for (const auto &node_ptr : graph->get_nodes()) {
     const auto node_pos = ImNodes::GetNodeGridSpacePos(
         node_id_map.create_or_get_imnodes_id(node_ptr->get_uuid()));
-    node_ptr->position.x = node_pos.x;
-    node_ptr->position.y = node_pos.y;
+    node_ptr->set_position({node_pos.x, node_pos.y});
   }
 
   graph = nullptr;
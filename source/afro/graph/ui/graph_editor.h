@@ -40,6 +40,7 @@ class GraphEditor : public ui::Widget {
   auto check_for_new_links() -> void;
   auto check_for_deleted_links() -> void;
   auto check_for_deleted_nodes() -> void;
+  auto check_for_moved_nodes() -> void;
   auto draw_node(std::shared_ptr<Node> node) -> void;
   auto draw_property(const property::Property& property) -> void;
 
@@ -0,0 +1,470 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "autosave.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "material_graph/data/material_node.h"
+#include "utils/log.h"
+
+namespace fs = std::filesystem;
+
+namespace afro::io {
+using namespace graph::material;
+
+namespace {
+constexpr std::string_view SUBGRAPH_PREFIX = "subgraph_";
+// Size and hash of each captured batch of records.
+constexpr size_t FRAME_HEADER_SIZE = 2 * sizeof(uint64_t);
+
+enum class RecordKind : uint8_t {
+  ADD_GRAPH = 1,
+  REMOVE_GRAPH = 2,
+  SET_NODE = 3,
+  REMOVE_NODE = 4,
+  ADD_LINK = 5,
+  REMOVE_LINK = 6,
+  SET_GRAPH_INFO = 7,
+};
+
+// Records start with their kind and the graph they change.
+auto begin_record(codec::Writer& writer, RecordKind kind, UUID graph)
+    -> void {
+  writer.write(static_cast<uint8_t>(kind));
+  writer.write(graph);
+}
+
+auto write_node_record(codec::Writer& writer, UUID graph, graph::Node& node)
+    -> void {
+  begin_record(writer, RecordKind::SET_NODE, graph);
+  codec::write_node(writer, dynamic_cast<MaterialNode&>(node));
+}
+
+auto find_link(graph::Graph& graph, UUID uuid)
+    -> std::vector<graph::Link>::const_iterator {
+  const auto& links = graph.get_links();
+  return std::find_if(links.begin(), links.end(), [uuid](const auto& link) {
+    return link.get_uuid() == uuid;
+  });
+}
+}  // namespace
+
+Autosave::Autosave(std::vector<MaterialNodeDefinition> definitions,
+                   fs::path directory, uint64_t compact_size)
+    : definitions_(std::move(definitions)),
+      directory_(std::move(directory)),
+      compact_size_(compact_size) {}
+
+Autosave::~Autosave() { shutdown(); }
+
+auto Autosave::startup() -> void {
+  fs::create_directories(directory_);
+  fs::remove(directory_ / PROJECT_NAME);
+  journal_.open(directory_ / JOURNAL_NAME, std::ios::binary | std::ios::trunc);
+  if (!journal_) {
+    throw std::runtime_error(
+        fmt::format("Can't write {}", (directory_ / JOURNAL_NAME).string()));
+  }
+  journal_size_ = 0;
+  project_.emplace(definitions_);
+  tracked_.clear();
+  pending_.clear();
+  running_ = true;
+  thread_ = std::thread([this]() { run(); });
+}
+
+auto Autosave::shutdown() -> void {
+  if (!thread_.joinable()) {
+    return;
+  }
+  {
+    auto lock = std::scoped_lock(batches_mutex_);
+    running_ = false;
+  }
+  batches_changed_.notify_all();
+  thread_.join();
+  journal_.close();
+  tracked_.clear();
+  pending_.clear();
+}
+
+auto Autosave::track_node(Tracked& tracked,
+                          const std::shared_ptr<graph::Node>& node) -> void {
+  const auto uuid = node->get_uuid();
+  const auto changed = [&tracked, uuid]() {
+    tracked.changed_nodes.insert(uuid);
+  };
+  auto& connections = tracked.nodes[uuid];
+  connections[0] = node->on_invalidate.connect(changed);
+  connections[1] = node->on_moved.connect(changed);
+}
+
+auto Autosave::track(const std::shared_ptr<MaterialGraph>& graph) -> void {
+  const auto uuid = graph->get_uuid();
+  auto& tracked = *tracked_.emplace(uuid, std::make_unique<Tracked>())
+                       .first->second;
+  tracked.graph = graph;
+  begin_record(tracked.records, RecordKind::ADD_GRAPH, uuid);
+  // Recorded from the back.
+  tracked.unrecorded_nodes.reserve(graph->get_nodes().size());
+  for (auto iter = graph->get_nodes().rbegin();
+       iter != graph->get_nodes().rend(); ++iter) {
+    tracked.unrecorded_nodes.push_back((*iter)->get_uuid());
+  }
+  tracked.unrecorded_links.assign(graph->get_links().rbegin(),
+                                  graph->get_links().rend());
+  pending_.push_back(uuid);
+
+  // Until the graph is recorded, added nodes and links are queued and
+  // removals are recorded right away, they're ignored if nothing was
+  // recorded yet.
+  tracked.connections.emplace_back(graph->node_added.connect(
+      [this, &tracked, uuid](const std::shared_ptr<graph::Node>& node) {
+        if (!tracked.recorded) {
+          tracked.unrecorded_nodes.push_back(node->get_uuid());
+          return;
+        }
+        track_node(tracked, node);
+        write_node_record(tracked.records, uuid, *node);
+      }));
+  tracked.connections.emplace_back(graph->node_removed.connect(
+      [&tracked, uuid](const std::shared_ptr<graph::Node>& node) {
+        tracked.nodes.erase(node->get_uuid());
+        tracked.changed_nodes.erase(node->get_uuid());
+        begin_record(tracked.records, RecordKind::REMOVE_NODE, uuid);
+        tracked.records.write(node->get_uuid());
+      }));
+  tracked.connections.emplace_back(
+      graph->link_added.connect([&tracked, uuid](const graph::Link& link) {
+        if (!tracked.recorded) {
+          tracked.unrecorded_links.push_back(link);
+          return;
+        }
+        begin_record(tracked.records, RecordKind::ADD_LINK, uuid);
+        codec::write_link(tracked.records, *tracked.graph, link);
+      }));
+  tracked.connections.emplace_back(
+      graph->link_removed.connect([&tracked, uuid](const graph::Link& link) {
+        begin_record(tracked.records, RecordKind::REMOVE_LINK, uuid);
+        tracked.records.write(link.get_uuid());
+      }));
+}
+
+auto Autosave::record_changes(Tracked& tracked, codec::Writer& batch)
+    -> void {
+  const auto uuid = tracked.graph->get_uuid();
+  batch.write_bytes(tracked.records.get_bytes());
+  tracked.records.get_bytes().clear();
+  for (const auto node_uuid : tracked.changed_nodes) {
+    write_node_record(batch, uuid,
+                      *tracked.graph->get_node_by_uuid(node_uuid));
+  }
+  tracked.changed_nodes.clear();
+  // Also bumped by node changes, the info is small enough to not tell.
+  if (tracked.recorded && tracked.graph->get_version() != tracked.version) {
+    tracked.version = tracked.graph->get_version();
+    begin_record(batch, RecordKind::SET_GRAPH_INFO, uuid);
+    codec::write_graph_info(batch, *tracked.graph);
+  }
+}
+
+auto Autosave::record_part(Tracked& tracked, const Graphs& graphs,
+                           codec::Writer& batch, size_t& budget) -> bool {
+  auto& graph = *tracked.graph;
+  const auto uuid = graph.get_uuid();
+  while (!tracked.unrecorded_nodes.empty()) {
+    if (budget == 0) {
+      return false;
+    }
+    --budget;
+    auto node = graph.get_node_by_uuid(tracked.unrecorded_nodes.back());
+    if (node == nullptr) {
+      tracked.unrecorded_nodes.pop_back();
+      continue;
+    }
+    // Definitions of subgraph instances are made from their graph, so it's
+    // recorded first.
+    const auto& id =
+        dynamic_cast<MaterialNode&>(*node).get_definition().get_id();
+    if (id.starts_with(SUBGRAPH_PREFIX)) {
+      const auto subgraph = graphs.find(static_cast<UUID>(
+          std::stoull(id.substr(SUBGRAPH_PREFIX.size()))));
+      if (subgraph != graphs.end()) {
+        const auto subgraph_uuid = subgraph->first;
+        if (!tracked_.contains(subgraph_uuid)) {
+          track(subgraph->second);
+        }
+        if (!tracked_.at(subgraph_uuid)->recorded) {
+          std::erase(pending_, subgraph_uuid);
+          pending_.insert(pending_.begin(), subgraph_uuid);
+          return false;
+        }
+      }
+    }
+    track_node(tracked, node);
+    write_node_record(batch, uuid, *node);
+    tracked.unrecorded_nodes.pop_back();
+  }
+  while (!tracked.unrecorded_links.empty()) {
+    if (budget == 0) {
+      return false;
+    }
+    --budget;
+    const auto link = tracked.unrecorded_links.back();
+    tracked.unrecorded_links.pop_back();
+    const auto links = graph.get_links_from_node(link.get_from_node());
+    if (std::find(links.begin(), links.end(), link) != links.end()) {
+      begin_record(batch, RecordKind::ADD_LINK, uuid);
+      codec::write_link(batch, graph, link);
+    }
+  }
+  return true;
+}
+
+auto Autosave::record_pending(const Graphs& graphs, codec::Writer& batch)
+    -> void {
+  auto budget = RECORDS_PER_CAPTURE;
+  while (!pending_.empty() && budget > 0) {
+    auto& tracked = *tracked_.at(pending_.front());
+    // Removals happened before the state the part records.
+    record_changes(tracked, batch);
+    if (!record_part(tracked, graphs, batch, budget)) {
+      continue;
+    }
+    tracked.recorded = true;
+    tracked.version = tracked.graph->get_version();
+    begin_record(batch, RecordKind::SET_GRAPH_INFO, pending_.front());
+    codec::write_graph_info(batch, *tracked.graph);
+    pending_.erase(pending_.begin());
+  }
+}
+
+auto Autosave::capture(const store::Data& data) -> void {
+  auto batch = codec::Writer();
+  auto graphs = Graphs();
+  for (const auto& graph : data.material_graphs) {
+    graphs[graph->get_uuid()] = graph;
+  }
+  for (auto iter = tracked_.begin(); iter != tracked_.end();) {
+    if (graphs.contains(iter->first)) {
+      ++iter;
+      continue;
+    }
+    begin_record(batch, RecordKind::REMOVE_GRAPH, iter->first);
+    std::erase(pending_, iter->first);
+    iter = tracked_.erase(iter);
+  }
+  for (const auto& graph : data.material_graphs) {
+    if (!tracked_.contains(graph->get_uuid())) {
+      track(graph);
+    }
+  }
+
+  record_pending(graphs, batch);
+  // Changes may refer to graphs that aren't recorded yet, e.g. a new
+  // instance of a subgraph.
+  if (pending_.empty()) {
+    for (const auto& graph : data.material_graphs) {
+      record_changes(*tracked_.at(graph->get_uuid()), batch);
+    }
+  }
+
+  if (batch.get_bytes().empty()) {
+    return;
+  }
+  {
+    auto lock = std::scoped_lock(batches_mutex_);
+    batches_.push_back(std::move(batch.get_bytes()));
+    ++queued_count_;
+  }
+  batches_changed_.notify_all();
+}
+
+auto Autosave::flush() -> void {
+  auto lock = std::unique_lock(batches_mutex_);
+  const auto queued = queued_count_;
+  batches_changed_.wait(lock, [this, queued]() {
+    return written_count_ >= queued || !thread_.joinable();
+  });
+}
+
+auto Autosave::run() -> void {
+  while (true) {
+    auto batches = std::vector<std::vector<uint8_t>>();
+    {
+      auto lock = std::unique_lock(batches_mutex_);
+      batches_changed_.wait(
+          lock, [this]() { return !batches_.empty() || !running_; });
+      if (batches_.empty() && !running_) {
+        break;
+      }
+      batches.swap(batches_);
+    }
+    for (const auto& batch : batches) {
+      write(batch);
+    }
+    {
+      auto lock = std::scoped_lock(batches_mutex_);
+      written_count_ += batches.size();
+    }
+    batches_changed_.notify_all();
+  }
+  compact();
+}
+
+auto Autosave::write(std::span<const uint8_t> batch) -> void {
+  try {
+    auto header = codec::Writer();
+    header.write(static_cast<uint64_t>(batch.size()));
+    header.write(codec::hash_bytes(batch));
+    journal_.write(reinterpret_cast<const char*>(header.get_bytes().data()),
+                   static_cast<std::streamsize>(header.get_bytes().size()));
+    journal_.write(reinterpret_cast<const char*>(batch.data()),
+                   static_cast<std::streamsize>(batch.size()));
+    journal_.flush();
+    if (!journal_) {
+      throw std::runtime_error("Can't write the journal");
+    }
+    journal_size_ += FRAME_HEADER_SIZE + batch.size();
+    apply(*project_, batch);
+  } catch (const std::exception& e) {
+    log::core_error("Autosave failed: {}", e.what());
+    return;
+  }
+  if (journal_size_ >= compact_size_) {
+    compact();
+  }
+}
+
+auto Autosave::compact() -> void {
+  if (journal_size_ == 0) {
+    return;
+  }
+  try {
+    // Only graphs that changed since the last compaction are written.
+    if (project_->get_path().empty()) {
+      project_->save_as(directory_ / PROJECT_NAME);
+    } else {
+      project_->save();
+    }
+    // Replaying records already in the project changes nothing, so a crash
+    // before the journal is emptied loses nothing.
+    journal_.close();
+    journal_.open(directory_ / JOURNAL_NAME,
+                  std::ios::binary | std::ios::trunc);
+    journal_size_ = 0;
+    log::core_info("Compacted the autosave journal");
+  } catch (const std::exception& e) {
+    log::core_error("Can't compact the autosave journal: {}", e.what());
+  }
+}
+
+auto Autosave::apply(Project& project, std::span<const uint8_t> batch)
+    -> void {
+  auto reader = codec::Reader(batch);
+  while (!reader.is_at_end()) {
+    const auto kind = static_cast<RecordKind>(reader.read<uint8_t>());
+    const auto uuid = reader.read<UUID>();
+    if (kind == RecordKind::ADD_GRAPH) {
+      project.add_graph(std::make_shared<MaterialGraph>(uuid));
+      continue;
+    }
+    if (kind == RecordKind::REMOVE_GRAPH) {
+      project.remove_graph(uuid);
+      continue;
+    }
+
+    auto graph = project.get_graph(uuid);
+    switch (kind) {
+      case RecordKind::SET_NODE: {
+        const auto header = codec::read_node_header(reader);
+        auto node = std::dynamic_pointer_cast<MaterialNode>(
+            graph->get_node_by_uuid(header.uuid));
+        if (node != nullptr) {
+          codec::read_node_state(reader, *node);
+          break;
+        }
+        node = MaterialNode::create(
+            project.find_definition(header.definition_id, header.name),
+            header.uuid);
+        codec::read_node_state(reader, *node);
+        graph->add_node(node);
+        break;
+      }
+      case RecordKind::REMOVE_NODE: {
+        const auto node = reader.read<UUID>();
+        if (graph->get_node_by_uuid(node) != nullptr) {
+          graph->remove_node_by_uuid(node);
+        }
+        break;
+      }
+      case RecordKind::ADD_LINK: {
+        const auto link = codec::read_link(reader, *graph);
+        if (find_link(*graph, link.get_uuid()) == graph->get_links().end()) {
+          graph->add_link(link);
+        }
+        break;
+      }
+      case RecordKind::REMOVE_LINK: {
+        const auto link = find_link(*graph, reader.read<UUID>());
+        if (link != graph->get_links().end()) {
+          graph->remove_link(graph::Link(*link));
+        }
+        break;
+      }
+      case RecordKind::SET_GRAPH_INFO:
+        codec::read_graph_info(reader, *graph);
+        break;
+      default:
+        throw std::runtime_error(fmt::format(
+            "Unknown autosave record {}", static_cast<int>(kind)));
+    }
+  }
+}
+
+auto Autosave::recover(const fs::path& directory,
+                       std::vector<MaterialNodeDefinition> definitions)
+    -> std::optional<Project> {
+  const auto project_path = directory / PROJECT_NAME;
+  const auto journal_path = directory / JOURNAL_NAME;
+  if (!fs::exists(project_path) && !fs::exists(journal_path)) {
+    return std::nullopt;
+  }
+  auto project = fs::exists(project_path)
+                     ? Project::open(project_path, std::move(definitions))
+                     : Project(std::move(definitions));
+
+  auto in = std::ifstream(journal_path, std::ios::binary);
+  auto journal = std::vector<uint8_t>(std::istreambuf_iterator<char>(in),
+                                      std::istreambuf_iterator<char>());
+  auto reader = codec::Reader(journal);
+  auto batches = 0;
+  try {
+    while (!reader.is_at_end()) {
+      const auto size = reader.read<uint64_t>();
+      const auto hash = reader.read<uint64_t>();
+      const auto batch = reader.read_bytes(size);
+      if (codec::hash_bytes(batch) != hash) {
+        throw std::runtime_error("Corrupt capture");
+      }
+      apply(project, batch);
+      ++batches;
+    }
+  } catch (const std::exception& e) {
+    // The capture being written when the editor crashed.
+    log::core_warn("Recovered {} captures of the autosave journal, then: {}",
+                   batches, e.what());
+  }
+  return project;
+}
+}  // namespace afro::io
@@ -0,0 +1,173 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <array>
+#include <boost/signals2/connection.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "graph_codec.h"
+#include "material_graph/data/material_graph.h"
+#include "material_graph/data/material_node_definition.h"
+#include "project.h"
+#include "store/data/data.h"
+
+namespace afro::io {
+/**
+ * @brief Saves the graphs of a store::Data on a background thread, so a
+ * crash loses at most the edits made since the last capture.
+ *
+ * Like AsyncEngine, no graph is shared with the background thread.
+ * capture() records on the UI thread what changed since the last capture:
+ * nodes whose values changed or that were moved, added and removed nodes,
+ * links and graphs and changed outputs and exposed properties. Its cost
+ * depends on the edits rather than the size of the graphs. A graph seen for
+ * the first time is recorded a few hundred nodes and links per capture, the
+ * changes of the other graphs are held back until it's complete.
+ *
+ * The background thread appends the records to a journal and applies them
+ * to its own copy of the graphs. Once the journal grows past the compaction
+ * size, the copy is saved to a project next to it and the journal is
+ * emptied. recover() opens that project and replays the journal.
+ */
+class Autosave {
+ public:
+  static constexpr uint64_t DEFAULT_COMPACT_SIZE = uint64_t{16} << 20;
+  static constexpr const char* PROJECT_NAME = "autosave.afro";
+  static constexpr const char* JOURNAL_NAME = "autosave.journal";
+  // Nodes and links of graphs seen for the first time recorded per capture.
+  static constexpr size_t RECORDS_PER_CAPTURE = 256;
+
+ private:
+  // What changed in a graph since the last capture.
+  struct Tracked {
+    std::shared_ptr<graph::material::MaterialGraph> graph;
+    std::vector<boost::signals2::scoped_connection> connections;
+    // Changes and moves of each node.
+    std::unordered_map<UUID,
+                       std::array<boost::signals2::scoped_connection, 2>>
+        nodes;
+    std::unordered_set<UUID> changed_nodes;
+    // Added and removed nodes and links in the order they happened.
+    codec::Writer records;
+    uint64_t version = 0;
+    // Nodes and links not recorded yet while the graph is first recorded.
+    // They're recorded as they are once it's their turn, if still there.
+    std::vector<UUID> unrecorded_nodes;
+    std::vector<graph::Link> unrecorded_links;
+    bool recorded = false;
+  };
+  using Graphs =
+      std::unordered_map<UUID, std::shared_ptr<graph::material::MaterialGraph>>;
+
+  std::vector<graph::material::MaterialNodeDefinition> definitions_;
+  std::filesystem::path directory_;
+  uint64_t compact_size_;
+  std::thread thread_;
+
+  std::mutex batches_mutex_;
+  std::condition_variable batches_changed_;
+  std::vector<std::vector<uint8_t>> batches_;
+  uint64_t queued_count_ = 0;
+  uint64_t written_count_ = 0;
+  bool running_ = false;
+
+  // Only used by the UI thread.
+  std::unordered_map<UUID, std::unique_ptr<Tracked>> tracked_;
+  // Graphs that aren't completely recorded yet, in the order they will be.
+  std::vector<UUID> pending_;
+
+  // Only used by the background thread.
+  std::optional<Project> project_;
+  std::ofstream journal_;
+  uint64_t journal_size_ = 0;
+
+  auto track(const std::shared_ptr<graph::material::MaterialGraph>& graph)
+      -> void;
+  auto track_node(Tracked& tracked, const std::shared_ptr<graph::Node>& node)
+      -> void;
+  // Moves the changes recorded since the last capture into @a batch.
+  auto record_changes(Tracked& tracked, codec::Writer& batch) -> void;
+  // Records up to @a budget of the nodes and links of a graph seen for the
+  // first time. Returns false while some are left or once a subgraph it
+  // needs is queued before it.
+  auto record_part(Tracked& tracked, const Graphs& graphs,
+                   codec::Writer& batch, size_t& budget) -> bool;
+  auto record_pending(const Graphs& graphs, codec::Writer& batch) -> void;
+  auto run() -> void;
+  auto write(std::span<const uint8_t> batch) -> void;
+  auto compact() -> void;
+  static auto apply(Project& project, std::span<const uint8_t> batch)
+      -> void;
+
+ public:
+  /**
+   * @brief Autosave to @a directory that compacts the journal once it's
+   * @a compact_size bytes. Nodes are created from @a definitions when it's
+   * recovered.
+   */
+  Autosave(std::vector<graph::material::MaterialNodeDefinition> definitions,
+           std::filesystem::path directory,
+           uint64_t compact_size = DEFAULT_COMPACT_SIZE);
+
+  /**
+   * @brief Starts the background thread. The previous autosave in the
+   * directory is discarded, it has to be recovered before.
+   */
+  auto startup() -> void;
+  /**
+   * @brief Writes what's left, compacts the journal and stops the
+   * background thread.
+   */
+  auto shutdown() -> void;
+
+  /**
+   * @brief Records the changes of @a data since the last capture and hands
+   * them to the background thread. Must be called on the thread that edits
+   * the graphs.
+   */
+  auto capture(const store::Data& data) -> void;
+  /**
+   * @brief Whether graphs seen for the first time aren't completely recorded
+   * yet, until then capture() should be called every frame.
+   */
+  [[nodiscard]] auto is_recording_graphs() const -> bool {
+    return !pending_.empty();
+  }
+  /**
+   * @brief Waits until everything captured so far is in the journal.
+   */
+  auto flush() -> void;
+
+  /**
+   * @brief The graphs autosaved to @a directory, nullopt if there's no
+   * autosave. A journal cut short by a crash is replayed up to the last
+   * complete capture.
+   *
+   * @throw std::runtime_error if the autosaved project can't be read.
+   */
+  static auto recover(
+      const std::filesystem::path& directory,
+      std::vector<graph::material::MaterialNodeDefinition> definitions)
+      -> std::optional<Project>;
+
+  Autosave(Autosave&) = delete;
+  auto operator=(const Autosave&) -> Autosave& = delete;
+  ~Autosave();
+};
+}  // namespace afro::io
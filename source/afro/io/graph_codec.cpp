@@ -0,0 +1,336 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "graph_codec.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+#include "utils/assert.h"
+#include "utils/log.h"
+
+namespace afro::io::codec {
+using namespace graph::material;
+
+static_assert(std::endian::native == std::endian::little,
+              "Graphs are read and written little endian");
+
+namespace {
+auto write_spline(Writer& writer, const curve::BezierSpline& spline)
+    -> void {
+  writer.write(static_cast<uint32_t>(spline.points.size()));
+  for (const auto& point : spline.points) {
+    for (const auto& vec : {point.t1, point.pos, point.t2}) {
+      writer.write(vec.x);
+      writer.write(vec.y);
+    }
+  }
+}
+
+auto read_spline(Reader& reader) -> curve::BezierSpline {
+  auto spline = curve::BezierSpline();
+  spline.points.resize(reader.read_count(sizeof(float) * 6));
+  for (auto& point : spline.points) {
+    for (auto* vec : {&point.t1, &point.pos, &point.t2}) {
+      vec->x = reader.read<float>();
+      vec->y = reader.read<float>();
+    }
+  }
+  return spline;
+}
+
+auto find_property_id(graph::Graph& graph, UUID node, UUID property)
+    -> const std::string& {
+  auto material_node =
+      std::dynamic_pointer_cast<MaterialNode>(graph.get_node_by_uuid(node));
+  if (material_node == nullptr) {
+    throw std::runtime_error(fmt::format("Link to missing node {}", node));
+  }
+  for (const auto& prop : material_node->get_properties()) {
+    if (prop.get_uuid() == property) {
+      return prop.get_property_definition().id;
+    }
+  }
+  throw std::runtime_error(
+      fmt::format("Node {} has no property {}", node, property));
+}
+
+auto find_property(graph::Graph& graph, UUID node, const std::string& id)
+    -> UUID {
+  auto material_node =
+      std::dynamic_pointer_cast<MaterialNode>(graph.get_node_by_uuid(node));
+  if (material_node == nullptr) {
+    throw std::runtime_error(fmt::format("Link to missing node {}", node));
+  }
+  return material_node->get_property(id).get_uuid();
+}
+}  // namespace
+
+auto hash_bytes(std::span<const uint8_t> bytes) -> uint64_t {
+  auto hash = uint64_t{0xcbf29ce484222325};
+  for (const auto byte : bytes) {
+    hash = (hash ^ byte) * 0x100000001b3;
+  }
+  return hash;
+}
+
+auto write_value(Writer& writer, const property::PropertyValue& value)
+    -> void {
+  writer.write(static_cast<uint8_t>(value.index()));
+  std::visit(
+      [&writer](const auto& val) {
+        using T = std::decay_t<decltype(val)>;
+        if constexpr (std::is_same_v<T, int> || std::is_same_v<T, float>) {
+          writer.write(val);
+        } else if constexpr (std::is_same_v<T, bool>) {
+          writer.write(static_cast<uint8_t>(val));
+        } else if constexpr (std::is_same_v<T, IVec2> ||
+                             std::is_same_v<T, FVec2>) {
+          writer.write(val.x);
+          writer.write(val.y);
+        } else if constexpr (std::is_same_v<T, IVec3> ||
+                             std::is_same_v<T, FVec3>) {
+          writer.write(val.x);
+          writer.write(val.y);
+          writer.write(val.z);
+        } else if constexpr (std::is_same_v<T, IVec4> ||
+                             std::is_same_v<T, FVec4>) {
+          writer.write(val.x);
+          writer.write(val.y);
+          writer.write(val.z);
+          writer.write(val.w);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+          writer.write_string(val);
+        } else if constexpr (std::is_same_v<T, property::EnumItem>) {
+          writer.write_string(val.name);
+          writer.write(val.value);
+        } else {
+          static_assert(std::is_same_v<T, curve::ColorCurve>);
+          for (const auto* spline : {&val.lum, &val.r, &val.g, &val.b,
+                                     &val.a}) {
+            write_spline(writer, *spline);
+          }
+        }
+      },
+      value);
+}
+
+auto read_value(Reader& reader) -> property::PropertyValue {
+  const auto index = reader.read<uint8_t>();
+  switch (index) {
+    case 0:
+      return reader.read<int>();
+    case 1: {
+      auto value = IVec2();
+      value.x = reader.read<int>();
+      value.y = reader.read<int>();
+      return value;
+    }
+    case 2: {
+      auto value = IVec3();
+      value.x = reader.read<int>();
+      value.y = reader.read<int>();
+      value.z = reader.read<int>();
+      return value;
+    }
+    case 3: {
+      auto value = IVec4();
+      value.x = reader.read<int>();
+      value.y = reader.read<int>();
+      value.z = reader.read<int>();
+      value.w = reader.read<int>();
+      return value;
+    }
+    case 4:
+      return reader.read<float>();
+    case 5: {
+      auto value = FVec2();
+      value.x = reader.read<float>();
+      value.y = reader.read<float>();
+      return value;
+    }
+    case 6: {
+      auto value = FVec3();
+      value.x = reader.read<float>();
+      value.y = reader.read<float>();
+      value.z = reader.read<float>();
+      return value;
+    }
+    case 7: {
+      auto value = FVec4();
+      value.x = reader.read<float>();
+      value.y = reader.read<float>();
+      value.z = reader.read<float>();
+      value.w = reader.read<float>();
+      return value;
+    }
+    case 8:
+      return reader.read_string();
+    case 9:
+      return reader.read<uint8_t>() != 0;
+    case 10: {
+      auto name = reader.read_string();
+      return property::EnumItem(std::move(name), reader.read<int>());
+    }
+    case 11: {
+      auto value = curve::ColorCurve();
+      for (auto* spline : {&value.lum, &value.r, &value.g, &value.b,
+                           &value.a}) {
+        *spline = read_spline(reader);
+      }
+      return value;
+    }
+    default:
+      break;
+  }
+  throw std::runtime_error(
+      fmt::format("Unknown property value type {}", index));
+}
+
+auto write_node(Writer& writer, MaterialNode& node) -> void {
+  writer.write(node.get_uuid());
+  writer.write_string(node.get_definition().get_id());
+  writer.write_string(node.get_name());
+  writer.write(node.position.x);
+  writer.write(node.position.y);
+  writer.write(node.get_buffer_size().x);
+  writer.write(node.get_buffer_size().y);
+  writer.write(static_cast<uint8_t>(node.get_high_precision()));
+  writer.write(static_cast<uint32_t>(node.get_properties().size()));
+  for (const auto& prop : node.get_properties()) {
+    writer.write_string(prop.get_property_definition().id);
+    write_value(writer, prop.get_value());
+  }
+}
+
+auto read_node_header(Reader& reader) -> NodeHeader {
+  auto header = NodeHeader();
+  header.uuid = reader.read<UUID>();
+  header.definition_id = reader.read_string();
+  header.name = reader.read_string();
+  return header;
+}
+
+auto read_node_state(Reader& reader, MaterialNode& node) -> void {
+  node.position.x = reader.read<float>();
+  node.position.y = reader.read<float>();
+  auto buffer_size = IVec2();
+  buffer_size.x = reader.read<int>();
+  buffer_size.y = reader.read<int>();
+  node.set_buffer_size(buffer_size);
+  node.set_high_precision(reader.read<uint8_t>() != 0);
+  const auto property_count = reader.read<uint32_t>();
+  auto& properties = node.get_properties();
+  for (uint32_t i = 0; i < property_count; ++i) {
+    const auto id = reader.read_string();
+    const auto value = read_value(reader);
+    auto prop = std::find_if(
+        properties.begin(), properties.end(), [&id](const auto& prop) {
+          return prop.get_property_definition().id == id;
+        });
+    // Definitions may have changed since the node was written.
+    if (prop == properties.end() ||
+        prop->get_value().index() != value.index()) {
+      log::core_warn("Ignoring property {} of node {}", id, node.get_uuid());
+      continue;
+    }
+    prop->set_value(value);
+  }
+}
+
+auto write_link(Writer& writer, graph::Graph& graph, const graph::Link& link)
+    -> void {
+  writer.write(link.get_uuid());
+  writer.write(link.get_from_node());
+  writer.write_string(
+      find_property_id(graph, link.get_from_node(), link.get_from_property()));
+  writer.write(link.get_to_node());
+  writer.write_string(
+      find_property_id(graph, link.get_to_node(), link.get_to_property()));
+}
+
+auto read_link(Reader& reader, graph::Graph& graph) -> graph::Link {
+  const auto uuid = reader.read<UUID>();
+  const auto from_node = reader.read<UUID>();
+  const auto from_property =
+      find_property(graph, from_node, reader.read_string());
+  const auto to_node = reader.read<UUID>();
+  const auto to_property = find_property(graph, to_node, reader.read_string());
+  return {uuid, to_node, from_node, to_property, from_property};
+}
+
+auto write_graph_info(Writer& writer, MaterialGraph& graph) -> void {
+  writer.write_string(graph.get_name());
+  writer.write(graph.get_output_node());
+  writer.write(static_cast<uint32_t>(graph.get_exposed_properties().size()));
+  for (const auto& exposed : graph.get_exposed_properties()) {
+    writer.write(exposed.node);
+    writer.write_string(exposed.property_id);
+  }
+}
+
+auto read_graph_info(Reader& reader, MaterialGraph& graph) -> void {
+  auto name = reader.read_string();
+  if (graph.get_name() != name) {
+    graph.set_name(std::move(name));
+  }
+  const auto output_node = reader.read<UUID>();
+  const auto count = reader.read_count(sizeof(UUID) + sizeof(uint32_t));
+  for (uint32_t i = 0; i < count; ++i) {
+    auto property = ExposedProperty();
+    property.node = reader.read<UUID>();
+    property.property_id = reader.read_string();
+    const auto& exposed = graph.get_exposed_properties();
+    const auto is_exposed =
+        std::any_of(exposed.begin(), exposed.end(), [&](const auto& other) {
+          return other.node == property.node &&
+                 other.property_id == property.property_id;
+        });
+    if (!is_exposed) {
+      graph.expose_property(property.node, std::move(property.property_id));
+    }
+  }
+  if (graph.get_output_node() != output_node) {
+    graph.set_output_node(output_node);
+  }
+}
+
+auto write_graph(Writer& writer, MaterialGraph& graph) -> void {
+  writer.write(static_cast<uint32_t>(graph.get_nodes().size()));
+  for (const auto& base : graph.get_nodes()) {
+    auto node = std::dynamic_pointer_cast<MaterialNode>(base);
+    AF_ASSERT_MSG(node != nullptr, "Material graphs only hold material nodes")
+    write_node(writer, *node);
+  }
+  writer.write(static_cast<uint32_t>(graph.get_links().size()));
+  for (const auto& link : graph.get_links()) {
+    write_link(writer, graph, link);
+  }
+  write_graph_info(writer, graph);
+}
+
+auto read_graph(Reader& reader, MaterialGraph& graph,
+                const FindDefinition& find_definition) -> void {
+  const auto node_count = reader.read<uint32_t>();
+  for (uint32_t i = 0; i < node_count; ++i) {
+    const auto header = read_node_header(reader);
+    auto node = MaterialNode::create(
+        find_definition(header.definition_id, header.name), header.uuid);
+    read_node_state(reader, *node);
+    graph.add_node(node);
+  }
+  const auto link_count = reader.read<uint32_t>();
+  auto links = std::vector<graph::Link>();
+  for (uint32_t i = 0; i < link_count; ++i) {
+    links.push_back(read_link(reader, graph));
+  }
+  graph.add_links(links);
+  read_graph_info(reader, graph);
+}
+}  // namespace afro::io::codec
@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "common/data/uuid.h"
+#include "material_graph/data/material_graph.h"
+#include "material_graph/data/material_node.h"
+#include "material_graph/data/material_node_definition.h"
+
+/**
+ * @brief The binary encoding of graphs shared by projects and autosaves.
+ * Everything is little endian, links refer to properties by id since their
+ * UUIDs change whenever a node is created.
+ */
+namespace afro::io::codec {
+class Writer {
+ private:
+  std::vector<uint8_t> bytes_;
+
+ public:
+  template <typename T>
+  auto write(T value) -> void {
+    static_assert(std::is_arithmetic_v<T>);
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    bytes_.insert(bytes_.end(), bytes, bytes + sizeof(T));
+  }
+  auto write_bytes(std::span<const uint8_t> bytes) -> void {
+    bytes_.insert(bytes_.end(), bytes.begin(), bytes.end());
+  }
+  auto write_string(std::string_view value) -> void {
+    write(static_cast<uint32_t>(value.size()));
+    bytes_.insert(bytes_.end(), value.begin(), value.end());
+  }
+  auto get_bytes() -> std::vector<uint8_t>& { return bytes_; }
+};
+
+/**
+ * @brief Reads what a Writer wrote, any read past the end throws
+ * std::runtime_error.
+ */
+class Reader {
+ private:
+  std::span<const uint8_t> bytes_;
+  size_t position_ = 0;
+
+ public:
+  explicit Reader(std::span<const uint8_t> bytes) : bytes_(bytes) {}
+
+  [[nodiscard]] auto is_at_end() const -> bool {
+    return position_ == bytes_.size();
+  }
+  auto read_bytes(size_t size) -> std::span<const uint8_t> {
+    if (size > bytes_.size() - position_) {
+      throw std::runtime_error("Unexpected end of data");
+    }
+    const auto bytes = bytes_.subspan(position_, size);
+    position_ += size;
+    return bytes;
+  }
+  template <typename T>
+  auto read() -> T {
+    static_assert(std::is_arithmetic_v<T>);
+    auto value = T();
+    std::memcpy(&value, read_bytes(sizeof(T)).data(), sizeof(T));
+    return value;
+  }
+  /**
+   * @brief A count of items that take at least @a item_size bytes each,
+   * checked against the bytes left before anything is allocated for them.
+   */
+  auto read_count(size_t item_size) -> uint32_t {
+    const auto count = read<uint32_t>();
+    if (count > (bytes_.size() - position_) / item_size) {
+      throw std::runtime_error("Unexpected end of data");
+    }
+    return count;
+  }
+  auto read_string() -> std::string {
+    const auto bytes = read_bytes(read<uint32_t>());
+    return {reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+  }
+};
+
+/**
+ * @brief Finds the definition of a node from its definition id and name.
+ */
+using FindDefinition = std::function<graph::material::MaterialNodeDefinition(
+    const std::string& id, const std::string& name)>;
+
+// FNV-1a, which unlike std::hash is the same everywhere, as it's stored.
+auto hash_bytes(std::span<const uint8_t> bytes) -> uint64_t;
+
+auto write_value(Writer& writer, const property::PropertyValue& value)
+    -> void;
+auto read_value(Reader& reader) -> property::PropertyValue;
+
+/**
+ * @brief Writes the UUID, definition id and name of @a node followed by its
+ * state, which is its position, buffer settings and property values.
+ */
+auto write_node(Writer& writer, graph::material::MaterialNode& node) -> void;
+
+struct NodeHeader {
+  UUID uuid = 0;
+  std::string definition_id;
+  std::string name;
+};
+
+/**
+ * @brief Reads the start of a node written by write_node, its state has to
+ * be read with read_node_state next.
+ */
+auto read_node_header(Reader& reader) -> NodeHeader;
+/**
+ * @brief Reads the state of @a node. Values of properties that no longer
+ * exist or changed type are skipped.
+ */
+auto read_node_state(Reader& reader, graph::material::MaterialNode& node)
+    -> void;
+
+/**
+ * @brief Writes @a link of @a graph.
+ *
+ * @throw std::runtime_error if a node or property doesn't exist.
+ */
+auto write_link(Writer& writer, graph::Graph& graph, const graph::Link& link)
+    -> void;
+/**
+ * @brief Reads a link between nodes of @a graph.
+ *
+ * @throw std::runtime_error if a node or property doesn't exist.
+ */
+auto read_link(Reader& reader, graph::Graph& graph) -> graph::Link;
+
+/**
+ * @brief Writes the name, output node and exposed properties of @a graph.
+ */
+auto write_graph_info(Writer& writer, graph::material::MaterialGraph& graph)
+    -> void;
+/**
+ * @brief Sets the name and output node of @a graph and exposes the
+ * properties it doesn't expose yet.
+ */
+auto read_graph_info(Reader& reader, graph::material::MaterialGraph& graph)
+    -> void;
+
+/**
+ * @brief Writes the nodes, links and info of @a graph. Links to nodes that
+ * were removed are left out.
+ */
+auto write_graph(Writer& writer, graph::material::MaterialGraph& graph)
+    -> void;
+/**
+ * @brief Adds the nodes, links and info written by write_graph to the empty
+ * @a graph.
+ */
+auto read_graph(Reader& reader, graph::material::MaterialGraph& graph,
+                const FindDefinition& find_definition) -> void;
+}  // namespace afro::io::codec
@@ -11,20 +11,233 @@
 #include <OpenImageIO/imageio.h>
 #include <fmt/format.h>
 
+#include <algorithm>
 #include <array>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
 
-#include "core/image_texture.h"
+#include "common/image_texture.h"
+#include "common/packed_file.h"
+#include "common/pixel_convert.h"
+#include "image_cache.h"
+
+namespace fs = std::filesystem;
 
 namespace afro::io {
 using namespace core;
+
+namespace {
+constexpr int TILE_SIZE = 64;
+
+// Lets OpenImageIO read a packed file without unpacking all of it.
+class PackedFileReader : public OIIO::Filesystem::IOProxy {
+ private:
+  const PackedFile &file_;
+
+ public:
+  explicit PackedFileReader(const PackedFile &file)
+      : IOProxy("", IOProxy::Read), file_(file) {}
+
+  [[nodiscard]] auto proxytype() const -> const char * override {
+    return "afro_packed_file";
+  }
+  auto read(void *data, size_t size) -> size_t override {
+    const auto read = pread(data, size, m_pos);
+    m_pos += static_cast<int64_t>(read);
+    return read;
+  }
+  auto pread(void *data, size_t size, int64_t offset) -> size_t override {
+    const auto begin = std::min(static_cast<size_t>(offset), file_.get_size());
+    const auto read = std::min(size, file_.get_size() - begin);
+    file_.read(begin, {static_cast<uint8_t *>(data), read});
+    return read;
+  }
+  [[nodiscard]] auto size() const -> size_t override {
+    return file_.get_size();
+  }
+};
+
+auto open_input(const fs::path &path) -> std::unique_ptr<OIIO::ImageInput> {
+  auto input = OIIO::ImageInput::open(path.string());
+  if (input == nullptr) {
+    throw std::runtime_error(
+        fmt::format("Can't open {}: {}", path.string(), OIIO::geterror()));
+  }
+  return input;
+}
+
+auto is_float(const OIIO::ImageSpec &spec) -> bool {
+  return spec.format.basetype != OIIO::TypeDesc::UINT8;
+}
+
+// Format of the channels read from a file, at most four are read.
+auto get_pixel_format(const OIIO::ImageSpec &spec) -> PixelFormat {
+  auto format = PixelFormat{std::min(spec.nchannels, 4)};
+  switch (spec.format.basetype) {
+    case OIIO::TypeDesc::UINT8:
+      format.type = ChannelType::UINT8;
+      break;
+    case OIIO::TypeDesc::UINT16:
+      format.type = ChannelType::UINT16;
+      break;
+    case OIIO::TypeDesc::HALF:
+      format.type = ChannelType::FLOAT16;
+      break;
+    default:
+      format.type = ChannelType::FLOAT32;
+      break;
+  }
+  if (spec.get_string_attribute("oiio:ColorSpace") == "sRGB") {
+    format.color_space = ColorSpace::SRGB;
+  }
+  return format;
+}
+
+auto get_type_desc(ChannelType type) -> OIIO::TypeDesc {
+  switch (type) {
+    case ChannelType::UINT8:
+      return OIIO::TypeDesc::UINT8;
+    case ChannelType::UINT16:
+      return OIIO::TypeDesc::UINT16;
+    case ChannelType::FLOAT16:
+      return OIIO::TypeDesc::HALF;
+    case ChannelType::FLOAT32:
+      break;
+  }
+  return OIIO::TypeDesc::FLOAT;
+}
+
+// Reads a region of the current mip level in @a format. Tiles are read
+// whole, so the region is grown to their bounds and viewed afterwards.
+auto read_region(OIIO::ImageInput &input, int mip_level,
+                 const PixelFormat &format, int x, int y, int width,
+                 int height) -> ImageBuffer {
+  const auto &spec = input.spec();
+  auto x_begin = 0;
+  auto x_end = spec.width;
+  auto y_begin = y;
+  auto y_end = y + height;
+  if (spec.tile_width > 0) {
+    x_begin = x / spec.tile_width * spec.tile_width;
+    x_end = std::min(spec.width, (x + width + spec.tile_width - 1) /
+                                     spec.tile_width * spec.tile_width);
+    y_begin = y / spec.tile_height * spec.tile_height;
+    y_end = std::min(spec.height, (y + height + spec.tile_height - 1) /
+                                      spec.tile_height * spec.tile_height);
+  }
+  auto pixels = ImageBuffer(format, x_end - x_begin, y_end - y_begin);
+  const auto type = get_type_desc(format.type);
+  const auto read =
+      spec.tile_width > 0
+          ? input.read_tiles(0, mip_level, spec.x + x_begin, spec.x + x_end,
+                             spec.y + y_begin, spec.y + y_end, spec.z,
+                             spec.z + 1, 0, format.channels, type,
+                             pixels.get_mutable_data())
+          : input.read_scanlines(0, mip_level, spec.y + y_begin,
+                                 spec.y + y_end, spec.z, 0, format.channels,
+                                 type, pixels.get_mutable_data());
+  if (!read) {
+    throw std::runtime_error(input.geterror());
+  }
+  return pixels.get_region(x - x_begin, y - y_begin, width, height);
+}
+
+// Decodes into RGBA of the file's color space, 8 bit files stay 8 bit and
+// deeper ones become 32 bit float.
+auto decode(OIIO::ImageInput &input, std::string_view name, int mip_level,
+            std::optional<std::array<int, 4>> region = std::nullopt)
+    -> ImageBuffer {
+  if (!input.seek_subimage(0, mip_level)) {
+    throw std::runtime_error(
+        fmt::format("{} has no mip level {}", name, mip_level));
+  }
+  const auto &spec = input.spec();
+  const auto [x, y, width, height] =
+      region.value_or(std::array<int, 4>{0, 0, spec.width, spec.height});
+  if (x < 0 || y < 0 || width <= 0 || height <= 0 ||
+      x + width > spec.width || y + height > spec.height) {
+    throw std::runtime_error(
+        fmt::format("Region is outside of mip level {} of {}", mip_level,
+                    name));
+  }
+  const auto source_format = get_pixel_format(spec);
+  const auto format =
+      PixelFormat{4,
+                  is_float(spec) ? ChannelType::FLOAT32 : ChannelType::UINT8,
+                  source_format.color_space};
+  return convert_image(
+      read_region(input, mip_level, source_format, x, y, width, height),
+      format);
+}
+}  // namespace
+
 auto load_image_from_file(std::string_view file_path) -> ImageBuffer {
-  // TODO Implement
-  return ImageBuffer(ImageTextureFormat::rgba8, 0, 0);
+  return *ImageCache::get().load(fs::path(file_path));
+}
+
+auto load_image_from_memory(std::string_view file_name, void *data,
+                            size_t size) -> ImageBuffer {
+  auto proxy = OIIO::Filesystem::IOMemReader(data, size);
+  auto input = OIIO::ImageInput::open(std::string(file_name), nullptr, &proxy);
+  if (input == nullptr) {
+    throw std::runtime_error(
+        fmt::format("Can't decode {}: {}", file_name, OIIO::geterror()));
+  }
+  return decode(*input, file_name, 0);
+}
+
+auto load_image_from_packed_file(std::string_view file_name,
+                                 const PackedFile &file) -> ImageBuffer {
+  auto proxy = PackedFileReader(file);
+  auto input = OIIO::ImageInput::open(std::string(file_name), nullptr, &proxy);
+  if (input == nullptr) {
+    throw std::runtime_error(
+        fmt::format("Can't decode {}: {}", file_name, OIIO::geterror()));
+  }
+  return decode(*input, file_name, 0);
+}
+
+auto read_image_info(const fs::path &path) -> ImageInfo {
+  auto input = open_input(path);
+  const auto &spec = input->spec();
+  auto info = ImageInfo{spec.width, spec.height, 1, is_float(spec)};
+  while (input->seek_subimage(0, info.mip_levels)) {
+    ++info.mip_levels;
+  }
+  return info;
+}
+
+auto decode_image(const fs::path &path, int mip_level) -> ImageBuffer {
+  auto input = open_input(path);
+  return decode(*input, path.string(), mip_level);
+}
+
+auto decode_image_region(const fs::path &path, int mip_level, int x, int y,
+                         int width, int height) -> ImageBuffer {
+  auto input = open_input(path);
+  return decode(*input, path.string(), mip_level,
+                std::array<int, 4>{x, y, width, height});
 }
 
-auto load_image_from_memory(std::string_view file_name, void *data, size_t size) -> ImageBuffer {
-  // TODO Implement
-  return ImageBuffer(ImageTextureFormat::rgba8, 0, 0);
+auto write_tiled_image(const fs::path &source, const fs::path &destination)
+    -> void {
+  auto config = OIIO::ImageSpec();
+  config.tile_width = TILE_SIZE;
+  config.tile_height = TILE_SIZE;
+  config.attribute("compression", "zip");
+  config.attribute("maketx:filtername", "lanczos3");
+  // Readers never see a partially written file.
+  auto partial = destination;
+  partial.replace_extension(".partial" + destination.extension().string());
+  if (!OIIO::ImageBufAlgo::make_texture(OIIO::ImageBufAlgo::MakeTxTexture,
+                                        source.string(), partial.string(),
+                                        config)) {
+    throw std::runtime_error(fmt::format("Can't convert {}: {}",
+                                         source.string(), OIIO::geterror()));
+  }
+  fs::rename(partial, destination);
 }
 
 }  // namespace afro::io
@@ -6,11 +6,71 @@
 
 #pragma once
 
-#include "core/image_texture.h"
+#include <filesystem>
+#include <string_view>
+
+#include "common/image_texture.h"
 
 namespace afro::io {
+struct ImageInfo {
+  int width = 0;
+  int height = 0;
+  // Levels stored in the file, 1 unless it is mip-mapped.
+  int mip_levels = 1;
+  // More than 8 bits per channel, decoded as rgba32f.
+  bool is_float = false;
+};
+
+/**
+ * @brief Decodes the file at @a file_path into 8 bit RGBA, or 32 bit float
+ * RGBA if it has more than 8 bits per channel, keeping the color space of
+ * the file. Decoded images are cached, see ImageCache.
+ *
+ * @throw std::runtime_error if the file can't be decoded.
+ */
 auto load_image_from_file(std::string_view file_path) -> core::ImageBuffer;
 
+/**
+ * @brief Decodes an image file that was read into memory, @a file_name is
+ * used to pick the format.
+ *
+ * @throw std::runtime_error if the data can't be decoded.
+ */
 auto load_image_from_memory(std::string_view file_name, void *data, size_t size)
     -> core::ImageBuffer;
-}  // namespace afro::io
\ No newline at end of file
+
+/**
+ * @brief Decodes an image file embedded in a project, only the chunks the
+ * decoder reads are decompressed.
+ *
+ * @throw std::runtime_error if the data can't be decoded.
+ */
+auto load_image_from_packed_file(std::string_view file_name,
+                                 const core::PackedFile &file)
+    -> core::ImageBuffer;
+
+// Uncached access to image files, each call opens the file.
+
+/**
+ * @throw std::runtime_error if the file can't be opened.
+ */
+auto read_image_info(const std::filesystem::path &path) -> ImageInfo;
+/**
+ * @brief Decodes @a mip_level of a file like load_image_from_file().
+ */
+auto decode_image(const std::filesystem::path &path, int mip_level = 0)
+    -> core::ImageBuffer;
+/**
+ * @brief Decodes a region of @a mip_level. Only the tiles overlapping the
+ * region are read from tiled files.
+ */
+auto decode_image_region(const std::filesystem::path &path, int mip_level,
+                         int x, int y, int width, int height)
+    -> core::ImageBuffer;
+/**
+ * @brief Converts @a source into a tiled file with every mip level at
+ * @a destination, which is written atomically.
+ */
+auto write_tiled_image(const std::filesystem::path &source,
+                       const std::filesystem::path &destination) -> void;
+}  // namespace afro::io
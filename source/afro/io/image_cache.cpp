@@ -0,0 +1,200 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "image_cache.h"
+
+#include <OpenImageIO/thread.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
+#include "utils/log.h"
+#include "utils/paths.h"
+
+namespace fs = std::filesystem;
+
+namespace afro::io {
+auto get_modified_time(const fs::path& path) -> int64_t {
+  auto error = std::error_code();
+  const auto time = fs::last_write_time(path, error);
+  return error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+auto ImageCache::get() -> ImageCache& {
+  static ImageCache cache;
+  return cache;
+}
+
+auto ImageCache::get_info(const fs::path& path) -> ImageInfo {
+  auto info = read_image_info(path);
+  if (info.mip_levels == 1 && std::max(info.width, info.height) > TILED_SIZE) {
+    info.mip_levels = std::bit_width(
+        static_cast<unsigned>(std::max(info.width, info.height)));
+  }
+  return info;
+}
+
+auto ImageCache::get_source(const fs::path& path, int64_t modified)
+    -> fs::path {
+  const auto info = read_image_info(path);
+  // Files with their own mip levels are read directly.
+  if (info.mip_levels > 1 || std::max(info.width, info.height) <= TILED_SIZE) {
+    return path;
+  }
+  const auto name = fmt::format(
+      "{:016x}", std::hash<std::string>()(fs::absolute(path).string()));
+  const auto directory = paths::cache_dir() / "images";
+  const auto tiled = directory / fmt::format("{}-{}.tx", name, modified);
+  auto lock = std::scoped_lock(tiled_mutex_);
+  if (!fs::exists(tiled)) {
+    fs::create_directories(directory);
+    // Files of earlier versions of the image are stale.
+    for (const auto& file : fs::directory_iterator(directory)) {
+      if (file.path().filename().string().starts_with(name + "-")) {
+        fs::remove(file.path());
+      }
+    }
+    log::core_info("Converting {} into a tiled image", path.string());
+    write_tiled_image(path, tiled);
+  }
+  return tiled;
+}
+
+auto ImageCache::decode(const fs::path& path, int64_t modified, int mip_level)
+    -> ImagePtr {
+  auto image = ImagePtr();
+  try {
+    image = std::make_shared<const core::ImageBuffer>(
+        decode_image(get_source(path, modified), mip_level));
+  } catch (const std::exception& error) {
+    log::core_error("Failed to decode {}: {}", path.string(), error.what());
+    return nullptr;
+  }
+
+  auto lock = std::scoped_lock(mutex_);
+  auto iter = entries_.find(Key(path.string(), modified, mip_level));
+  if (iter != entries_.end() && iter->second.bytes == 0) {
+    iter->second.bytes = image->get_storage()->get_size();
+    memory_usage_ += iter->second.bytes;
+    // The image that was just decoded is the most recently used, which is
+    // kept even if it's over budget so it isn't decoded again right away.
+    iter->second.last_used = ++uses_;
+    evict();
+  }
+  return image;
+}
+
+auto ImageCache::evict() -> void {
+  while (memory_usage_ > memory_budget_) {
+    auto oldest = entries_.end();
+    for (auto iter = entries_.begin(); iter != entries_.end(); ++iter) {
+      // Images still being decoded don't count yet.
+      if (iter->second.bytes > 0 && iter->second.last_used < uses_ &&
+          (oldest == entries_.end() ||
+           iter->second.last_used < oldest->second.last_used)) {
+        oldest = iter;
+      }
+    }
+    if (oldest == entries_.end()) {
+      return;
+    }
+    memory_usage_ -= oldest->second.bytes;
+    entries_.erase(oldest);
+  }
+}
+
+auto ImageCache::request(const fs::path& path, int mip_level)
+    -> std::shared_future<ImagePtr> {
+  const auto modified = get_modified_time(path);
+  auto promise = std::shared_ptr<std::promise<ImagePtr>>();
+  auto image = std::shared_future<ImagePtr>();
+  {
+    auto lock = std::scoped_lock(mutex_);
+    auto& entry = entries_[Key(path.string(), modified, mip_level)];
+    entry.last_used = ++uses_;
+    if (entry.image.valid()) {
+      return entry.image;
+    }
+    promise = std::make_shared<std::promise<ImagePtr>>();
+    entry.image = promise->get_future().share();
+    image = entry.image;
+  }
+  // A pool without threads runs the task right away, so mutex_ can't be
+  // held here.
+  OIIO::default_thread_pool()->push(
+      [this, promise, path, modified, mip_level](int) {
+        promise->set_value(decode(path, modified, mip_level));
+        image_loaded(path);
+      });
+  return image;
+}
+
+auto ImageCache::load(const fs::path& path, int mip_level) -> ImagePtr {
+  auto image = request(path, mip_level).get();
+  if (image == nullptr) {
+    throw std::runtime_error(
+        fmt::format("Can't decode mip level {} of {}", mip_level,
+                    path.string()));
+  }
+  return image;
+}
+
+auto ImageCache::is_ready(const fs::path& path, int mip_level) -> bool {
+  const auto key = Key(path.string(), get_modified_time(path), mip_level);
+  auto lock = std::scoped_lock(mutex_);
+  auto iter = entries_.find(key);
+  return iter != entries_.end() && iter->second.image.valid() &&
+         iter->second.image.wait_for(std::chrono::seconds(0)) ==
+             std::future_status::ready;
+}
+
+auto ImageCache::is_loading(const fs::path& path) -> bool {
+  const auto name = path.string();
+  auto lock = std::scoped_lock(mutex_);
+  for (auto iter = entries_.lower_bound(
+           Key(name, std::numeric_limits<int64_t>::min(), 0));
+       iter != entries_.end() && std::get<0>(iter->first) == name; ++iter) {
+    if (iter->second.image.valid() &&
+        iter->second.image.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready) {
+      return true;
+    }
+  }
+  return false;
+}
+
+auto ImageCache::load_region(const fs::path& path, int mip_level, int x,
+                             int y, int width, int height)
+    -> core::ImageBuffer {
+  return decode_image_region(get_source(path, get_modified_time(path)),
+                             mip_level, x, y, width, height);
+}
+
+auto ImageCache::set_memory_budget(size_t bytes) -> void {
+  auto lock = std::scoped_lock(mutex_);
+  memory_budget_ = bytes;
+  ++uses_;
+  evict();
+}
+
+auto ImageCache::get_memory_usage() -> size_t {
+  auto lock = std::scoped_lock(mutex_);
+  return memory_usage_;
+}
+
+auto ImageCache::clear() -> void {
+  auto lock = std::scoped_lock(mutex_);
+  entries_.clear();
+  memory_usage_ = 0;
+}
+}  // namespace afro::io
@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <boost/signals2/signal.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+
+#include "common/image_texture.h"
+#include "image.h"
+
+namespace afro::io {
+using ImagePtr = std::shared_ptr<const core::ImageBuffer>;
+
+/**
+ * @brief Decodes images on OpenImageIO's thread pool and keeps them in
+ * memory, keyed by path, modification time and mip level, so editing a file
+ * invalidates it. The least recently used images are dropped once they take
+ * more than the memory budget.
+ *
+ * Images with a side larger than TILED_SIZE are converted once into tiled,
+ * mip-mapped files in paths::cache_dir(). Their mip levels and regions are
+ * read from those without decoding the full image.
+ */
+class ImageCache {
+ public:
+  static constexpr int TILED_SIZE = 2048;
+  static constexpr size_t DEFAULT_MEMORY_BUDGET = size_t{512} << 20;
+
+ private:
+  // Path, modification time and mip level.
+  using Key = std::tuple<std::string, int64_t, int>;
+
+  struct Entry {
+    std::shared_future<ImagePtr> image;
+    size_t bytes = 0;
+    uint64_t last_used = 0;
+  };
+
+  std::mutex mutex_;
+  std::map<Key, Entry> entries_;
+  size_t memory_usage_ = 0;
+  size_t memory_budget_ = DEFAULT_MEMORY_BUDGET;
+  uint64_t uses_ = 0;
+  // Held while a tiled file is written so it's only written once.
+  std::mutex tiled_mutex_;
+
+  // Path of the file mip levels of @a path are read from, its tiled file
+  // for large images, which is written first if it doesn't exist.
+  auto get_source(const std::filesystem::path& path, int64_t modified)
+      -> std::filesystem::path;
+  auto decode(const std::filesystem::path& path, int64_t modified,
+              int mip_level) -> ImagePtr;
+  // Called with mutex_ held.
+  auto evict() -> void;
+
+ public:
+  /**
+   * @brief Emitted on a decode thread with the path of each image that
+   * finished decoding.
+   */
+  boost::signals2::signal<void(const std::filesystem::path&)> image_loaded;
+
+  static auto get() -> ImageCache&;
+
+  /**
+   * @brief Size of @a path and the mip levels request() can decode, which
+   * are all levels down to 1x1 for large images and only the image itself
+   * for others.
+   *
+   * @throw std::runtime_error if the file can't be opened.
+   */
+  auto get_info(const std::filesystem::path& path) -> ImageInfo;
+  /**
+   * @brief Starts decoding @a mip_level of @a path unless it's cached. The
+   * result is null if decoding failed, which is logged.
+   */
+  auto request(const std::filesystem::path& path, int mip_level = 0)
+      -> std::shared_future<ImagePtr>;
+  /**
+   * @brief Decodes @a mip_level of @a path, waiting for it.
+   *
+   * @throw std::runtime_error if the image can't be decoded.
+   */
+  auto load(const std::filesystem::path& path, int mip_level = 0) -> ImagePtr;
+  /**
+   * @brief Whether request() would return a finished image.
+   */
+  auto is_ready(const std::filesystem::path& path, int mip_level = 0) -> bool;
+  /**
+   * @brief Whether any mip level of @a path is being decoded.
+   */
+  auto is_loading(const std::filesystem::path& path) -> bool;
+  /**
+   * @brief Decodes a region of @a mip_level of @a path, which isn't cached.
+   *
+   * @throw std::runtime_error if the region can't be decoded.
+   */
+  auto load_region(const std::filesystem::path& path, int mip_level, int x,
+                   int y, int width, int height) -> core::ImageBuffer;
+
+  auto set_memory_budget(size_t bytes) -> void;
+  [[nodiscard]] auto get_memory_usage() -> size_t;
+  /**
+   * @brief Drops every decoded image, tiled files are kept.
+   */
+  auto clear() -> void;
+};
+
+/**
+ * @brief Modification time of @a path as a count, 0 if it doesn't exist.
+ */
+auto get_modified_time(const std::filesystem::path& path) -> int64_t;
+}  // namespace afro::io
@@ -0,0 +1,487 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "project.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "graph_codec.h"
+#include "material_graph/definitions/subgraph_definition.h"
+#include "utils/assert.h"
+#include "utils/log.h"
+
+namespace fs = std::filesystem;
+
+namespace afro::io {
+using namespace graph::material;
+using codec::hash_bytes;
+using codec::Reader;
+using codec::Writer;
+
+namespace {
+constexpr auto MAGIC = std::array<char, 8>{'A', 'F', 'R', 'O',
+                                           'P', 'R', 'O', 'J'};
+constexpr size_t HEADER_SIZE = Project::ALIGNMENT;
+constexpr size_t TOC_ENTRY_SIZE = 48;
+constexpr std::string_view SUBGRAPH_PREFIX = "subgraph_";
+
+auto pad(std::ostream& out) -> void {
+  const auto position = static_cast<uint64_t>(out.tellp());
+  const auto padding = (Project::ALIGNMENT - position % Project::ALIGNMENT) %
+                       Project::ALIGNMENT;
+  const auto zeros = std::array<char, Project::ALIGNMENT>();
+  out.write(zeros.data(), static_cast<std::streamsize>(padding));
+}
+
+auto write(std::ostream& out, std::span<const uint8_t> bytes) -> void {
+  out.write(reinterpret_cast<const char*>(bytes.data()),
+            static_cast<std::streamsize>(bytes.size()));
+}
+
+auto write_graph(MaterialGraph& graph) -> std::vector<uint8_t> {
+  auto writer = Writer();
+  codec::write_graph(writer, graph);
+  return std::move(writer.get_bytes());
+}
+
+// Everything but the compressed bytes of the chunks, which follow it.
+auto write_asset_header(const Project::Asset& asset) -> std::vector<uint8_t> {
+  auto writer = Writer();
+  writer.write_string(asset.name);
+  writer.write(static_cast<uint64_t>(asset.file.get_size()));
+  writer.write(static_cast<uint32_t>(asset.file.get_chunks().size()));
+  for (const auto& chunk : asset.file.get_chunks()) {
+    writer.write(static_cast<uint64_t>(chunk->get_size()));
+    writer.write(static_cast<uint64_t>(chunk->get_compressed().size()));
+  }
+  return std::move(writer.get_bytes());
+}
+
+auto write_asset(std::ostream& out, const Project::Asset& asset)
+    -> uint64_t {
+  const auto header = write_asset_header(asset);
+  write(out, header);
+  auto size = static_cast<uint64_t>(header.size());
+  for (const auto& chunk : asset.file.get_chunks()) {
+    write(out, chunk->get_compressed());
+    size += chunk->get_compressed().size();
+  }
+  return size;
+}
+}  // namespace
+
+Project::Project(std::vector<MaterialNodeDefinition> definitions)
+    : definitions_(std::move(definitions)) {}
+
+auto Project::open(const fs::path& path,
+                   std::vector<MaterialNodeDefinition> definitions)
+    -> Project {
+  auto project = Project(std::move(definitions));
+  project.path_ = path;
+  project.file_ = std::make_shared<core::MappedFileStorage>(path);
+  const auto file = std::span<const uint8_t>(project.file_->get_data(),
+                                             project.file_->get_size());
+  if (file.size() < HEADER_SIZE ||
+      !std::equal(MAGIC.begin(), MAGIC.end(), file.begin())) {
+    throw std::runtime_error(
+        fmt::format("{} isn't a project", path.string()));
+  }
+
+  auto header = Reader(file.subspan(MAGIC.size(), HEADER_SIZE - MAGIC.size()));
+  const auto version = header.read<uint32_t>();
+  if (version > VERSION) {
+    throw std::runtime_error(
+        fmt::format("{} is from a newer version of Afro", path.string()));
+  }
+  header.read<uint32_t>();
+  const auto toc_offset = header.read<uint64_t>();
+  const auto toc_size = header.read<uint64_t>();
+  const auto toc_hash = header.read<uint64_t>();
+  if (toc_offset > file.size() || toc_size > file.size() - toc_offset ||
+      hash_bytes(file.subspan(toc_offset, toc_size)) != toc_hash) {
+    throw std::runtime_error(
+        fmt::format("The table of contents of {} is corrupt", path.string()));
+  }
+
+  auto toc = Reader(file.subspan(toc_offset, toc_size));
+  const auto count = toc.read<uint32_t>();
+  toc.read<uint32_t>();
+  for (uint32_t i = 0; i < count; ++i) {
+    auto section = Section();
+    section.kind = static_cast<SectionKind>(toc.read<uint32_t>());
+    toc.read<uint32_t>();
+    section.uuid = toc.read<UUID>();
+    section.offset = toc.read<uint64_t>();
+    section.size = toc.read<uint64_t>();
+    section.hash = toc.read<uint64_t>();
+    toc.read<uint64_t>();
+    if (section.offset > file.size() ||
+        section.size > file.size() - section.offset) {
+      throw std::runtime_error(fmt::format(
+          "Section {} of {} is past its end", i, path.string()));
+    }
+    switch (section.kind) {
+      case SectionKind::GRAPH:
+        project.graphs_[section.uuid].section = section;
+        break;
+      case SectionKind::ASSET:
+        project.assets_[section.uuid].section = section;
+        break;
+      default:
+        project.other_sections_.push_back(section);
+        break;
+    }
+  }
+  project.saved_section_count_ = count;
+  log::core_info("Opened {} with {} sections", path.string(), count);
+  return project;
+}
+
+auto Project::get_file_size() const -> uint64_t {
+  return path_.empty() ? 0 : fs::file_size(path_);
+}
+
+auto Project::get_used_size() const -> uint64_t {
+  auto size = uint64_t{HEADER_SIZE};
+  const auto add = [&size](const Section& section) {
+    size += (section.size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  };
+  for (const auto& [uuid, entry] : graphs_) {
+    add(entry.section);
+  }
+  for (const auto& [uuid, entry] : assets_) {
+    add(entry.section);
+  }
+  for (const auto& section : other_sections_) {
+    add(section);
+  }
+  return size + 8 + TOC_ENTRY_SIZE * (graphs_.size() + assets_.size() +
+                                      other_sections_.size());
+}
+
+auto Project::get_bytes(const Section& section) const
+    -> std::span<const uint8_t> {
+  AF_ASSERT_MSG(file_ != nullptr &&
+                    section.offset + section.size <= file_->get_size(),
+                "Section isn't in the mapped file")
+  return {file_->get_data() + section.offset, section.size};
+}
+
+auto Project::find_definition(const std::string& id, const std::string& name)
+    -> MaterialNodeDefinition {
+  for (const auto& definition : definitions_) {
+    if (definition.get_id() == id) {
+      return definition;
+    }
+  }
+  // Subgraph instances are defined by a graph of the project.
+  if (id.starts_with(SUBGRAPH_PREFIX)) {
+    const auto uuid = static_cast<UUID>(
+        std::stoull(id.substr(SUBGRAPH_PREFIX.size())));
+    if (graphs_.contains(uuid)) {
+      return make_subgraph_definition(get_graph(uuid), name);
+    }
+  }
+  throw std::runtime_error(fmt::format("Unknown node definition {}", id));
+}
+
+auto Project::load_graph(GraphEntry& entry) -> void {
+  if (entry.is_loading) {
+    throw std::runtime_error(
+        fmt::format("Graph {} is a subgraph of itself", entry.section.uuid));
+  }
+  const auto bytes = get_bytes(entry.section);
+  if (hash_bytes(bytes) != entry.section.hash) {
+    throw std::runtime_error(
+        fmt::format("Graph {} is corrupt", entry.section.uuid));
+  }
+  entry.is_loading = true;
+  auto reader = Reader(bytes);
+  auto graph = std::make_shared<MaterialGraph>(entry.section.uuid);
+  try {
+    codec::read_graph(reader, *graph,
+                      [this](const std::string& id, const std::string& name) {
+                        return find_definition(id, name);
+                      });
+  } catch (...) {
+    entry.is_loading = false;
+    throw;
+  }
+  entry.is_loading = false;
+  entry.graph = std::move(graph);
+}
+
+auto Project::load_asset(const AssetEntry& entry) const
+    -> std::shared_ptr<const Asset> {
+  auto reader = Reader(get_bytes(entry.section));
+  auto asset = std::make_shared<Asset>();
+  asset->name = reader.read_string();
+  const auto size = reader.read<uint64_t>();
+  auto chunk_sizes = std::vector<std::pair<uint64_t, uint64_t>>(
+      reader.read_count(sizeof(uint64_t) * 2));
+  for (auto& [chunk_size, compressed_size] : chunk_sizes) {
+    chunk_size = reader.read<uint64_t>();
+    compressed_size = reader.read<uint64_t>();
+    // Chunks are decompressed into buffers of their size, so it's checked
+    // before any is.
+    if (chunk_size == 0 || chunk_size > core::PackedFile::CHUNK_SIZE) {
+      throw std::runtime_error(
+          fmt::format("Packed file {} is corrupt", entry.section.uuid));
+    }
+  }
+  auto chunks = std::vector<core::PackedChunkPtr>();
+  chunks.reserve(chunk_sizes.size());
+  for (const auto& [chunk_size, compressed_size] : chunk_sizes) {
+    const auto compressed = reader.read_bytes(compressed_size);
+    chunks.push_back(core::PackedChunkStore::get().add_compressed(
+        {compressed.begin(), compressed.end()}, chunk_size));
+  }
+  asset->file = core::PackedFile(std::move(chunks));
+  if (asset->file.get_size() != size) {
+    throw std::runtime_error(
+        fmt::format("Packed file {} is corrupt", entry.section.uuid));
+  }
+  return asset;
+}
+
+auto Project::get_graph_uuids() const -> std::vector<UUID> {
+  auto uuids = std::vector<UUID>();
+  for (const auto& [uuid, entry] : graphs_) {
+    uuids.push_back(uuid);
+  }
+  return uuids;
+}
+
+auto Project::get_graph(UUID uuid) -> std::shared_ptr<MaterialGraph> {
+  auto& entry = graphs_.at(uuid);
+  if (entry.graph == nullptr) {
+    load_graph(entry);
+  }
+  return entry.graph;
+}
+
+auto Project::is_loaded(UUID uuid) const -> bool {
+  if (auto iter = graphs_.find(uuid); iter != graphs_.end()) {
+    return iter->second.graph != nullptr;
+  }
+  if (auto iter = assets_.find(uuid); iter != assets_.end()) {
+    return iter->second.asset != nullptr;
+  }
+  return false;
+}
+
+auto Project::add_graph(std::shared_ptr<MaterialGraph> graph) -> void {
+  auto& entry = graphs_[graph->get_uuid()];
+  entry.section = {SectionKind::GRAPH, graph->get_uuid()};
+  entry.graph = std::move(graph);
+}
+
+auto Project::remove_graph(UUID uuid) -> void { graphs_.erase(uuid); }
+
+auto Project::get_asset_uuids() const -> std::vector<UUID> {
+  auto uuids = std::vector<UUID>();
+  for (const auto& [uuid, entry] : assets_) {
+    uuids.push_back(uuid);
+  }
+  return uuids;
+}
+
+auto Project::get_asset(UUID uuid) -> std::shared_ptr<const Asset> {
+  auto& entry = assets_.at(uuid);
+  if (entry.asset == nullptr) {
+    entry.asset = load_asset(entry);
+  }
+  return entry.asset;
+}
+
+auto Project::add_asset(UUID uuid, Asset asset) -> void {
+  auto& entry = assets_[uuid];
+  entry.section = {SectionKind::ASSET, uuid};
+  entry.asset = std::make_shared<const Asset>(std::move(asset));
+}
+
+auto Project::remove_asset(UUID uuid) -> void { assets_.erase(uuid); }
+
+auto Project::save() -> void {
+  if (path_.empty()) {
+    throw std::runtime_error("The project has no path yet");
+  }
+  append_to_file();
+  // Replaced sections stay in the file until it's rewritten.
+  if (get_file_size() > 2 * get_used_size()) {
+    log::core_info("Compacting {}", path_.string());
+    write_file(path_);
+  }
+}
+
+auto Project::save_as(const fs::path& path) -> void { write_file(path); }
+
+auto Project::write_toc(std::ostream& out,
+                        const std::vector<Section>& sections) -> void {
+  auto toc = Writer();
+  toc.write(static_cast<uint32_t>(sections.size()));
+  toc.write(uint32_t{0});
+  for (const auto& section : sections) {
+    toc.write(static_cast<uint32_t>(section.kind));
+    toc.write(uint32_t{0});
+    toc.write(section.uuid);
+    toc.write(section.offset);
+    toc.write(section.size);
+    toc.write(section.hash);
+    toc.write(uint64_t{0});
+  }
+  pad(out);
+  const auto toc_offset = static_cast<uint64_t>(out.tellp());
+  write(out, toc.get_bytes());
+  // The sections and the table are on disk before the header points at
+  // them, so an interrupted save leaves the previous one intact.
+  out.flush();
+  auto header = Writer();
+  header.write(VERSION);
+  header.write(uint32_t{0});
+  header.write(toc_offset);
+  header.write(static_cast<uint64_t>(toc.get_bytes().size()));
+  header.write(hash_bytes(toc.get_bytes()));
+  out.seekp(0);
+  out.write(MAGIC.data(), MAGIC.size());
+  write(out, header.get_bytes());
+  out.flush();
+}
+
+auto Project::get_sections() const -> std::vector<Section> {
+  auto sections = std::vector<Section>();
+  for (const auto& [uuid, entry] : graphs_) {
+    sections.push_back(entry.section);
+  }
+  for (const auto& [uuid, entry] : assets_) {
+    sections.push_back(entry.section);
+  }
+  sections.insert(sections.end(), other_sections_.begin(),
+                  other_sections_.end());
+  return sections;
+}
+
+auto Project::write_file(const fs::path& path) -> void {
+  auto partial = path;
+  partial += ".partial";
+  auto sections = get_sections();
+  {
+    auto out = std::ofstream(partial, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      throw std::runtime_error(
+          fmt::format("Can't write {}", partial.string()));
+    }
+    out.write(std::array<char, HEADER_SIZE>().data(), HEADER_SIZE);
+    auto section = sections.begin();
+    // Sections that weren't loaded are copied from the current file.
+    const auto write_section = [&](const auto& write_loaded) {
+      pad(out);
+      const auto offset = static_cast<uint64_t>(out.tellp());
+      if (!write_loaded()) {
+        write(out, get_bytes(*section));
+      }
+      section->offset = offset;
+      section->size = static_cast<uint64_t>(out.tellp()) - offset;
+      ++section;
+    };
+    for (const auto& [uuid, entry] : graphs_) {
+      write_section([&]() {
+        if (entry.graph == nullptr) {
+          return false;
+        }
+        const auto bytes = write_graph(*entry.graph);
+        write(out, bytes);
+        section->hash = hash_bytes(bytes);
+        return true;
+      });
+    }
+    for (const auto& [uuid, entry] : assets_) {
+      write_section([&]() {
+        if (entry.asset == nullptr) {
+          return false;
+        }
+        write_asset(out, *entry.asset);
+        return true;
+      });
+    }
+    for (size_t i = 0; i < other_sections_.size(); ++i) {
+      write_section([]() { return false; });
+    }
+    write_toc(out, sections);
+    out.close();
+    if (!out) {
+      throw std::runtime_error(
+          fmt::format("Can't write {}", partial.string()));
+    }
+  }
+
+  // The current file isn't read anymore, so it may be replaced.
+  file_ = std::make_shared<core::MappedFileStorage>(partial);
+  auto section = sections.begin();
+  for (auto& [uuid, entry] : graphs_) {
+    entry.section = *section++;
+  }
+  for (auto& [uuid, entry] : assets_) {
+    entry.section = *section++;
+  }
+  std::copy(section, sections.end(), other_sections_.begin());
+  saved_section_count_ = sections.size();
+  fs::rename(partial, path);
+  path_ = path;
+}
+
+auto Project::append_to_file() -> void {
+  auto out = std::fstream(path_, std::ios::binary | std::ios::in |
+                                     std::ios::out);
+  if (!out) {
+    throw std::runtime_error(fmt::format("Can't write {}", path_.string()));
+  }
+  out.seekp(0, std::ios::end);
+  auto changed = false;
+  for (auto& [uuid, entry] : graphs_) {
+    if (entry.graph == nullptr) {
+      continue;
+    }
+    const auto bytes = write_graph(*entry.graph);
+    const auto hash = hash_bytes(bytes);
+    if (entry.section.size > 0 && entry.section.hash == hash) {
+      continue;
+    }
+    pad(out);
+    entry.section.offset = static_cast<uint64_t>(out.tellp());
+    entry.section.size = bytes.size();
+    entry.section.hash = hash;
+    write(out, bytes);
+    changed = true;
+  }
+  for (auto& [uuid, entry] : assets_) {
+    if (entry.section.size > 0) {
+      continue;
+    }
+    pad(out);
+    entry.section.offset = static_cast<uint64_t>(out.tellp());
+    entry.section.size = write_asset(out, *entry.asset);
+    changed = true;
+  }
+  const auto sections = get_sections();
+  // Sections were removed if there are fewer.
+  if (!changed && sections.size() == saved_section_count_) {
+    return;
+  }
+  write_toc(out, sections);
+  if (!out) {
+    throw std::runtime_error(fmt::format("Can't write {}", path_.string()));
+  }
+  saved_section_count_ = sections.size();
+}
+}  // namespace afro::io
@@ -0,0 +1,196 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <ostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "common/data/uuid.h"
+#include "common/packed_file.h"
+#include "common/pixel_storage.h"
+#include "material_graph/data/material_graph.h"
+#include "material_graph/data/material_node_definition.h"
+
+namespace afro::io {
+/**
+ * @brief The graphs and packed files of a project, saved in a binary file.
+ *
+ * The file starts with a header pointing at a table of contents, which
+ * lists a section per graph and per packed file. The header, the sections
+ * and the table are aligned to ALIGNMENT bytes:
+ *
+ *     header | section | ... | section | table of contents
+ *
+ * Opening a project maps the file and only reads the table, graphs and
+ * packed files are read from the mapping when first accessed. Saving
+ * appends the sections that changed and a new table, then points the
+ * header at it. The file is rewritten without the replaced sections once
+ * they take more than half of it.
+ */
+class Project {
+ public:
+  static constexpr uint32_t VERSION = 1;
+  static constexpr size_t ALIGNMENT = 64;
+
+  struct Asset {
+    // Name of the original file, e.g. to pick the decoder of an image.
+    std::string name;
+    core::PackedFile file;
+  };
+
+ private:
+  enum class SectionKind : uint32_t { GRAPH = 1, ASSET = 2 };
+
+  struct Section {
+    SectionKind kind = SectionKind::GRAPH;
+    UUID uuid = 0;
+    // Where the section is in the file, size is 0 if it wasn't saved.
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    // Of the bytes of graph sections, so unchanged graphs aren't written.
+    uint64_t hash = 0;
+  };
+
+  struct GraphEntry {
+    Section section;
+    // Null until the graph is first accessed.
+    std::shared_ptr<graph::material::MaterialGraph> graph;
+    bool is_loading = false;
+  };
+
+  struct AssetEntry {
+    Section section;
+    // Null until the packed file is first accessed.
+    std::shared_ptr<const Asset> asset;
+  };
+
+  std::vector<graph::material::MaterialNodeDefinition> definitions_;
+  std::filesystem::path path_;
+  std::shared_ptr<core::MappedFileStorage> file_;
+  std::map<UUID, GraphEntry> graphs_;
+  std::map<UUID, AssetEntry> assets_;
+  // Sections of kinds added by newer versions, which are kept as they are.
+  std::vector<Section> other_sections_;
+  // Sections in the table of contents of the file.
+  size_t saved_section_count_ = 0;
+
+  [[nodiscard]] auto get_bytes(const Section& section) const
+      -> std::span<const uint8_t>;
+  auto load_graph(GraphEntry& entry) -> void;
+  [[nodiscard]] auto load_asset(const AssetEntry& entry) const
+      -> std::shared_ptr<const Asset>;
+  /**
+   * @brief Writes every section to a new file at @a path and reads unloaded
+   * sections from it afterwards.
+   */
+  auto write_file(const std::filesystem::path& path) -> void;
+  /**
+   * @brief Appends the sections that changed and a new table of contents to
+   * the file.
+   */
+  auto append_to_file() -> void;
+  // Bytes of the file the current sections and their table would take.
+  [[nodiscard]] auto get_used_size() const -> uint64_t;
+  // Graphs, then packed files, then other sections.
+  [[nodiscard]] auto get_sections() const -> std::vector<Section>;
+  /**
+   * @brief Appends the table of contents of @a sections to @a out and
+   * points the header at it.
+   */
+  static auto write_toc(std::ostream& out,
+                        const std::vector<Section>& sections) -> void;
+
+ public:
+  /**
+   * @brief An empty project that isn't saved yet, nodes are created from
+   * @a definitions and subgraphs of the project when it's loaded.
+   */
+  explicit Project(
+      std::vector<graph::material::MaterialNodeDefinition> definitions);
+  Project(Project&&) = default;
+  auto operator=(Project&&) -> Project& = default;
+
+  /**
+   * @brief Maps the project at @a path and reads its table of contents.
+   *
+   * @throw std::runtime_error if the file isn't a project or is from a newer
+   * version.
+   */
+  static auto open(
+      const std::filesystem::path& path,
+      std::vector<graph::material::MaterialNodeDefinition> definitions)
+      -> Project;
+
+  [[nodiscard]] auto get_path() const -> const std::filesystem::path& {
+    return path_;
+  }
+  /**
+   * @brief Size of the file, including replaced sections.
+   */
+  [[nodiscard]] auto get_file_size() const -> uint64_t;
+
+  [[nodiscard]] auto get_graph_uuids() const -> std::vector<UUID>;
+  /**
+   * @brief The graph, which is read from the file if it wasn't yet.
+   *
+   * @throw std::out_of_range if the project has no such graph.
+   * @throw std::runtime_error if the graph can't be read.
+   */
+  auto get_graph(UUID uuid) -> std::shared_ptr<graph::material::MaterialGraph>;
+  /**
+   * @brief Whether the graph or packed file was read from the file or added.
+   */
+  [[nodiscard]] auto is_loaded(UUID uuid) const -> bool;
+  auto add_graph(std::shared_ptr<graph::material::MaterialGraph> graph)
+      -> void;
+  auto remove_graph(UUID uuid) -> void;
+
+  /**
+   * @brief Definition of nodes with the definition id @a id, either one of
+   * the definitions of the project or a subgraph instance named @a name.
+   *
+   * @throw std::runtime_error if there's no such definition.
+   */
+  [[nodiscard]] auto find_definition(const std::string& id,
+                                     const std::string& name)
+      -> graph::material::MaterialNodeDefinition;
+
+  [[nodiscard]] auto get_asset_uuids() const -> std::vector<UUID>;
+  /**
+   * @brief The packed file, which is read from the file if it wasn't yet.
+   * Its chunks are only decompressed when read.
+   *
+   * @throw std::out_of_range if the project has no such packed file.
+   * @throw std::runtime_error if the packed file can't be read.
+   */
+  auto get_asset(UUID uuid) -> std::shared_ptr<const Asset>;
+  auto add_asset(UUID uuid, Asset asset) -> void;
+  auto remove_asset(UUID uuid) -> void;
+
+  /**
+   * @brief Writes the sections that changed since the project was opened or
+   * last saved.
+   *
+   * @throw std::runtime_error if the project has no path or can't be
+   * written.
+   */
+  auto save() -> void;
+  /**
+   * @brief Writes the whole project to @a path, which it's saved to from
+   * then on.
+   *
+   * @throw std::runtime_error if the file can't be written.
+   */
+  auto save_as(const std::filesystem::path& path) -> void;
+};
+}  // namespace afro::io
@@ -0,0 +1,35 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <memory>
+
+#include "common/interfaces/command.h"
+#include "material_graph/data/material_node.h"
+
+namespace afro::graph::material {
+/**
+ * @brief Switches the output of a node between 8 bits and half floats per
+ * channel.
+ */
+class SetHighPrecision : public Command {
+ private:
+  std::shared_ptr<MaterialNode> node_;
+  bool value_;
+
+ public:
+  SetHighPrecision(std::shared_ptr<MaterialNode> node, bool value)
+      : Command("SET_HIGH_PRECISION"), node_(std::move(node)), value_(value) {}
+
+  auto execute() -> void override { node_->set_high_precision(value_); }
+  auto undo() -> void override { node_->set_high_precision(!value_); }
+  [[nodiscard]] auto get_memory_usage() const -> size_t override {
+    return sizeof(*this);
+  }
+  ~SetHighPrecision() override = default;
+};
+}  // namespace afro::graph::material
@@ -6,11 +6,88 @@
 
 #include "material_graph.h"
 
+#include <fmt/format.h>
+
 #include <algorithm>
 #include <iterator>
 #include <memory>
 #include <queue>
+#include <stdexcept>
 #include <unordered_map>
 #include <utility>
 
-namespace afro::graph::material {}  // namespace afro::graph::material
\ No newline at end of file
+namespace afro::graph::material {
+auto ExposedProperty::get_instance_property_id() const -> std::string {
+  return fmt::format("{}.{}", node, property_id);
+}
+
+auto MaterialGraph::set_name(std::string new_name) -> void {
+  name = std::move(new_name);
+  bump_version();
+  interface_changed();
+}
+
+auto MaterialGraph::expose_property(UUID node, std::string property_id)
+    -> void {
+  auto material_node =
+      std::dynamic_pointer_cast<MaterialNode>(get_node_by_uuid(node));
+  if (material_node == nullptr) {
+    throw std::runtime_error("Node not found");
+  }
+  if (material_node->get_property(property_id)
+          .get_property_definition()
+          .is_socket) {
+    throw std::runtime_error("Sockets can't be exposed");
+  }
+  exposed_properties.push_back({node, std::move(property_id)});
+  bump_version();
+  interface_changed();
+}
+
+auto MaterialGraph::set_exposed_properties(
+    std::vector<ExposedProperty> properties) -> void {
+  exposed_properties = std::move(properties);
+  bump_version();
+  interface_changed();
+}
+
+auto MaterialGraph::set_output_node(UUID node) -> void {
+  output_node = node;
+  bump_version();
+  interface_changed();
+}
+
+auto copy_node(MaterialNode& node, std::unordered_map<UUID, UUID>& props)
+    -> std::shared_ptr<MaterialNode> {
+  auto copy = MaterialNode::create(node.get_definition(), node.get_uuid());
+  copy->set_buffer_size(node.get_buffer_size());
+  copy->set_high_precision(node.get_high_precision());
+  auto& from = node.get_properties();
+  auto& to = copy->get_properties();
+  for (size_t i = 0; i < from.size(); ++i) {
+    to[i].set_value(from[i].get_value());
+    props[from[i].get_uuid()] = to[i].get_uuid();
+  }
+  return copy;
+}
+
+auto copy_graph(MaterialGraph& graph, std::unordered_map<UUID, UUID>& props,
+                std::unordered_map<UUID, Link>& links)
+    -> std::shared_ptr<MaterialGraph> {
+  auto copy = std::make_shared<MaterialGraph>();
+  for (auto& node : graph.get_nodes()) {
+    copy->add_node(copy_node(dynamic_cast<MaterialNode&>(*node), props));
+  }
+  for (const auto& link : graph.get_links()) {
+    auto link_copy =
+        Link({link.get_from_node(), props.at(link.get_from_property())},
+             {link.get_to_node(), props.at(link.get_to_property())});
+    copy->add_link(link_copy);
+    links.emplace(link.get_uuid(), link_copy);
+  }
+  copy->set_name(graph.get_name());
+  copy->set_exposed_properties(graph.get_exposed_properties());
+  copy->set_output_node(graph.get_output_node());
+  return copy;
+}
+}  // namespace afro::graph::material
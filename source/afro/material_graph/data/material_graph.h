@@ -6,17 +6,90 @@
 
 #pragma once
 
+#include <boost/signals2/signal.hpp>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "graph/data/graph.h"
 #include "material_node.h"
 
 namespace afro::graph::material {
+/**
+ * @brief A property of a node in the graph that subgraph instances of the
+ * graph show as their own.
+ */
+struct ExposedProperty {
+  UUID node;
+  std::string property_id;
+
+  /**
+   * @brief Id of the property on subgraph instances.
+   */
+  [[nodiscard]] auto get_instance_property_id() const -> std::string;
+};
 
 class MaterialGraph : public Graph {
+ private:
+  std::string name;
+  std::vector<ExposedProperty> exposed_properties;
+  UUID output_node = 0;
+
  public:
+  /**
+   * @brief Emitted when the name, the exposed properties or the output node
+   * changed.
+   */
+  boost::signals2::signal<void()> interface_changed;
+
   MaterialGraph() = default;
+  explicit MaterialGraph(UUID uuid) : Graph(uuid, {}) {}
+
+  /**
+   * @brief Name subgraph instances of the graph are created with, empty
+   * until it's named.
+   */
+  [[nodiscard]] auto get_name() const -> const std::string& { return name; }
+  auto set_name(std::string new_name) -> void;
+
+  /**
+   * @throws std::runtime_error if the property is a socket, sockets are fed
+   * by links inside the graph.
+   */
+  auto expose_property(UUID node, std::string property_id) -> void;
+  [[nodiscard]] auto get_exposed_properties() const
+      -> const std::vector<ExposedProperty>& {
+    return exposed_properties;
+  }
+  /**
+   * @brief Replaces the exposed properties without checking them, e.g. to
+   * copy them from another graph with the same nodes.
+   */
+  auto set_exposed_properties(std::vector<ExposedProperty> properties) -> void;
+
+  /**
+   * @brief Sets the node whose output subgraph instances of the graph output.
+   */
+  auto set_output_node(UUID node) -> void;
+  [[nodiscard]] auto get_output_node() const -> UUID { return output_node; }
+
   ~MaterialGraph() override = default;
 };
 
+/**
+ * @brief A node with the UUID, size and values of @a node. The UUIDs of the
+ * copied properties are recorded in @a props.
+ */
+auto copy_node(MaterialNode& node, std::unordered_map<UUID, UUID>& props)
+    -> std::shared_ptr<MaterialNode>;
+/**
+ * @brief A graph with copies of the nodes, links and interface of @a graph,
+ * which isn't affected by edits of either. The UUIDs of the copied
+ * properties are recorded in @a props, the copies of the links in @a links.
+ */
+auto copy_graph(MaterialGraph& graph, std::unordered_map<UUID, UUID>& props,
+                std::unordered_map<UUID, Link>& links)
+    -> std::shared_ptr<MaterialGraph>;
+
 }  // namespace afro::graph::material
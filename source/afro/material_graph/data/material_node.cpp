@@ -8,10 +8,29 @@
 
 namespace afro::graph::material {
 auto MaterialNode::get_buffer_format() const -> gl::GLenum {
-  return gl::GLenum::GL_RGBA;
+  for (const auto& prop : get_properties()) {
+    const auto& prop_def = prop.get_property_definition();
+    if (prop_def.type == property::Type::OUTPUT &&
+        prop_def.value_type == property::ValueType::FLOAT) {
+      return high_precision ? gl::GLenum::GL_R16F : gl::GLenum::GL_R8;
+    }
+  }
+  return high_precision ? gl::GLenum::GL_RGBA16F : gl::GLenum::GL_RGBA8;
 }
-auto MaterialNode::get_buffer_size() const -> IVec2 {
-  return afro::IVec2(1024, 1024);
+auto MaterialNode::get_buffer_size() const -> IVec2 { return buffer_size; }
+auto MaterialNode::set_buffer_size(IVec2 size) -> void {
+  if (size.x == buffer_size.x && size.y == buffer_size.y) {
+    return;
+  }
+  buffer_size = size;
+  on_invalidate();
+}
+auto MaterialNode::set_high_precision(bool value) -> void {
+  if (value == high_precision) {
+    return;
+  }
+  high_precision = value;
+  on_invalidate();
 }
 auto MaterialNode::get_property(std::string_view prop_id)
     -> property::Property& {
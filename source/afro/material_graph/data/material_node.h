@@ -21,6 +21,8 @@ namespace afro::graph::material {
 class MaterialNode : public Node {
  private:
   MaterialNodeDefinition definition;
+  IVec2 buffer_size{1024, 1024};
+  bool high_precision = false;
 
  public:
   MaterialNode(UUID uuid, std::vector<property::Property> properties,
@@ -55,6 +57,23 @@ class MaterialNode : public Node {
   [[nodiscard]] auto get_definition() -> auto& { return definition; }
 
   auto get_buffer_size() const -> IVec2;
+  /**
+   * @brief Resizes the output, which invalidates the node if it changed.
+   */
+  auto set_buffer_size(IVec2 size) -> void;
+  [[nodiscard]] auto get_high_precision() const -> bool {
+    return high_precision;
+  }
+  /**
+   * @brief Stores the output with half floats instead of 8 bits per channel,
+   * e.g. for height maps that normals are derived from. Invalidates the node
+   * if it changed.
+   */
+  auto set_high_precision(bool value) -> void;
+  /**
+   * @brief Sized format of the output buffer. Outputs whose socket is a
+   * FLOAT are stored with a single channel, others as RGBA.
+   */
   auto get_buffer_format() const -> gl::GLenum;
   auto get_property(std::string_view prop_id) -> property::Property&;
 };
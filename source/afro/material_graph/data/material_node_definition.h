@@ -6,11 +6,15 @@
 
 #pragma once
 
+#include <functional>
+#include <optional>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "property/data/property_definition.h"
 #include "ui/data/icons.h"
+#include "utils/math.h"
 
 namespace afro::graph::material {
 
@@ -18,8 +22,46 @@ class MaterialNode;
 class MaterialEngine;
 class MaterialGraph;
 
+/**
+ * @brief Runs a node in place of the engine, which draws nodes that don't
+ * have one with their shader.
+ */
 using MaterialNodeExecFun =
     std::function<void(MaterialEngine*, MaterialGraph*, MaterialNode*)>;
+/**
+ * @brief Returns a key for state outside the node's properties and inputs
+ * that its output depends on, the engine re-runs the node when it changes.
+ */
+using MaterialNodeKeyFun =
+    std::function<size_t(const MaterialEngine*, MaterialNode*)>;
+/**
+ * @brief Computes the output of a node whose inputs are all constant on the
+ * CPU, so it doesn't have to be drawn.
+ */
+using MaterialNodeConstantFun = std::function<FVec4(MaterialNode*)>;
+/**
+ * @brief Returns how many passes a compute node makes for an output of the
+ * given size.
+ */
+using MaterialNodePassFun = std::function<int(IVec2)>;
+
+/**
+ * @brief A GLSL compute shader a node is run with instead of a fragment
+ * shader, for algorithms that read and write arbitrary pixels.
+ *
+ * Every pass dispatches the shader once with the pass index in the `pass`
+ * uniform, and writes of a pass are visible to the next one. The output is
+ * bound to image unit 0 with the node's buffer format, rgba8 or r8 and
+ * rgba16f or r16f at high precision, and the scratch images, which have the
+ * output's size, to image units 1 and up as rgba32f. Sockets and values are
+ * bound like with fragment shaders.
+ */
+struct MaterialComputeShader {
+  std::string shader_code;
+  int scratch_images = 0;
+  // A single pass if empty.
+  MaterialNodePassFun get_pass_count;
+};
 
 class MaterialNodeDefinition {
  private:
@@ -29,20 +71,27 @@ class MaterialNodeDefinition {
   std::string shader_code;
   ui::Icon icon;
   MaterialNodeExecFun on_execute;
-  static MaterialNodeExecFun def_exec_fun;
+  MaterialNodeKeyFun get_key;
+  // Each output pixel only depends on the same pixel of the inputs.
+  bool is_pointwise = false;
+  MaterialNodeConstantFun constant_fun;
+  std::optional<MaterialComputeShader> compute_shader;
+  std::vector<std::string> specialized_props;
 
  public:
   MaterialNodeDefinition(
       std::string id, std::string name,
       std::vector<property::PropertyDefinition> prop_definitions,
       std::string shader_code, ui::Icon icon,
-      MaterialNodeExecFun on_execute = def_exec_fun)
+      MaterialNodeExecFun on_execute = {},
+      MaterialNodeKeyFun get_key = {})
       : id(std::move(id)),
         name(std::move(name)),
         prop_definitions(std::move(prop_definitions)),
         shader_code(std::move(shader_code)),
         icon(icon),
-        on_execute(on_execute) {}
+        on_execute(std::move(on_execute)),
+        get_key(std::move(get_key)) {}
 
   [[nodiscard]] auto get_id() const -> auto& { return id; }
   [[nodiscard]] auto get_name() const -> auto& { return name; }
@@ -52,5 +101,33 @@ class MaterialNodeDefinition {
   [[nodiscard]] auto get_shader_code() const -> auto& { return shader_code; }
   [[nodiscard]] auto get_icon() const -> auto& { return icon; }
   [[nodiscard]] auto get_on_execute() -> auto& { return on_execute; }
+  [[nodiscard]] auto get_key_fun() const -> auto& { return get_key; }
+  [[nodiscard]] auto get_is_pointwise() const -> bool { return is_pointwise; }
+  auto set_is_pointwise(bool value) -> void { is_pointwise = value; }
+  [[nodiscard]] auto get_constant_fun() const -> auto& { return constant_fun; }
+  auto set_constant_fun(MaterialNodeConstantFun fun) -> void {
+    constant_fun = std::move(fun);
+  }
+  [[nodiscard]] auto get_compute_shader() const -> auto& {
+    return compute_shader;
+  }
+  /**
+   * @brief Runs the node with @a shader, shader_code is ignored.
+   */
+  auto set_compute_shader(MaterialComputeShader shader) -> void {
+    compute_shader = std::move(shader);
+  }
+  [[nodiscard]] auto get_specialized_props() const -> auto& {
+    return specialized_props;
+  }
+  /**
+   * @brief Compiles a variant of the shader for every combination of values
+   * of the enum properties @a ids that is drawn, with each of them defined
+   * to its value, so branches on them are resolved at compile time. The
+   * shader must only declare their uniforms if they aren't defined.
+   */
+  auto set_specialized_props(std::vector<std::string> ids) -> void {
+    specialized_props = std::move(ids);
+  }
 };
 }  // namespace afro::graph::material
\ No newline at end of file
@@ -6,6 +6,7 @@
 
 #include "definitions.h"
 
+#include "image_definition.h"
 #include "material_graph/data/material_node.h"
 #include "material_graph/engine/material_engine.h"
 #include "property/data/property.h"
@@ -170,14 +171,26 @@ const MaterialNodeDefinition circle_node_definition = {
       property::ValueType::FLOAT, property::ValueUnit::NONE, false, false, 0.1F,
       0.0F, 1.0F},
      {"_output", "Output", "Empty desc", property::Type::OUTPUT,
-      property::ValueType::FLOAT_4, property::ValueUnit::COLOR, true, false,
-      FVec4{0.0F, 0.0F, 0.0F, 0.0F}}},
+      property::ValueType::FLOAT, property::ValueUnit::COLOR, true, false,
+      0.0F}},
     static_cast<char const*>(embed_data_circle_frag),
     ui::Icon::BLEND_NODE};
 
 auto material::NodeDefinitions::get_node_definitions()
     -> std::vector<MaterialNodeDefinition> {
-  return {solid_color_node_defintion, mix_node_definition,
-          channel_select_node_definition, circle_node_definition};
+  auto solid_color = solid_color_node_defintion;
+  solid_color.set_is_pointwise(true);
+  solid_color.set_constant_fun([](MaterialNode* node) {
+    return node->get_property("color").get<FVec4>();
+  });
+  auto mix = mix_node_definition;
+  mix.set_is_pointwise(true);
+  mix.set_specialized_props({"blendMode", "alphaMode"});
+  auto channel_select = channel_select_node_definition;
+  channel_select.set_is_pointwise(true);
+  channel_select.set_specialized_props(
+      {"channel_red", "channel_green", "channel_blue", "channel_alpha"});
+  return {solid_color, mix, channel_select, circle_node_definition,
+          make_image_definition()};
 }
 }  // namespace afro::graph::material
\ No newline at end of file
@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "image_definition.h"
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "io/image_cache.h"
+#include "material_graph/engine/material_engine.h"
+#include "utils/log.h"
+
+namespace fs = std::filesystem;
+
+namespace afro::graph::material {
+namespace {
+auto get_file_path(MaterialNode& node) -> fs::path {
+  return node.get_property("file_path").get<std::string>();
+}
+
+// The smallest level that still covers @a size.
+auto get_mip_level(const io::ImageInfo& info, IVec2 size) -> int {
+  auto level = 0;
+  while (level + 1 < info.mip_levels &&
+         (info.width >> (level + 1)) >= size.x &&
+         (info.height >> (level + 1)) >= size.y) {
+    ++level;
+  }
+  return level;
+}
+
+auto execute_image_node(MaterialEngine* engine, MaterialGraph*,
+                        MaterialNode* node) -> void {
+  const auto output = node->get_property("_output").get_uuid();
+  const auto path = get_file_path(*node);
+  auto image = io::ImagePtr();
+  if (!path.empty()) {
+    try {
+      auto& cache = io::ImageCache::get();
+      const auto level =
+          get_mip_level(cache.get_info(path), engine->get_output_size(*node));
+      auto request = cache.request(path, level);
+      if (request.wait_for(std::chrono::seconds(0)) ==
+          std::future_status::ready) {
+        image = request.get();
+      }
+    } catch (const std::exception& error) {
+      log::core_error("Can't load image {}: {}", path.string(), error.what());
+    }
+  }
+  if (image == nullptr) {
+    engine->write_constant(output, FVec4{0.0F, 0.0F, 0.0F, 0.0F},
+                           node->get_buffer_format());
+    return;
+  }
+  engine->write_image(output, *image, node->get_buffer_format());
+}
+
+// Changes when the file is edited and when a decode of it starts or ends,
+// after which the node has to pick up the image.
+auto get_image_key(const MaterialEngine*, MaterialNode* node) -> size_t {
+  const auto path = get_file_path(*node);
+  if (path.empty()) {
+    return 0;
+  }
+  return std::hash<std::string>()(
+      fmt::format("{}:{}:{}", path.string(), io::get_modified_time(path),
+                  io::ImageCache::get().is_loading(path)));
+}
+}  // namespace
+
+auto make_image_definition() -> MaterialNodeDefinition {
+  return {"image_node",
+          "Image",
+          {{"file_path", "File", "Path of the image file",
+            property::Type::INPUT, property::ValueType::STRING,
+            property::ValueUnit::PATH, false, false, std::string()},
+           {"_output", "Output", "Empty desc", property::Type::OUTPUT,
+            property::ValueType::FLOAT_4, property::ValueUnit::COLOR, true,
+            false, FVec4{0.0F, 0.0F, 0.0F, 0.0F}}},
+          "",
+          ui::Icon::IMAGE_NODE,
+          execute_image_node,
+          get_image_key};
+}
+}  // namespace afro::graph::material
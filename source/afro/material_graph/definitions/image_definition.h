@@ -0,0 +1,20 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include "material_graph/data/material_node_definition.h"
+
+namespace afro::graph::material {
+/**
+ * @brief Definition of nodes that output the image file at their file_path
+ * property. The image is decoded in the background, until it is ready the
+ * node outputs transparent black and it runs again once it is. The smallest
+ * mip level covering the output size is uploaded, so large images aren't
+ * uploaded at full size for small buffers or previews.
+ */
+auto make_image_definition() -> MaterialNodeDefinition;
+}  // namespace afro::graph::material
@@ -0,0 +1,63 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "subgraph_definition.h"
+
+#include <fmt/format.h>
+
+#include <vector>
+
+#include "material_graph/engine/material_engine.h"
+#include "utils/log.h"
+
+namespace afro::graph::material {
+auto make_subgraph_definition(const std::shared_ptr<MaterialGraph>& graph,
+                              std::string name) -> MaterialNodeDefinition {
+  auto props = std::vector<property::PropertyDefinition>();
+  for (const auto& exposed : graph->get_exposed_properties()) {
+    auto node = std::dynamic_pointer_cast<MaterialNode>(
+        graph->get_node_by_uuid(exposed.node));
+    if (node == nullptr) {
+      continue;
+    }
+    const auto& prop = node->get_property(exposed.property_id);
+    const auto& prop_def = prop.get_property_definition();
+    props.emplace_back(exposed.get_instance_property_id(), prop_def.name,
+                       prop_def.description, prop_def.type,
+                       prop_def.value_type, prop_def.value_unit, false,
+                       prop_def.is_editable, prop.get_value(),
+                       prop_def.min_value, prop_def.max_value,
+                       prop_def.step_value, prop_def.presets);
+  }
+  props.emplace_back("_output", "Output", "Output of the subgraph",
+                     property::Type::OUTPUT, property::ValueType::FLOAT_4,
+                     property::ValueUnit::COLOR, true, false, FVec4{});
+
+  // Resolved through the engine, which may render a copy of the graph.
+  auto weak_graph = std::weak_ptr<MaterialGraph>(graph);
+  const auto uuid = graph->get_uuid();
+  return {fmt::format("subgraph_{}", uuid),
+          std::move(name),
+          std::move(props),
+          "",
+          ui::Icon::NONE,
+          [uuid, weak_graph](MaterialEngine* engine, MaterialGraph*,
+                             MaterialNode* node) {
+            auto subgraph = engine->get_subgraph(uuid, weak_graph);
+            if (subgraph == nullptr) {
+              log::core_error("Subgraph of instance {} was deleted",
+                              node->get_uuid());
+              return;
+            }
+            engine->execute_subgraph(subgraph, *node);
+          },
+          [uuid, weak_graph](const MaterialEngine* engine,
+                             MaterialNode*) -> size_t {
+            auto subgraph = engine->get_subgraph(uuid, weak_graph);
+            return subgraph != nullptr ? subgraph->get_version() : 0;
+          }};
+}
+}  // namespace afro::graph::material
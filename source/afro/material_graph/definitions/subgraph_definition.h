@@ -0,0 +1,24 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "material_graph/data/material_graph.h"
+#include "material_graph/data/material_node_definition.h"
+
+namespace afro::graph::material {
+/**
+ * @brief Definition of nodes that show the output of @a graph. The nodes
+ * have the exposed properties of @a graph, defaulting to their current
+ * values, and are evaluated by the engine through @a graph. Instances with
+ * the same values share one result until @a graph changes.
+ */
+auto make_subgraph_definition(const std::shared_ptr<MaterialGraph>& graph,
+                              std::string name) -> MaterialNodeDefinition;
+}  // namespace afro::graph::material
@@ -8,15 +8,19 @@
 
 #include <fruit/fruit.h>
 
+#include "material_graph/definitions/definitions.h"
 #include "material_graph/ui/material_editor.h"
 #include "property/di.h"
+#include "store/di.h"
 #include "undo/di.h"
 
 namespace afro::graph::material {
 
-auto get_material_graph_component() -> fruit::Component<MaterialEditor> {
+auto get_material_graph_component()
+    -> fruit::Component<MaterialEditor, NodeDefinitions> {
   return fruit::createComponent()
       .install(undo::getUndoComponent)
+      .install(store::getStoreComponent)
       .install(property::get_property_component);
 }
 
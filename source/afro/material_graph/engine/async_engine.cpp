@@ -0,0 +1,498 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "async_engine.h"
+
+#include <utility>
+
+#include "io/image_cache.h"
+#include "utils/log.h"
+
+namespace afro::graph::material {
+namespace {
+auto get_output_property(MaterialNode& node) -> property::Property* {
+  for (auto& prop : node.get_properties()) {
+    if (prop.get_property_definition().type == property::Type::OUTPUT) {
+      return &prop;
+    }
+  }
+  return nullptr;
+}
+}  // namespace
+
+auto AsyncEngine::startup(std::unique_ptr<ui::GlContext> context) -> void {
+  context_ = std::move(context);
+  running_ = true;
+  engine_.node_executed.connect([this](MaterialNode& node) { publish(node); });
+  // Subgraph instances render the mirror of their graph, the original
+  // belongs to the UI thread.
+  engine_.set_subgraph_resolver(
+      [this](UUID uuid) -> std::shared_ptr<MaterialGraph> {
+        auto iter = mirrors_.find(uuid);
+        return iter != mirrors_.end() ? iter->second.graph : nullptr;
+      });
+  // Image nodes show a placeholder until their image is decoded.
+  image_loaded_ = io::ImageCache::get().image_loaded.connect(
+      [this](const std::filesystem::path&) { request_update(); });
+  thread_ = std::thread([this]() { run(); });
+}
+
+auto AsyncEngine::shutdown() -> void {
+  if (!thread_.joinable()) {
+    return;
+  }
+  // Follows the UI's last frame, which may still sample front buffers.
+  auto last_frame =
+      gl::glFenceSync(gl::GL_SYNC_GPU_COMMANDS_COMPLETE, gl::GL_NONE_BIT);
+  // The engine context can only wait for the fence once it reached the GPU.
+  gl::glFlush();
+  {
+    auto lock = std::scoped_lock(commands_mutex_);
+    running_ = false;
+    last_frame_ = last_frame;
+  }
+  commands_changed_.notify_one();
+  thread_.join();
+  image_loaded_.disconnect();
+  context_.reset();
+}
+
+AsyncEngine::~AsyncEngine() { shutdown(); }
+
+auto AsyncEngine::enqueue(Command command) -> void {
+  {
+    auto lock = std::scoped_lock(commands_mutex_);
+    commands_.push_back(std::move(command));
+    // Changes queued before can't be moved past this command anymore.
+    queued_changes_.clear();
+    ++generation_;
+  }
+  commands_changed_.notify_one();
+}
+
+auto AsyncEngine::enqueue_change(UUID node, Command command) -> void {
+  {
+    auto lock = std::scoped_lock(commands_mutex_);
+    auto [queued, inserted] =
+        queued_changes_.try_emplace(node, commands_.size());
+    if (inserted) {
+      commands_.push_back(std::move(command));
+    } else {
+      commands_[queued->second] = std::move(command);
+    }
+    ++generation_;
+  }
+  commands_changed_.notify_one();
+}
+
+auto AsyncEngine::request_update() -> void {
+  {
+    auto lock = std::scoped_lock(commands_mutex_);
+    // Nothing was edited, so a running update isn't cancelled. The next one
+    // runs the nodes whose keys changed.
+    commands_.emplace_back([]() {});
+  }
+  commands_changed_.notify_one();
+}
+
+auto AsyncEngine::run() -> void {
+  context_->make_current();
+  while (true) {
+    auto commands = std::vector<Command>();
+    auto generation = uint64_t{0};
+    {
+      auto lock = std::unique_lock(commands_mutex_);
+      commands_changed_.wait(
+          lock, [this]() { return !commands_.empty() || !running_; });
+      if (!running_) {
+        break;
+      }
+      commands.swap(commands_);
+      queued_changes_.clear();
+      generation = generation_;
+    }
+    // Everything edited since the last update is rendered in one go.
+    for (auto& command : commands) {
+      command();
+    }
+    return_released();
+    if (engine_.get_graph() != nullptr) {
+      engine_.update(
+          [this, generation]() { return generation_ != generation; });
+    }
+  }
+  // Set with running_ under the lock, so it is visible here.
+  gl::glWaitSync(last_frame_, gl::GL_NONE_BIT, gl::GL_TIMEOUT_IGNORED);
+  gl::glDeleteSync(last_frame_);
+  last_frame_ = nullptr;
+  return_buffers();
+  engine_.shutdown();
+  context_->release_current();
+}
+
+auto AsyncEngine::publish(MaterialNode& node) -> void {
+  // Nodes of subgraph clones have no preview.
+  if (mirror_ == nullptr || engine_.get_graph() != mirror_->graph) {
+    return;
+  }
+  auto* output = get_output_property(node);
+  if (output == nullptr || !engine_.has_buffer(output->get_uuid())) {
+    return;
+  }
+
+  auto front = FrameBuffer();
+  front.texture = engine_.lend_texture(output->get_uuid());
+  front.fence =
+      gl::glFenceSync(gl::GL_SYNC_GPU_COMMANDS_COMPLETE, gl::GL_NONE_BIT);
+  // The UI context can only wait for the fence once it reached the GPU.
+  gl::glFlush();
+
+  {
+    auto lock = std::scoped_lock(front_mutex_);
+    std::swap(front_buffers_[node.get_uuid()], front);
+    if (front.shown) {
+      // The UI may still draw it this frame.
+      retired_.push_back(std::exchange(front, {}));
+    }
+  }
+  return_buffer(front);
+}
+
+auto AsyncEngine::return_buffer(FrameBuffer& buffer) -> void {
+  if (buffer.read_fence != nullptr) {
+    // Orders the engine's next write of the texture after the UI's last
+    // draw of it.
+    gl::glWaitSync(buffer.read_fence, gl::GL_NONE_BIT, gl::GL_TIMEOUT_IGNORED);
+    gl::glDeleteSync(buffer.read_fence);
+  }
+  if (buffer.fence != nullptr) {
+    gl::glDeleteSync(buffer.fence);
+  }
+  if (buffer.texture != 0) {
+    engine_.return_texture(buffer.texture);
+  }
+  buffer = {};
+}
+
+auto AsyncEngine::return_released() -> void {
+  auto lock = std::scoped_lock(front_mutex_);
+  for (auto& buffer : released_) {
+    return_buffer(buffer);
+  }
+  released_.clear();
+}
+
+auto AsyncEngine::return_buffers() -> void {
+  return_released();
+  auto lock = std::scoped_lock(front_mutex_);
+  for (auto& [uuid, buffer] : front_buffers_) {
+    return_buffer(buffer);
+  }
+  front_buffers_.clear();
+  for (auto& buffer : retired_) {
+    return_buffer(buffer);
+  }
+  retired_.clear();
+}
+
+auto AsyncEngine::return_buffers(UUID node) -> void {
+  auto lock = std::scoped_lock(front_mutex_);
+  auto iter = front_buffers_.find(node);
+  if (iter == front_buffers_.end()) {
+    return;
+  }
+  if (iter->second.shown) {
+    // The UI may still draw it this frame, like a replaced front buffer.
+    retired_.push_back(std::exchange(iter->second, {}));
+  } else {
+    return_buffer(iter->second);
+  }
+  front_buffers_.erase(iter);
+}
+
+auto AsyncEngine::get_preview_texture(MaterialNode& node) -> gl::GLuint {
+  auto lock = std::scoped_lock(front_mutex_);
+  auto iter = front_buffers_.find(node.get_uuid());
+  if (iter == front_buffers_.end()) {
+    return 0;
+  }
+  auto& front = iter->second;
+  if (front.fence != nullptr) {
+    // Orders the UI's draws after the copy without blocking this thread.
+    gl::glWaitSync(front.fence, gl::GL_NONE_BIT, gl::GL_TIMEOUT_IGNORED);
+    gl::glDeleteSync(front.fence);
+    front.fence = nullptr;
+  }
+  front.shown = true;
+  return front.texture;
+}
+
+auto AsyncEngine::begin_frame() -> void {
+  auto lock = std::scoped_lock(front_mutex_);
+  if (retired_.empty()) {
+    return;
+  }
+  for (auto& buffer : retired_) {
+    // Follows every draw of the last frame, which may have sampled it.
+    buffer.read_fence =
+        gl::glFenceSync(gl::GL_SYNC_GPU_COMMANDS_COMPLETE, gl::GL_NONE_BIT);
+    buffer.shown = false;
+    released_.push_back(buffer);
+  }
+  retired_.clear();
+  // The engine context can only wait for the fences once they reached the
+  // GPU.
+  gl::glFlush();
+}
+
+auto AsyncEngine::add_graph(const std::shared_ptr<MaterialGraph>& graph)
+    -> void {
+  const auto uuid = graph->get_uuid();
+  if (mirrored_.contains(uuid)) {
+    return;
+  }
+  auto mirror = Mirror();
+  mirror.graph = copy_graph(*graph, mirror.props, mirror.links);
+  enqueue([this, uuid, mirror = std::move(mirror)]() {
+    mirrors_.emplace(uuid, mirror);
+  });
+  // Every mirror follows its graph, whether it's shown or not, so e.g. an
+  // undo in another graph reaches it too.
+  auto& connections = mirrored_[uuid];
+  connections[0] = graph->changed.connect(
+      [this, uuid](const GraphChanges& changes) {
+        on_graph_changed(uuid, changes);
+      });
+  connections[1] = graph->interface_changed.connect(
+      [this, uuid, source = graph.get()]() {
+        enqueue(apply(uuid, {set_interface(*source)}));
+      });
+}
+
+auto AsyncEngine::set_graph(const std::shared_ptr<MaterialGraph>& graph)
+    -> void {
+  add_graph(graph);
+  active_ = graph->get_uuid();
+  enqueue([this, uuid = graph->get_uuid()]() {
+    mirror_ = &mirrors_.at(uuid);
+    engine_.set_graph(mirror_->graph);
+  });
+}
+
+auto AsyncEngine::clear_graph() -> void {
+  active_.reset();
+  enqueue([this]() {
+    mirror_ = nullptr;
+    engine_.clear_graph();
+  });
+}
+
+auto AsyncEngine::set_interactive(bool interactive) -> void {
+  if (interactive == interactive_) {
+    return;
+  }
+  interactive_ = interactive;
+  enqueue([this, interactive]() { engine_.set_interactive(interactive); });
+}
+
+auto AsyncEngine::set_preview_resolution(int resolution) -> void {
+  if (resolution == preview_resolution_) {
+    return;
+  }
+  preview_resolution_ = resolution;
+  enqueue([this, resolution]() {
+    engine_.set_preview_resolution(resolution);
+  });
+}
+
+auto AsyncEngine::apply(UUID graph, std::vector<Edit> edits) -> Command {
+  return [this, graph, edits = std::move(edits)]() {
+    auto iter = mirrors_.find(graph);
+    if (iter == mirrors_.end()) {
+      return;
+    }
+    auto& mirror = iter->second;
+    // The engine tracks the changes of its active graph, so an inactive one
+    // is activated while it's edited.
+    const auto inactive = &mirror != mirror_;
+    if (inactive) {
+      engine_.set_graph(mirror.graph);
+    }
+    mirror.graph->begin_transaction();
+    for (const auto& edit : edits) {
+      edit(mirror);
+    }
+    mirror.graph->commit_transaction();
+    if (inactive && mirror_ != nullptr) {
+      engine_.set_graph(mirror_->graph);
+    } else if (inactive) {
+      engine_.clear_graph();
+    }
+  };
+}
+
+auto AsyncEngine::create_node(const std::shared_ptr<MaterialNode>& node)
+    -> Edit {
+  auto props = std::unordered_map<UUID, UUID>();
+  auto copy = copy_node(*node, props);
+  return [this, copy, props = std::move(props)](Mirror& mirror) {
+    mirror.props.insert(props.begin(), props.end());
+    mirror.graph->add_node(copy);
+    engine_.on_node_created(copy);
+  };
+}
+
+auto AsyncEngine::change_node(MaterialNode& node) -> Edit {
+  auto values = std::vector<property::PropertyValue>();
+  for (const auto& prop : node.get_properties()) {
+    values.push_back(prop.get_value());
+  }
+  return [this, uuid = node.get_uuid(), size = node.get_buffer_size(),
+          high_precision = node.get_high_precision(),
+          values = std::move(values)](Mirror& mirror) {
+    auto copy = std::dynamic_pointer_cast<MaterialNode>(
+        mirror.graph->get_node_by_uuid(uuid));
+    if (copy == nullptr) {
+      return;
+    }
+    copy->set_buffer_size(size);
+    copy->set_high_precision(high_precision);
+    auto& props = copy->get_properties();
+    for (size_t i = 0; i < props.size(); ++i) {
+      props[i].set_value(values[i]);
+    }
+    engine_.on_node_changed(uuid);
+  };
+}
+
+auto AsyncEngine::delete_node(const std::shared_ptr<MaterialNode>& node)
+    -> Edit {
+  auto props = std::vector<UUID>();
+  for (const auto& prop : node->get_properties()) {
+    props.push_back(prop.get_uuid());
+  }
+  return [this, uuid = node->get_uuid(),
+          props = std::move(props)](Mirror& mirror) {
+    auto copy = std::dynamic_pointer_cast<MaterialNode>(
+        mirror.graph->get_node_by_uuid(uuid));
+    if (copy == nullptr) {
+      return;
+    }
+    mirror.graph->remove_node_by_uuid(uuid);
+    engine_.on_node_deleted(copy);
+    for (const auto& prop : props) {
+      mirror.props.erase(prop);
+    }
+
+    return_buffers(uuid);
+  };
+}
+
+auto AsyncEngine::create_link(const Link& link) -> Edit {
+  return [this, link](Mirror& mirror) {
+    auto from = mirror.props.find(link.get_from_property());
+    auto to = mirror.props.find(link.get_to_property());
+    if (from == mirror.props.end() || to == mirror.props.end()) {
+      log::core_error("Link {} connects unknown properties", link.get_uuid());
+      return;
+    }
+    auto copy = Link({link.get_from_node(), from->second},
+                     {link.get_to_node(), to->second});
+    mirror.graph->add_link(copy);
+    mirror.links.emplace(link.get_uuid(), copy);
+    engine_.on_link_created(copy);
+  };
+}
+
+auto AsyncEngine::delete_link(const Link& link) -> Edit {
+  return [this, uuid = link.get_uuid()](Mirror& mirror) {
+    auto copy = mirror.links.find(uuid);
+    if (copy == mirror.links.end()) {
+      return;
+    }
+    mirror.graph->remove_link(copy->second);
+    engine_.on_link_deleted(copy->second);
+    mirror.links.erase(copy);
+  };
+}
+
+auto AsyncEngine::on_node_created(const std::shared_ptr<MaterialNode>& node)
+    -> void {
+  if (active_.has_value()) {
+    enqueue(apply(*active_, {create_node(node)}));
+  }
+}
+
+auto AsyncEngine::on_node_changed(MaterialNode& node) -> void {
+  if (active_.has_value()) {
+    // Replaces a queued change of the node, its values are superseded.
+    enqueue_change(node.get_uuid(), apply(*active_, {change_node(node)}));
+  }
+}
+
+auto AsyncEngine::on_node_deleted(const std::shared_ptr<MaterialNode>& node)
+    -> void {
+  if (active_.has_value()) {
+    enqueue(apply(*active_, {delete_node(node)}));
+  }
+}
+
+auto AsyncEngine::on_link_created(const Link& link) -> void {
+  if (active_.has_value()) {
+    enqueue(apply(*active_, {create_link(link)}));
+  }
+}
+
+auto AsyncEngine::on_link_deleted(const Link& link) -> void {
+  if (active_.has_value()) {
+    enqueue(apply(*active_, {delete_link(link)}));
+  }
+}
+
+auto AsyncEngine::set_interface(const MaterialGraph& graph) -> Edit {
+  return [exposed = graph.get_exposed_properties(),
+          output = graph.get_output_node()](Mirror& mirror) {
+    mirror.graph->set_exposed_properties(exposed);
+    mirror.graph->set_output_node(output);
+  };
+}
+
+auto AsyncEngine::on_graph_changed(UUID graph, const GraphChanges& changes)
+    -> void {
+  if (changes.added_nodes.empty() && changes.removed_nodes.empty() &&
+      changes.added_links.empty() && changes.removed_links.empty()) {
+    // Only values changed, e.g. by dragging a slider, which are coalesced.
+    for (const auto& node : changes.changed_nodes) {
+      auto& material_node = dynamic_cast<MaterialNode&>(*node);
+      enqueue_change(node->get_uuid(),
+                     apply(graph, {change_node(material_node)}));
+    }
+    return;
+  }
+
+  // Removals first, so a node that was deleted and added back is replaced.
+  auto edits = std::vector<Edit>();
+  edits.reserve(changes.removed_links.size() + changes.removed_nodes.size() +
+                changes.added_nodes.size() + changes.added_links.size() +
+                changes.changed_nodes.size());
+  for (const auto& link : changes.removed_links) {
+    edits.push_back(delete_link(link));
+  }
+  for (const auto& node : changes.removed_nodes) {
+    edits.push_back(delete_node(std::dynamic_pointer_cast<MaterialNode>(node)));
+  }
+  for (const auto& node : changes.added_nodes) {
+    edits.push_back(create_node(std::dynamic_pointer_cast<MaterialNode>(node)));
+  }
+  for (const auto& link : changes.added_links) {
+    edits.push_back(create_link(link));
+  }
+  for (const auto& node : changes.changed_nodes) {
+    edits.push_back(change_node(dynamic_cast<MaterialNode&>(*node)));
+  }
+  enqueue(apply(graph, std::move(edits)));
+}
+}  // namespace afro::graph::material
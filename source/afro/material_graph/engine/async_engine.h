@@ -0,0 +1,194 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <fruit/fruit.h>
+#include <glbinding/gl43core/gl.h>
+
+#include <array>
+#include <atomic>
+#include <boost/signals2/connection.hpp>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "material_engine.h"
+#include "ui/interfaces/gl_context.h"
+
+namespace afro::graph::material {
+/**
+ * @brief Runs a MaterialEngine on its own thread and OpenGL context so the UI
+ * never waits for a graph to render.
+ *
+ * The engine renders a mirror of each graph. Edits made on the UI thread are
+ * copied into commands the engine thread applies to the mirror before its
+ * next update, so no node is shared between the threads. Mirrors follow
+ * their graphs whether they're rendered or not. Every output has a
+ * front buffer holding the last complete result, which previews show. It's
+ * the engine's own texture, lent until the node finishes again, and the
+ * engine renders into another one meanwhile.
+ *
+ * Only the latest state is rendered, an update still running when new edits
+ * arrive stops at the next node and continues after applying them.
+ */
+class AsyncEngine {
+ private:
+  using Command = std::function<void()>;
+
+  // The engine thread's copy of a graph, nodes keep their UUIDs.
+  struct Mirror {
+    std::shared_ptr<MaterialGraph> graph;
+    // Properties and links of the original to their copies.
+    std::unordered_map<UUID, UUID> props;
+    std::unordered_map<UUID, Link> links;
+  };
+  // An edit of a graph copied for its mirror.
+  using Edit = std::function<void(Mirror&)>;
+
+  struct FrameBuffer {
+    // Lent by the engine, which renders into another texture meanwhile.
+    gl::GLuint texture = 0;
+    // Signaled once the result is rendered into texture.
+    gl::GLsync fence = nullptr;
+    // Signaled once the UI's draws sampling texture are done.
+    gl::GLsync read_fence = nullptr;
+    // Whether the UI got texture, so it may still sample it.
+    bool shown = false;
+  };
+
+  MaterialEngine engine_;
+  std::unique_ptr<ui::GlContext> context_;
+  std::thread thread_;
+
+  std::mutex commands_mutex_;
+  std::condition_variable commands_changed_;
+  std::vector<Command> commands_;
+  // Index in commands_ of each node's change queued since the last other
+  // command, a newer change of the node replaces it.
+  std::unordered_map<UUID, size_t> queued_changes_;
+  bool running_ = false;
+  // Signaled once the UI's last frame is done, set by shutdown().
+  gl::GLsync last_frame_ = nullptr;
+  // Bumped by every edit. An update is cancelled between nodes once edits
+  // newer than the ones it renders are queued.
+  std::atomic<uint64_t> generation_{0};
+
+  // Only used by the engine thread, mirrors by the UUID of their graph.
+  std::unordered_map<UUID, Mirror> mirrors_;
+  Mirror* mirror_ = nullptr;
+
+  std::mutex front_mutex_;
+  std::unordered_map<UUID, FrameBuffer> front_buffers_;
+  // Front buffers that were replaced while the UI may still draw them. Once
+  // begin_frame() fenced them, they're released to go back to the engine.
+  std::vector<FrameBuffer> retired_;
+  std::vector<FrameBuffer> released_;
+
+  // Only used by the UI thread. Graphs with a mirror and the connections
+  // that keep it up to date.
+  std::unordered_map<UUID, std::array<boost::signals2::scoped_connection, 2>>
+      mirrored_;
+  std::optional<UUID> active_;
+  bool interactive_ = false;
+  int preview_resolution_ = MaterialEngine::DEFAULT_PREVIEW_RESOLUTION;
+  boost::signals2::scoped_connection image_loaded_;
+
+  auto enqueue(Command command) -> void;
+  auto enqueue_change(UUID node, Command command) -> void;
+  // Wakes the engine thread for an update without any edit, e.g. when
+  // something outside the graph a node depends on changed. Thread safe.
+  auto request_update() -> void;
+  auto run() -> void;
+  // Makes the output of @a node its front buffer.
+  auto publish(MaterialNode& node) -> void;
+  // Gives the texture of @a buffer back to the engine.
+  auto return_buffer(FrameBuffer& buffer) -> void;
+  // Gives the buffers the UI released back to the engine.
+  auto return_released() -> void;
+  auto return_buffers() -> void;
+  // Retires the front buffer of @a node instead if the UI may draw it.
+  auto return_buffers(UUID node) -> void;
+  // A command applying @a edits to the mirror of @a graph in one
+  // transaction.
+  auto apply(UUID graph, std::vector<Edit> edits) -> Command;
+  auto create_node(const std::shared_ptr<MaterialNode>& node) -> Edit;
+  auto change_node(MaterialNode& node) -> Edit;
+  auto delete_node(const std::shared_ptr<MaterialNode>& node) -> Edit;
+  auto create_link(const Link& link) -> Edit;
+  auto delete_link(const Link& link) -> Edit;
+  // Copies the exposed properties and output node of @a graph.
+  auto set_interface(const MaterialGraph& graph) -> Edit;
+  auto on_graph_changed(UUID graph, const GraphChanges& changes) -> void;
+
+ public:
+  INJECT(AsyncEngine()) = default;
+
+  /**
+   * @brief Starts the engine thread, which renders with @a context.
+   */
+  auto startup(std::unique_ptr<ui::GlContext> context) -> void;
+  /**
+   * @brief Stops the engine thread and frees its GL objects, the context is
+   * destroyed on the calling thread. Must be called on the UI thread with
+   * its context current, after its last frame.
+   */
+  auto shutdown() -> void;
+
+  /**
+   * @brief Mirrors @a graph, which follows its edits from then on, without
+   * rendering it. Graphs used as subgraphs must be added.
+   */
+  auto add_graph(const std::shared_ptr<MaterialGraph>& graph) -> void;
+  /**
+   * @brief Renders @a graph, which is added first if it wasn't.
+   */
+  auto set_graph(const std::shared_ptr<MaterialGraph>& graph) -> void;
+  auto clear_graph() -> void;
+  auto set_interactive(bool interactive) -> void;
+  /**
+   * @brief Largest size nodes render at while interactive, see
+   * MaterialEngine::set_interactive().
+   */
+  auto set_preview_resolution(int resolution) -> void;
+  [[nodiscard]] auto get_preview_resolution() const -> int {
+    return preview_resolution_;
+  }
+  /**
+   * @brief Applies an edit of the active graph. Added graphs report their
+   * edits themselves, these are for edits made without notifying.
+   */
+  auto on_node_created(const std::shared_ptr<MaterialNode>& node) -> void;
+  auto on_node_changed(MaterialNode& node) -> void;
+  auto on_node_deleted(const std::shared_ptr<MaterialNode>& node) -> void;
+  auto on_link_created(const Link& link) -> void;
+  auto on_link_deleted(const Link& link) -> void;
+
+  /**
+   * @brief The last complete result of @a node, 0 until it has one. Must be
+   * called on the thread of the UI context.
+   *
+   * The texture stays valid for the frame, the engine only writes to it
+   * again after the next begin_frame().
+   */
+  auto get_preview_texture(MaterialNode& node) -> gl::GLuint;
+  /**
+   * @brief Hands the previews replaced during the last frame back to the
+   * engine. Must be called on the thread of the UI context once the draws
+   * of that frame were issued.
+   */
+  auto begin_frame() -> void;
+
+  AsyncEngine(AsyncEngine&) = delete;
+  auto operator=(const AsyncEngine&) -> AsyncEngine& = delete;
+  ~AsyncEngine();
+};
+}  // namespace afro::graph::material
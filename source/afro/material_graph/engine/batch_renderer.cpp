@@ -0,0 +1,278 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "batch_renderer.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "common/pixel_convert.h"
+#include "utils/assert.h"
+
+namespace afro::graph::material {
+namespace {
+using Adjacency = std::unordered_map<UUID, std::vector<UUID>>;
+
+/**
+ * @brief Every node reachable from @a start through @a adjacency, including
+ * the start nodes.
+ */
+auto reach(const std::vector<UUID>& start, const Adjacency& adjacency)
+    -> std::unordered_set<UUID> {
+  auto visited = std::unordered_set<UUID>(start.begin(), start.end());
+  auto queue = std::queue<UUID>();
+  for (const auto& uuid : visited) {
+    queue.push(uuid);
+  }
+  while (!queue.empty()) {
+    auto iter = adjacency.find(queue.front());
+    queue.pop();
+    if (iter == adjacency.end()) {
+      continue;
+    }
+    for (const auto& next : iter->second) {
+      if (visited.insert(next).second) {
+        queue.push(next);
+      }
+    }
+  }
+  return visited;
+}
+
+auto get_output_property(MaterialNode& node) -> property::Property* {
+  for (auto& prop : node.get_properties()) {
+    if (prop.get_property_definition().type == property::Type::OUTPUT) {
+      return &prop;
+    }
+  }
+  return nullptr;
+}
+
+using ResolvedOverrides =
+    std::vector<std::pair<property::Property*, const property::PropertyValue*>>;
+}  // namespace
+
+auto BatchRenderer::render(const std::vector<OverrideSet>& variants,
+                           const std::vector<UUID>& output_nodes,
+                           const BatchExporter& exporter) -> BatchStats {
+  const auto graph = engine_.get_graph();
+  AF_ASSERT_MSG(graph != nullptr, "Batch rendering without a graph")
+  auto stats = BatchStats();
+  if (variants.empty()) {
+    return stats;
+  }
+
+  // The variants are set on a copy, so the graph itself never changes.
+  // Nodes keep their UUIDs and results of the graph are reused by value.
+  auto props = std::unordered_map<UUID, UUID>();
+  auto links = std::unordered_map<UUID, Link>();
+  const auto copy = copy_graph(*graph, props, links);
+
+  // Resolves all overrides up front so a bad one fails before rendering.
+  auto resolved = std::vector<ResolvedOverrides>();
+  auto originals =
+      std::unordered_map<property::Property*, property::PropertyValue>();
+  auto touched = std::vector<UUID>();
+  for (const auto& override_set : variants) {
+    auto& resolved_set = resolved.emplace_back();
+    for (const auto& prop_override : override_set) {
+      auto node = std::dynamic_pointer_cast<MaterialNode>(
+          copy->get_node_by_uuid(prop_override.node));
+      if (node == nullptr) {
+        throw std::runtime_error(
+            fmt::format("Override of unknown node {}", prop_override.node));
+      }
+      auto& prop = node->get_property(prop_override.property_id);
+      originals.try_emplace(&prop, prop.get_value());
+      resolved_set.emplace_back(&prop, &prop_override.value);
+      touched.push_back(prop_override.node);
+    }
+  }
+
+  // Whatever else uses the context may have changed its bindings.
+  engine_.get_gl_state().reset();
+  engine_.set_graph(copy);
+  auto order = engine_.get_nodes_topologically_sorted();
+  auto nodes = std::unordered_map<UUID, MaterialNode*>();
+  for (auto& node : order) {
+    nodes[node->get_uuid()] = node.get();
+  }
+  auto upstream = Adjacency();
+  auto downstream = Adjacency();
+  for (const auto& link : copy->get_links()) {
+    upstream[link.get_to_node()].push_back(link.get_from_node());
+    downstream[link.get_from_node()].push_back(link.get_to_node());
+  }
+
+  auto roots = output_nodes;
+  if (roots.empty()) {
+    for (auto& node : order) {
+      if (!downstream.contains(node->get_uuid())) {
+        roots.push_back(node->get_uuid());
+      }
+    }
+  }
+
+  const auto needed = reach(roots, upstream);
+  const auto varying = reach(touched, downstream);
+  auto varying_order = std::vector<MaterialNode*>();
+  for (auto& node : order) {
+    if (!needed.contains(node->get_uuid())) {
+      continue;
+    }
+    if (varying.contains(node->get_uuid())) {
+      varying_order.push_back(node.get());
+    } else {
+      engine_.execute_node(*node);
+      ++stats.invariant_nodes;
+    }
+  }
+  stats.varying_nodes = varying_order.size();
+  stats.executions = stats.invariant_nodes;
+
+  auto readbacks = std::vector<Readback>();
+  if (exporter) {
+    for (const auto& root : roots) {
+      auto iter = nodes.find(root);
+      auto* output = iter != nodes.end() ? get_output_property(*iter->second)
+                                         : nullptr;
+      if (output == nullptr) {
+        continue;
+      }
+      auto& readback = readbacks.emplace_back(
+          Readback{root, output->get_uuid(), iter->second->get_buffer_size()});
+      const auto size = static_cast<gl::GLsizeiptr>(readback.size.x) *
+                        readback.size.y * 4;
+      gl::glGenBuffers(static_cast<gl::GLsizei>(SLOTS),
+                       readback.pixel_buffers.data());
+      for (auto pixel_buffer : readback.pixel_buffers) {
+        gl::glBindBuffer(gl::GL_PIXEL_PACK_BUFFER, pixel_buffer);
+        gl::glBufferData(gl::GL_PIXEL_PACK_BUFFER, size, nullptr,
+                         gl::GL_STREAM_READ);
+      }
+    }
+    gl::glBindBuffer(gl::GL_PIXEL_PACK_BUFFER, 0);
+  }
+
+  for (size_t variant = 0; variant < resolved.size(); ++variant) {
+    if (variant > 0) {
+      for (auto& [prop, value] : resolved[variant - 1]) {
+        prop->set_value(originals.at(prop));
+      }
+    }
+    for (auto& [prop, value] : resolved[variant]) {
+      prop->set_value(*value);
+    }
+    for (auto* node : varying_order) {
+      engine_.execute_node(*node);
+    }
+    stats.executions += varying_order.size();
+
+    if (exporter) {
+      start_readback(readbacks, variant);
+      // Exports the previous variant while the GPU works on this one.
+      if (variant > 0) {
+        finish_readback(readbacks, variant - 1, exporter);
+      }
+    }
+  }
+
+  if (exporter) {
+    finish_readback(readbacks, resolved.size() - 1, exporter);
+    for (auto& readback : readbacks) {
+      gl::glDeleteBuffers(static_cast<gl::GLsizei>(SLOTS),
+                          readback.pixel_buffers.data());
+    }
+  }
+
+  engine_.set_graph(graph);
+  engine_.remove_graph(copy);
+  return stats;
+}
+
+auto BatchRenderer::start_readback(std::vector<Readback>& readbacks,
+                                   size_t variant) -> void {
+  const auto slot = variant % SLOTS;
+  gl::glPixelStorei(gl::GL_PACK_ALIGNMENT, 1);
+  for (auto& readback : readbacks) {
+    auto& buffer = engine_.get_buffer(readback.output);
+    const auto size = engine_.get_buffer_size(readback.output);
+    const auto grayscale =
+        is_grayscale_format(engine_.get_buffer_format(readback.output));
+    engine_.get_gl_state().bind_frame_buffer(buffer.frame_buffer_id);
+    gl::glBindBuffer(gl::GL_PIXEL_PACK_BUFFER, readback.pixel_buffers[slot]);
+    gl::glReadPixels(0, 0, std::min(size.x, readback.size.x),
+                     std::min(size.y, readback.size.y),
+                     grayscale ? gl::GL_RED : gl::GL_RGBA,
+                     gl::GL_UNSIGNED_BYTE, nullptr);
+    readback.read_sizes[slot] = size;
+    readback.read_grayscale[slot] = grayscale;
+  }
+  gl::glBindBuffer(gl::GL_PIXEL_PACK_BUFFER, 0);
+}
+
+auto BatchRenderer::finish_readback(std::vector<Readback>& readbacks,
+                                    size_t variant,
+                                    const BatchExporter& exporter) -> void {
+  const auto slot = variant % SLOTS;
+  for (auto& readback : readbacks) {
+    const auto read_size = readback.read_sizes[slot];
+    const auto is_constant = read_size.x == 1 && read_size.y == 1;
+    const auto size = is_constant ? IVec2(1, 1) : readback.size;
+    const auto channels = readback.read_grayscale[slot] ? size_t{1} : 4;
+    const auto bytes = static_cast<size_t>(size.x) * size.y * channels;
+    gl::glBindBuffer(gl::GL_PIXEL_PACK_BUFFER, readback.pixel_buffers[slot]);
+    const auto* pixels = static_cast<const uint8_t*>(
+        gl::glMapBufferRange(gl::GL_PIXEL_PACK_BUFFER, 0,
+                             static_cast<gl::GLsizeiptr>(bytes),
+                             gl::GL_MAP_READ_BIT));
+    if (pixels == nullptr) {
+      log::core_error("Failed to map the output of {} for variant {}",
+                      readback.node, variant);
+      continue;
+    }
+    if (is_constant || channels == 1) {
+      // Exports folded outputs at the size the node was asked for and
+      // grayscale ones as RGBA.
+      if (readback.expanded.get_width() != readback.size.x ||
+          readback.expanded.get_height() != readback.size.y) {
+        readback.expanded = core::ImageBuffer(
+            core::formats::rgba8, readback.size.x, readback.size.y);
+      }
+      auto* expanded = readback.expanded.get_mutable_data();
+      const auto count = static_cast<size_t>(readback.size.x) *
+                         readback.size.y;
+      const auto format = channels == 1 ? core::formats::r8
+                                        : core::formats::rgba8;
+      core::convert_pixels(pixels, format, expanded, core::formats::rgba8,
+                           is_constant ? 1 : count);
+      if (is_constant) {
+        for (size_t i = 1; i < count; ++i) {
+          std::copy_n(expanded, 4, expanded + i * 4);
+        }
+      }
+      exporter({variant, readback.node, readback.expanded});
+    } else {
+      // Exports the mapped pixels without copying them.
+      auto image = core::ImageBuffer(
+          core::formats::rgba8, size.x, size.y,
+          std::make_shared<core::ExternalStorage>(
+              const_cast<uint8_t*>(pixels), bytes, false));
+      exporter({variant, readback.node, image});
+      AF_ASSERT_MSG(image.get_storage().use_count() == 1,
+                    "Exporter kept a view of the mapped pixels")
+    }
+    gl::glUnmapBuffer(gl::GL_PIXEL_PACK_BUFFER);
+  }
+  gl::glBindBuffer(gl::GL_PIXEL_PACK_BUFFER, 0);
+}
+}  // namespace afro::graph::material
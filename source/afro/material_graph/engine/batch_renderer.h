@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <glbinding/gl43core/gl.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "common/data/uuid.h"
+#include "common/image_texture.h"
+#include "material_engine.h"
+#include "property/data/property_value.h"
+
+namespace afro::graph::material {
+struct PropertyOverride {
+  UUID node;
+  std::string property_id;
+  property::PropertyValue value;
+};
+
+/**
+ * @brief The property values of one variation, properties that aren't
+ * overridden keep the value they have in the graph.
+ */
+using OverrideSet = std::vector<PropertyOverride>;
+
+struct BatchImage {
+  size_t variant;
+  UUID node;
+  // RGBA8 rows from bottom to top. It may view the mapped pixel buffer, so
+  // exporters that keep it must copy() it.
+  core::ImageBuffer image;
+};
+
+using BatchExporter = std::function<void(const BatchImage&)>;
+
+struct BatchStats {
+  // Nodes the outputs depend on that no override reaches.
+  size_t invariant_nodes = 0;
+  // Nodes the outputs depend on that are overridden or downstream of one.
+  size_t varying_nodes = 0;
+  size_t executions = 0;
+};
+
+/**
+ * @brief Renders variations of the engine's graph. Nodes no override reaches
+ * are executed once for the whole batch, only the overridden nodes and
+ * everything downstream of them are executed per variant. The outputs of a
+ * variant are read back while the next one renders.
+ */
+class BatchRenderer {
+ private:
+  // Readbacks alternate between two sets of pixel buffers.
+  static constexpr size_t SLOTS = 2;
+
+  struct Readback {
+    UUID node;
+    UUID output;
+    IVec2 size;
+    std::array<gl::GLuint, SLOTS> pixel_buffers{};
+    // Size of the buffer read into each slot, constant outputs are 1x1.
+    std::array<IVec2, SLOTS> read_sizes{};
+    // Whether a slot holds a single channel, which is exported as gray.
+    std::array<bool, SLOTS> read_grayscale{};
+    core::ImageBuffer expanded;
+  };
+
+  MaterialEngine& engine_;
+
+  auto start_readback(std::vector<Readback>& readbacks, size_t variant)
+      -> void;
+  auto finish_readback(std::vector<Readback>& readbacks, size_t variant,
+                       const BatchExporter& exporter) -> void;
+
+ public:
+  explicit BatchRenderer(MaterialEngine& engine) : engine_(engine) {}
+
+  /**
+   * @brief Renders every override set in @a variants and passes the output of
+   * each node in @a output_nodes to @a exporter.
+   *
+   * @param output_nodes Nodes to export, the graph's sinks when empty.
+   * @param exporter Called in variant order, nothing is read back if empty.
+   * The variants are rendered from a copy of the graph, which isn't changed.
+   */
+  auto render(const std::vector<OverrideSet>& variants,
+              const std::vector<UUID>& output_nodes,
+              const BatchExporter& exporter) -> BatchStats;
+};
+}  // namespace afro::graph::material
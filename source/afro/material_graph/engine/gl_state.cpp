@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "gl_state.h"
+
+#include "utils/assert.h"
+
+using namespace gl;
+
+namespace afro::graph::material {
+
+auto GlState::use_program(GLuint program) -> void {
+  if (program_ == program) {
+    ++stats_.skipped_calls;
+    return;
+  }
+  glUseProgram(program);
+  program_ = program;
+  ++stats_.calls;
+}
+
+auto GlState::bind_frame_buffer(GLuint frame_buffer) -> void {
+  if (frame_buffer_ == frame_buffer) {
+    ++stats_.skipped_calls;
+    return;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
+  frame_buffer_ = frame_buffer;
+  ++stats_.calls;
+}
+
+auto GlState::set_viewport(int width, int height) -> void {
+  if (viewport_[0] == width && viewport_[1] == height) {
+    ++stats_.skipped_calls;
+    return;
+  }
+  glViewport(0, 0, width, height);
+  viewport_ = {width, height};
+  ++stats_.calls;
+}
+
+auto GlState::set_active_unit(int unit) -> void {
+  if (active_unit_ == unit) {
+    ++stats_.skipped_calls;
+    return;
+  }
+  glActiveTexture(GL_TEXTURE0 + unit);
+  active_unit_ = unit;
+  ++stats_.calls;
+}
+
+auto GlState::bind_texture(int unit, GLuint texture) -> void {
+  AF_ASSERT_MSG(unit >= 0 && unit < MAX_TEXTURE_UNITS,
+                "Texture unit out of range")
+  if (textures_[unit] == texture) {
+    // Neither the unit nor the texture have to be selected.
+    stats_.skipped_calls += 2;
+    return;
+  }
+  set_active_unit(unit);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  textures_[unit] = texture;
+  ++stats_.calls;
+}
+
+auto GlState::activate_texture(int unit, GLuint texture) -> void {
+  AF_ASSERT_MSG(unit >= 0 && unit < MAX_TEXTURE_UNITS,
+                "Texture unit out of range")
+  set_active_unit(unit);
+  if (textures_[unit] == texture) {
+    ++stats_.skipped_calls;
+    return;
+  }
+  glBindTexture(GL_TEXTURE_2D, texture);
+  textures_[unit] = texture;
+  ++stats_.calls;
+}
+
+auto GlState::draw_full_screen_triangle() -> void {
+  if (triangle_vertex_array_ == 0) {
+    glGenVertexArrays(1, &triangle_vertex_array_);
+  }
+  if (vertex_array_ != triangle_vertex_array_) {
+    glBindVertexArray(triangle_vertex_array_);
+    vertex_array_ = triangle_vertex_array_;
+    ++stats_.calls;
+  } else {
+    ++stats_.skipped_calls;
+  }
+  constexpr GLsizei num_vertices = 3;
+  glDrawArrays(GL_TRIANGLES, 0, num_vertices);
+  ++stats_.calls;
+}
+
+auto GlState::delete_texture(GLuint texture) -> void {
+  glDeleteTextures(1, &texture);
+  for (auto& bound : textures_) {
+    if (bound == texture) {
+      bound = 0;
+    }
+  }
+}
+
+auto GlState::delete_frame_buffer(GLuint frame_buffer) -> void {
+  glDeleteFramebuffers(1, &frame_buffer);
+  if (frame_buffer_ == frame_buffer) {
+    frame_buffer_ = 0;
+  }
+}
+
+auto GlState::reset() -> void {
+  program_ = UNKNOWN;
+  frame_buffer_ = UNKNOWN;
+  viewport_ = {-1, -1};
+  active_unit_ = -1;
+  textures_.fill(UNKNOWN);
+  vertex_array_ = UNKNOWN;
+}
+
+auto GlState::deinit() -> void {
+  glDeleteVertexArrays(1, &triangle_vertex_array_);
+  triangle_vertex_array_ = 0;
+  reset();
+}
+}  // namespace afro::graph::material
@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <glbinding/gl43core/gl.h>
+
+#include <array>
+#include <cstddef>
+#include <limits>
+
+namespace afro::graph::material {
+struct GlCallStats {
+  size_t calls = 0;
+  // Calls that were skipped because they wouldn't have changed anything.
+  size_t skipped_calls = 0;
+};
+
+/**
+ * @brief The GL state the engine draws with, calls that wouldn't change it
+ * are skipped. Code that changes the bindings on the same context without
+ * going through it must call reset() before the engine draws again.
+ *
+ * It also owns the vertex array full screen triangles are drawn with, the
+ * vertex shader generates them from gl_VertexID so it has no buffers.
+ */
+class GlState {
+ public:
+  static constexpr int MAX_TEXTURE_UNITS = 16;
+
+ private:
+  static constexpr gl::GLuint UNKNOWN = std::numeric_limits<gl::GLuint>::max();
+
+  gl::GLuint program_ = UNKNOWN;
+  gl::GLuint frame_buffer_ = UNKNOWN;
+  std::array<int, 2> viewport_{-1, -1};
+  int active_unit_ = -1;
+  std::array<gl::GLuint, MAX_TEXTURE_UNITS> textures_{};
+  gl::GLuint vertex_array_ = UNKNOWN;
+  gl::GLuint triangle_vertex_array_ = 0;
+  GlCallStats stats_;
+
+  auto set_active_unit(int unit) -> void;
+
+ public:
+  GlState() { reset(); }
+
+  auto use_program(gl::GLuint program) -> void;
+  auto bind_frame_buffer(gl::GLuint frame_buffer) -> void;
+  auto set_viewport(int width, int height) -> void;
+  /**
+   * @brief Binds @a texture to @a unit for sampling, the active unit is
+   * left unspecified.
+   */
+  auto bind_texture(int unit, gl::GLuint texture) -> void;
+  /**
+   * @brief Binds @a texture to @a unit and makes it the active unit, so
+   * texture calls such as uploads act on it.
+   */
+  auto activate_texture(int unit, gl::GLuint texture) -> void;
+  auto draw_full_screen_triangle() -> void;
+  // Deleting a bound object unbinds it and its name may be reused, so
+  // objects that may be bound are deleted through these.
+  auto delete_texture(gl::GLuint texture) -> void;
+  auto delete_frame_buffer(gl::GLuint frame_buffer) -> void;
+  /**
+   * @brief Counts @a calls made without a cached state, e.g. uniforms.
+   */
+  auto count_calls(size_t calls) -> void { stats_.calls += calls; }
+
+  /**
+   * @brief Forgets the cached state, the next call of each kind is made.
+   */
+  auto reset() -> void;
+  /**
+   * @brief Deletes the vertex array, the context must be current.
+   */
+  auto deinit() -> void;
+  [[nodiscard]] auto get_stats() const -> const GlCallStats& {
+    return stats_;
+  }
+};
+}  // namespace afro::graph::material
@@ -6,42 +6,717 @@
 
 #include "material_engine.h"
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
 #include <queue>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
 
 #include "utils/assert.h"
+#include "utils/embed_data.h"
+
+EMBEDDED_DATA(grayscaleconv_frag)
 
 namespace afro::graph::material {
+namespace {
+auto hash_combine(size_t seed, size_t value) -> size_t {
+  return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+template <typename T>
+auto hash_vec(size_t seed, const Vec2<T> &vec) -> size_t {
+  return hash_combine(hash_combine(seed, std::hash<T>()(vec.x)),
+                      std::hash<T>()(vec.y));
+}
+
+template <typename T>
+auto hash_vec(size_t seed, const Vec3<T> &vec) -> size_t {
+  return hash_combine(hash_vec(seed, Vec2<T>(vec.x, vec.y)),
+                      std::hash<T>()(vec.z));
+}
+
+template <typename T>
+auto hash_vec(size_t seed, const Vec4<T> &vec) -> size_t {
+  return hash_combine(hash_vec(seed, Vec3<T>(vec.x, vec.y, vec.z)),
+                      std::hash<T>()(vec.w));
+}
+
+auto hash_value(size_t seed, const property::PropertyValue &value) -> size_t {
+  seed = hash_combine(seed, value.index());
+  return std::visit(
+      [seed](const auto &val) {
+        using T = std::decay_t<decltype(val)>;
+        if constexpr (std::is_arithmetic_v<T> ||
+                      std::is_same_v<T, std::string>) {
+          return hash_combine(seed, std::hash<T>()(val));
+        } else if constexpr (std::is_same_v<T, property::EnumItem>) {
+          return hash_combine(seed, std::hash<int>()(val.value));
+        } else if constexpr (std::is_same_v<T, curve::ColorCurve>) {
+          auto result = seed;
+          for (const auto *spline :
+               {&val.lum, &val.r, &val.g, &val.b, &val.a}) {
+            for (const auto &point : spline->points) {
+              result = hash_vec(result, point.t1);
+              result = hash_vec(result, point.pos);
+              result = hash_vec(result, point.t2);
+            }
+          }
+          return result;
+        } else {
+          return hash_vec(seed, val);
+        }
+      },
+      value);
+}
+
+auto get_output_property(MaterialNode &node) -> property::Property * {
+  for (auto &prop : node.get_properties()) {
+    if (prop.get_property_definition().type == property::Type::OUTPUT) {
+      return &prop;
+    }
+  }
+  return nullptr;
+}
+
+// Value an unlinked socket is sampled as, scalars are grayscale.
+auto get_socket_value(const property::PropertyValue &value) -> FVec4 {
+  return std::visit(
+      [](const auto &val) -> FVec4 {
+        using T = std::decay_t<decltype(val)>;
+        if constexpr (std::is_same_v<T, FVec4>) {
+          return val;
+        } else if constexpr (std::is_same_v<T, FVec3>) {
+          return {val.x, val.y, val.z, 1.0F};
+        } else if constexpr (std::is_same_v<T, float> ||
+                             std::is_same_v<T, int> ||
+                             std::is_same_v<T, bool>) {
+          const auto scalar = static_cast<float>(val);
+          return {scalar, scalar, scalar, 1.0F};
+        } else {
+          return {0.0F, 0.0F, 0.0F, 1.0F};
+        }
+      },
+      value);
+}
+
+// Format of the scratch images of compute nodes.
+constexpr auto SCRATCH_FORMAT = gl::GL_RGBA32F;
+// Key of the processor converting colors to grayscale in processors_,
+// definition ids don't begin with an underscore.
+constexpr auto GRAYSCALE_PROCESSOR_ID = "_grayscale";
+
+// Pixels plus the mip chain.
+auto get_buffer_bytes(int width, int height, gl::GLenum format) -> size_t {
+  return static_cast<size_t>(width) * height * get_pixel_bytes(format) * 4 /
+         3;
+}
+
+auto delete_buffer(GlState &state, const OutputBuffer &buffer) -> void {
+  state.delete_texture(buffer.texture_id);
+  state.delete_frame_buffer(buffer.frame_buffer_id);
+}
+
+// Pixel format and type of uploads from memory in @a format.
+auto get_upload_format(const core::PixelFormat &format)
+    -> std::pair<gl::GLenum, gl::GLenum> {
+  constexpr auto PIXEL_FORMATS = std::array<gl::GLenum, 4>{
+      gl::GL_RED, gl::GL_RG, gl::GL_RGB, gl::GL_RGBA};
+  auto type = gl::GL_FLOAT;
+  switch (format.type) {
+    case core::ChannelType::UINT8:
+      type = gl::GL_UNSIGNED_BYTE;
+      break;
+    case core::ChannelType::UINT16:
+      type = gl::GL_UNSIGNED_SHORT;
+      break;
+    case core::ChannelType::FLOAT16:
+      type = gl::GL_HALF_FLOAT;
+      break;
+    case core::ChannelType::FLOAT32:
+      break;
+  }
+  return {PIXEL_FORMATS.at(format.channels - 1), type};
+}
+}  // namespace
+
+auto MaterialEngine::BufferKeyHash::operator()(const BufferKey &key) const
+    -> size_t {
+  const auto &[width, height, format] = key;
+  return hash_combine(
+      hash_combine(std::hash<int>()(width), std::hash<int>()(height)),
+      static_cast<size_t>(format));
+}
+
 auto MaterialEngine::set_graph(std::shared_ptr<MaterialGraph> graph) -> void {
   AF_ASSERT_MSG(graph != nullptr, "graph is null");
-  AF_ASSERT_MSG(graph_ == nullptr, "graph is already set")
-  graph_ = graph;
-
-  // Mark all nodes as dirty
-  for (auto &node : graph->get_nodes()) {
-    AF_ASSERT(node != nullptr)
-    std::shared_ptr<MaterialNode> material_node =
-        std::dynamic_pointer_cast<MaterialNode>(node);
-    is_node_dirty[material_node->get_uuid()] = true;
+  if (graph_ != nullptr) {
+    get_active_state().last_active = ++activations_;
   }
+  attach_graph(graph).last_active = ++activations_;
+  graph_ = std::move(graph);
 }
 
 auto MaterialEngine::clear_graph() -> void {
+  if (graph_ == nullptr) {
+    return;
+  }
+  get_active_state().last_active = ++activations_;
   graph_ = nullptr;
-  buffers_.clear();
-  is_node_dirty.clear();
+  enforce_memory_budget();
+}
+
+auto MaterialEngine::remove_graph(const std::shared_ptr<MaterialGraph> &graph)
+    -> void {
+  detach_graph(graph);
+  enforce_memory_budget();
+}
+
+auto MaterialEngine::attach_graph(const std::shared_ptr<MaterialGraph> &graph)
+    -> GraphState & {
+  auto [iter, inserted] = graphs_.try_emplace(graph.get());
+  auto &state = iter->second;
+  if (inserted) {
+    // Nodes that never executed are outdated, so everything runs on first
+    // update.
+    state.graph = graph;
+  }
+  return state;
+}
+
+auto MaterialEngine::detach_graph(const std::shared_ptr<MaterialGraph> &graph)
+    -> void {
+  auto iter = graphs_.find(graph.get());
+  if (iter == graphs_.end()) {
+    return;
+  }
+  release_graph_buffers(iter->second);
+  if (graph_ == graph) {
+    graph_ = nullptr;
+  }
+  graphs_.erase(iter);
+}
+
+auto MaterialEngine::get_active_state() -> GraphState & {
+  AF_ASSERT_MSG(graph_ != nullptr, "No active graph")
+  return graphs_.at(graph_.get());
+}
+
+auto MaterialEngine::update(const CancelFun &is_cancelled) -> bool {
+  // Whatever else uses the context may have changed its bindings.
+  gl_state_.reset();
+  const auto gl_stats = gl_state_.get_stats();
+  const auto completed = run_outdated_nodes(get_active_state(), is_cancelled);
+  compile_pending_variants();
+  log::core_trace("Update made {} GL calls and skipped {}",
+                  gl_state_.get_stats().calls - gl_stats.calls,
+                  gl_state_.get_stats().skipped_calls - gl_stats.skipped_calls);
+  if (!completed) {
+    ++stats_.cancelled_updates;
+  }
+  enforce_memory_budget();
+  return completed;
+}
+
+auto MaterialEngine::get_plan(GraphState &state) -> ExecutionPlan & {
+  if (state.plan.structure_version != state.graph->get_structure_version()) {
+    compile_plan(state);
+  }
+  return state.plan;
+}
+
+auto MaterialEngine::compile_plan(GraphState &state) -> void {
+  AF_ASSERT_MSG(state.graph == graph_, "Compiling an inactive graph")
+  auto &plan = state.plan;
+  plan.steps.clear();
+  plan.node_steps.clear();
+  for (auto &node : get_nodes_topologically_sorted()) {
+    plan.node_steps[node->get_uuid()] = plan.steps.size();
+    auto &step = plan.steps.emplace_back();
+    step.node = node.get();
+    step.state = &state.nodes[node->get_uuid()];
+    auto &definition = node->get_definition();
+    step.definition_hash = std::hash<std::string>()(definition.get_id());
+    if (auto &exec_fun = definition.get_on_execute()) {
+      step.exec_fun = &exec_fun;
+    } else {
+      step.processor = create_or_get_processor(definition).get();
+    }
+
+    auto links = graph_->get_links_to_node(node->get_uuid());
+    auto texture_unit = gl::GLint{0};
+    for (auto &prop : node->get_properties()) {
+      const auto &prop_def = prop.get_property_definition();
+      if (prop_def.type == property::Type::OUTPUT) {
+        AF_ASSERT_MSG(step.output == nullptr || step.exec_fun != nullptr,
+                      "Node has multiple output properties")
+        if (step.output == nullptr) {
+          step.output = &prop;
+        }
+        continue;
+      }
+      if (prop_def.type != property::Type::INPUT) {
+        continue;
+      }
+      auto &slot = step.slots.emplace_back();
+      slot.prop = &prop;
+      if (prop_def.is_socket) {
+        auto link =
+            std::find_if(links.begin(), links.end(), [&prop](Link &link) {
+              return link.get_to_property() == prop.get_uuid();
+            });
+        if (link != links.end()) {
+          slot.source = plan.node_steps.at(link->get_from_node());
+          step.inputs.push_back(slot.source.value());
+          // Grayscale outputs sample as gray in color sockets through their
+          // swizzle, colors have to be converted for grayscale sockets.
+          const auto *source = plan.steps[slot.source.value()].output;
+          slot.to_grayscale =
+              prop_def.value_type == property::ValueType::FLOAT &&
+              source != nullptr &&
+              source->get_property_definition().value_type !=
+                  property::ValueType::FLOAT;
+        }
+        slot.texture_unit = texture_unit++;
+      }
+      slot.specialized =
+          step.processor != nullptr &&
+          prop_def.value_type == property::ValueType::ENUM &&
+          std::ranges::find(definition.get_specialized_props(), prop_def.id) !=
+              definition.get_specialized_props().end();
+      step.has_specialized_slots |= slot.specialized;
+      // Props that begin with _ are common properties
+      if (step.processor != nullptr &&
+          (prop_def.is_socket || prop_def.id[0] != '_')) {
+        slot.location = step.processor->get_uniform_location(prop_def.id);
+        AF_ASSERT_MSG(slot.location != -1, "Uniform not found")
+        if (prop_def.is_socket) {
+          AF_ASSERT_MSG(slot.texture_unit < GlState::MAX_TEXTURE_UNITS,
+                        "Node has too many sockets")
+          step.processor->set_sampler(slot.location, slot.texture_unit);
+        }
+      }
+    }
+  }
+  plan.structure_version = graph_->get_structure_version();
+  ++stats_.compiled_plans;
+}
+
+auto MaterialEngine::get_step(MaterialNode &node) -> PlanStep & {
+  auto &plan = get_plan(get_active_state());
+  auto iter = plan.node_steps.find(node.get_uuid());
+  AF_ASSERT_MSG(iter != plan.node_steps.end(), "Node is part of a cycle")
+  return plan.steps[iter->second];
+}
+
+auto MaterialEngine::is_step_outdated(const ExecutionPlan &plan,
+                                      const PlanStep &step) const -> bool {
+  const auto &node_state = *step.state;
+  if (node_state.executed == 0 || node_state.changed > node_state.executed ||
+      (node_state.reduced && !interactive_)) {
+    return true;
+  }
+  for (auto input : step.inputs) {
+    const auto &input_state = *plan.steps[input].state;
+    if (input_state.executed == 0 ||
+        input_state.executed > node_state.executed) {
+      return true;
+    }
+  }
+  const auto &key_fun = step.node->get_definition().get_key_fun();
+  if (!key_fun) {
+    return false;
+  }
+  return node_state.key != key_fun(this, step.node);
+}
+
+auto MaterialEngine::run_outdated_nodes(GraphState &state,
+                                        const CancelFun &is_cancelled)
+    -> bool {
+  auto &plan = get_plan(state);
+
+  for (auto &step : plan.steps) {
+    if (!is_step_outdated(plan, step)) {
+      continue;
+    }
+    if (is_cancelled && is_cancelled()) {
+      return false;
+    }
+    execute_step(plan, step);
+  }
+  return true;
+}
+
+auto MaterialEngine::execute_node(MaterialNode &node) -> void {
+  auto &step = get_step(node);
+  execute_step(get_active_state().plan, step);
+}
+
+auto MaterialEngine::execute_step(ExecutionPlan &plan, PlanStep &step)
+    -> void {
+  auto &node = *step.node;
+  auto &node_state = *step.state;
+  if (const auto &key_fun = node.get_definition().get_key_fun()) {
+    node_state.key = key_fun(this, &node);
+  }
+  const auto full_size = node.get_buffer_size();
+  const auto render_size = get_render_size(node);
+  const auto reduced =
+      render_size.x != full_size.x || render_size.y != full_size.y;
+  const auto hash = get_result_hash(plan, step, get_output_size(plan, step),
+                                    node_state.key);
+  node_state.result_hash = hash;
+
+  if (step.output != nullptr) {
+    auto current = buffers_.find(step.output->get_uuid());
+    auto result = hash.has_value() ? results_.find(hash.value())
+                                   : results_.end();
+    // Takes over the buffer of an identical node, but re-runs the node if it
+    // is its own buffer as something it can't see, e.g. a file, has changed.
+    if (result != results_.end() &&
+        (current == buffers_.end() || current->second != result->second)) {
+      share_buffer(step.output->get_uuid(), result->second);
+      step.entry = &entries_.at(result->second);
+      node_state.executed = ++generation_;
+      node_state.reduced = reduced;
+      ++stats_.reused_results;
+      node_executed(node);
+      return;
+    }
+    if (current != buffers_.end()) {
+      if (entries_.at(current->second).users > 1) {
+        release_buffer(step.output->get_uuid());
+      } else {
+        forget_results(current->second);
+      }
+    }
+  }
+
+  log::core_trace("Executing node: {}", node.get_uuid());
+  if (step.exec_fun != nullptr) {
+    (*step.exec_fun)(this, graph_.get(), &node);
+  } else {
+    draw_step(plan, step);
+  }
+  node_state.executed = ++generation_;
+  node_state.reduced = reduced;
+  ++stats_.executions;
+
+  step.entry = nullptr;
+  if (step.output != nullptr) {
+    auto current = buffers_.find(step.output->get_uuid());
+    if (current != buffers_.end()) {
+      step.entry = &entries_.at(current->second);
+      if (hash.has_value()) {
+        step.entry->result_hashes.push_back(hash.value());
+        results_[hash.value()] = current->second;
+      }
+    }
+  }
+  node_executed(node);
 }
 
-auto MaterialEngine::update() -> void {
-  auto nodes = get_nodes_topologically_sorted();
+auto MaterialEngine::draw_step(ExecutionPlan &plan, PlanStep &step) -> void {
+  auto &node = *step.node;
+  const auto size = get_output_size(plan, step);
+  const auto format = node.get_buffer_format();
+  const auto &constant_fun = node.get_definition().get_constant_fun();
+  if (constant_fun && size.x == 1 && size.y == 1) {
+    if (step.output != nullptr) {
+      write_constant(step.output->get_uuid(), constant_fun(&node), format);
+    }
+    return;
+  }
+  if (step.output == nullptr) {
+    return;
+  }
 
-  for (auto &node : nodes) {
-    if (is_node_dirty[node->get_uuid()]) {
-      log::core_trace("Executing node: {}", node->get_uuid());
-      MaterialNodeExecFun &exec_fun = node->get_definition().get_on_execute();
-      exec_fun(this, graph_.get(), node.get());
-      is_node_dirty[node->get_uuid()] = false;
+  // Textures are created before any input is bound, creating one binds it.
+  auto &buffer =
+      create_or_get_buffer(step.output->get_uuid(), size.x, size.y, format);
+  // Buffers only used while the node runs, they go back to the pool after
+  // it where the next node needing a buffer of the same key takes them.
+  auto transient = std::vector<std::pair<BufferKey, OutputBuffer>>();
+  auto textures = std::vector<gl::GLuint>();
+  for (auto &slot : step.slots) {
+    if (slot.location == -1 ||
+        !slot.prop->get_property_definition().is_socket) {
+      continue;
+    }
+    if (!slot.source.has_value()) {
+      textures.push_back(
+          get_constant_texture(get_socket_value(slot.prop->get_value())));
+      continue;
     }
+    const auto *input = plan.steps[slot.source.value()].entry;
+    AF_ASSERT_MSG(input != nullptr, "Buffer does not exist")
+    if (slot.to_grayscale) {
+      textures.push_back(
+          transient.emplace_back(draw_grayscale(*input)).second.texture_id);
+    } else {
+      textures.push_back(input->buffer.texture_id);
+    }
+  }
+
+  auto *processor = get_variant(step);
+  const auto &locations = processor == step.variant ? step.variant_locations
+                                                    : std::vector<gl::GLint>();
+  auto texture = textures.begin();
+  for (size_t i = 0; i < step.slots.size(); ++i) {
+    const auto &slot = step.slots[i];
+    if (slot.location == -1) {
+      continue;
+    }
+    if (slot.prop->get_property_definition().is_socket) {
+      gl_state_.bind_texture(slot.texture_unit, *texture++);
+      continue;
+    }
+    // Variants don't have the uniforms of the values they are compiled for.
+    const auto location = locations.empty() ? slot.location : locations[i];
+    if (location != -1) {
+      processor->set_prop(location, *slot.prop);
+      gl_state_.count_calls(1);
+    }
+  }
+  if (processor != step.processor) {
+    ++stats_.specialized_draws;
+  }
+
+  if (const auto &compute = node.get_definition().get_compute_shader()) {
+    const auto scratch_key = BufferKey(size.x, size.y, SCRATCH_FORMAT);
+    auto scratch_textures = std::vector<gl::GLuint>();
+    for (int i = 0; i < compute->scratch_images; ++i) {
+      scratch_textures.push_back(
+          transient.emplace_back(scratch_key, acquire_buffer(scratch_key))
+              .second.texture_id);
+    }
+    const auto passes =
+        compute->get_pass_count ? compute->get_pass_count(size) : 1;
+    processor->dispatch(gl_state_, buffer.texture_id, format,
+                        scratch_textures, size.x, size.y, passes);
+  } else {
+    processor->execute(gl_state_, buffer.frame_buffer_id, buffer.texture_id,
+                       size.x, size.y);
+  }
+  for (const auto &[key, transient_buffer] : transient) {
+    pool_.emplace(key, transient_buffer);
+  }
+}
+
+auto MaterialEngine::get_variant(PlanStep &step) -> MaterialProcessor * {
+  if (!specialization_ || !step.has_specialized_slots) {
+    return step.processor;
+  }
+  auto defines = std::string();
+  for (const auto &slot : step.slots) {
+    if (slot.specialized) {
+      defines += "#define " + slot.prop->get_property_definition().id + " " +
+                 std::to_string(slot.prop->get<int>()) + "\n";
+    }
+  }
+  if (step.variant != nullptr && step.variant_defines == defines) {
+    return step.variant;
+  }
+
+  auto &definition = step.node->get_definition();
+  auto key = ProcessorKey(definition.get_id(), std::move(defines));
+  auto iter = processors_.find(key);
+  if (iter == processors_.end()) {
+    // Compiling would stall this update, which draws with the generic
+    // shader meanwhile.
+    if (!pending_variants_.contains(key)) {
+      const auto &compute = definition.get_compute_shader();
+      const auto &code =
+          compute ? compute->shader_code : definition.get_shader_code();
+      auto variant = PendingVariant{add_defines(code, key.second),
+                                    compute.has_value()};
+      pending_variants_.emplace(std::move(key), std::move(variant));
+    }
+    return step.processor;
+  }
+
+  step.variant = iter->second.get();
+  step.variant_defines = key.second;
+  step.variant_locations.clear();
+  for (const auto &slot : step.slots) {
+    auto location = gl::GLint{-1};
+    if (slot.location != -1) {
+      const auto &prop_def = slot.prop->get_property_definition();
+      location = step.variant->get_uniform_location(prop_def.id);
+      // Samplers a variant doesn't read are optimized out.
+      if (prop_def.is_socket && location != -1) {
+        step.variant->set_sampler(location, slot.texture_unit);
+      }
+    }
+    step.variant_locations.push_back(location);
+  }
+  return step.variant;
+}
+
+auto MaterialEngine::compile_pending_variants() -> void {
+  for (auto &[key, variant] : pending_variants_) {
+    auto processor = std::make_shared<MaterialProcessor>();
+    if (variant.is_compute) {
+      processor->init_compute(variant.shader_code);
+    } else {
+      processor->init(variant.shader_code);
+    }
+    processors_[key] = std::move(processor);
+    ++stats_.compiled_variants;
+  }
+  pending_variants_.clear();
+}
+
+auto MaterialEngine::draw_grayscale(const BufferEntry &input)
+    -> std::pair<BufferKey, OutputBuffer> {
+  const auto &[width, height, format] = input.key;
+  const auto key = BufferKey(width, height, get_grayscale_format(format));
+  auto buffer = acquire_buffer(key);
+  auto &processor = processors_[{GRAYSCALE_PROCESSOR_ID, {}}];
+  if (processor == nullptr) {
+    processor = std::make_shared<MaterialProcessor>();
+    processor->init(static_cast<const char *>(embed_data_grayscaleconv_frag));
+    processor->set_sampler(processor->get_uniform_location("MainTex"), 0);
+    // Averages the color channels.
+    processor->set_uniform(processor->get_uniform_location("weight"),
+                           FVec4{1.0F, 1.0F, 1.0F, 0.0F});
   }
+  gl_state_.bind_texture(0, input.buffer.texture_id);
+  processor->execute(gl_state_, buffer.frame_buffer_id, buffer.texture_id,
+                     width, height);
+  ++stats_.grayscale_conversions;
+  return {key, buffer};
+}
+
+auto MaterialEngine::get_subgraph(UUID uuid,
+                                  const std::weak_ptr<MaterialGraph> &graph)
+    const -> std::shared_ptr<MaterialGraph> {
+  if (subgraph_resolver_) {
+    return subgraph_resolver_(uuid);
+  }
+  return graph.lock();
+}
+
+auto MaterialEngine::execute_subgraph(
+    const std::shared_ptr<MaterialGraph> &graph, MaterialNode &instance)
+    -> void {
+  if (!evaluating_subgraphs_.insert(graph.get()).second) {
+    log::core_error("Subgraph instance {} is part of the graph it shows",
+                    instance.get_uuid());
+    return;
+  }
+
+  auto &clone = subgraph_clones_[graph.get()];
+  if (clone.graph == nullptr || clone.version != graph->get_version()) {
+    if (clone.graph != nullptr) {
+      detach_graph(clone.graph);
+    }
+    clone = SubgraphClone{std::make_shared<MaterialGraph>(),
+                          graph->get_version(),
+                          {}};
+    auto props = std::unordered_map<UUID, UUID>();
+    for (auto &node_ptr : graph->get_nodes()) {
+      auto node = std::dynamic_pointer_cast<MaterialNode>(node_ptr);
+      auto copy = MaterialNode::create(node->get_definition());
+      copy->set_buffer_size(node->get_buffer_size());
+      copy->set_high_precision(node->get_high_precision());
+      auto &from = node->get_properties();
+      auto &to = copy->get_properties();
+      for (size_t i = 0; i < from.size(); ++i) {
+        to[i].set_value(from[i].get_value());
+        props[from[i].get_uuid()] = to[i].get_uuid();
+      }
+      clone.graph->add_node(copy);
+      clone.nodes[node->get_uuid()] = std::move(copy);
+    }
+    for (const auto &link : graph->get_links()) {
+      clone.graph->add_link(
+          Link({clone.nodes.at(link.get_from_node())->get_uuid(),
+                props.at(link.get_from_property())},
+               {clone.nodes.at(link.get_to_node())->get_uuid(),
+                props.at(link.get_to_property())}));
+    }
+  }
+
+  // Applies the instance's size and values, only what changed is re-run.
+  auto changed = std::vector<UUID>();
+  const auto size = instance.get_buffer_size();
+  for (auto &[uuid, node] : clone.nodes) {
+    if (node->get_buffer_size().x != size.x ||
+        node->get_buffer_size().y != size.y) {
+      node->set_buffer_size(size);
+      changed.push_back(node->get_uuid());
+    }
+  }
+  for (const auto &exposed : graph->get_exposed_properties()) {
+    auto node = clone.nodes.find(exposed.node);
+    if (node == clone.nodes.end()) {
+      continue;
+    }
+    auto &prop = node->second->get_property(exposed.property_id);
+    const auto &value =
+        instance.get_property(exposed.get_instance_property_id()).get_value();
+    if (hash_value(0, prop.get_value()) != hash_value(0, value)) {
+      prop.set_value(value);
+      changed.push_back(node->second->get_uuid());
+    }
+  }
+
+  auto previous = graph_;
+  graph_ = clone.graph;
+  auto &state = attach_graph(clone.graph);
+  for (const auto &uuid : changed) {
+    mark_node_changed(uuid);
+  }
+  // Not cancellable, the instance takes over the output right after.
+  run_outdated_nodes(state, {});
+  state.last_active = ++activations_;
+
+  auto output_node = clone.nodes.find(graph->get_output_node());
+  auto *output = get_output_property(instance);
+  if (output_node == clone.nodes.end()) {
+    log::core_error("Subgraph of instance {} has no output node",
+                    instance.get_uuid());
+  } else if (auto *inner_output = get_output_property(*output_node->second);
+             output != nullptr && inner_output != nullptr) {
+    auto result = buffers_.find(inner_output->get_uuid());
+    if (result != buffers_.end()) {
+      share_buffer(output->get_uuid(), result->second);
+    }
+  }
+
+  graph_ = std::move(previous);
+  evaluating_subgraphs_.erase(graph.get());
+}
+
+auto MaterialEngine::get_result_hash(const ExecutionPlan &plan,
+                                     const PlanStep &step, IVec2 size,
+                                     std::optional<size_t> key)
+    -> std::optional<size_t> {
+  auto hash = step.definition_hash;
+  hash = hash_combine(hash, std::hash<int>()(size.x));
+  hash = hash_combine(hash, std::hash<int>()(size.y));
+  hash =
+      hash_combine(hash, static_cast<size_t>(step.node->get_buffer_format()));
+
+  for (const auto &slot : step.slots) {
+    if (slot.source.has_value()) {
+      const auto &input = plan.steps[slot.source.value()].state->result_hash;
+      if (!input.has_value()) {
+        return std::nullopt;
+      }
+      hash = hash_combine(hash, input.value());
+      continue;
+    }
+    hash = hash_value(hash, slot.prop->get_value());
+  }
+  if (key.has_value()) {
+    hash = hash_combine(hash, key.value());
+  }
+  return hash;
 }
 
 auto MaterialEngine::get_nodes_topologically_sorted()
@@ -85,100 +760,223 @@ auto MaterialEngine::get_nodes_topologically_sorted()
 auto MaterialEngine::create_or_get_processor(
     const MaterialNodeDefinition &node_def)
     -> std::shared_ptr<MaterialProcessor> {
-  auto iter = processors_.find(node_def.get_id());
+  const auto key = ProcessorKey(node_def.get_id(), {});
+  auto iter = processors_.find(key);
   if (iter != processors_.end()) {
     return iter->second;
   }
 
   auto processor = std::make_shared<MaterialProcessor>();
-  processor->init(node_def.get_shader_code());
-  processors_[node_def.get_id()] = processor;
+  if (const auto &compute = node_def.get_compute_shader()) {
+    processor->init_compute(compute->shader_code);
+  } else {
+    processor->init(node_def.get_shader_code());
+  }
+  processors_[key] = processor;
   return processor;
 }
 
 auto MaterialEngine::create_or_get_buffer(UUID uuid, int width, int height,
                                           gl::GLenum format) -> OutputBuffer & {
+  const auto key = BufferKey(width, height, format);
   auto iter = buffers_.find(uuid);
   if (iter != buffers_.end()) {
-    return iter->second;
+    auto &entry = entries_.at(iter->second);
+    if (entry.key == key) {
+      replace_lent_buffer(entry);
+      return entry.buffer;
+    }
+    release_buffer(uuid);
+  }
+
+  const auto entry_id = next_entry_id_++;
+  auto &entry = entries_[entry_id];
+  entry.buffer = acquire_buffer(key);
+  entry.key = key;
+  entry.bytes = get_buffer_bytes(width, height, format);
+  entry.users = 1;
+  buffers_[uuid] = entry_id;
+  return entry.buffer;
+}
+
+auto MaterialEngine::acquire_buffer(const BufferKey &key) -> OutputBuffer {
+  auto pooled = pool_.find(key);
+  if (pooled != pool_.end()) {
+    auto buffer = pooled->second;
+    pool_.erase(pooled);
+    return buffer;
   }
-  gl::GLuint texture = 0;
-  gl::GLuint frame_buffer = 0;
 
-  gl43core::glGenTextures(1, &texture);
-  glBindTexture(gl::GL_TEXTURE_2D, texture);
+  const auto &[width, height, format] = key;
+  auto buffer = OutputBuffer();
+  gl43core::glGenTextures(1, &buffer.texture_id);
+  gl_state_.activate_texture(0, buffer.texture_id);
   glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_WRAP_S,
                   gl::GL_CLAMP_TO_EDGE);
   glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_WRAP_T,
                   gl::GL_CLAMP_TO_EDGE);
-  glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_MIN_FILTER, gl::GL_NEAREST);
-  glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_MAG_FILTER, gl::GL_NEAREST);
-
-  gl::glTexImage2D(gl::GL_TEXTURE_2D, 0, gl::GL_RGBA, width, height, 0, format,
-                   gl::GL_UNSIGNED_BYTE, nullptr);
-  // TODO Swizzle G & B to R for grayscale
+  glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_MIN_FILTER,
+                  gl::GL_NEAREST);
+  glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_MAG_FILTER,
+                  gl::GL_NEAREST);
+  // Sized storage with the whole mip chain, so compute nodes can bind it as
+  // an image.
+  const auto levels = static_cast<gl::GLsizei>(
+      std::bit_width(static_cast<unsigned>(std::max(width, height))));
+  gl::glTexStorage2D(gl::GL_TEXTURE_2D, levels, format, width, height);
+  if (is_grayscale_format(format)) {
+    set_grayscale_swizzle();
+  }
 
-  gl::glGenFramebuffers(1, &frame_buffer);
-  glBindFramebuffer(gl::GL_FRAMEBUFFER, frame_buffer);
+  gl::glGenFramebuffers(1, &buffer.frame_buffer_id);
+  gl_state_.bind_frame_buffer(buffer.frame_buffer_id);
   glFramebufferTexture2D(gl::GL_FRAMEBUFFER, gl::GL_COLOR_ATTACHMENT0,
-                         gl::GL_TEXTURE_2D, texture, 0);
-  glBindTexture(gl::GL_TEXTURE_2D, texture);
-  glGenerateMipmap(gl::GL_TEXTURE_2D);
-  glBindTexture(gl::GL_TEXTURE_2D, 0);
-
-  buffers_[uuid] = {texture, frame_buffer};
-  return buffers_[uuid];
+                         gl::GL_TEXTURE_2D, buffer.texture_id, 0);
+  memory_usage_ += get_buffer_bytes(width, height, format);
+  return buffer;
 }
 
-auto MaterialEngine::destroy_buffer(afro::UUID prop_id) -> void {
-  auto iter = buffers_.find(prop_id);
-  AF_ASSERT_MSG(iter != buffers_.end(), "Buffer does not exist")
+auto MaterialEngine::share_buffer(UUID prop_uuid, size_t entry_id) -> void {
+  auto iter = buffers_.find(prop_uuid);
+  if (iter != buffers_.end() && iter->second == entry_id) {
+    return;
+  }
+  release_buffer(prop_uuid);
+  buffers_[prop_uuid] = entry_id;
+  ++entries_.at(entry_id).users;
+}
 
-  auto buffer = iter->second;
-  gl::glDeleteTextures(1, &buffer.texture_id);
-  gl::glDeleteFramebuffers(1, &buffer.frame_buffer_id);
+auto MaterialEngine::forget_results(size_t entry_id) -> void {
+  auto &entry = entries_.at(entry_id);
+  for (auto hash : entry.result_hashes) {
+    auto result = results_.find(hash);
+    if (result != results_.end() && result->second == entry_id) {
+      results_.erase(result);
+    }
+  }
+  entry.result_hashes.clear();
+}
 
+auto MaterialEngine::release_buffer(UUID prop_uuid) -> void {
+  auto iter = buffers_.find(prop_uuid);
+  if (iter == buffers_.end()) {
+    return;
+  }
+  const auto entry_id = iter->second;
   buffers_.erase(iter);
+
+  auto &entry = entries_.at(entry_id);
+  if (--entry.users > 0) {
+    return;
+  }
+  forget_results(entry_id);
+  if (auto lent = lent_.find(entry.buffer.texture_id); lent != lent_.end()) {
+    lent->second.detached = true;
+  } else {
+    pool_.emplace(entry.key, entry.buffer);
+  }
+  entries_.erase(entry_id);
 }
 
-auto MaterialEngine::mark_nodes_dirty(afro::UUID start_node_uuid) -> void {
-  is_node_dirty[start_node_uuid] = true;
-  auto links = graph_->get_links_from_node(start_node_uuid);
+auto MaterialEngine::replace_lent_buffer(BufferEntry &entry) -> void {
+  auto lent = lent_.find(entry.buffer.texture_id);
+  if (lent == lent_.end()) {
+    return;
+  }
+  // The lent texture keeps the last result.
+  lent->second.detached = true;
+  entry.buffer = acquire_buffer(entry.key);
+}
 
-  for (auto &link : links) {
-    mark_nodes_dirty(link.get_to_node());
+auto MaterialEngine::release_graph_buffers(GraphState &state) -> void {
+  for (auto &node : state.graph->get_nodes()) {
+    for (auto &prop : node->get_properties()) {
+      if (prop.get_property_definition().type == property::Type::OUTPUT) {
+        release_buffer(prop.get_uuid());
+      }
+    }
   }
+  state.nodes.clear();
+  state.plan = {};
+}
+
+auto MaterialEngine::enforce_memory_budget() -> void {
+  while (memory_usage_ > memory_budget_) {
+    if (!pool_.empty()) {
+      auto pooled = pool_.begin();
+      const auto &[width, height, format] = pooled->first;
+      delete_buffer(gl_state_, pooled->second);
+      memory_usage_ -= get_buffer_bytes(width, height, format);
+      pool_.erase(pooled);
+      continue;
+    }
+
+    GraphState *oldest = nullptr;
+    for (auto &[uuid, state] : graphs_) {
+      if (state.graph == graph_ || state.plan.steps.empty()) {
+        continue;
+      }
+      if (oldest == nullptr || state.last_active < oldest->last_active) {
+        oldest = &state;
+      }
+    }
+    if (oldest == nullptr) {
+      break;
+    }
+    log::core_trace("Evicting the results of an inactive graph");
+    release_graph_buffers(*oldest);
+    ++stats_.evicted_graphs;
+  }
+}
+
+auto MaterialEngine::set_memory_budget(size_t bytes) -> void {
+  memory_budget_ = bytes;
+  enforce_memory_budget();
+}
+
+auto MaterialEngine::mark_node_changed(UUID node_uuid) -> void {
+  get_active_state().nodes[node_uuid].changed = ++generation_;
 }
 
 auto MaterialEngine::on_node_created(std::shared_ptr<MaterialNode> node)
     -> void {
-  mark_nodes_dirty(node->get_uuid());
+  mark_node_changed(node->get_uuid());
 }
 
 auto MaterialEngine::on_node_changed(UUID node_uuid) -> void {
-  mark_nodes_dirty(node_uuid);
+  mark_node_changed(node_uuid);
 }
 
 auto MaterialEngine::on_node_deleted(std::shared_ptr<MaterialNode> node)
     -> void {
   for (auto &prop : node->get_properties()) {
     if (prop.get_property_definition().type == property::Type::OUTPUT) {
-      destroy_buffer(prop.get_uuid());
+      release_buffer(prop.get_uuid());
     }
   }
+  if (graph_ != nullptr) {
+    auto &state = get_active_state();
+    state.nodes.erase(node->get_uuid());
+    // The plan is compiled again before it's used, as the graph changed.
+    state.plan = {};
+  }
 }
 
 auto MaterialEngine::on_link_created(Link link) -> void {
-  mark_nodes_dirty(link.get_to_node());
+  mark_node_changed(link.get_to_node());
 }
 
 auto MaterialEngine::on_link_deleted(Link link) -> void {
-  mark_nodes_dirty(link.get_to_node());
+  mark_node_changed(link.get_to_node());
 }
 
 auto MaterialEngine::get_preview_texture(MaterialNode &node) -> gl::GLuint {
   for (const auto &prop : node.get_properties()) {
     if (prop.get_property_definition().type == property::Type::OUTPUT) {
+      auto iter = buffers_.find(prop.get_uuid());
+      if (iter != buffers_.end()) {
+        return entries_.at(iter->second).buffer.texture_id;
+      }
       auto buffer = create_or_get_buffer(
           prop.get_uuid(), node.get_buffer_size().x, node.get_buffer_size().y,
           node.get_buffer_format());
@@ -189,15 +987,194 @@ auto MaterialEngine::get_preview_texture(MaterialNode &node) -> gl::GLuint {
   return 0;
 }
 
+auto MaterialEngine::get_output_size(MaterialNode &node) -> IVec2 {
+  auto &step = get_step(node);
+  return get_output_size(get_active_state().plan, step);
+}
+
+auto MaterialEngine::get_output_size(const ExecutionPlan &plan,
+                                     const PlanStep &step) -> IVec2 {
+  if (!constant_folding_ || !step.node->get_definition().get_is_pointwise()) {
+    return get_render_size(*step.node);
+  }
+  for (auto input : step.inputs) {
+    const auto *entry = plan.steps[input].entry;
+    if (entry == nullptr) {
+      return get_render_size(*step.node);
+    }
+    const auto &[width, height, format] = entry->key;
+    if (width != 1 || height != 1) {
+      return get_render_size(*step.node);
+    }
+  }
+  return {1, 1};
+}
+
+auto MaterialEngine::get_render_size(MaterialNode &node) const -> IVec2 {
+  auto size = node.get_buffer_size();
+  if (!interactive_) {
+    return size;
+  }
+  // Halves both sides to keep the aspect ratio of power of two sizes.
+  while (std::max(size.x, size.y) > preview_resolution_ &&
+         std::min(size.x, size.y) > 1) {
+    size = {size.x / 2, size.y / 2};
+  }
+  return size;
+}
+
+auto MaterialEngine::write_constant(UUID prop_uuid, const FVec4 &value,
+                                    gl::GLenum format) -> void {
+  auto &buffer = create_or_get_buffer(prop_uuid, 1, 1, format);
+  gl_state_.activate_texture(0, buffer.texture_id);
+  gl::glTexSubImage2D(gl::GL_TEXTURE_2D, 0, 0, 0, 1, 1, gl::GL_RGBA,
+                      gl::GL_FLOAT, &value);
+  ++stats_.constant_nodes;
+}
+
+auto MaterialEngine::write_image(UUID prop_uuid,
+                                 const core::ImageBuffer &image,
+                                 gl::GLenum format) -> void {
+  AF_ASSERT_MSG(!image.is_empty(), "Image is empty")
+  auto &buffer = create_or_get_buffer(prop_uuid, image.get_width(),
+                                      image.get_height(), format);
+  const auto size = static_cast<gl::GLsizeiptr>(image.get_byte_size());
+  if (upload_buffer_ == 0) {
+    gl::glGenBuffers(1, &upload_buffer_);
+  }
+  gl::glBindBuffer(gl::GL_PIXEL_UNPACK_BUFFER, upload_buffer_);
+  // Orphans the storage of the last upload, which the GPU may still read,
+  // instead of waiting for it.
+  gl::glBufferData(gl::GL_PIXEL_UNPACK_BUFFER, size, nullptr,
+                   gl::GL_STREAM_DRAW);
+  auto *mapped = gl::glMapBufferRange(
+      gl::GL_PIXEL_UNPACK_BUFFER, 0, size,
+      gl::GL_MAP_WRITE_BIT | gl::GL_MAP_INVALIDATE_BUFFER_BIT);
+  // Regions of larger images are packed while copying.
+  if (image.is_packed()) {
+    std::memcpy(mapped, image.get_data(), image.get_byte_size());
+  } else {
+    for (int y = 0; y < image.get_height(); ++y) {
+      std::memcpy(static_cast<uint8_t *>(mapped) + image.get_row_size() * y,
+                  image.get_row(y), image.get_row_size());
+    }
+  }
+  gl::glUnmapBuffer(gl::GL_PIXEL_UNPACK_BUFFER);
+  gl_state_.activate_texture(0, buffer.texture_id);
+  const auto [pixel_format, type] = get_upload_format(image.get_format());
+  // Rows of one and three channel images aren't aligned to four bytes.
+  gl::glPixelStorei(gl::GL_UNPACK_ALIGNMENT, 1);
+  gl::glTexSubImage2D(gl::GL_TEXTURE_2D, 0, 0, 0, image.get_width(),
+                      image.get_height(), pixel_format, type, nullptr);
+  gl::glBindBuffer(gl::GL_PIXEL_UNPACK_BUFFER, 0);
+  gl::glGenerateMipmap(gl::GL_TEXTURE_2D);
+  gl_state_.count_calls(9);
+}
+
+auto MaterialEngine::get_constant_texture(const FVec4 &value) -> gl::GLuint {
+  const auto key = std::array<float, 4>{value.x, value.y, value.z, value.w};
+  auto iter = constant_textures_.find(key);
+  if (iter != constant_textures_.end()) {
+    return iter->second;
+  }
+  // Dragging a slider makes a new value every frame.
+  if (constant_textures_.size() >= MAX_CONSTANT_TEXTURES) {
+    for (auto &[constant, texture] : constant_textures_) {
+      gl_state_.delete_texture(texture);
+    }
+    constant_textures_.clear();
+  }
+
+  gl::GLuint texture = 0;
+  gl::glGenTextures(1, &texture);
+  gl_state_.activate_texture(0, texture);
+  gl::glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_MIN_FILTER,
+                      gl::GL_NEAREST);
+  gl::glTexParameteri(gl::GL_TEXTURE_2D, gl::GL_TEXTURE_MAG_FILTER,
+                      gl::GL_NEAREST);
+  gl::glTexImage2D(gl::GL_TEXTURE_2D, 0, gl::GL_RGBA32F, 1, 1, 0, gl::GL_RGBA,
+                   gl::GL_FLOAT, key.data());
+  constant_textures_[key] = texture;
+  return texture;
+}
+
 auto MaterialEngine::shutdown() -> void {
   log::core_info("Shutting down material engine");
   for (auto &processor : processors_) {
     processor.second->deinit();
   }
+  pending_variants_.clear();
+  for (auto &[entry_id, entry] : entries_) {
+    delete_buffer(gl_state_, entry.buffer);
+  }
+  for (auto &[key, buffer] : pool_) {
+    delete_buffer(gl_state_, buffer);
+  }
+  for (auto &[texture, lent] : lent_) {
+    if (lent.detached) {
+      delete_buffer(gl_state_, lent.buffer);
+    }
+  }
+  for (auto &[constant, texture] : constant_textures_) {
+    gl_state_.delete_texture(texture);
+  }
+  constant_textures_.clear();
+  gl::glDeleteBuffers(1, &upload_buffer_);
+  upload_buffer_ = 0;
+  gl_state_.deinit();
+  buffers_.clear();
+  entries_.clear();
+  results_.clear();
+  pool_.clear();
+  lent_.clear();
+  memory_usage_ = 0;
+  for (auto &[uuid, state] : graphs_) {
+    for (auto &[node_uuid, node_state] : state.nodes) {
+      node_state.result_hash.reset();
+    }
+    state.plan = {};
+  }
 }
 auto MaterialEngine::get_buffer(UUID prop_uuid) -> OutputBuffer & {
   auto iter = buffers_.find(prop_uuid);
   AF_ASSERT_MSG(iter != buffers_.end(), "Buffer does not exist")
-  return iter->second;
+  return entries_.at(iter->second).buffer;
+}
+
+auto MaterialEngine::lend_texture(UUID prop_uuid) -> gl::GLuint {
+  auto iter = buffers_.find(prop_uuid);
+  AF_ASSERT_MSG(iter != buffers_.end(), "Buffer does not exist")
+  const auto &entry = entries_.at(iter->second);
+  auto &lent = lent_[entry.buffer.texture_id];
+  lent.buffer = entry.buffer;
+  lent.key = entry.key;
+  ++lent.count;
+  return entry.buffer.texture_id;
+}
+
+auto MaterialEngine::return_texture(gl::GLuint texture) -> void {
+  auto lent = lent_.find(texture);
+  AF_ASSERT_MSG(lent != lent_.end(), "Texture is not lent")
+  if (--lent->second.count > 0) {
+    return;
+  }
+  if (lent->second.detached) {
+    pool_.emplace(lent->second.key, lent->second.buffer);
+  }
+  lent_.erase(lent);
+}
+
+auto MaterialEngine::get_buffer_size(UUID prop_uuid) const -> IVec2 {
+  auto iter = buffers_.find(prop_uuid);
+  AF_ASSERT_MSG(iter != buffers_.end(), "Buffer does not exist")
+  const auto &[width, height, format] = entries_.at(iter->second).key;
+  return {width, height};
+}
+
+auto MaterialEngine::get_buffer_format(UUID prop_uuid) const -> gl::GLenum {
+  auto iter = buffers_.find(prop_uuid);
+  AF_ASSERT_MSG(iter != buffers_.end(), "Buffer does not exist")
+  const auto &[width, height, format] = entries_.at(iter->second).key;
+  return format;
 }
-}  // namespace afro::graph::material
\ No newline at end of file
+}  // namespace afro::graph::material
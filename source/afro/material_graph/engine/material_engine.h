@@ -8,50 +8,425 @@
 
 #include <fruit/fruit.h>
 
+#include <array>
+#include <boost/signals2/signal.hpp>
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
+#include "common/image_texture.h"
 #include "material_graph/data/material_graph.h"
 #include "material_graph/data/material_node.h"
+#include "gl_state.h"
 #include "material_processor.h"
 #include "output_buffer.h"
 
 namespace afro::graph::material {
+struct EngineStats {
+  size_t executions = 0;
+  // Nodes whose output was taken from an identical node instead of executing.
+  size_t reused_results = 0;
+  size_t evicted_graphs = 0;
+  // Executions whose output was computed on the CPU instead of drawn.
+  size_t constant_nodes = 0;
+  // Execution plans compiled after the structure of a graph changed.
+  size_t compiled_plans = 0;
+  // Updates stopped early because the state they rendered was superseded.
+  size_t cancelled_updates = 0;
+  // Color inputs converted for a grayscale socket before being sampled.
+  size_t grayscale_conversions = 0;
+  // Shader variants compiled for the values of specialized props.
+  size_t compiled_variants = 0;
+  // Draws made with a variant instead of the generic shader.
+  size_t specialized_draws = 0;
+};
+
+/**
+ * @brief Asked between nodes whether the rest of an update is wasted work.
+ */
+using CancelFun = std::function<bool()>;
+/**
+ * @brief Returns the graph the engine renders in place of the graph with the
+ * UUID, or nullptr if it has none.
+ */
+using SubgraphResolver = std::function<std::shared_ptr<MaterialGraph>(UUID)>;
+
+/**
+ * @brief Executes material graphs. Any number of graphs can be attached, one
+ * of them is active and is the one update() and the on_* callbacks act on.
+ * The others keep their results and dirty state so switching back to them
+ * doesn't re-render anything, unless their buffers were evicted to stay
+ * within the memory budget.
+ *
+ * Buffers are shared between all graphs. Nodes with the same definition,
+ * values, size and inputs share one output buffer, so identical subgraphs
+ * are only rendered once.
+ */
 class MaterialEngine {
+ public:
+  static constexpr int DEFAULT_PREVIEW_RESOLUTION = 256;
+
  private:
-  std::shared_ptr<MaterialGraph> graph_;
-  std::unordered_map<std::string, std::shared_ptr<MaterialProcessor>>
-      processors_;
-  std::unordered_map<UUID, OutputBuffer> buffers_;
-  std::unordered_map<UUID, bool> is_node_dirty;
+  static constexpr size_t DEFAULT_MEMORY_BUDGET = size_t{1} << 30;
+  static constexpr size_t MAX_CONSTANT_TEXTURES = 256;
 
-  auto destroy_buffer(UUID prop_uuid) -> void;
+  using BufferKey = std::tuple<int, int, gl::GLenum>;
+  // Definition id and the defines of a variant, empty for the generic
+  // shader.
+  using ProcessorKey = std::pair<std::string, std::string>;
 
-  auto get_nodes_topologically_sorted()
-      -> std::vector<std::shared_ptr<MaterialNode>>;
+  struct PendingVariant {
+    std::string shader_code;
+    bool is_compute = false;
+  };
+
+  struct BufferKeyHash {
+    auto operator()(const BufferKey& key) const -> size_t;
+  };
+
+  struct BufferEntry {
+    OutputBuffer buffer;
+    BufferKey key;
+    size_t bytes = 0;
+    // Number of output properties rendering to this buffer.
+    int users = 0;
+    std::vector<size_t> result_hashes;
+  };
+
+  // A buffer whose texture was lent with lend_texture().
+  struct LentBuffer {
+    OutputBuffer buffer;
+    BufferKey key;
+    // Times it was lent and not returned yet.
+    int count = 0;
+    // No entry holds it anymore, it goes to the pool once returned.
+    bool detached = false;
+  };
 
-  auto mark_nodes_dirty(UUID start_node_uuid) -> void;
+  struct NodeState {
+    // Generations at which the node was last changed and last executed, 0
+    // if it never was.
+    uint64_t changed = 0;
+    uint64_t executed = 0;
+    // Executed below its buffer size while interactive.
+    bool reduced = false;
+    std::optional<size_t> result_hash;
+    // Last MaterialNodeKeyFun result of nodes that have one.
+    std::optional<size_t> key;
+  };
+
+  // An input property of a step.
+  struct InputSlot {
+    property::Property* prop = nullptr;
+    // Step whose output a linked socket samples.
+    std::optional<size_t> source;
+    // Uniform the property is bound to, -1 if it isn't.
+    gl::GLint location = -1;
+    gl::GLint texture_unit = 0;
+    // A grayscale socket linked to a color output.
+    bool to_grayscale = false;
+    // An enum the shader is specialized for.
+    bool specialized = false;
+  };
+
+  // A node with everything needed to run it resolved.
+  struct PlanStep {
+    MaterialNode* node = nullptr;
+    NodeState* state = nullptr;
+    property::Property* output = nullptr;
+    // Input properties in the order they are hashed and bound.
+    std::vector<InputSlot> slots;
+    // Steps whose outputs this one reads.
+    std::vector<size_t> inputs;
+    size_t definition_hash = 0;
+    // Null for nodes the engine draws with processor.
+    MaterialNodeExecFun* exec_fun = nullptr;
+    MaterialProcessor* processor = nullptr;
+    bool has_specialized_slots = false;
+    // Variant of processor the step was last drawn with, the uniforms of
+    // the slots in it and its defines.
+    MaterialProcessor* variant = nullptr;
+    std::vector<gl::GLint> variant_locations;
+    std::string variant_defines;
+    // Holds the output since the last execution.
+    BufferEntry* entry = nullptr;
+  };
+
+  // The nodes of a graph in execution order. It is compiled again whenever
+  // the structure of the graph changes, edited values are read through the
+  // slots so edits don't touch it.
+  struct ExecutionPlan {
+    std::vector<PlanStep> steps;
+    std::unordered_map<UUID, size_t> node_steps;
+    std::optional<uint64_t> structure_version;
+  };
+
+  struct GraphState {
+    std::shared_ptr<MaterialGraph> graph;
+    std::unordered_map<UUID, NodeState> nodes;
+    ExecutionPlan plan;
+    uint64_t last_active = 0;
+  };
+
+  // Private copy of a graph that subgraph instances are evaluated with, so
+  // applying their values doesn't touch the original.
+  struct SubgraphClone {
+    std::shared_ptr<MaterialGraph> graph;
+    uint64_t version = 0;
+    // UUID of the original node to its copy.
+    std::unordered_map<UUID, std::shared_ptr<MaterialNode>> nodes;
+  };
+
+  std::shared_ptr<MaterialGraph> graph_;
+  std::unordered_map<const MaterialGraph*, GraphState> graphs_;
+  std::map<ProcessorKey, std::shared_ptr<MaterialProcessor>> processors_;
+  // Sources of the variants drawn with the generic shader, which are
+  // compiled at the end of the update.
+  std::map<ProcessorKey, PendingVariant> pending_variants_;
+  // Output property UUID to entry id.
+  std::unordered_map<UUID, size_t> buffers_;
+  std::unordered_map<size_t, BufferEntry> entries_;
+  // Result hash to the entry id holding that result.
+  std::unordered_map<size_t, size_t> results_;
+  // Released buffers ready to be reused by a node with the same key.
+  std::unordered_multimap<BufferKey, OutputBuffer, BufferKeyHash> pool_;
+  // Lent buffers by the name of their texture.
+  std::unordered_map<gl::GLuint, LentBuffer> lent_;
+  size_t next_entry_id_ = 0;
+  size_t memory_usage_ = 0;
+  size_t memory_budget_ = DEFAULT_MEMORY_BUDGET;
+  uint64_t activations_ = 0;
+  uint64_t generation_ = 0;
+  std::unordered_map<const MaterialGraph*, SubgraphClone> subgraph_clones_;
+  std::unordered_set<const MaterialGraph*> evaluating_subgraphs_;
+  SubgraphResolver subgraph_resolver_;
+  std::map<std::array<float, 4>, gl::GLuint> constant_textures_;
+  GlState gl_state_;
+  // Pixel buffer object images are uploaded through.
+  gl::GLuint upload_buffer_ = 0;
+  bool constant_folding_ = true;
+  bool specialization_ = true;
+  bool interactive_ = false;
+  int preview_resolution_ = DEFAULT_PREVIEW_RESOLUTION;
+  EngineStats stats_;
+
+  auto get_active_state() -> GraphState&;
+  auto attach_graph(const std::shared_ptr<MaterialGraph>& graph)
+      -> GraphState&;
+  auto detach_graph(const std::shared_ptr<MaterialGraph>& graph) -> void;
+  // Compiles the plan of @a state if the graph changed since.
+  auto get_plan(GraphState& state) -> ExecutionPlan&;
+  auto compile_plan(GraphState& state) -> void;
+  auto get_step(MaterialNode& node) -> PlanStep&;
+  [[nodiscard]] auto is_step_outdated(const ExecutionPlan& plan,
+                                      const PlanStep& step) const -> bool;
+  // Returns false if @a is_cancelled stopped it before all nodes ran.
+  auto run_outdated_nodes(GraphState& state, const CancelFun& is_cancelled)
+      -> bool;
+  auto execute_step(ExecutionPlan& plan, PlanStep& step) -> void;
+  // Draws a step without an exec fun with its definition's shader.
+  auto draw_step(ExecutionPlan& plan, PlanStep& step) -> void;
+  // The variant of the step's processor for the current values of its
+  // specialized slots, or the generic one until the variant is compiled.
+  auto get_variant(PlanStep& step) -> MaterialProcessor*;
+  auto compile_pending_variants() -> void;
+  // Draws the average of the color channels of @a input into a buffer from
+  // the pool, which the caller returns to it.
+  auto draw_grayscale(const BufferEntry& input)
+      -> std::pair<BufferKey, OutputBuffer>;
+  auto get_output_size(const ExecutionPlan& plan, const PlanStep& step)
+      -> IVec2;
+  // Buffer size of @a node, scaled down to the preview resolution while
+  // interactive.
+  [[nodiscard]] auto get_render_size(MaterialNode& node) const -> IVec2;
+  static auto get_result_hash(const ExecutionPlan& plan, const PlanStep& step,
+                              IVec2 size, std::optional<size_t> key)
+      -> std::optional<size_t>;
+  // Takes a buffer of @a key from the pool or creates one.
+  auto acquire_buffer(const BufferKey& key) -> OutputBuffer;
+  auto share_buffer(UUID prop_uuid, size_t entry_id) -> void;
+  // Removes the results held by the entry, before it's overwritten or freed.
+  auto forget_results(size_t entry_id) -> void;
+  auto release_buffer(UUID prop_uuid) -> void;
+  // Gives @a entry another buffer if its texture is lent, before the entry
+  // is overwritten.
+  auto replace_lent_buffer(BufferEntry& entry) -> void;
+  auto release_graph_buffers(GraphState& state) -> void;
+  auto enforce_memory_budget() -> void;
+
+  /**
+   * @brief Stamps @a node_uuid as changed. Nodes downstream of it aren't
+   * touched, they see that an input executed after them when they are
+   * checked.
+   */
+  auto mark_node_changed(UUID node_uuid) -> void;
 
  public:
+  // Emitted after a node ran or took over a result, get_graph() is the graph
+  // it belongs to.
+  boost::signals2::signal<void(MaterialNode&)> node_executed;
+
   INJECT(MaterialEngine()) = default;
 
+  /**
+   * @brief Returns the nodes of the active graph in execution order. Nodes
+   * that are part of a cycle are left out.
+   */
+  auto get_nodes_topologically_sorted()
+      -> std::vector<std::shared_ptr<MaterialNode>>;
+
   auto create_or_get_processor(MaterialNodeDefinition const& node_def)
       -> std::shared_ptr<MaterialProcessor>;
 
   auto create_or_get_buffer(UUID prop_uuid, int width, int height,
                             gl::GLenum format) -> OutputBuffer&;
   auto get_buffer(UUID prop_uuid) -> OutputBuffer&;
+  [[nodiscard]] auto has_buffer(UUID prop_uuid) const -> bool {
+    return buffers_.contains(prop_uuid);
+  }
+  [[nodiscard]] auto get_buffer_size(UUID prop_uuid) const -> IVec2;
+  [[nodiscard]] auto get_buffer_format(UUID prop_uuid) const -> gl::GLenum;
+  /**
+   * @brief Lends the texture of the output @a prop_uuid, e.g. to show it on
+   * another context. Until it's returned the engine doesn't write, reuse or
+   * delete it, a node that runs again renders into another texture.
+   */
+  auto lend_texture(UUID prop_uuid) -> gl::GLuint;
+  /**
+   * @brief Returns a texture from lend_texture(). It's lent once more for
+   * every time it was lent.
+   */
+  auto return_texture(gl::GLuint texture) -> void;
+
+  /**
+   * @brief Size @a node renders at. Pointwise nodes whose inputs are all
+   * constant render a single pixel, since sampling it anywhere gives the
+   * same value. Other nodes render at their buffer size, or the preview
+   * resolution while interactive.
+   */
+  auto get_output_size(MaterialNode& node) -> IVec2;
+  /**
+   * @brief Stores @a value as the single pixel output of @a prop_uuid, in a
+   * buffer of @a format.
+   */
+  auto write_constant(UUID prop_uuid, const FVec4& value, gl::GLenum format)
+      -> void;
+  /**
+   * @brief Uploads @a image as the output of @a prop_uuid, into a buffer of
+   * its size and @a format. The pixels are streamed through a pixel buffer
+   * object, so the copy to the GPU doesn't block the engine.
+   */
+  auto write_image(UUID prop_uuid, const core::ImageBuffer& image,
+                   gl::GLenum format) -> void;
+  /**
+   * @brief A cached 1x1 texture of @a value, to sample unlinked sockets.
+   */
+  auto get_constant_texture(const FVec4& value) -> gl::GLuint;
+  /**
+   * @brief Renders every node at its full size when disabled.
+   */
+  auto set_constant_folding(bool enabled) -> void {
+    constant_folding_ = enabled;
+  }
+  /**
+   * @brief Draws every node with the generic shader of its definition when
+   * disabled, see MaterialNodeDefinition::set_specialized_props().
+   */
+  auto set_specialization(bool enabled) -> void { specialization_ = enabled; }
 
+  /**
+   * @brief While interactive, e.g. while a value is dragged, nodes that run
+   * render at no more than the preview resolution. Once it ends the next
+   * update re-renders them at full size.
+   */
+  auto set_interactive(bool interactive) -> void {
+    interactive_ = interactive;
+  }
+  auto set_preview_resolution(int resolution) -> void {
+    preview_resolution_ = resolution;
+  }
+
+  [[nodiscard]] auto get_graph() const
+      -> const std::shared_ptr<MaterialGraph>& {
+    return graph_;
+  }
+  /**
+   * @brief Makes @a graph the active graph, attaching it first if the engine
+   * hasn't seen it yet.
+   */
   auto set_graph(std::shared_ptr<MaterialGraph> graph) -> void;
+  /**
+   * @brief Deactivates the active graph, its results are kept.
+   */
   auto clear_graph() -> void;
-  auto update() -> void;
+  /**
+   * @brief Detaches a graph and releases its buffers.
+   */
+  auto remove_graph(const std::shared_ptr<MaterialGraph>& graph) -> void;
+  /**
+   * @brief Runs every outdated node of the active graph.
+   *
+   * @param is_cancelled Checked before each node, once it returns true the
+   * update stops and the nodes that didn't run stay outdated.
+   * @return false if the update was cancelled.
+   */
+  auto update(const CancelFun& is_cancelled = {}) -> bool;
+  /**
+   * @brief Runs @a node regardless of whether it is dirty, its inputs must be
+   * up to date.
+   */
+  auto execute_node(MaterialNode& node) -> void;
+  /**
+   * @brief Makes subgraphs resolve through @a resolver, e.g. to the copies
+   * owned by the engine's thread, instead of the graphs they were made from.
+   */
+  auto set_subgraph_resolver(SubgraphResolver resolver) -> void {
+    subgraph_resolver_ = std::move(resolver);
+  }
+  /**
+   * @brief The graph to render for the subgraph @a uuid, @a graph itself
+   * unless a resolver is set.
+   */
+  [[nodiscard]] auto get_subgraph(UUID uuid,
+                                  const std::weak_ptr<MaterialGraph>& graph)
+      const -> std::shared_ptr<MaterialGraph>;
+  /**
+   * @brief Renders @a graph with the exposed property values of @a instance
+   * and makes the result the output of @a instance. @a graph is read while
+   * rendering, so it must not be edited by another thread.
+   */
+  auto execute_subgraph(const std::shared_ptr<MaterialGraph>& graph,
+                        MaterialNode& instance) -> void;
   auto on_node_created(std::shared_ptr<MaterialNode>) -> void;
   auto on_node_changed(UUID node_uuid) -> void;
   auto on_node_deleted(std::shared_ptr<MaterialNode>) -> void;
   auto on_link_created(Link link) -> void;
   auto on_link_deleted(Link link) -> void;
 
+  /**
+   * @brief Bytes of GPU memory inactive graphs and released buffers may use
+   * before they are freed, least recently active graph first.
+   */
+  auto set_memory_budget(size_t bytes) -> void;
+  [[nodiscard]] auto get_memory_usage() const -> size_t {
+    return memory_usage_;
+  }
+  [[nodiscard]] auto get_stats() const -> const EngineStats& { return stats_; }
+  /**
+   * @brief Bindings of the engine's context, code drawing on it through the
+   * engine's objects binds them with it.
+   */
+  auto get_gl_state() -> GlState& { return gl_state_; }
+
   auto get_preview_texture(MaterialNode& node) -> gl::GLuint;
   auto shutdown() -> void;
 };
-}  // namespace afro::graph::material
\ No newline at end of file
+}  // namespace afro::graph::material
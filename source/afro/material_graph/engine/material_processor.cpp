@@ -6,6 +6,8 @@
 
 #include "material_processor.h"
 
+#include <algorithm>
+
 #include "utils/assert.h"
 #include "utils/embed_data.h"
 
@@ -15,6 +17,28 @@ EMBEDDED_DATA(mat_vertex_vert)
 
 namespace afro::graph::material {
 
+auto add_defines(std::string_view shader_code, std::string_view defines)
+    -> std::string {
+  auto split = size_t{0};
+  auto line = 1;
+  const auto version = shader_code.find("#version");
+  if (version != std::string_view::npos) {
+    const auto end = shader_code.find('\n', version);
+    split = end == std::string_view::npos ? shader_code.size() : end + 1;
+    line += static_cast<int>(
+        std::count(shader_code.begin(), shader_code.begin() + split, '\n'));
+  }
+  auto result = std::string(shader_code.substr(0, split));
+  if (split == shader_code.size() && !result.empty() &&
+      result.back() != '\n') {
+    result += '\n';
+  }
+  result += defines;
+  result += "#line " + std::to_string(line) + "\n";
+  result += shader_code.substr(split);
+  return result;
+}
+
 auto MaterialProcessor::init(std::string_view fragment_shader) -> void {
   const auto *vertex_source =
       static_cast<const char *>(embed_data_mat_vertex_vert);
@@ -32,39 +56,28 @@ auto MaterialProcessor::init(std::string_view fragment_shader) -> void {
   glLinkProgram(program_id);
   glDeleteShader(vertex);
   glDeleteShader(fragment);
+  is_initialized = true;
+}
 
-  glGenVertexArrays(1, &vao);
-  glGenBuffers(1, &vbo);
-  glGenBuffers(1, &ebo);
-
-  glBindVertexArray(vao);
-
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBufferData(
-      GL_ARRAY_BUFFER, sizeof(VERTICES),
-      VERTICES,  // NOLINT(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
-      GL_STATIC_DRAW);
-
-  const auto stride_size = 5;
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
-                        stride_size * sizeof(GL_FLOAT), (void *)nullptr);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE,
-                        stride_size * sizeof(GL_FLOAT),
-                        reinterpret_cast<void *>(3 * 4));
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
-
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(INDICES),
-               static_cast<const void *>(INDICES), GL_STATIC_DRAW);
+auto MaterialProcessor::init_compute(std::string_view compute_shader)
+    -> void {
+  const auto *compute_source = compute_shader.data();
+  auto compute = glCreateShader(GL_COMPUTE_SHADER);
+  glShaderSource(compute, 1, &compute_source, nullptr);
+  glCompileShader(compute);
+  program_id = glCreateProgram();
+  glAttachShader(program_id, compute);
+  glLinkProgram(program_id);
+  glDeleteShader(compute);
+  glGetProgramiv(program_id, GL_COMPUTE_WORK_GROUP_SIZE,
+                 work_group_size.data());
+  pass_location = glGetUniformLocation(program_id, "pass");
+  is_compute = true;
   is_initialized = true;
 }
 
 auto MaterialProcessor::deinit() -> void {
   gl::glDeleteProgram(program_id);
-  glDeleteVertexArrays(1, &vao);
-  glDeleteBuffers(1, &vbo);
-  glDeleteBuffers(1, &ebo);
   is_initialized = false;
 }
 
@@ -72,68 +85,104 @@ MaterialProcessor::~MaterialProcessor() {
   AF_ASSERT_MSG(!is_initialized, "OpenGL Leak")
 }
 
-auto MaterialProcessor::set_texture(std::string_view sampler_name,
-                                    gl::GLint texture_unit) -> void {
-  auto location = glGetUniformLocation(program_id, sampler_name.data());
-  AF_ASSERT_MSG(location != -1, "Uniform not found")
-  glActiveTexture(GL_TEXTURE0 + texture_target_offset);
-  glBindTexture(GL_TEXTURE_2D, texture_unit);
-  glUseProgram(program_id);
-  glUniform1i(location, texture_target_offset);
-  texture_target_offset += 1;
+auto MaterialProcessor::get_uniform_location(std::string_view name) const
+    -> gl::GLint {
+  return glGetUniformLocation(program_id, name.data());
 }
 
-auto MaterialProcessor::execute(gl::GLuint output_frame_buf, gl::GLuint tex_buf,
-                                int width, int height) -> void {
+auto MaterialProcessor::set_sampler(gl::GLint location,
+                                    gl::GLint texture_unit) const -> void {
+  glProgramUniform1i(program_id, location, texture_unit);
+}
+
+auto MaterialProcessor::execute(GlState &state, gl::GLuint output_frame_buf,
+                                gl::GLuint tex_buf, int width,
+                                int height) const -> void {
   // TODO: Add support for multiple output frame buffers
-  glUseProgram(program_id);
-  glBindFramebuffer(gl::GLenum::GL_FRAMEBUFFER, output_frame_buf);
-  glViewport(0, 0, width, height);
-  glBindVertexArray(vao);
-  constexpr GLsizei num_indices = 6;
-  glDrawElements(GL_TRIANGLES, num_indices, GL_UNSIGNED_INT, nullptr);
-  glBindTexture(GL_TEXTURE_2D, tex_buf);
+  state.use_program(program_id);
+  state.bind_frame_buffer(output_frame_buf);
+  state.set_viewport(width, height);
+  state.draw_full_screen_triangle();
+  // Leaves the output bound to unit 0, where the next node of a chain
+  // samples it.
+  state.activate_texture(0, tex_buf);
   glGenerateMipmap(GL_TEXTURE_2D);
-  glBindTexture(GL_TEXTURE_2D, 0);
-  texture_target_offset = 0;
+  state.count_calls(1);
 }
 
-auto MaterialProcessor::set_prop(property::Property &prop) const -> void {
-  auto location = glGetUniformLocation(
-      program_id, prop.get_property_definition().id.data());
-  AF_ASSERT_MSG(location != -1, "Uniform not found")
-  glUseProgram(program_id);
+auto MaterialProcessor::dispatch(GlState &state, gl::GLuint output_tex,
+                                 gl::GLenum output_format,
+                                 const std::vector<gl::GLuint> &scratch_images,
+                                 int width, int height, int passes) const
+    -> void {
+  AF_ASSERT_MSG(is_compute, "Dispatching a fragment shader")
+  AF_ASSERT_MSG(static_cast<int>(scratch_images.size()) < MAX_IMAGE_UNITS,
+                "Node has too many scratch images")
+  state.use_program(program_id);
+  glBindImageTexture(0, output_tex, 0, GL_FALSE, 0, GL_READ_WRITE,
+                     output_format);
+  for (size_t i = 0; i < scratch_images.size(); ++i) {
+    glBindImageTexture(static_cast<GLuint>(i + 1), scratch_images[i], 0,
+                       GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+  }
+  state.count_calls(1 + scratch_images.size());
+
+  const auto groups_x = (width + work_group_size[0] - 1) / work_group_size[0];
+  const auto groups_y = (height + work_group_size[1] - 1) / work_group_size[1];
+  for (int pass = 0; pass < passes; ++pass) {
+    if (pass_location != -1) {
+      glProgramUniform1i(program_id, pass_location, pass);
+      state.count_calls(1);
+    }
+    if (pass > 0) {
+      glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+      state.count_calls(1);
+    }
+    glDispatchCompute(static_cast<GLuint>(groups_x),
+                      static_cast<GLuint>(groups_y), 1);
+    state.count_calls(1);
+  }
+  // Later nodes sample the output and readbacks copy it.
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT |
+                  GL_FRAMEBUFFER_BARRIER_BIT);
+  state.activate_texture(0, output_tex);
+  glGenerateMipmap(GL_TEXTURE_2D);
+  state.count_calls(2);
+}
 
+auto MaterialProcessor::set_prop(gl::GLint location,
+                                 property::Property &prop) const -> void {
   switch (prop.get_property_definition().value_type) {
     case property::ValueType::INTEGER:
-      glUniform1i(location, prop.get<int>());
+      glProgramUniform1i(program_id, location, prop.get<int>());
       break;
     case property::ValueType::INTEGER_2:
-      glUniform2iv(location, 1, prop.get<IVec2>().data());
+      glProgramUniform2iv(program_id, location, 1, prop.get<IVec2>().data());
       break;
     case property::ValueType::INTEGER_3:
-      glUniform3iv(location, 1, prop.get<IVec3>().data());
+      glProgramUniform3iv(program_id, location, 1, prop.get<IVec3>().data());
       break;
     case property::ValueType::INTEGER_4:
-      glUniform4iv(location, 1, prop.get<IVec4>().data());
+      glProgramUniform4iv(program_id, location, 1, prop.get<IVec4>().data());
       break;
     case property::ValueType::FLOAT:
-      glUniform1f(location, prop.get<float>());
+      glProgramUniform1f(program_id, location, prop.get<float>());
       break;
     case property::ValueType::FLOAT_2:
-      glUniform2fv(location, 1, prop.get<FVec2>().data());
+      glProgramUniform2fv(program_id, location, 1, prop.get<FVec2>().data());
       break;
     case property::ValueType::FLOAT_3:
-      glUniform3fv(location, 1, prop.get<FVec3>().data());
+      glProgramUniform3fv(program_id, location, 1, prop.get<FVec3>().data());
       break;
     case property::ValueType::FLOAT_4:
-      glUniform4fv(location, 1, prop.get<FVec4>().data());
+      glProgramUniform4fv(program_id, location, 1, prop.get<FVec4>().data());
       break;
     case property::ValueType::BOOLEAN:
-      glUniform1i(location, static_cast<gl::GLint>(prop.get<bool>()));
+      glProgramUniform1i(program_id, location,
+                         static_cast<gl::GLint>(prop.get<bool>()));
       break;
     case property::ValueType::ENUM:
-      glUniform1i(location, prop.get<int>());
+      glProgramUniform1i(program_id, location, prop.get<int>());
       break;
     case property::ValueType::STRING:
     case property::ValueType::COLOR_BEZIER_CURVE:
@@ -142,4 +191,10 @@ auto MaterialProcessor::set_prop(property::Property &prop) const -> void {
   }
 }
 
+auto MaterialProcessor::set_uniform(gl::GLint location,
+                                    const FVec4 &value) const -> void {
+  glProgramUniform4f(program_id, location, value.x, value.y, value.z,
+                     value.w);
+}
+
 }  // namespace afro::graph::material
\ No newline at end of file
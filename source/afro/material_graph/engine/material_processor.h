@@ -8,38 +8,73 @@
 
 #include <glbinding/gl43core/gl.h>
 
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gl_state.h"
 #include "property/data/property.h"
 
 namespace afro::graph::material {
+/**
+ * @brief Inserts @a defines, e.g. `#define blendMode 2\n`, after the #version
+ * directive of @a shader_code. Line numbers in compile errors still match
+ * the original.
+ */
+auto add_defines(std::string_view shader_code, std::string_view defines)
+    -> std::string;
+
 class MaterialProcessor {
+ public:
+  // Image units every GL 4.3 implementation has for compute shaders.
+  static constexpr int MAX_IMAGE_UNITS = 8;
+
  private:
   bool is_initialized = false;
-  int texture_target_offset = 0;
   gl::GLuint program_id = 0;
-  gl::GLuint vbo = 0, vao = 0, ebo = 0;
-  //                                            x  | y |  z  | u |  v
-  // clang-format off
-  static constexpr  gl::GLfloat VERTICES[] = {  1,   1,   0,   1,   1,
-                                               -1,   1,   0,   0,   1,
-                                                1,  -1,   0,   1,   0,
-                                               -1,  -1,   0,   0,   0 };
-  static constexpr int INDICES[] = {0, 1, 2, 2, 1, 3};
-  // clang-format on
+  bool is_compute = false;
+  std::array<gl::GLint, 3> work_group_size{1, 1, 1};
+  gl::GLint pass_location = -1;
 
  public:
   MaterialProcessor() = default;
 
   auto init(std::string_view fragment_shader) -> void;
+  /**
+   * @brief Makes the processor run @a compute_shader with dispatch() instead
+   * of drawing.
+   */
+  auto init_compute(std::string_view compute_shader) -> void;
 
   auto deinit() -> void;
 
-  auto set_texture(std::string_view sampler_name, gl::GLint texture_unit)
-      -> void;
+  /**
+   * @brief Location of a uniform, -1 if the shader doesn't have it.
+   */
+  [[nodiscard]] auto get_uniform_location(std::string_view name) const
+      -> gl::GLint;
+
+  /**
+   * @brief Makes the sampler at @a location read @a texture_unit, which is
+   * kept by the program so it only has to be set once.
+   */
+  auto set_sampler(gl::GLint location, gl::GLint texture_unit) const -> void;
 
-  auto execute(gl::GLuint output_frame_buf, gl::GLuint tex_buf, int width,
-               int height) -> void;
+  auto execute(GlState &state, gl::GLuint output_frame_buf, gl::GLuint tex_buf,
+               int width, int height) const -> void;
+  /**
+   * @brief Runs the compute shader @a passes times over the output, see
+   * MaterialComputeShader for how the images are bound.
+   */
+  auto dispatch(GlState &state, gl::GLuint output_tex,
+                gl::GLenum output_format,
+                const std::vector<gl::GLuint> &scratch_images, int width,
+                int height, int passes) const -> void;
+  [[nodiscard]] auto get_is_compute() const -> bool { return is_compute; }
 
-  auto set_prop(property::Property &prop) const -> void;
+  auto set_prop(gl::GLint location, property::Property &prop) const -> void;
+  auto set_uniform(gl::GLint location, const FVec4 &value) const -> void;
 
   MaterialProcessor(MaterialProcessor &) = delete;
   auto operator=(const MaterialProcessor &) -> MaterialProcessor & = delete;
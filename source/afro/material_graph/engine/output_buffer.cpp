@@ -6,4 +6,43 @@
 
 #include "output_buffer.h"
 
-namespace afro::graph::material {}  // namespace afro::graph::material
+#include <array>
+
+#include "utils/assert.h"
+
+using namespace gl;
+
+namespace afro::graph::material {
+auto is_grayscale_format(GLenum format) -> bool {
+  return format == GL_R8 || format == GL_R16F;
+}
+
+auto get_grayscale_format(GLenum format) -> GLenum {
+  return format == GL_RGBA16F || format == GL_R16F ? GL_R16F : GL_R8;
+}
+
+auto get_pixel_bytes(GLenum format) -> size_t {
+  switch (format) {
+    case GL_R8:
+      return 1;
+    case GL_R16F:
+      return 2;
+    case GL_RGBA8:
+      return 4;
+    case GL_RGBA16F:
+      return 8;
+    case GL_RGBA32F:
+      return 16;
+    default:
+      AF_ASSERT_MSG(false, "Unsupported buffer format")
+      return 0;
+  }
+}
+
+auto set_grayscale_swizzle() -> void {
+  const auto swizzle = std::array<GLint, 4>{
+      static_cast<GLint>(GL_RED), static_cast<GLint>(GL_RED),
+      static_cast<GLint>(GL_RED), static_cast<GLint>(GL_ONE)};
+  glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle.data());
+}
+}  // namespace afro::graph::material
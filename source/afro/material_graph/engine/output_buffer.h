@@ -8,6 +8,8 @@
 
 #include <glbinding/gl43core/gl.h>
 
+#include <cstddef>
+
 namespace afro::graph::material {
 class OutputBuffer {
  public:
@@ -19,4 +21,20 @@ class OutputBuffer {
 
   OutputBuffer() : texture_id(0), frame_buffer_id(0) {}
 };
-}  // namespace afro::graph::material
\ No newline at end of file
+
+/**
+ * @brief Whether buffers of the sized @a format store a single channel.
+ */
+auto is_grayscale_format(gl::GLenum format) -> bool;
+/**
+ * @brief The single channel format with the precision of @a format.
+ */
+auto get_grayscale_format(gl::GLenum format) -> gl::GLenum;
+auto get_pixel_bytes(gl::GLenum format) -> size_t;
+/**
+ * @brief Makes the texture bound to GL_TEXTURE_2D sample its red channel as
+ * gray with an alpha of one, so shaders read single channel buffers like
+ * color ones.
+ */
+auto set_grayscale_swizzle() -> void;
+}  // namespace afro::graph::material
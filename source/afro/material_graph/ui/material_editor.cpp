@@ -8,34 +8,69 @@
 
 #include <imgui.h>
 
+#include <fmt/format.h>
+
+#include <array>
+#include <memory>
+
 #include "graph/commands/add_node_command.h"
 #include "imnodes/imnodes.h"
+#include "material_graph/commands/set_high_precision_command.h"
+#include "material_graph/definitions/subgraph_definition.h"
 #include "ui/utils/ui_utils.h"
 #include "utils/translation.h"
 
 namespace afro::graph::material {
+namespace {
+constexpr auto PREVIEW_RESOLUTIONS = std::array{64, 128, 256, 512, 1024};
+}  // namespace
+
 auto MaterialEditor::draw() -> void {
   // Draw the main menu bar
   if (ImGui::BeginMainMenuBar()) {
     if (ImGui::BeginMenu(translate("Editors"))) {
       ImGui::MenuItem(translate("Material Editor"), nullptr, &show);
+      // Resolution of the previews while a value is dragged.
+      if (ImGui::BeginMenu(translate("Preview Resolution"))) {
+        for (const auto resolution : PREVIEW_RESOLUTIONS) {
+          if (ImGui::MenuItem(fmt::format("{0}x{0}", resolution).c_str(),
+                              nullptr,
+                              resolution == engine->get_preview_resolution())) {
+            engine->set_preview_resolution(resolution);
+          }
+        }
+        ImGui::EndMenu();
+      }
       ImGui::EndMenu();
     }
     ImGui::EndMainMenuBar();
   }
 
-  if (graph != nullptr) {
-    engine->update();
-  }
+  update_subgraphs();
+  // The last frame's draws were issued, previews it replaced can be reused.
+  engine->begin_frame();
+  // Drags render at preview resolution until released.
+  engine->set_interactive(props_editor->is_scrubbing());
 
   GraphEditor::draw();
 }
 
 auto MaterialEditor::draw_node_body(Node& node) -> void {
-  uintptr_t ptr =
-      engine->get_preview_texture(dynamic_cast<MaterialNode&>(node));
+  auto& material_node = dynamic_cast<MaterialNode&>(node);
+  uintptr_t ptr = engine->get_preview_texture(material_node);
   ImGui::Image(reinterpret_cast<ImTextureID>(ptr),
                {ImGui::GetFontSize() * 7, ImGui::GetFontSize() * 7});
+
+  // Half floats keep e.g. height maps normals are derived from smooth.
+  ImGui::PushID(&node);
+  auto high_precision = material_node.get_high_precision();
+  if (ImGui::Checkbox(translate("16 bit"), &high_precision)) {
+    undo_stack->enqueue(std::make_unique<SetHighPrecision>(
+        std::dynamic_pointer_cast<MaterialNode>(
+            graph->get_node_by_uuid(node.get_uuid())),
+        high_precision));
+  }
+  ImGui::PopID();
 }
 
 auto MaterialEditor::draw_main_context_menu() -> void {
@@ -54,59 +89,58 @@ auto MaterialEditor::draw_main_context_menu() -> void {
       }
       ImGui::EndMenu();
     }
+    if (ImGui::BeginMenu(translate("Add subgraph"))) {
+      for (size_t i = 0; i < subgraphs.size(); ++i) {
+        if (subgraphs[i].get() == graph.get()) {
+          continue;
+        }
+        const auto& definition = subgraph_definitions[i];
+        ui::draw_command<graph::AddNode>(undo_stack.get(),
+                                         definition.get_name(),
+                                         ui::Icon::NONE, definition, graph);
+      }
+      ImGui::EndMenu();
+    }
     ImGui::EndPopup();
   }
 }
 
+auto MaterialEditor::update_subgraphs() -> void {
+  if (!subgraphs_changed && subgraphs == data->material_graphs) {
+    return;
+  }
+  subgraphs = data->material_graphs;
+  subgraph_definitions.clear();
+  subgraph_connections.clear();
+  for (size_t i = 0; i < subgraphs.size(); ++i) {
+    const auto& subgraph = subgraphs[i];
+    // Subgraph instances are rendered from the mirrors of their graphs.
+    engine->add_graph(subgraph);
+    const auto name =
+        subgraph->get_name().empty()
+            ? fmt::format("{} {}", translate("Graph"), i + 1)
+            : subgraph->get_name();
+    subgraph_definitions.push_back(make_subgraph_definition(subgraph, name));
+    subgraph_connections.emplace_back(subgraph->interface_changed.connect(
+        [this]() { subgraphs_changed = true; }));
+  }
+  subgraphs_changed = false;
+}
+
+auto MaterialEditor::startup(std::unique_ptr<ui::GlContext> context) -> void {
+  engine->startup(std::move(context));
+}
+
 auto MaterialEditor::set_graph(const std::shared_ptr<MaterialGraph> graph)
     -> void {
   GraphEditor::set_graph(graph);
+  update_subgraphs();
   engine->set_graph(graph);
-
-  // Listen for node change
-  for (const auto& node : graph->get_nodes()) {
-    connections.push_back(node->on_invalidate.connect([this, node]() {
-      log::core_trace("Node changed: {}", node->get_uuid());
-      engine->on_node_changed(node->get_uuid());
-    }));
-  }
-
-  graph->node_added.connect([this](const std::shared_ptr<Node>& node) {
-    log::core_trace("Node added: {}", node->get_name());
-    engine->on_node_created(std::dynamic_pointer_cast<MaterialNode>(node));
-    node->on_invalidate.connect([this, node]() {
-      log::core_trace("Node changed: {}", node->get_uuid());
-      engine->on_node_changed(node->get_uuid());
-    });
-  });
-
-  // Listen for node removal
-  graph->node_removed.connect([this](const std::shared_ptr<Node>& node) {
-    node->on_invalidate.disconnect_all_slots();
-    engine->on_node_deleted(std::dynamic_pointer_cast<MaterialNode>(node));
-    log::core_trace("Node removed: {}", node->get_name());
-  });
-
-  // Listen for link change
-  graph->link_added.connect([this](Link link) {
-    log::core_trace("Link created: {} -> {}", link.get_from_property(),
-                    link.get_to_property());
-    engine->on_link_created(link);
-  });
-  graph->link_removed.connect([this](Link link) {
-    log::core_trace("Link removed: {} -> {}", link.get_from_property(),
-                    link.get_to_property());
-    engine->on_link_deleted(link);
-  });
 }
 
 auto MaterialEditor::clear_graph() -> void {
   GraphEditor::clear_graph();
   engine->clear_graph();
-  graph->node_added.disconnect_all_slots();
-  graph->node_removed.disconnect_all_slots();
-  graph->link_added.disconnect_all_slots();
-  graph->link_removed.disconnect_all_slots();
 }
 auto MaterialEditor::shutdown() -> void { engine->shutdown(); }
 }  // namespace afro::graph::material
\ No newline at end of file
@@ -8,13 +8,17 @@
 
 #include <fruit/fruit.h>
 
+#include <boost/signals2/connection.hpp>
 #include <boost/signals2/signal.hpp>
+#include <memory>
 #include <utility>
+#include <vector>
 
 #include "graph/ui/graph_editor.h"
 #include "material_graph/data/material_graph.h"
 #include "material_graph/definitions/definitions.h"
-#include "material_graph/engine/material_engine.h"
+#include "material_graph/engine/async_engine.h"
+#include "store/data/data.h"
 #include "ui/interfaces/widget.h"
 #include "undo/interfaces/undo_stack.h"
 
@@ -22,9 +26,20 @@ namespace afro::graph::material {
 class MaterialEditor : public GraphEditor {
  private:
   std::shared_ptr<undo::UndoStack> undo_stack;
-  std::shared_ptr<MaterialEngine> engine;
-  std::vector<boost::signals2::connection> connections;
+  std::shared_ptr<AsyncEngine> engine;
   std::shared_ptr<NodeDefinitions> node_definitions;
+  std::shared_ptr<store::Data> data;
+  std::shared_ptr<property::PropertyEditor> props_editor;
+  // Graphs of the store when the subgraph definitions were made, in the
+  // same order as the definitions.
+  std::vector<std::shared_ptr<MaterialGraph>> subgraphs;
+  std::vector<MaterialNodeDefinition> subgraph_definitions;
+  std::vector<boost::signals2::scoped_connection> subgraph_connections;
+  bool subgraphs_changed = false;
+
+  // Mirrors graphs added to the store and remakes the subgraph definitions
+  // once the store or the interface of a graph changed.
+  auto update_subgraphs() -> void;
 
  protected:
   auto draw_node_body(Node& node) -> void override;
@@ -32,14 +47,21 @@ class MaterialEditor : public GraphEditor {
 
  public:
   INJECT(MaterialEditor(std::shared_ptr<undo::UndoStack> undo_stack_,
-                        std::shared_ptr<property::PropertyEditor> props_editor,
-                        std::shared_ptr<MaterialEngine> engine_,
-                        std::shared_ptr<NodeDefinitions> node_definitions_))
-      : GraphEditor("Material Editor", undo_stack_, std::move(props_editor)),
+                        std::shared_ptr<property::PropertyEditor> props_editor_,
+                        std::shared_ptr<AsyncEngine> engine_,
+                        std::shared_ptr<NodeDefinitions> node_definitions_,
+                        std::shared_ptr<store::Data> data_))
+      : GraphEditor("Material Editor", undo_stack_, props_editor_),
         undo_stack(std::move(undo_stack_)),
         engine(std::move(engine_)),
-        node_definitions(std::move(node_definitions_)) {}
+        node_definitions(std::move(node_definitions_)),
+        data(std::move(data_)),
+        props_editor(std::move(props_editor_)) {}
 
+  /**
+   * @brief Starts rendering graphs with @a context on the engine thread.
+   */
+  auto startup(std::unique_ptr<ui::GlContext> context) -> void;
   auto set_graph(std::shared_ptr<MaterialGraph> graph) -> void;
   auto clear_graph() -> void override;
   auto draw() -> void override;
@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <variant>
+
+#include "common/interfaces/command.h"
+#include "common/interfaces/object.h"
+#include "property/data/property.h"
+
+namespace afro::property {
+
+/**
+ * @brief Sets a property of an object. Consecutive changes of the same
+ * property, like dragging a slider, merge into a single undo step.
+ */
+class SetPropertyValue : public Command {
+ private:
+  std::shared_ptr<AfObject> owner_;
+  UUID property_;
+  PropertyValue old_value_;
+  PropertyValue new_value_;
+
+  auto get_property() -> Property& {
+    for (auto& property : owner_->get_properties()) {
+      if (property.get_uuid() == property_) {
+        return property;
+      }
+    }
+    throw CommandError("Property not found");
+  }
+
+  // Like Property::set_value, as EnumItem isn't assignable.
+  static auto assign(PropertyValue& to, const PropertyValue& from) -> void {
+    std::visit(
+        [&to](const auto& val) {
+          to.emplace<std::decay_t<decltype(val)>>(val);
+        },
+        from);
+  }
+
+  static auto get_value_memory_usage(const PropertyValue& value) -> size_t {
+    return std::visit(
+        [](const auto& val) -> size_t {
+          using T = std::decay_t<decltype(val)>;
+          if constexpr (std::is_same_v<T, std::string>) {
+            return val.capacity();
+          } else if constexpr (std::is_same_v<T, curve::ColorCurve>) {
+            auto size = size_t{0};
+            for (const auto* spline : {&val.lum, &val.r, &val.g, &val.b,
+                                       &val.a}) {
+              size += spline->points.capacity() * sizeof(curve::ControlPoint);
+            }
+            return size;
+          } else {
+            return 0;
+          }
+        },
+        value);
+  }
+
+ public:
+  SetPropertyValue(std::shared_ptr<AfObject> owner, UUID property,
+                   PropertyValue value)
+      : Command("SET_PROPERTY_VALUE"),
+        owner_(std::move(owner)),
+        property_(property),
+        new_value_(std::move(value)) {}
+
+  auto execute() -> void override {
+    auto& property = get_property();
+    assign(old_value_, property.get_value());
+    property.set_value(new_value_);
+  }
+  auto undo() -> void override { get_property().set_value(old_value_); }
+
+  [[nodiscard]] auto get_memory_usage() const -> size_t override {
+    return sizeof(*this) + get_value_memory_usage(old_value_) +
+           get_value_memory_usage(new_value_);
+  }
+  auto merge(Command& next) -> bool override {
+    auto* other = dynamic_cast<SetPropertyValue*>(&next);
+    if (other == nullptr || other->owner_ != owner_ ||
+        other->property_ != property_) {
+      return false;
+    }
+    assign(new_value_, other->new_value_);
+    return true;
+  }
+  ~SetPropertyValue() override = default;
+};
+
+}  // namespace afro::property
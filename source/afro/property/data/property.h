@@ -29,6 +29,10 @@ class Property {
     return property_definition;
   }
 
+  [[nodiscard]] auto get_value() const -> const PropertyValue& {
+    return value;
+  }
+
   template <typename T>
   auto get() -> T& {
     return std::get<T>(value);
@@ -42,6 +46,22 @@ class Property {
                     property_definition.name);
   }
 
+  /**
+   * @brief Sets the value from a type erased PropertyValue, the held
+   * alternative is replaced rather than assigned since EnumItem isn't
+   * assignable.
+   */
+  auto set_value(const PropertyValue& new_value) -> void {
+    std::visit(
+        [this](const auto& val) {
+          value.emplace<std::decay_t<decltype(val)>>(val);
+        },
+        new_value);
+    on_value_changed(*this);
+    log::core_trace("Property {} changed signal emitted.",
+                    property_definition.name);
+  }
+
   template <typename T>
   auto operator=(T new_value) -> Property& {
     set(new_value);
@@ -3,9 +3,10 @@
 #include <fruit/fruit.h>
 
 #include "ui/property_editor.h"
+#include "undo/di.h"
 
 namespace afro::property {
 auto get_property_component() -> fruit::Component<PropertyEditor> {
-  return fruit::createComponent();
+  return fruit::createComponent().install(undo::getUndoComponent);
 }
 }  // namespace afro::property
\ No newline at end of file
@@ -3,8 +3,10 @@
 #include <imgui.h>
 #include <utils/translation.h>
 
+#include <memory>
 #include <vector>
 
+#include "property/commands/set_property_value_command.h"
 #include "property_widgets.h"
 
 namespace afro::property {
@@ -18,6 +20,8 @@ void PropertyEditor::draw() {
     ImGui::EndMainMenuBar();
   }
 
+  scrubbing = false;
+
   // Draw the property editor
   if (not show) return;
 
@@ -36,16 +40,24 @@ void PropertyEditor::draw() {
     return;
   }
 
-  auto &properties = object.lock()->get_properties();
-  for (auto &property : properties) {
-    get_draw_function(property)(property);
+  auto owner = object.lock();
+  // A group is active while any widget inside it is.
+  ImGui::BeginGroup();
+  for (auto &property : owner->get_properties()) {
+    // Consecutive values, e.g. of a drag, merge into one undo step.
+    get_draw_function(property)(property, [&](PropertyValue value) {
+      undo_stack->enqueue(std::make_unique<SetPropertyValue>(
+          owner, property.get_uuid(), std::move(value)));
+    });
   }
+  ImGui::EndGroup();
+  scrubbing = ImGui::IsItemActive();
 
   ImGui::End();
 }
 
 auto PropertyEditor::get_draw_function(Property &property)
-    -> std::function<void(Property &)> {
+    -> std::function<void(Property &, const SetValue &)> {
   switch (property.get_property_definition().value_type) {
     case ValueType::INTEGER:
       return draw_integer_property;
@@ -72,7 +84,7 @@ auto PropertyEditor::get_draw_function(Property &property)
     case ValueType::COLOR_BEZIER_CURVE:
       return draw_curve_property;
     default:
-      return [](Property &) {
+      return [](Property &, const SetValue &) {
         ImGui::TextUnformatted(translate("Unknown property type"));
       };
   }
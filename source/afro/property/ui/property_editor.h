@@ -7,19 +7,30 @@
 
 #include "common/interfaces/object.h"
 #include "property/data/property.h"
+#include "property_widgets.h"
 #include "ui/interfaces/widget.h"
+#include "undo/interfaces/undo_stack.h"
 
 namespace afro::property {
 class PropertyEditor : public ui::Widget {
  private:
+  std::shared_ptr<undo::UndoStack> undo_stack;
   std::weak_ptr<AfObject> object;
-  auto get_draw_function(Property &property) -> std::function<void(Property &)>;
+  bool scrubbing = false;
+  auto get_draw_function(Property &property)
+      -> std::function<void(Property &, const SetValue &)>;
 
  public:
-  INJECT(PropertyEditor()) = default;
+  INJECT(PropertyEditor(std::shared_ptr<undo::UndoStack> undo_stack))
+      : undo_stack(std::move(undo_stack)) {}
   ~PropertyEditor() override = default;
 
   void set_object(std::weak_ptr<AfObject> object);
+  /**
+   * @brief Whether one of the property widgets was held in the last frame,
+   * e.g. a value being dragged.
+   */
+  [[nodiscard]] auto is_scrubbing() const -> bool { return scrubbing; }
 
   void draw() override;
 };
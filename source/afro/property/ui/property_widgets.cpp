@@ -12,37 +12,38 @@
 #include "ui/utils/ui_utils.h"
 
 namespace afro::property {
-auto draw_integer_property(Property& property) -> void {
+auto draw_integer_property(Property& property, const SetValue& set_value)
+    -> void {
   const auto& prop_def = property.get_property_definition();
 
   ImGui::PushID(prop_def.id.data());
   ImGui::TextUnformatted(prop_def.name.data());
   ui::tooltip(prop_def.description);
-  auto* value = &property.get<int>();
+  auto value = property.get<int>();
 
   static const PropertyValue default_step{1.0F};
   static const PropertyValue zero_value{0};
   static const PropertyValue max_value{std::numeric_limits<int>::max()};
 
   if (ImGui::DragInt(
-          "###drag_int", value,
+          "###drag_int", &value,
           std::get<float>(prop_def.step_value.value_or(default_step)),
           std::get<int>(prop_def.min_value.value_or(zero_value)),
           std::get<int>(prop_def.max_value.value_or(max_value)), nullptr,
           ImGuiSliderFlags_AlwaysClamp)) {
-    // TODO: Add undo/redo
-    property = *value;
+    set_value(value);
   }
   ImGui::PopID();
 }
 
-auto draw_integer2_property(Property& property) -> void {
+auto draw_integer2_property(Property& property, const SetValue& set_value)
+    -> void {
   const auto& prop_def = property.get_property_definition();
 
   ImGui::PushID(prop_def.id.data());
   ImGui::TextUnformatted(prop_def.name.data());
   ui::tooltip(prop_def.description);
-  auto* value = &property.get<IVec2>();
+  auto value = property.get<IVec2>();
 
   static const PropertyValue default_step{1.0F};
   static const PropertyValue zero_value{0};
@@ -51,40 +52,38 @@ auto draw_integer2_property(Property& property) -> void {
   switch (prop_def.value_unit) {
     case ValueUnit::NONE: {
       if (ImGui::DragInt2(
-              "###drag_int2", reinterpret_cast<int*>(value),
+              "###drag_int2", reinterpret_cast<int*>(&value),
               std::get<float>(prop_def.step_value.value_or(default_step)),
               std::get<int>(prop_def.min_value.value_or(zero_value)),
               std::get<int>(prop_def.max_value.value_or(max_value)), nullptr,
               ImGuiSliderFlags_AlwaysClamp)) {
-        // TODO: Add undo/redo
-        property = *value;
+        set_value(value);
       }
       break;
     }
     case ValueUnit::POWER_2: {
       ImGui::BeginGroup();
-      if (ImGui::DragInt("###x", &value->x,
+      if (ImGui::DragInt("###x", &value.x,
                          std::get<float>(prop_def.step_value.value_or(
-                             default_step)),  // TODO: Add undo/redo
+                             default_step)),
                          std::get<int>(prop_def.min_value.value_or(zero_value)),
                          std::get<int>(prop_def.max_value.value_or(max_value)),
                          nullptr, ImGuiSliderFlags_AlwaysClamp) ||
-          ImGui::DragInt("###y", &value->y,
+          ImGui::DragInt("###y", &value.y,
                          std::get<float>(prop_def.step_value.value_or(
-                             default_step)),  // TODO: Add undo/redo
+                             default_step)),
                          std::get<int>(prop_def.min_value.value_or(zero_value)),
                          std::get<int>(prop_def.max_value.value_or(max_value)),
                          nullptr, ImGuiSliderFlags_AlwaysClamp)) {
-        // TODO: Add undo/redo
-        property = *value;
+        set_value(value);
       }
       ImGui::EndGroup();
       ImGui::SameLine();
 
       ImGui::BeginGroup();
       ImGui::BeginDisabled();
-      ImGui::Text("%d", static_cast<int>(std::pow(2, value->x)));
-      ImGui::Text("%d", static_cast<int>(std::pow(2, value->y)));
+      ImGui::Text("%d", static_cast<int>(std::pow(2, value.x)));
+      ImGui::Text("%d", static_cast<int>(std::pow(2, value.y)));
       ImGui::EndDisabled();
       ImGui::EndGroup();
       break;
@@ -96,12 +95,13 @@ auto draw_integer2_property(Property& property) -> void {
   ImGui::PopID();
 }
 
-auto draw_integer3_property(Property& property) -> void {
+auto draw_integer3_property(Property& property, const SetValue& set_value)
+    -> void {
   const auto& prop_def = property.get_property_definition();
 
   ImGui::PushID(prop_def.id.data());
   ImGui::TextUnformatted(prop_def.name.data());
-  auto* value = &property.get<IVec3>();
+  auto value = property.get<IVec3>();
 
   static const PropertyValue default_step{1.0F};
   static const PropertyValue zero_value{0};
@@ -110,13 +110,12 @@ auto draw_integer3_property(Property& property) -> void {
   switch (prop_def.value_unit) {
     case ValueUnit::NONE: {
       if (ImGui::DragInt3(
-              "###drag_int3", reinterpret_cast<int*>(value),
+              "###drag_int3", reinterpret_cast<int*>(&value),
               std::get<float>(prop_def.step_value.value_or(default_step)),
               std::get<int>(prop_def.min_value.value_or(zero_value)),
               std::get<int>(prop_def.max_value.value_or(max_value)), nullptr,
               ImGuiSliderFlags_AlwaysClamp)) {
-        // TODO: Add undo/redo
-        property = *value;
+        set_value(value);
       }
       break;
     }
@@ -127,13 +126,14 @@ auto draw_integer3_property(Property& property) -> void {
   ImGui::PopID();
 }
 
-auto draw_integer4_property(Property& property) -> void {
+auto draw_integer4_property(Property& property, const SetValue& set_value)
+    -> void {
   const auto& prop_def = property.get_property_definition();
 
   ImGui::PushID(prop_def.id.data());
   ImGui::TextUnformatted(prop_def.name.data());
   ui::tooltip(prop_def.description);
-  auto* value = &property.get<IVec4>();
+  auto value = property.get<IVec4>();
 
   static const PropertyValue default_step{1.0F};
   static const PropertyValue zero_value{0};
@@ -142,13 +142,12 @@ auto draw_integer4_property(Property& property) -> void {
   switch (prop_def.value_unit) {
     case ValueUnit::NONE: {
       if (ImGui::DragInt4(
-              "###drag_int4", reinterpret_cast<int*>(value),
+              "###drag_int4", reinterpret_cast<int*>(&value),
               std::get<float>(prop_def.step_value.value_or(default_step)),
               std::get<int>(prop_def.min_value.value_or(zero_value)),
               std::get<int>(prop_def.max_value.value_or(max_value)), nullptr,
               ImGuiSliderFlags_AlwaysClamp)) {
-        // TODO: Add undo/redo
-        property = *value;
+        set_value(value);
       }
       break;
     }
@@ -159,37 +158,38 @@ auto draw_integer4_property(Property& property) -> void {
   ImGui::PopID();
 }
 
-auto draw_float_property(Property& property) -> void {
+auto draw_float_property(Property& property, const SetValue& set_value)
+    -> void {
   const auto& prop_def = property.get_property_definition();
 
   ImGui::PushID(prop_def.id.data());
   ImGui::TextUnformatted(prop_def.name.data());
   ui::tooltip(prop_def.description);
-  auto* value = &property.get<float>();
+  auto value = property.get<float>();
 
   static const PropertyValue default_step{0.01F};
   static const PropertyValue zero_value{0.0F};
   static const PropertyValue max_value{std::numeric_limits<float>::max()};
 
   if (ImGui::DragFloat(
-          "###drag_float", value,
+          "###drag_float", &value,
           std::get<float>(prop_def.step_value.value_or(default_step)),
           std::get<float>(prop_def.min_value.value_or(zero_value)),
           std::get<float>(prop_def.max_value.value_or(max_value)), nullptr,
           ImGuiSliderFlags_AlwaysClamp)) {
-    // TODO: Add undo/redo
-    property = *value;
+    set_value(value);
   }
   ImGui::PopID();
 }
 
-auto draw_float2_property(Property& property) -> void {
+auto draw_float2_property(Property& property, const SetValue& set_value)
+    -> void {
   const auto& prop_def = property.get_property_definition();
 
   ImGui::PushID(prop_def.id.data());
   ImGui::TextUnformatted(prop_def.name.data());
   ui::tooltip(prop_def.description);
-  auto* value = &property.get<FVec2>();
+  auto value = property.get<FVec2>();
 
   static const PropertyValue default_step{0.01F};
   static const PropertyValue zero_value{0.0F};
@@ -198,13 +198,12 @@ auto draw_float2_property(Property& property) -> void {
   switch (prop_def.value_unit) {
     case ValueUnit::NONE: {
       if (ImGui::DragFloat2(
-              "###drag_float2", reinterpret_cast<float*>(value),
+              "###drag_float2", reinterpret_cast<float*>(&value),
               std::get<float>(prop_def.step_value.value_or(default_step)),
               std::get<float>(prop_def.min_value.value_or(zero_value)),
               std::get<float>(prop_def.max_value.value_or(max_value)), "%f",
               ImGuiSliderFlags_AlwaysClamp)) {
-        // TODO: Add undo/redo
-        property = *value;
+        set_value(value);
       }
       break;
     }
@@ -215,13 +214,14 @@ auto draw_float2_property(Property& property) -> void {
   ImGui::PopID();
 }
 
-auto draw_float3_property(Property& property) -> void {
+auto draw_float3_property(Property& property, const SetValue& set_value)
+    -> void {
   const auto& prop_def = property.get_property_definition();
 
   ImGui::PushID(prop_def.id.data());
   ImGui::TextUnformatted(prop_def.name.data());
   ui::tooltip(prop_def.description);
-  auto* value = &property.get<FVec3>();
+  auto value = property.get<FVec3>();
 
   static const PropertyValue default_step{0.01F};
   static const PropertyValue zero_value{0.0F};
@@ -230,21 +230,19 @@ auto draw_float3_property(Property& property) -> void {
   switch (prop_def.value_unit) {
     case ValueUnit::NONE: {
       if (ImGui::DragFloat3(
-              "###drag_float3", reinterpret_cast<float*>(value),
+              "###drag_float3", reinterpret_cast<float*>(&value),
               std::get<float>(prop_def.step_value.value_or(default_step)),
               std::get<float>(prop_def.min_value.value_or(zero_value)),
               std::get<float>(prop_def.max_value.value_or(max_value)), nullptr,
               ImGuiSliderFlags_AlwaysClamp)) {
-        // TODO: Add undo/redo
-        property = *value;
+        set_value(value);
       }
       break;
     }
     case ValueUnit::COLOR: {
-      if (ImGui::ColorEdit3("###color_edit3", reinterpret_cast<float*>(value),
+      if (ImGui::ColorEdit3("###color_edit3", reinterpret_cast<float*>(&value),
                             ImGuiColorEditFlags_Float)) {
-        //  TODO: Add undo/redo
-        property = *value;
+        set_value(value);
       }
       break;
     }
@@ -255,13 +253,14 @@ auto draw_float3_property(Property& property) -> void {
   ImGui::PopID();
 }
 
-auto draw_float4_property(Property& property) -> void {
+auto draw_float4_property(Property& property, const SetValue& set_value)
+    -> void {
   const auto& prop_def = property.get_property_definition();
 
   ImGui::PushID(prop_def.id.data());
   ImGui::TextUnformatted(prop_def.name.data());
   ui::tooltip(prop_def.description);
-  auto* value = &property.get<FVec4>();
+  auto value = property.get<FVec4>();
 
   static const PropertyValue default_step{0.01F};
   static const PropertyValue zero_value{0.0F};
@@ -270,23 +269,21 @@ auto draw_float4_property(Property& property) -> void {
   switch (prop_def.value_unit) {
     case ValueUnit::NONE: {
       if (ImGui::DragFloat4(
-              "###drag_float4", reinterpret_cast<float*>(value),
+              "###drag_float4", reinterpret_cast<float*>(&value),
               std::get<float>(prop_def.step_value.value_or(default_step)),
               std::get<float>(prop_def.min_value.value_or(zero_value)),
               std::get<float>(prop_def.max_value.value_or(max_value)), nullptr,
               ImGuiSliderFlags_AlwaysClamp)) {
-        // TODO: Add undo/redo
-        property = *value;
+        set_value(value);
       }
       break;
     }
     case ValueUnit::COLOR: {
-      if (ImGui::ColorEdit4("###color_edit4", reinterpret_cast<float*>(value),
+      if (ImGui::ColorEdit4("###color_edit4", reinterpret_cast<float*>(&value),
                             ImGuiColorEditFlags_Float |
                                 ImGuiColorEditFlags_AlphaBar |
                                 ImGuiColorEditFlags_AlphaPreviewHalf)) {
-        // TODO: Add undo/redo
-        property = *value;
+        set_value(value);
       }
       break;
     }
@@ -297,34 +294,34 @@ auto draw_float4_property(Property& property) -> void {
   ImGui::PopID();
 }
 
-auto draw_bool_property(Property& property) -> void {
+auto draw_bool_property(Property& property, const SetValue& set_value)
+    -> void {
   const auto& prop_def = property.get_property_definition();
 
   ImGui::PushID(prop_def.id.data());
   ImGui::TextUnformatted(prop_def.name.data());
   ui::tooltip(prop_def.description);
-  auto* value = &property.get<bool>();
+  auto value = property.get<bool>();
 
-  if (ImGui::Checkbox("###checkbox", value)) {
-    // TODO: Add undo/redo
-    property = *value;
+  if (ImGui::Checkbox("###checkbox", &value)) {
+    set_value(value);
   }
   ImGui::PopID();
 }
 
-auto draw_string_property(Property& property) -> void {
+auto draw_string_property(Property& property, const SetValue& set_value)
+    -> void {
   const auto& prop_def = property.get_property_definition();
 
   ImGui::PushID(prop_def.id.data());
   ImGui::TextUnformatted(prop_def.name.data());
   ui::tooltip(prop_def.description);
-  auto* value = &property.get<std::string>();
+  auto value = property.get<std::string>();
 
   switch (prop_def.value_unit) {
     case ValueUnit::NONE: {
-      if (ImGui::InputText("###input_text", value)) {
-        // TODO: Add undo/redo
-        property = *value;
+      if (ImGui::InputText("###input_text", &value)) {
+        set_value(value);
       }
       break;
     }
@@ -335,13 +332,14 @@ auto draw_string_property(Property& property) -> void {
   ImGui::PopID();
 }
 
-auto draw_enum_property(Property& property) -> void {
+auto draw_enum_property(Property& property, const SetValue& set_value)
+    -> void {
   const auto& prop_def = property.get_property_definition();
 
   ImGui::PushID(prop_def.id.data());
   ImGui::TextUnformatted(prop_def.name.data());
   ui::tooltip(prop_def.description);
-  auto* value = &property.get<int>();
+  auto value = property.get<int>();
   auto enum_items = prop_def.presets.value_or(std::vector<PropertyValue>());
 
   switch (prop_def.value_unit) {
@@ -349,7 +347,7 @@ auto draw_enum_property(Property& property) -> void {
       auto it = std::find_if(enum_items.begin(), enum_items.end(),
                              [&](const PropertyValue& item) {
                                const auto& enum_item = std::get<EnumItem>(item);
-                               return *value == enum_item.value;
+                               return value == enum_item.value;
                              });
       auto selected = it != enum_items.end()
                           ? std::get<EnumItem>(*it).name.data()
@@ -359,9 +357,9 @@ auto draw_enum_property(Property& property) -> void {
         for (const auto& item : enum_items) {
           const auto& enum_item = std::get<EnumItem>(item);
 
-          bool is_selected = *value == enum_item.value;
+          bool is_selected = value == enum_item.value;
           if (ImGui::Selectable(enum_item.name.data(), is_selected)) {
-            property = enum_item.value;
+            set_value(enum_item.value);
           }
         }
         ImGui::EndCombo();
@@ -375,14 +373,17 @@ auto draw_enum_property(Property& property) -> void {
   ImGui::PopID();
 }
 
-auto draw_curve_property(Property& property) -> void {
+auto draw_curve_property(Property& property, const SetValue& set_value)
+    -> void {
   const auto& prop_def = property.get_property_definition();
 
   ImGui::PushID(prop_def.id.data());
   ImGui::TextUnformatted(prop_def.name.data());
   ui::tooltip(prop_def.description);
-  auto* value = &property.get<curve::ColorCurve>();
-  curve::draw_color_curve_editor(*value);
+  auto value = property.get<curve::ColorCurve>();
+  if (curve::draw_color_curve_editor(value)) {
+    set_value(value);
+  }
   ImGui::PopID();
 }
 
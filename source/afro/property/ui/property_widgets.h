@@ -1,18 +1,38 @@
 #pragma once
+#include <functional>
+
 #include "property/data/property.h"
 
 namespace afro::property {
-auto draw_integer_property(Property& property) -> void;
-auto draw_integer2_property(Property& property) -> void;
-auto draw_integer3_property(Property& property) -> void;
-auto draw_integer4_property(Property& property) -> void;
-auto draw_float_property(Property& property) -> void;
-auto draw_float2_property(Property& property) -> void;
-auto draw_float3_property(Property& property) -> void;
-auto draw_float4_property(Property& property) -> void;
-auto draw_bool_property(Property& property) -> void;
-auto draw_string_property(Property& property) -> void;
-auto draw_enum_property(Property& property) -> void;
-auto draw_curve_property(Property& property) -> void;
+/**
+ * @brief Receives the value a widget was changed to. The widgets don't
+ * change the property themselves, so the change can be undone.
+ */
+using SetValue = std::function<void(PropertyValue)>;
+
+auto draw_integer_property(Property& property, const SetValue& set_value)
+    -> void;
+auto draw_integer2_property(Property& property, const SetValue& set_value)
+    -> void;
+auto draw_integer3_property(Property& property, const SetValue& set_value)
+    -> void;
+auto draw_integer4_property(Property& property, const SetValue& set_value)
+    -> void;
+auto draw_float_property(Property& property, const SetValue& set_value)
+    -> void;
+auto draw_float2_property(Property& property, const SetValue& set_value)
+    -> void;
+auto draw_float3_property(Property& property, const SetValue& set_value)
+    -> void;
+auto draw_float4_property(Property& property, const SetValue& set_value)
+    -> void;
+auto draw_bool_property(Property& property, const SetValue& set_value)
+    -> void;
+auto draw_string_property(Property& property, const SetValue& set_value)
+    -> void;
+auto draw_enum_property(Property& property, const SetValue& set_value)
+    -> void;
+auto draw_curve_property(Property& property, const SetValue& set_value)
+    -> void;
 
 }  // namespace afro::property
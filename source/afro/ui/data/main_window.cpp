@@ -35,6 +35,29 @@ EMBEDDED_DATA(droidsans_ttf)
 EMBEDDED_DATA(fa_solid_900_ttf)
 
 namespace afro::ui {
+namespace {
+// A hidden window, GLFW has no contexts without one.
+class GlfwContext : public GlContext {
+ private:
+  GLFWwindow *window;
+
+ public:
+  explicit GlfwContext(GLFWwindow *window) : window(window) {}
+
+  auto make_current() -> void override {
+    glfwMakeContextCurrent(window);
+    glbinding::initialize(
+        reinterpret_cast<glbinding::ContextHandle>(window),
+        [](const char *name) { return glfwGetProcAddress(name); });
+  }
+
+  auto release_current() -> void override { glfwMakeContextCurrent(nullptr); }
+
+  GlfwContext(GlfwContext &) = delete;
+  auto operator=(const GlfwContext &) -> GlfwContext & = delete;
+  ~GlfwContext() override { glfwDestroyWindow(window); }
+};
+}  // namespace
 
 void GLAPIENTRY open_gl_log(gl::GLenum /*unused*/, gl::GLenum /*unused*/,
                             gl::GLuint /*unused*/, gl::GLenum severity,
@@ -179,6 +202,16 @@ auto MainWindow::add_widget(std::shared_ptr<Widget> widget) -> void {
   widgets.push_back(std::move(widget));
 }
 
+auto MainWindow::create_shared_context() -> std::unique_ptr<GlContext> {
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  auto *window = glfwCreateWindow(1, 1, "", nullptr, glfw_window);
+  glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+  if (window == nullptr) {
+    throw std::runtime_error("Failed to create a shared OpenGL context");
+  }
+  return std::make_unique<GlfwContext>(window);
+}
+
 auto MainWindow::draw() -> bool {
   glfwPollEvents();
 
@@ -24,6 +24,7 @@ class MainWindow : public Window {
   auto shutdown() const -> void override;
   auto draw() -> bool override;
   auto add_widget(std::shared_ptr<Widget> widget) -> void override;
+  auto create_shared_context() -> std::unique_ptr<GlContext> override;
   static auto glfw_callback(int error, const char* description) -> void;
 };
 }  // namespace afro::ui
\ No newline at end of file
@@ -0,0 +1,21 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+namespace afro::ui {
+/**
+ * @brief An OpenGL context that shares textures and buffers with the one the
+ * UI draws with, for rendering on another thread.
+ */
+class GlContext {
+ public:
+  // Makes the context current on the calling thread.
+  virtual auto make_current() -> void = 0;
+  virtual auto release_current() -> void = 0;
+  virtual ~GlContext() = default;
+};
+}  // namespace afro::ui
@@ -2,6 +2,7 @@
 
 #include <memory>
 
+#include "gl_context.h"
 #include "widget.h"
 
 namespace afro::ui {
@@ -11,6 +12,8 @@ class Window {
   virtual auto shutdown() const -> void = 0;
   virtual auto draw() -> bool = 0;
   virtual auto add_widget(std::shared_ptr<Widget> widget) -> void = 0;
+  // Must be called on the thread that called startup().
+  virtual auto create_shared_context() -> std::unique_ptr<GlContext> = 0;
   virtual ~Window() = default;
 };
 
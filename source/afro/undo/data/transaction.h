@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "common/interfaces/command.h"
+#include "common/interfaces/transactional.h"
+#include "undo/interfaces/undo_stack.h"
+
+namespace afro::undo {
+/**
+ * @brief Operations that are done and undone as one. Each run of them is
+ * wrapped in a transaction of the scopes, so e.g. a graph is notified once.
+ */
+class Transaction : public Command {
+ private:
+  std::vector<Operation> operations_;
+  std::vector<std::shared_ptr<Transactional>> scopes_;
+
+  // Commits the scopes in the reverse order, even if an operation throws.
+  class Scope {
+   private:
+    const std::vector<std::shared_ptr<Transactional>>& scopes_;
+
+   public:
+    explicit Scope(const std::vector<std::shared_ptr<Transactional>>& scopes)
+        : scopes_(scopes) {
+      for (const auto& scope : scopes_) {
+        scope->begin_transaction();
+      }
+    }
+    Scope(const Scope&) = delete;
+    auto operator=(const Scope&) -> Scope& = delete;
+    ~Scope() {
+      for (auto it = scopes_.rbegin(); it != scopes_.rend(); ++it) {
+        (*it)->commit_transaction();
+      }
+    }
+  };
+
+ public:
+  Transaction(std::string_view name, std::vector<Operation> operations,
+              std::vector<std::shared_ptr<Transactional>> scopes)
+      : Command(name),
+        operations_(std::move(operations)),
+        scopes_(std::move(scopes)) {}
+
+  auto execute() -> void override {
+    auto scope = Scope(scopes_);
+    for (auto& operation : operations_) {
+      operation->execute();
+    }
+  }
+  auto undo() -> void override {
+    auto scope = Scope(scopes_);
+    for (auto it = operations_.rbegin(); it != operations_.rend(); ++it) {
+      (*it)->undo();
+    }
+  }
+  auto redo() -> void override {
+    auto scope = Scope(scopes_);
+    for (auto& operation : operations_) {
+      operation->redo();
+    }
+  }
+
+  [[nodiscard]] auto get_operations() const -> const std::vector<Operation>& {
+    return operations_;
+  }
+  [[nodiscard]] auto get_memory_usage() const -> size_t override {
+    auto size = sizeof(*this) + operations_.capacity() * sizeof(Operation);
+    for (const auto& operation : operations_) {
+      size += operation->get_memory_usage();
+    }
+    return size;
+  }
+  ~Transaction() override = default;
+};
+}  // namespace afro::undo
@@ -1,7 +1,15 @@
 #include "undo_stack_impl.h"
 
+#include <utility>
+
+#include "transaction.h"
+#include "utils/assert.h"
+
 namespace afro::undo {
 auto UndoStackImpl::execute_undo() -> void {
+  if (undo_depth != 0) {
+    last_push.reset();
+  }
   while (undo_depth != 0 && has_undo()) {
     operations[next_undo_idx]->undo();
     --next_undo_idx;
@@ -11,6 +19,9 @@ auto UndoStackImpl::execute_undo() -> void {
 }
 
 auto UndoStackImpl::execute_redo() -> void {
+  if (redo_depth != 0) {
+    last_push.reset();
+  }
   while (redo_depth != 0 && has_redo()) {
     operations[next_undo_idx + 1]->redo();
     ++next_undo_idx;
@@ -30,9 +41,38 @@ auto UndoStackImpl::has_redo() const -> bool {
 }
 
 auto UndoStackImpl::enqueue(Operation item) -> void {
+  if (transaction_depth > 0) {
+    transaction_operations.emplace_back(std::move(item));
+    return;
+  }
   pending_operations.emplace_back(std::move(item));
 }
 
+auto UndoStackImpl::begin_transaction(
+    std::string_view name, std::vector<std::shared_ptr<Transactional>> scopes)
+    -> void {
+  if (transaction_depth++ == 0) {
+    transaction_name = name;
+  }
+  transaction_scopes.insert(transaction_scopes.end(),
+                            std::make_move_iterator(scopes.begin()),
+                            std::make_move_iterator(scopes.end()));
+}
+
+auto UndoStackImpl::commit_transaction() -> void {
+  AF_ASSERT_MSG(transaction_depth > 0, "No transaction to commit")
+  if (--transaction_depth > 0) {
+    return;
+  }
+  auto operations = std::exchange(transaction_operations, {});
+  auto scopes = std::exchange(transaction_scopes, {});
+  if (operations.empty()) {
+    return;
+  }
+  pending_operations.emplace_back(std::make_unique<Transaction>(
+      transaction_name, std::move(operations), std::move(scopes)));
+}
+
 auto UndoStackImpl::execute_pending() -> void {
   execute_undo();
   execute_redo();
@@ -46,10 +86,57 @@ auto UndoStackImpl::execute_pending() -> void {
 auto UndoStackImpl::push_operation(Operation item) -> void {
   // Removes anything undone, if there is any
   if (next_undo_idx != static_cast<int>(operations.size() - 1)) {
-    operations.erase(operations.begin() + 1 + next_undo_idx, operations.end());
+    erase_operations(next_undo_idx + 1, operations.size());
+  }
+  const auto now = std::chrono::steady_clock::now();
+  const auto can_merge = !operations.empty() && last_push.has_value() &&
+                         now - *last_push < merge_window;
+  last_push = now;
+  if (can_merge && operations.back()->merge(*item)) {
+    memory_usage -= operation_sizes.back();
+    operation_sizes.back() = operations.back()->get_memory_usage();
+    memory_usage += operation_sizes.back();
+  } else {
+    operation_sizes.push_back(item->get_memory_usage());
+    memory_usage += operation_sizes.back();
+    operations.emplace_back(std::move(item));
   }
-  operations.emplace_back(std::move(item));
   next_undo_idx = static_cast<int>(operations.size() - 1);
+  trim();
+}
+
+auto UndoStackImpl::erase_operations(size_t begin, size_t end) -> void {
+  for (auto i = begin; i < end; ++i) {
+    memory_usage -= operation_sizes[i];
+  }
+  operations.erase(operations.begin() + static_cast<ptrdiff_t>(begin),
+                   operations.begin() + static_cast<ptrdiff_t>(end));
+  operation_sizes.erase(
+      operation_sizes.begin() + static_cast<ptrdiff_t>(begin),
+      operation_sizes.begin() + static_cast<ptrdiff_t>(end));
+}
+
+auto UndoStackImpl::trim() -> void {
+  if (memory_usage <= memory_budget) {
+    return;
+  }
+  // Drops down to 3/4 of the budget, so operations are erased in batches
+  // rather than one per push. Only operations that are done can go, the
+  // most recent of them is kept.
+  const auto target = memory_budget / 4 * 3;
+  auto usage = memory_usage;
+  auto count = size_t{0};
+  while (usage > target && static_cast<int>(count) < next_undo_idx) {
+    usage -= operation_sizes[count];
+    ++count;
+  }
+  erase_operations(0, count);
+  next_undo_idx -= static_cast<int>(count);
+}
+
+auto UndoStackImpl::set_memory_budget(size_t bytes) -> void {
+  memory_budget = bytes;
+  trim();
 }
 
 auto UndoStackImpl::get_operations() const -> const std::vector<Operation>& {
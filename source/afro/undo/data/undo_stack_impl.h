@@ -2,24 +2,55 @@
 
 #include <fruit/fruit.h>
 
+#include <chrono>
+#include <cstddef>
 #include <deque>
+#include <optional>
+#include <string_view>
+#include <vector>
 
 #include "undo/interfaces/undo_stack.h"
 
 namespace afro::undo {
+/**
+ * @brief Undo history bounded by the memory its operations keep alive.
+ *
+ * An operation executed within the merge window of the previous one is
+ * merged into it if the previous one accepts it, so e.g. dragging a slider
+ * is undone in one step. Once the operations take more than the memory
+ * budget, the oldest are dropped until they take 3/4 of it.
+ */
 class UndoStackImpl : public UndoStack {
+ public:
+  static constexpr size_t DEFAULT_MEMORY_BUDGET = size_t{64} << 20;
+  static constexpr std::chrono::milliseconds DEFAULT_MERGE_WINDOW{500};
+
  private:
   std::vector<Operation> operations;
+  // Memory usage of each operation when it was pushed or last merged into.
+  std::vector<size_t> operation_sizes;
+  size_t memory_usage = 0;
+  size_t memory_budget = DEFAULT_MEMORY_BUDGET;
+  std::chrono::steady_clock::duration merge_window = DEFAULT_MERGE_WINDOW;
+  // When the last operation was pushed, reset by undo and redo so nothing
+  // is merged into an operation that was undone or redone.
+  std::optional<std::chrono::steady_clock::time_point> last_push;
   std::deque<Operation> pending_operations;
+  // The open transaction, see begin_transaction().
+  int transaction_depth = 0;
+  std::string_view transaction_name;
+  std::vector<Operation> transaction_operations;
+  std::vector<std::shared_ptr<Transactional>> transaction_scopes;
   int next_undo_idx = -1;
   // Amount of undo operations to be undone on next main loop iteration.
   int undo_depth = 0;
   // Amount of redo operations to be redone on next main loop iteration.
   int redo_depth = 0;
-  const int max_undo = 100;
   auto execute_undo() -> void;
   auto execute_redo() -> void;
   auto push_operation(Operation item) -> void;
+  auto erase_operations(size_t begin, size_t end) -> void;
+  auto trim() -> void;
 
  public:
   INJECT(UndoStackImpl()) {}
@@ -28,8 +59,29 @@ class UndoStackImpl : public UndoStack {
   auto has_undo() const -> bool override;
   auto has_redo() const -> bool override;
   auto enqueue(Operation item) -> void override;
+  auto begin_transaction(
+      std::string_view name,
+      std::vector<std::shared_ptr<Transactional>> scopes = {})
+      -> void override;
+  auto commit_transaction() -> void override;
   auto execute_pending() -> void override;
   auto get_operations() const -> const std::vector<Operation>& override;
   auto get_next_undo_idx() const -> int override;
+
+  /**
+   * @brief Drops the oldest operations once the history takes more than
+   * @a bytes, the most recent one is always kept.
+   */
+  auto set_memory_budget(size_t bytes) -> void;
+  [[nodiscard]] auto get_memory_usage() const -> size_t {
+    return memory_usage;
+  }
+  /**
+   * @brief Operations executed within @a window of the previous one may be
+   * merged into it, zero disables merging.
+   */
+  auto set_merge_window(std::chrono::steady_clock::duration window) -> void {
+    merge_window = window;
+  }
 };
 }  // namespace afro::undo
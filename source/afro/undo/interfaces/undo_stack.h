@@ -1,8 +1,11 @@
 #pragma once
 
 #include <memory>
+#include <string_view>
+#include <vector>
 
 #include "common/interfaces/command.h"
+#include "common/interfaces/transactional.h"
 
 namespace afro::undo {
 using Operation = std::unique_ptr<Command>;
@@ -24,6 +27,17 @@ class UndoStack {
   virtual auto has_undo() const -> bool = 0;
   virtual auto has_redo() const -> bool = 0;
   virtual auto enqueue(Operation item) -> void = 0;
+  /**
+   * @brief Groups the operations enqueued until the matching
+   * commit_transaction() into one undo step named @a name, which must
+   * outlive it. Each time the step is done or undone it runs within a
+   * transaction of @a scopes. Transactions can be nested, the inner ones
+   * join the outermost one.
+   */
+  virtual auto begin_transaction(
+      std::string_view name,
+      std::vector<std::shared_ptr<Transactional>> scopes = {}) -> void = 0;
+  virtual auto commit_transaction() -> void = 0;
   virtual auto execute_pending() -> void = 0;
   virtual auto get_operations() const -> const std::vector<Operation>& = 0;
   /**
@@ -5,6 +5,7 @@
  */
 
 #include <array>
+#include <cstdlib>
 #include <filesystem>
 #include <string>
 #include <string_view>
@@ -55,7 +56,7 @@ auto data_dir() -> fs::path {
 #if defined(_WIN32)
   auto path = fs::absolute(exe_path().parent_path()) / "data";
 #elif defined(__linux__)
-#error "data_dir() not implemented on this platform"
+  auto path = fs::absolute(exe_path().parent_path()) / "data";
 #elif defined(__APPLE__)
   auto path = fs::absolute(exe_path().parent_path()) / "data";
 #warning "data_dir() not implemented on this platform"
@@ -70,7 +71,7 @@ auto sys_addons_dir() -> fs::path {
 #if defined(_WIN32)
   auto path = data_dir() / "addons";
 #elif defined(__linux__)
-#error "sys_addon_dir() not implemented on this platform"
+  auto path = data_dir() / "addons";
 #elif defined(__APPLE__)
   auto path = data_dir() / "addons";
 #warning "sys_addon_dir() not implemented on this platform"
@@ -107,7 +108,16 @@ auto user_data_path() -> fs::path {
     CoTaskMemFree(buffer);
   }
 #elif defined(__linux__)
-#error "user_data_path() not implemented on this platform"
+  auto version = fmt::format("{}.{}", build_info::MAJOR_VERSION, build_info::MINOR_VERSION);
+  const auto *xdg_config_home = std::getenv("XDG_CONFIG_HOME");
+  const auto *home = std::getenv("HOME");
+  if (xdg_config_home != nullptr && *xdg_config_home != '\0') {
+    path = fs::path(xdg_config_home) / "afro" / version;
+  } else if (home != nullptr) {
+    path = fs::path(home) / ".config" / "afro" / version;
+  } else {
+    path = fs::temp_directory_path() / "afro" / version;
+  }
 #elif defined(__APPLE__)
   auto version = fmt::format("{}.{}", build_info::MAJOR_VERSION, build_info::MINOR_VERSION);
   path = "/Users/leultefera/afro/" + version;
@@ -135,8 +145,8 @@ auto exe_path() -> fs::path {
 
 #elif defined(__linux__)
   std::array<char, PATH_MAX> buffer = {""};
-  ssize_t count = readlink("/proc/self/exe", path, PATH_MAX);
-  if (count != -1) return buffer.data();
+  ssize_t count = readlink("/proc/self/exe", buffer.data(), PATH_MAX - 1);
+  if (count != -1) return std::string(buffer.data(), count);
 
 #elif defined(__APPLE__)
   std::vector<char> buffer;
@@ -147,8 +157,41 @@ auto exe_path() -> fs::path {
   }
   return buffer.data();
 #endif
+  return {};
 }
 
-auto cache_dir() -> fs::path { return ""; }
+auto cache_dir() -> fs::path {
+  fs::path path{""};
+#if defined(_WIN32)
+  PWSTR buffer = nullptr;
+  auto result = SHGetKnownFolderPath(FOLDERID_LocalAppData, KF_FLAG_CREATE, nullptr, &buffer);
+  if (SUCCEEDED(result)) {
+    auto wstr = std::wstring_view(buffer);
+    path = fs::path(wstr.begin(), wstr.end()) / "afro" / "cache";
+    CoTaskMemFree(buffer);
+  }
+#elif defined(__linux__)
+  const auto *xdg_cache_home = std::getenv("XDG_CACHE_HOME");
+  const auto *home = std::getenv("HOME");
+  if (xdg_cache_home != nullptr && *xdg_cache_home != '\0') {
+    path = fs::path(xdg_cache_home) / "afro";
+  } else if (home != nullptr) {
+    path = fs::path(home) / ".cache" / "afro";
+  }
+#elif defined(__APPLE__)
+  const auto *home = std::getenv("HOME");
+  if (home != nullptr) {
+    path = fs::path(home) / "Library" / "Caches" / "afro";
+  }
+#else
+#error "cache_dir() not implemented on this platform"
+#endif
+  // Falls back to a temporary directory, caches can always be rebuilt.
+  if (path.empty()) {
+    path = temp_dir() / "cache";
+  }
+  assure_path(path);
+  return path;
+}
 
 }  // namespace afro::paths
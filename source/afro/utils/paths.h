@@ -53,7 +53,8 @@ auto user_data_path() -> std::filesystem::path;
  */
 auto exe_path() -> std::filesystem::path;
 /**
- * @brief Path of the cache directory
+ * @brief Path of the directory where data that can be rebuilt, e.g. tiled
+ * copies of large images, is stored.
  *
  * @return std::filesystem::path
  */
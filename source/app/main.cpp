@@ -1,19 +1,27 @@
 #include <fruit/fruit.h>
 
+#include <chrono>
+#include <exception>
 #include <memory>
 
 #include "di.h"
+#include "io/autosave.h"
+#include "material_graph/definitions/definitions.h"
 #include "utils/log.h"
+#include "utils/paths.h"
 
 using namespace std;
 using namespace afro;
 
+constexpr auto AUTOSAVE_INTERVAL = chrono::seconds(30);
+
 auto main() -> int {
   log::init_log(log::get_logger(), log::LogLevel::trace);
 
   fruit::Injector<undo::UndoStack, undo::DebugWindow, store::Data,
                   store::Outliner, ui::Window, property::PropertyEditor,
-                  graph::material::MaterialEditor>
+                  graph::material::MaterialEditor,
+                  graph::material::NodeDefinitions>
       injector(get_root_component);
 
   auto* main_window = injector.get<ui::Window*>();
@@ -25,14 +33,53 @@ auto main() -> int {
   main_window->add_widget(
       injector.get<shared_ptr<graph::material::MaterialEditor>>());
 
-  auto graph = make_shared<graph::material::MaterialGraph>();
-  injector.get<shared_ptr<graph::material::MaterialEditor>>()->set_graph(graph);
+  injector.get<shared_ptr<graph::material::MaterialEditor>>()->startup(
+      main_window->create_shared_context());
+
+  // Restores the graphs of the last session, which may have crashed.
+  auto* data = injector.get<store::Data*>();
+  // The editor's definitions, so recovered nodes share them.
+  const auto definitions =
+      injector.get<shared_ptr<graph::material::NodeDefinitions>>();
+  const auto autosave_dir = paths::user_data_path() / "autosave";
+  try {
+    if (auto recovered = io::Autosave::recover(autosave_dir, *definitions)) {
+      for (const auto uuid : recovered->get_graph_uuids()) {
+        data->material_graphs.push_back(recovered->get_graph(uuid));
+      }
+    }
+  } catch (const exception& e) {
+    log::core_error("Can't recover the autosave: {}", e.what());
+  }
+  if (data->material_graphs.empty()) {
+    data->material_graphs.push_back(
+        make_shared<graph::material::MaterialGraph>());
+  }
+  injector.get<shared_ptr<graph::material::MaterialEditor>>()->set_graph(
+      data->material_graphs.front());
+
+  auto autosave = io::Autosave(*definitions, autosave_dir);
+  autosave.startup();
+  // Starts recording the recovered graphs, a part is recorded every frame
+  // until they're complete.
+  autosave.capture(*data);
+  auto last_capture = chrono::steady_clock::now();
 
   auto undo = injector.get<shared_ptr<undo::UndoStack>>();
   while (main_window->draw()) {
     undo->execute_pending();
+    if (const auto now = chrono::steady_clock::now();
+        autosave.is_recording_graphs() ||
+        now - last_capture >= AUTOSAVE_INTERVAL) {
+      autosave.capture(*data);
+      last_capture = now;
+    }
   }
 
+  do {
+    autosave.capture(*data);
+  } while (autosave.is_recording_graphs());
+  autosave.shutdown();
   injector.get<shared_ptr<graph::material::MaterialEditor>>()->shutdown();
 
   main_window->shutdown();
@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "material_graph/engine/material_engine.h"
+#include "synthetic_graph.h"
+
+using namespace afro;
+using namespace afro::bench;
+using namespace afro::graph::material;
+using afro::graph::generator::Shape;
+
+// Updates only run no-op exec funs, so no GL context is needed.
+
+static void BM_EngineTopologicalSortChain(benchmark::State& state) {
+  auto chain = generate(Shape::CHAIN, static_cast<int>(state.range(0)));
+  auto engine = MaterialEngine();
+  engine.set_graph(chain.graph);
+  for (auto _ : state) {
+    auto sorted = engine.get_nodes_topologically_sorted();
+    benchmark::DoNotOptimize(sorted.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_EngineTopologicalSortChain)
+    ->RangeMultiplier(10)
+    ->Range(MIN_NODES, MAX_NODES);
+
+static void BM_EngineTopologicalSortRandomDag(benchmark::State& state) {
+  auto dag = generate(Shape::RANDOM_DAG, static_cast<int>(state.range(0)));
+  auto engine = MaterialEngine();
+  engine.set_graph(dag.graph);
+  for (auto _ : state) {
+    auto sorted = engine.get_nodes_topologically_sorted();
+    benchmark::DoNotOptimize(sorted.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_EngineTopologicalSortRandomDag)
+    ->RangeMultiplier(10)
+    ->Range(MIN_NODES, MAX_NODES);
+
+// Only stamps the root, the nodes below it find out when they are checked.
+static void BM_EngineMarkDirtyDiamonds(benchmark::State& state) {
+  auto diamonds = generate(Shape::DIAMONDS, static_cast<int>(state.range(0)));
+  auto engine = MaterialEngine();
+  engine.set_graph(diamonds.graph);
+  const auto root = diamonds.nodes.front()->get_uuid();
+  for (auto _ : state) {
+    engine.on_node_changed(root);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_EngineMarkDirtyDiamonds)
+    ->RangeMultiplier(10)
+    ->Range(MIN_NODES, MAX_NODES);
+
+static void BM_EngineMarkDirtyChain(benchmark::State& state) {
+  auto chain = generate(Shape::CHAIN, static_cast<int>(state.range(0)));
+  auto engine = MaterialEngine();
+  engine.set_graph(chain.graph);
+  const auto root = chain.nodes.front()->get_uuid();
+  for (auto _ : state) {
+    engine.on_node_changed(root);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_EngineMarkDirtyChain)
+    ->RangeMultiplier(10)
+    ->Range(MIN_NODES, MAX_NODES);
+
+// Every node re-runs a no-op exec fun, this is the engine's own overhead per
+// executed node.
+static void BM_EngineUpdateChain(benchmark::State& state) {
+  const auto definition = make_node_definition(
+      1, [](MaterialEngine*, MaterialGraph*, MaterialNode*) {});
+  auto graph = std::make_shared<MaterialGraph>();
+  auto nodes = std::vector<std::shared_ptr<MaterialNode>>();
+  for (int i = 0; i < state.range(0); ++i) {
+    nodes.push_back(MaterialNode::create(definition));
+    graph->add_node(nodes.back());
+    if (i > 0) {
+      graph->add_link(make_link(*nodes[i - 1], *nodes[i]));
+    }
+  }
+  auto engine = MaterialEngine();
+  engine.set_graph(graph);
+  engine.update();
+  const auto root = nodes.front()->get_uuid();
+  for (auto _ : state) {
+    engine.on_node_changed(root);
+    engine.update();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_EngineUpdateChain)
+    ->RangeMultiplier(10)
+    ->Range(MIN_NODES, MAX_NODES);
@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <random>
+
+#include "synthetic_graph.h"
+
+using namespace afro;
+using namespace afro::bench;
+using namespace afro::graph::material;
+using afro::graph::generator::Shape;
+
+static void BM_GraphAddNode(benchmark::State& state) {
+  const auto count = static_cast<int>(state.range(0));
+  auto nodes = make_nodes(count, 1);
+  for (auto _ : state) {
+    auto graph = MaterialGraph();
+    for (auto& node : nodes) {
+      graph.add_node(node);
+    }
+    benchmark::DoNotOptimize(graph.get_nodes().data());
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_GraphAddNode)->RangeMultiplier(10)->Range(MIN_NODES, MAX_NODES);
+
+static void BM_GraphAddLink(benchmark::State& state) {
+  const auto count = static_cast<int>(state.range(0));
+  auto nodes = make_nodes(count, 1);
+  auto links = std::vector<graph::Link>();
+  for (int i = 1; i < count; ++i) {
+    links.push_back(make_link(*nodes[i - 1], *nodes[i]));
+  }
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto graph = MaterialGraph();
+    for (auto& node : nodes) {
+      graph.add_node(node);
+    }
+    state.ResumeTiming();
+    for (auto& link : links) {
+      graph.add_link(link);
+    }
+    benchmark::DoNotOptimize(graph.get_links().data());
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<int64_t>(links.size()));
+}
+BENCHMARK(BM_GraphAddLink)->RangeMultiplier(10)->Range(MIN_NODES, MAX_NODES);
+
+static void BM_GraphRemoveLink(benchmark::State& state) {
+  const auto count = static_cast<int>(state.range(0));
+  auto chain = generate(Shape::CHAIN, count);
+  auto links = chain.graph->get_links();
+  // Removes in random order so the position of the link in the graph doesn't
+  // favour one implementation.
+  std::shuffle(links.begin(), links.end(), std::mt19937_64(SEED));
+  for (auto _ : state) {
+    for (auto& link : links) {
+      chain.graph->remove_link(link);
+    }
+    state.PauseTiming();
+    chain.graph->add_links(links);
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<int64_t>(links.size()));
+}
+BENCHMARK(BM_GraphRemoveLink)
+    ->RangeMultiplier(10)
+    ->Range(MIN_NODES, MAX_QUADRATIC_NODES);
+
+// Like BM_GraphRemoveLink but in one transaction, as DeleteLinks does.
+static void BM_GraphRemoveLinks(benchmark::State& state) {
+  const auto count = static_cast<int>(state.range(0));
+  auto chain = generate(Shape::CHAIN, count);
+  auto links = chain.graph->get_links();
+  std::shuffle(links.begin(), links.end(), std::mt19937_64(SEED));
+  for (auto _ : state) {
+    chain.graph->remove_links(links);
+    state.PauseTiming();
+    chain.graph->add_links(links);
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<int64_t>(links.size()));
+}
+BENCHMARK(BM_GraphRemoveLinks)
+    ->RangeMultiplier(10)
+    ->Range(MIN_NODES, MAX_NODES);
+
+static void BM_GraphGetLinksToNode(benchmark::State& state) {
+  const auto count = static_cast<int>(state.range(0));
+  auto dag = generate(Shape::RANDOM_DAG, count);
+  auto rng = std::mt19937_64(7);
+  auto pick = std::uniform_int_distribution<int>(0, count - 1);
+  for (auto _ : state) {
+    auto links = dag.graph->get_links_to_node(dag.nodes[pick(rng)]->get_uuid());
+    benchmark::DoNotOptimize(links.data());
+  }
+}
+BENCHMARK(BM_GraphGetLinksToNode)
+    ->RangeMultiplier(10)
+    ->Range(MIN_NODES, MAX_NODES);
+
+// A frame that moves one node of a graph of range(0) nodes and takes a
+// snapshot, which only copies that node.
+static void BM_GraphSnapshot(benchmark::State& state) {
+  const auto count = static_cast<int>(state.range(0));
+  auto dag = generate(Shape::RANDOM_DAG, count);
+  dag.graph->snapshot();
+  auto& node = *dag.nodes.front();
+  for (auto _ : state) {
+    node.set_position({node.position.x + 1.0F, node.position.y});
+    benchmark::DoNotOptimize(dag.graph->snapshot());
+  }
+}
+BENCHMARK(BM_GraphSnapshot)
+    ->RangeMultiplier(10)
+    ->Range(MIN_NODES, MAX_NODES)
+    ->Unit(benchmark::kMicrosecond);
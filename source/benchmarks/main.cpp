@@ -0,0 +1,162 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ *
+ * Runs the registered benchmarks. Besides the usual Google Benchmark flags
+ * (--benchmark_filter, --benchmark_out=<file> --benchmark_out_format=json,
+ * ...) it accepts:
+ *   --save_baseline=<file>  Writes the per benchmark real time to <file>.
+ *   --baseline=<file>       Compares against a saved baseline and exits with
+ *                           1 if any benchmark got slower than the threshold.
+ *   --threshold=<ratio>     Allowed slowdown before a benchmark counts as a
+ *                           regression, defaults to 0.1 (10%).
+ */
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+
+#include <cereal/archives/json.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "utils/log.h"
+
+namespace {
+constexpr double DEFAULT_THRESHOLD = 0.1;
+
+struct BenchTiming {
+  std::string name;
+  double nanoseconds = 0;
+
+  template <class Archive>
+  void serialize(Archive& archive) {
+    archive(cereal::make_nvp("name", name),
+            cereal::make_nvp("ns", nanoseconds));
+  }
+};
+
+/**
+ * @brief Prints to the console as usual and records the real time of every
+ * run. With --benchmark_repetitions the median is recorded.
+ */
+class RecordingReporter : public benchmark::ConsoleReporter {
+ public:
+  std::map<std::string, double> timings;
+
+  void ReportRuns(const std::vector<Run>& runs) override {
+    for (const auto& run : runs) {
+      if (run.run_type == Run::RT_Aggregate && run.aggregate_name != "median") {
+        continue;
+      }
+      timings[run.benchmark_name()] =
+          run.GetAdjustedRealTime() * 1e9 /
+          benchmark::GetTimeUnitMultiplier(run.time_unit);
+    }
+    ConsoleReporter::ReportRuns(runs);
+  }
+};
+
+auto load_baseline(const std::string& path) -> std::vector<BenchTiming> {
+  auto timings = std::vector<BenchTiming>();
+  std::ifstream ifs(path);
+  if (!ifs) {
+    throw std::runtime_error(fmt::format("Can't open baseline {}", path));
+  }
+  cereal::JSONInputArchive archive(ifs);
+  archive(cereal::make_nvp("timings", timings));
+  return timings;
+}
+
+auto save_baseline(const std::string& path,
+                   const std::map<std::string, double>& results) -> void {
+  auto timings = std::vector<BenchTiming>();
+  for (const auto& [name, ns] : results) {
+    timings.push_back({name, ns});
+  }
+  std::ofstream ofs(path);
+  cereal::JSONOutputArchive archive(ofs);
+  archive(cereal::make_nvp("timings", timings));
+}
+
+/**
+ * @return the number of regressions.
+ */
+auto compare(const std::vector<BenchTiming>& baseline,
+             const std::map<std::string, double>& results, double threshold)
+    -> int {
+  int regressions = 0;
+  fmt::print("\n{:<60} {:>14} {:>14} {:>9}\n", "Benchmark", "Baseline (ns)",
+             "Current (ns)", "Change");
+  for (const auto& [name, base_ns] : baseline) {
+    auto iter = results.find(name);
+    if (iter == results.end()) {
+      continue;
+    }
+    const auto change = (iter->second - base_ns) / base_ns;
+    const auto regressed = change > threshold;
+    regressions += regressed ? 1 : 0;
+    fmt::print("{:<60} {:>14.1f} {:>14.1f} {:>+8.1f}%{}\n", name, base_ns,
+               iter->second, change * 100, regressed ? " REGRESSION" : "");
+  }
+  return regressions;
+}
+
+/**
+ * @brief Removes a --name=value flag from argv and returns its value.
+ */
+auto take_flag(int& argc, char** argv, std::string_view name)
+    -> std::optional<std::string> {
+  const auto prefix = fmt::format("--{}=", name);
+  for (int i = 1; i < argc; ++i) {
+    auto arg = std::string_view(argv[i]);
+    if (arg.starts_with(prefix)) {
+      auto value = std::string(arg.substr(prefix.size()));
+      for (int j = i; j < argc - 1; ++j) {
+        argv[j] = argv[j + 1];
+      }
+      --argc;
+      return value;
+    }
+  }
+  return std::nullopt;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  afro::log::init_log(afro::log::get_logger(), afro::log::LogLevel::warn);
+
+  const auto save_path = take_flag(argc, argv, "save_baseline");
+  const auto baseline_path = take_flag(argc, argv, "baseline");
+  const auto threshold = take_flag(argc, argv, "threshold");
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+
+  auto reporter = RecordingReporter();
+  benchmark::RunSpecifiedBenchmarks(&reporter);
+  benchmark::Shutdown();
+
+  if (save_path) {
+    save_baseline(*save_path, reporter.timings);
+  }
+  if (baseline_path) {
+    const auto regressions = compare(
+        load_baseline(*baseline_path), reporter.timings,
+        threshold ? std::atof(threshold->c_str()) : DEFAULT_THRESHOLD);
+    if (regressions != 0) {
+      fmt::print("{} benchmark(s) regressed\n", regressions);
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,84 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/pixel_convert.h"
+
+using namespace afro::core;
+
+namespace {
+constexpr size_t PIXEL_COUNT = size_t{1024} * 1024;
+
+struct Conversion {
+  const char* name;
+  PixelFormat from;
+  PixelFormat to;
+};
+
+// Imports, readbacks and exports.
+const std::array<Conversion, 6> CONVERSIONS = {
+    Conversion{"srgba8_to_rgba32f", formats::srgba8, formats::rgba32f},
+    Conversion{"rgba32f_to_srgba8", formats::rgba32f, formats::srgba8},
+    Conversion{"rgba16f_to_rgba32f", formats::rgba16f, formats::rgba32f},
+    Conversion{"rgba32f_to_rgba16", formats::rgba32f, formats::rgba16},
+    Conversion{"rgb8_to_rgba8", formats::rgb8, formats::rgba8},
+    Conversion{"rgba32f_premultiply", formats::rgba32f,
+               PixelFormat{4, ChannelType::FLOAT32, ColorSpace::LINEAR,
+                           true}}};
+
+const std::array<const char*, 4> LEVEL_NAMES = {"scalar", "sse4", "avx2",
+                                                "avx512"};
+}  // namespace
+
+// Converts a 1024x1024 image with the kernels of each SimdLevel, the
+// scalar ones being the baseline.
+static void BM_ConvertPixels(benchmark::State& state) {
+  const auto& conversion = CONVERSIONS.at(state.range(0));
+  const auto level = static_cast<SimdLevel>(state.range(1));
+  if (level > get_supported_simd_level()) {
+    state.SkipWithError("Not supported by this CPU");
+    return;
+  }
+  auto source =
+      std::vector<uint8_t>(PIXEL_COUNT * conversion.from.get_pixel_size());
+  for (size_t i = 0; i < source.size(); ++i) {
+    source[i] = static_cast<uint8_t>(i * 7);
+  }
+  // Float sources get values in [0, 1].
+  if (conversion.from.type == ChannelType::FLOAT32) {
+    auto* values = reinterpret_cast<float*>(source.data());
+    for (size_t i = 0; i < source.size() / sizeof(float); ++i) {
+      values[i] = static_cast<float>(i % 1000) / 1000.0F;
+    }
+  }
+  auto destination =
+      std::vector<uint8_t>(PIXEL_COUNT * conversion.to.get_pixel_size());
+  set_simd_level(level);
+  for (auto _ : state) {
+    convert_pixels(source.data(), conversion.from, destination.data(),
+                   conversion.to, PIXEL_COUNT);
+    benchmark::DoNotOptimize(destination.data());
+    benchmark::ClobberMemory();
+  }
+  set_simd_level(get_supported_simd_level());
+  state.SetLabel(std::string(conversion.name) + "/" +
+                 LEVEL_NAMES.at(state.range(1)));
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<int64_t>(PIXEL_COUNT));
+  state.SetBytesProcessed(
+      state.iterations() *
+      static_cast<int64_t>(source.size() + destination.size()));
+}
+BENCHMARK(BM_ConvertPixels)
+    ->ArgsProduct({benchmark::CreateDenseRange(0, CONVERSIONS.size() - 1, 1),
+                   benchmark::CreateDenseRange(0, 3, 1)})
+    ->Unit(benchmark::kMillisecond);
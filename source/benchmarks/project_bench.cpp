@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <random>
+#include <vector>
+
+#include "io/autosave.h"
+#include "io/project.h"
+#include "synthetic_graph.h"
+
+using namespace afro;
+using namespace afro::bench;
+using afro::graph::generator::Shape;
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr size_t ASSET_SIZE = size_t{64} << 20;
+constexpr int GRAPH_COUNT = 100;
+constexpr int GRAPH_NODES = 1000;
+
+// A project of GRAPH_COUNT graphs and @a size bytes of packed files, which
+// don't compress so the file is as big.
+auto write_project(const fs::path& path, size_t size) -> void {
+  auto project = io::Project(get_definitions());
+  for (int i = 0; i < GRAPH_COUNT; ++i) {
+    project.add_graph(generate(Shape::RANDOM_DAG, GRAPH_NODES).graph);
+  }
+  auto bytes = std::vector<uint8_t>(ASSET_SIZE);
+  auto random = std::mt19937_64(SEED);
+  for (auto& byte : bytes) {
+    byte = static_cast<uint8_t>(random());
+  }
+  // Chunks are shared in memory, each packed file still writes its own.
+  const auto file = core::PackedFile(bytes);
+  for (size_t i = 0; i < size / ASSET_SIZE; ++i) {
+    project.add_asset(i + 1, {"noise.raw", file});
+  }
+  project.save_as(path);
+}
+}  // namespace
+
+// Opens a project of range(0) MiB, which only reads its table of contents.
+static void BM_OpenProject(benchmark::State& state) {
+  const auto path = fs::temp_directory_path() / "afro_bench_project.afro";
+  write_project(path, static_cast<size_t>(state.range(0)) << 20);
+  for (auto _ : state) {
+    auto project = io::Project::open(path, get_definitions());
+    benchmark::DoNotOptimize(project.get_graph_uuids());
+  }
+  state.counters["file_mb"] =
+      static_cast<double>(fs::file_size(path)) / (1 << 20);
+  fs::remove(path);
+}
+BENCHMARK(BM_OpenProject)
+    ->RangeMultiplier(4)
+    ->Range(128, 2048)
+    ->Unit(benchmark::kMillisecond);
+
+// Opens a project and loads one of its graphs.
+static void BM_OpenProjectGraph(benchmark::State& state) {
+  const auto path = fs::temp_directory_path() / "afro_bench_project.afro";
+  write_project(path, ASSET_SIZE);
+  for (auto _ : state) {
+    auto project = io::Project::open(path, get_definitions());
+    benchmark::DoNotOptimize(
+        project.get_graph(project.get_graph_uuids().front()));
+  }
+  fs::remove(path);
+}
+BENCHMARK(BM_OpenProjectGraph)->Unit(benchmark::kMillisecond);
+
+// Captures a node of a graph of range(0) nodes being dragged, which is the
+// autosave work done on the UI thread.
+static void BM_AutosaveCapture(benchmark::State& state) {
+  const auto directory = fs::temp_directory_path() / "afro_bench_autosave";
+  auto data = store::Data();
+  auto generated =
+      generate(Shape::RANDOM_DAG, static_cast<int>(state.range(0)));
+  data.material_graphs.push_back(generated.graph);
+  auto autosave = io::Autosave(get_definitions(), directory);
+  autosave.startup();
+  autosave.capture(data);
+  auto& node = *generated.nodes.front();
+  for (auto _ : state) {
+    node.set_position({node.position.x + 1.0F, node.position.y});
+    autosave.capture(data);
+  }
+  autosave.shutdown();
+  fs::remove_all(directory);
+}
+BENCHMARK(BM_AutosaveCapture)
+    ->RangeMultiplier(10)
+    ->Range(MIN_NODES, MAX_NODES)
+    ->Unit(benchmark::kMicrosecond);
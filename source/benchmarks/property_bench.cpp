@@ -0,0 +1,47 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "curve/data/curve.h"
+#include "property/data/property.h"
+
+using namespace afro;
+
+static void BM_PropertySetFanOut(benchmark::State& state) {
+  auto prop = property::Property(property::PropertyDefinition(
+      "value", "Value", "Empty desc", property::Type::INPUT,
+      property::ValueType::FLOAT, property::ValueUnit::NONE, true, false,
+      0.0F));
+  int64_t calls = 0;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    prop.on_value_changed.connect([&calls](property::Property&) { ++calls; });
+  }
+  float value = 0.0F;
+  for (auto _ : state) {
+    prop.set(value);
+    value += 1.0F;
+  }
+  benchmark::DoNotOptimize(calls);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PropertySetFanOut)->RangeMultiplier(4)->Range(1, 1024);
+
+static void BM_BezierSplineLut(benchmark::State& state) {
+  auto spline = curve::BezierSpline();
+  // An S shaped curve with a few segments.
+  spline.points = {{{0.0F, 0.0F}, {0.0F, 0.0F}, {0.1F, 0.0F}},
+                   {{0.2F, 0.3F}, {0.3F, 0.3F}, {0.4F, 0.3F}},
+                   {{0.5F, 0.6F}, {0.6F, 0.6F}, {0.7F, 0.6F}},
+                   {{0.9F, 1.0F}, {1.0F, 1.0F}, {1.0F, 1.0F}}};
+  spline.sort();
+  for (auto _ : state) {
+    auto lut = spline.lut(static_cast<int>(state.range(0)));
+    benchmark::DoNotOptimize(lut.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BezierSplineLut)->RangeMultiplier(4)->Range(16, 4096);
@@ -0,0 +1,63 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "synthetic_graph.h"
+
+#include <fmt/format.h>
+
+namespace afro::bench {
+using namespace graph::material;
+
+auto make_node_definition(int inputs, MaterialNodeExecFun on_execute)
+    -> MaterialNodeDefinition {
+  auto props = std::vector<property::PropertyDefinition>();
+  for (int i = 0; i < inputs; ++i) {
+    props.emplace_back(fmt::format("socket{}", i), "Socket", "Empty desc",
+                       property::Type::INPUT, property::ValueType::FLOAT_4,
+                       property::ValueUnit::COLOR, true, false, FVec4{});
+  }
+  props.emplace_back("_output", "Output", "Empty desc", property::Type::OUTPUT,
+                     property::ValueType::FLOAT_4, property::ValueUnit::COLOR,
+                     true, false, FVec4{});
+  return {fmt::format("bench_node_{}", inputs), "Bench Node", props, "",
+          ui::Icon::NONE, std::move(on_execute)};
+}
+
+auto get_definitions() -> const std::vector<MaterialNodeDefinition>& {
+  static const auto definitions = std::vector<MaterialNodeDefinition>{
+      make_node_definition(0), make_node_definition(1),
+      make_node_definition(2)};
+  return definitions;
+}
+
+auto make_nodes(int count, int inputs)
+    -> std::vector<std::shared_ptr<MaterialNode>> {
+  const auto definition = make_node_definition(inputs);
+  auto nodes = std::vector<std::shared_ptr<MaterialNode>>();
+  nodes.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    nodes.push_back(MaterialNode::create(definition));
+  }
+  return nodes;
+}
+
+auto make_link(MaterialNode& from, MaterialNode& to, int input) -> graph::Link {
+  return {{from.get_uuid(), from.get_properties().back().get_uuid()},
+          {to.get_uuid(), to.get_properties()[input].get_uuid()}};
+}
+
+auto generate(graph::generator::Shape shape, int count)
+    -> graph::generator::GeneratedGraph {
+  auto options = graph::generator::GeneratorOptions();
+  options.shape = shape;
+  options.node_count = count;
+  options.seed = SEED;
+  options.mean_in_degree = 2.0;
+  return graph::generator::build_graph(
+      graph::generator::generate(options, get_definitions()),
+      get_definitions());
+}
+}  // namespace afro::bench
@@ -0,0 +1,50 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "graph_generator.h"
+#include "material_graph/data/material_graph.h"
+
+namespace afro::bench {
+constexpr int MIN_NODES = 10;
+constexpr int MAX_NODES = 100000;
+// Paths that scan all links for every link they touch are capped so a full
+// run stays in the range of minutes.
+constexpr int MAX_QUADRATIC_NODES = 10000;
+constexpr uint64_t SEED = 42;
+
+/**
+ * @brief A node definition with @a inputs socket inputs and a single output.
+ * It has no shader so graphs built from it can only be executed with
+ * @a on_execute.
+ */
+auto make_node_definition(int inputs,
+                          graph::material::MaterialNodeExecFun on_execute = {})
+    -> graph::material::MaterialNodeDefinition;
+
+/**
+ * @brief Node definitions with zero, one and two sockets.
+ */
+auto get_definitions()
+    -> const std::vector<graph::material::MaterialNodeDefinition>&;
+
+auto make_nodes(int count, int inputs)
+    -> std::vector<std::shared_ptr<graph::material::MaterialNode>>;
+
+auto make_link(graph::material::MaterialNode& from,
+               graph::material::MaterialNode& to, int input = 0) -> graph::Link;
+
+/**
+ * @brief Generates a graph of @a count nodes from get_definitions(). Random
+ * DAGs link two sockets per node on average.
+ */
+auto generate(graph::generator::Shape shape, int count)
+    -> graph::generator::GeneratedGraph;
+}  // namespace afro::bench
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+
+#include "common/interfaces/command.h"
+#include "synthetic_graph.h"
+#include "undo/data/undo_stack_impl.h"
+
+using namespace afro;
+using namespace afro::bench;
+
+namespace {
+struct CounterCommand : Command {
+  int64_t& counter;
+  explicit CounterCommand(int64_t& counter)
+      : Command("CounterCommand"), counter(counter) {}
+  auto execute() -> void override { ++counter; }
+  auto undo() -> void override { --counter; }
+};
+
+auto fill_history(undo::UndoStackImpl& stack, int64_t& counter, int64_t size)
+    -> void {
+  for (int64_t i = 0; i < size; ++i) {
+    stack.enqueue(std::make_unique<CounterCommand>(counter));
+  }
+  stack.execute_pending();
+}
+}  // namespace
+
+static void BM_UndoExecutePending(benchmark::State& state) {
+  int64_t counter = 0;
+  auto stack = undo::UndoStackImpl();
+  fill_history(stack, counter, state.range(0));
+  for (auto _ : state) {
+    stack.enqueue(std::make_unique<CounterCommand>(counter));
+    stack.execute_pending();
+  }
+  benchmark::DoNotOptimize(counter);
+}
+BENCHMARK(BM_UndoExecutePending)
+    ->RangeMultiplier(10)
+    ->Range(MIN_NODES, MAX_NODES);
+
+// Undo one step then push, which drops the redo tail every iteration.
+static void BM_UndoExecutePendingAfterUndo(benchmark::State& state) {
+  int64_t counter = 0;
+  auto stack = undo::UndoStackImpl();
+  fill_history(stack, counter, state.range(0));
+  for (auto _ : state) {
+    stack.undo(1);
+    stack.enqueue(std::make_unique<CounterCommand>(counter));
+    stack.execute_pending();
+  }
+  benchmark::DoNotOptimize(counter);
+}
+BENCHMARK(BM_UndoExecutePendingAfterUndo)
+    ->RangeMultiplier(10)
+    ->Range(MIN_NODES, MAX_NODES);
+
+static void BM_UndoRedoRoundTrip(benchmark::State& state) {
+  int64_t counter = 0;
+  auto stack = undo::UndoStackImpl();
+  fill_history(stack, counter, state.range(0));
+  for (auto _ : state) {
+    stack.undo(1);
+    stack.execute_pending();
+    stack.redo(1);
+    stack.execute_pending();
+  }
+  benchmark::DoNotOptimize(counter);
+}
+BENCHMARK(BM_UndoRedoRoundTrip)
+    ->RangeMultiplier(10)
+    ->Range(MIN_NODES, MAX_NODES);
@@ -0,0 +1,388 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "graph_generator.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <cereal/archives/json.hpp>
+#include <cereal/types/map.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace afro::graph::generator {
+using material::MaterialNode;
+using material::MaterialNodeDefinition;
+
+template <class Archive>
+void NodeDescription::serialize(Archive& archive) {
+  archive(cereal::make_nvp("definition", definition_id),
+          cereal::make_nvp("floats", float_values));
+}
+
+template <class Archive>
+void LinkDescription::serialize(Archive& archive) {
+  archive(cereal::make_nvp("from", from_node), cereal::make_nvp("to", to_node),
+          cereal::make_nvp("property", to_property));
+}
+
+template <class Archive>
+void GraphDescription::serialize(Archive& archive) {
+  archive(cereal::make_nvp("nodes", nodes), cereal::make_nvp("links", links));
+}
+
+namespace {
+constexpr int REALISTIC_WINDOW = 16;
+constexpr double REALISTIC_LINK_CHANCE = 0.85;
+constexpr double REALISTIC_EDIT_CHANCE = 0.5;
+// Share of sources, filters (one socket) and blends (two or more sockets).
+constexpr std::array<double, 3> REALISTIC_MIX = {0.25, 0.45, 0.30};
+constexpr int POWER_LAW_TRIES = 8;
+constexpr float LAYOUT_COLUMN_WIDTH = 220.0F;
+constexpr float LAYOUT_ROW_HEIGHT = 140.0F;
+
+struct DefinitionInfo {
+  const MaterialNodeDefinition* definition;
+  std::vector<std::string> sockets;
+};
+
+auto get_sockets(const MaterialNodeDefinition& definition)
+    -> std::vector<std::string> {
+  auto sockets = std::vector<std::string>();
+  for (const auto& prop_def : definition.get_prop_definitions()) {
+    if (prop_def.type == property::Type::INPUT && prop_def.is_socket) {
+      sockets.push_back(prop_def.id);
+    }
+  }
+  return sockets;
+}
+
+class Generator {
+ private:
+  const GeneratorOptions& options;
+  std::mt19937_64 rng;
+  std::vector<DefinitionInfo> infos;
+  // Definition of every node added so far.
+  std::vector<const DefinitionInfo*> node_infos;
+  // Every node once plus once per link from it, picking an element uniformly
+  // picks nodes proportional to their out degree.
+  std::vector<int> attachment;
+  GraphDescription description;
+
+  auto chance(double probability) -> bool {
+    return std::bernoulli_distribution(probability)(rng);
+  }
+
+  auto uniform(int low, int high) -> int {
+    return std::uniform_int_distribution<int>(low, high)(rng);
+  }
+
+  auto find_definition(int min_sockets, int max_sockets)
+      -> const DefinitionInfo* {
+    auto candidates = std::vector<const DefinitionInfo*>();
+    for (const auto& info : infos) {
+      const auto count = static_cast<int>(info.sockets.size());
+      if (count >= min_sockets && count <= max_sockets) {
+        candidates.push_back(&info);
+      }
+    }
+    if (candidates.empty()) {
+      return nullptr;
+    }
+    return candidates[uniform(0, static_cast<int>(candidates.size()) - 1)];
+  }
+
+  auto pick_definition(int min_sockets) -> const DefinitionInfo& {
+    const auto* info =
+        find_definition(min_sockets, std::numeric_limits<int>::max());
+    if (info == nullptr) {
+      throw std::runtime_error(fmt::format(
+          "No node definition with at least {} sockets", min_sockets));
+    }
+    return *info;
+  }
+
+  // Prefers definitions without sockets but takes anything if there are none.
+  auto pick_source_definition() -> const DefinitionInfo& {
+    const auto* info = find_definition(0, 0);
+    return info != nullptr ? *info : pick_definition(0);
+  }
+
+  auto add_node(const DefinitionInfo& info) -> int {
+    description.nodes.push_back({info.definition->get_id(), {}});
+    node_infos.push_back(&info);
+    const auto index = static_cast<int>(description.nodes.size()) - 1;
+    attachment.push_back(index);
+    return index;
+  }
+
+  auto link(int from, int to, int socket) -> void {
+    description.links.push_back(
+        {from, to, node_infos[to]->sockets[socket]});
+    attachment.push_back(from);
+  }
+
+  auto pick_from(int to, int window) -> int {
+    const auto low = window > 0 ? std::max(0, to - window) : 0;
+    if (options.distribution == DegreeDistribution::POWER_LAW) {
+      for (int i = 0; i < POWER_LAW_TRIES; ++i) {
+        const auto from =
+            attachment[uniform(0, static_cast<int>(attachment.size()) - 1)];
+        if (from >= low && from < to) {
+          return from;
+        }
+      }
+    }
+    return uniform(low, to - 1);
+  }
+
+  auto edit_floats(int node) -> void {
+    for (const auto& prop_def :
+         node_infos[node]->definition->get_prop_definitions()) {
+      if (prop_def.value_type != property::ValueType::FLOAT ||
+          !prop_def.min_value || !prop_def.max_value) {
+        continue;
+      }
+      const auto* min = std::get_if<float>(&*prop_def.min_value);
+      const auto* max = std::get_if<float>(&*prop_def.max_value);
+      if (min == nullptr || max == nullptr || !chance(REALISTIC_EDIT_CHANCE)) {
+        continue;
+      }
+      description.nodes[node].float_values[prop_def.id] =
+          std::uniform_real_distribution<float>(*min, *max)(rng);
+    }
+  }
+
+  auto generate_chain() -> void {
+    add_node(pick_source_definition());
+    for (int i = 1; i < options.node_count; ++i) {
+      link(i - 1, add_node(pick_definition(1)), 0);
+    }
+  }
+
+  auto generate_fan() -> void {
+    add_node(pick_source_definition());
+    for (int i = 1; i < options.node_count; ++i) {
+      link(0, add_node(pick_definition(1)), 0);
+    }
+  }
+
+  auto generate_diamonds() -> void {
+    auto top = add_node(pick_source_definition());
+    while (top + 3 < options.node_count) {
+      const auto left = add_node(pick_definition(1));
+      const auto right = add_node(pick_definition(1));
+      const auto bottom = add_node(pick_definition(2));
+      link(top, left, 0);
+      link(top, right, 0);
+      link(left, bottom, 0);
+      link(right, bottom, 1);
+      top = bottom;
+    }
+    while (static_cast<int>(description.nodes.size()) < options.node_count) {
+      const auto next = add_node(pick_definition(1));
+      link(next - 1, next, 0);
+    }
+  }
+
+  auto generate_random_dag() -> void {
+    auto max_sockets = 0;
+    for (const auto& info : infos) {
+      max_sockets =
+          std::max(max_sockets, static_cast<int>(info.sockets.size()));
+    }
+    auto degree = std::poisson_distribution<int>(
+        std::max(options.mean_in_degree, std::numeric_limits<double>::min()));
+    add_node(pick_source_definition());
+    for (int i = 1; i < options.node_count; ++i) {
+      const auto in_degree = std::min(degree(rng), max_sockets);
+      const auto node = add_node(pick_definition(in_degree));
+      for (int socket = 0; socket < in_degree; ++socket) {
+        link(pick_from(node, options.window), node, socket);
+      }
+    }
+  }
+
+  auto generate_realistic() -> void {
+    const auto window = options.window > 0 ? options.window : REALISTIC_WINDOW;
+    auto kind = std::discrete_distribution<int>(REALISTIC_MIX.begin(),
+                                                REALISTIC_MIX.end());
+    add_node(pick_source_definition());
+    edit_floats(0);
+    for (int i = 1; i < options.node_count; ++i) {
+      const DefinitionInfo* info = nullptr;
+      switch (kind(rng)) {
+        case 0:
+          info = &pick_source_definition();
+          break;
+        case 1:
+          info = find_definition(1, 1);
+          if (info == nullptr) {
+            info = &pick_definition(1);
+          }
+          break;
+        default:
+          info = &pick_definition(2);
+          break;
+      }
+      const auto node = add_node(*info);
+      edit_floats(node);
+      for (int socket = 0; socket < static_cast<int>(info->sockets.size());
+           ++socket) {
+        if (chance(REALISTIC_LINK_CHANCE)) {
+          link(pick_from(node, window), node, socket);
+        }
+      }
+    }
+  }
+
+ public:
+  Generator(const GeneratorOptions& options,
+            const std::vector<MaterialNodeDefinition>& definitions)
+      : options(options), rng(options.seed) {
+    for (const auto& definition : definitions) {
+      infos.push_back({&definition, get_sockets(definition)});
+    }
+  }
+
+  auto run() -> GraphDescription {
+    if (options.node_count <= 0) {
+      return {};
+    }
+    description.nodes.reserve(options.node_count);
+    switch (options.shape) {
+      case Shape::CHAIN:
+        generate_chain();
+        break;
+      case Shape::FAN:
+        generate_fan();
+        break;
+      case Shape::DIAMONDS:
+        generate_diamonds();
+        break;
+      case Shape::RANDOM_DAG:
+        generate_random_dag();
+        break;
+      case Shape::REALISTIC:
+        generate_realistic();
+        break;
+    }
+    return std::move(description);
+  }
+};
+
+auto get_output(MaterialNode& node) -> property::Property& {
+  for (auto& prop : node.get_properties()) {
+    if (prop.get_property_definition().type == property::Type::OUTPUT) {
+      return prop;
+    }
+  }
+  throw std::runtime_error(
+      fmt::format("{} has no output", node.get_definition().get_id()));
+}
+}  // namespace
+
+auto generate(const GeneratorOptions& options,
+              const std::vector<MaterialNodeDefinition>& definitions)
+    -> GraphDescription {
+  return Generator(options, definitions).run();
+}
+
+auto build_graph(const GraphDescription& description,
+                 const std::vector<MaterialNodeDefinition>& definitions)
+    -> GeneratedGraph {
+  auto definitions_by_id =
+      std::unordered_map<std::string, const MaterialNodeDefinition*>();
+  for (const auto& definition : definitions) {
+    definitions_by_id[definition.get_id()] = &definition;
+  }
+
+  auto result = GeneratedGraph{std::make_shared<material::MaterialGraph>(), {}};
+  result.nodes.reserve(description.nodes.size());
+  for (const auto& node_desc : description.nodes) {
+    auto iter = definitions_by_id.find(node_desc.definition_id);
+    if (iter == definitions_by_id.end()) {
+      throw std::runtime_error(
+          fmt::format("Unknown node definition {}", node_desc.definition_id));
+    }
+    auto node = MaterialNode::create(*iter->second);
+    for (const auto& [prop_id, value] : node_desc.float_values) {
+      node->get_property(prop_id).set(value);
+    }
+    result.nodes.push_back(std::move(node));
+  }
+
+  // Lays the nodes out in columns by their distance from the sources.
+  auto depth = std::vector<int>(result.nodes.size(), 0);
+  for (const auto& link_desc : description.links) {
+    depth[link_desc.to_node] =
+        std::max(depth[link_desc.to_node], depth[link_desc.from_node] + 1);
+  }
+  auto column_size = std::unordered_map<int, int>();
+  for (size_t i = 0; i < result.nodes.size(); ++i) {
+    result.nodes[i]->position = {
+        static_cast<float>(depth[i]) * LAYOUT_COLUMN_WIDTH,
+        static_cast<float>(column_size[depth[i]]++) * LAYOUT_ROW_HEIGHT};
+    result.graph->add_node(result.nodes[i]);
+  }
+
+  for (const auto& link_desc : description.links) {
+    auto& from = *result.nodes[link_desc.from_node];
+    auto& to = *result.nodes[link_desc.to_node];
+    auto& to_prop = to.get_property(link_desc.to_property);
+    result.graph->add_link(Link({from.get_uuid(), get_output(from).get_uuid()},
+                                {to.get_uuid(), to_prop.get_uuid()}));
+  }
+  return result;
+}
+
+auto save_description(std::ostream& stream, const GraphDescription& description)
+    -> void {
+  cereal::JSONOutputArchive archive(stream);
+  archive(cereal::make_nvp("graph", description));
+}
+
+auto load_description(std::istream& stream) -> GraphDescription {
+  auto description = GraphDescription();
+  cereal::JSONInputArchive archive(stream);
+  archive(cereal::make_nvp("graph", description));
+  return description;
+}
+
+namespace {
+constexpr std::array<std::pair<Shape, std::string_view>, 5> SHAPE_NAMES = {{
+    {Shape::CHAIN, "chain"},
+    {Shape::FAN, "fan"},
+    {Shape::DIAMONDS, "diamonds"},
+    {Shape::RANDOM_DAG, "random_dag"},
+    {Shape::REALISTIC, "realistic"},
+}};
+}  // namespace
+
+auto parse_shape(std::string_view name) -> std::optional<Shape> {
+  for (const auto& [shape, shape_name] : SHAPE_NAMES) {
+    if (shape_name == name) {
+      return shape;
+    }
+  }
+  return std::nullopt;
+}
+
+auto to_string(Shape shape) -> std::string_view {
+  for (const auto& [value, name] : SHAPE_NAMES) {
+    if (value == shape) {
+      return name;
+    }
+  }
+  return "unknown";
+}
+}  // namespace afro::graph::generator
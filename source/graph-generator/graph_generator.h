@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "material_graph/data/material_graph.h"
+#include "material_graph/data/material_node_definition.h"
+
+namespace afro::graph::generator {
+enum class Shape {
+  // n0 -> n1 -> ... -> n(count - 1)
+  CHAIN,
+  // One source feeding every other node.
+  FAN,
+  // Stacked diamonds, the number of paths doubles with every diamond.
+  DIAMONDS,
+  // Every node links to earlier nodes picked by the degree distribution.
+  RANDOM_DAG,
+  // Sources, filters and blends in the proportions of production materials,
+  // linked mostly to recently added nodes.
+  REALISTIC
+};
+
+enum class DegreeDistribution {
+  // Every earlier node is equally likely to be linked from.
+  UNIFORM,
+  // Earlier nodes are picked proportional to their out degree, which gives
+  // a few hubs feeding many nodes.
+  POWER_LAW
+};
+
+struct GeneratorOptions {
+  Shape shape = Shape::RANDOM_DAG;
+  int node_count = 100;
+  uint64_t seed = 0;
+  // RANDOM_DAG: Average number of linked sockets per node, capped by the
+  // socket count of its definition.
+  double mean_in_degree = 1.5;
+  DegreeDistribution distribution = DegreeDistribution::UNIFORM;
+  // RANDOM_DAG and REALISTIC: How many of the preceding nodes a node may be
+  // linked from, 0 means all of them.
+  int window = 0;
+};
+
+struct NodeDescription {
+  std::string definition_id;
+  // Values of FLOAT properties that differ from the default.
+  std::map<std::string, float> float_values;
+
+  template <class Archive>
+  void serialize(Archive& archive);
+};
+
+struct LinkDescription {
+  int from_node = 0;
+  int to_node = 0;
+  // Definition id of the socket the link ends at.
+  std::string to_property;
+
+  template <class Archive>
+  void serialize(Archive& archive);
+};
+
+/**
+ * @brief A generated graph as plain data. Nodes are in topological order and
+ * links refer to them by index, so it can be stored and built again.
+ */
+struct GraphDescription {
+  std::vector<NodeDescription> nodes;
+  std::vector<LinkDescription> links;
+
+  template <class Archive>
+  void serialize(Archive& archive);
+};
+
+struct GeneratedGraph {
+  std::shared_ptr<material::MaterialGraph> graph;
+  // Same order as GraphDescription::nodes.
+  std::vector<std::shared_ptr<material::MaterialNode>> nodes;
+};
+
+/**
+ * @brief Generates a graph from @a definitions. The same options and
+ * definitions always give the same description.
+ *
+ * @throws std::runtime_error if no definition fits the shape, e.g. DIAMONDS
+ * needs one with two sockets.
+ */
+auto generate(const GeneratorOptions& options,
+              const std::vector<material::MaterialNodeDefinition>& definitions)
+    -> GraphDescription;
+
+auto build_graph(
+    const GraphDescription& description,
+    const std::vector<material::MaterialNodeDefinition>& definitions)
+    -> GeneratedGraph;
+
+auto save_description(std::ostream& stream,
+                      const GraphDescription& description) -> void;
+auto load_description(std::istream& stream) -> GraphDescription;
+
+auto parse_shape(std::string_view name) -> std::optional<Shape>;
+auto to_string(Shape shape) -> std::string_view;
+}  // namespace afro::graph::generator
@@ -0,0 +1,96 @@
+/**
+ * @ingroup Tools
+ * @file main.cpp
+ * @brief graph-generator writes a reproducible synthetic material graph made
+ * of the built in node definitions as JSON.
+ *
+ * graph-generator [--shape=chain|fan|diamonds|random_dag|realistic]
+ *                 [--nodes=N] [--seed=S] [--mean-degree=D] [--window=W]
+ *                 [--power-law] [--out=FILE]
+ *
+ * Without --out the graph is written to stdout, a summary goes to stderr.
+ */
+
+#include <fmt/format.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "graph_generator.h"
+#include "material_graph/definitions/definitions.h"
+
+using namespace afro::graph;
+
+namespace {
+auto get_value(std::string_view arg, std::string_view name)
+    -> std::optional<std::string> {
+  const auto prefix = fmt::format("--{}=", name);
+  if (!arg.starts_with(prefix)) {
+    return std::nullopt;
+  }
+  return std::string(arg.substr(prefix.size()));
+}
+
+auto print_usage() -> void {
+  std::cerr << "Usage: graph-generator "
+               "[--shape=chain|fan|diamonds|random_dag|realistic] [--nodes=N] "
+               "[--seed=S] [--mean-degree=D] [--window=W] [--power-law] "
+               "[--out=FILE]\n";
+}
+}  // namespace
+
+auto main(int argc, char *argv[]) -> int {
+  auto options = generator::GeneratorOptions();
+  auto out_file = std::optional<std::string>();
+
+  for (std::string_view arg : std::span(argv, size_t(argc)).subspan(1)) {
+    if (auto value = get_value(arg, "shape")) {
+      auto shape = generator::parse_shape(*value);
+      if (!shape) {
+        std::cerr << fmt::format("Unknown shape {}\n", *value);
+        return 1;
+      }
+      options.shape = *shape;
+    } else if (auto value = get_value(arg, "nodes")) {
+      options.node_count = std::atoi(value->c_str());
+    } else if (auto value = get_value(arg, "seed")) {
+      options.seed = std::strtoull(value->c_str(), nullptr, 10);
+    } else if (auto value = get_value(arg, "mean-degree")) {
+      options.mean_in_degree = std::atof(value->c_str());
+    } else if (auto value = get_value(arg, "window")) {
+      options.window = std::atoi(value->c_str());
+    } else if (arg == "--power-law") {
+      options.distribution = generator::DegreeDistribution::POWER_LAW;
+    } else if (auto value = get_value(arg, "out")) {
+      out_file = *value;
+    } else {
+      print_usage();
+      return 1;
+    }
+  }
+
+  const auto definitions = material::NodeDefinitions();
+  const auto description = generator::generate(options, definitions);
+
+  if (out_file) {
+    std::ofstream ofs(*out_file);
+    if (!ofs.is_open()) {
+      std::cerr << fmt::format("Unable to open output {}\n", *out_file);
+      return 1;
+    }
+    generator::save_description(ofs, description);
+  } else {
+    generator::save_description(std::cout, description);
+    std::cout << '\n';
+  }
+  std::cerr << fmt::format(
+      "Generated {} graph with seed {}: {} nodes, {} links\n",
+      generator::to_string(options.shape), options.seed,
+      description.nodes.size(), description.links.size());
+  return 0;
+}
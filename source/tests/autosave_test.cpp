@@ -0,0 +1,246 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "io/autosave.h"
+
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include "utils/log.h"
+
+using namespace afro;
+using namespace afro::graph;
+using namespace afro::graph::material;
+using namespace std;
+
+namespace fs = std::filesystem;
+
+namespace {
+auto make_dummy_definition() -> MaterialNodeDefinition {
+  auto props = vector<property::PropertyDefinition>();
+  props.emplace_back("socket0", "Socket", "Empty desc", property::Type::INPUT,
+                     property::ValueType::FLOAT_4, property::ValueUnit::COLOR,
+                     true, false, FVec4{});
+  props.emplace_back("value", "Value", "Empty desc", property::Type::INPUT,
+                     property::ValueType::FLOAT, property::ValueUnit::NONE,
+                     false, true, 0.0F);
+  props.emplace_back("_output", "Output", "Empty desc", property::Type::OUTPUT,
+                     property::ValueType::FLOAT_4, property::ValueUnit::COLOR,
+                     true, false, FVec4{});
+  return {"dummy_node", "Dummy Node", props, "", ui::Icon::NONE};
+}
+
+auto connect(Graph& graph, MaterialNode& from, MaterialNode& to) -> Link {
+  auto link = Link({from.get_uuid(), from.get_property("_output").get_uuid()},
+                   {to.get_uuid(), to.get_property("socket0").get_uuid()});
+  graph.add_link(link);
+  return link;
+}
+
+// A chain of @a count nodes.
+auto make_graph(int count) -> shared_ptr<MaterialGraph> {
+  auto graph = make_shared<MaterialGraph>();
+  auto previous = shared_ptr<MaterialNode>();
+  for (int i = 0; i < count; ++i) {
+    auto node = MaterialNode::create(make_dummy_definition());
+    graph->add_node(node);
+    if (previous != nullptr) {
+      connect(*graph, *previous, *node);
+    }
+    previous = node;
+  }
+  return graph;
+}
+
+auto get_value(Graph& graph, UUID node) -> float {
+  return get<float>(dynamic_pointer_cast<MaterialNode>(
+                        graph.get_node_by_uuid(node))
+                        ->get_property("value")
+                        .get_value());
+}
+
+class AutosaveTest : public testing::Test {
+ protected:
+  fs::path directory;
+
+  void SetUp() override {
+    log::init_log(log::get_logger(), log::LogLevel::warn);
+    const auto* test = testing::UnitTest::GetInstance()->current_test_info();
+    directory = fs::temp_directory_path() /
+                fmt::format("afro_autosave_test_{}", test->name());
+    fs::remove_all(directory);
+  }
+  void TearDown() override { fs::remove_all(directory); }
+
+  auto recover() -> io::Project {
+    auto project =
+        io::Autosave::recover(directory, {make_dummy_definition()});
+    EXPECT_TRUE(project.has_value());
+    return std::move(*project);
+  }
+};
+}  // namespace
+
+TEST_F(AutosaveTest, edits_are_recovered) {
+  auto data = store::Data();
+  auto graph = make_graph(3);
+  data.material_graphs.push_back(graph);
+  auto autosave = io::Autosave({make_dummy_definition()}, directory);
+  autosave.startup();
+  autosave.capture(data);
+
+  auto& nodes = graph->get_nodes();
+  auto first = dynamic_pointer_cast<MaterialNode>(nodes[0]);
+  first->get_property("value").set_value(0.5F);
+  nodes[1]->set_position({4.0F, 2.0F});
+  graph->remove_link(graph->get_links()[0]);
+  auto added = MaterialNode::create(make_dummy_definition());
+  graph->add_node(added);
+  const auto link = connect(*graph, *first, *added);
+  graph->set_output_node(added->get_uuid());
+  autosave.capture(data);
+  autosave.flush();
+
+  // Recovered as if the editor crashed now.
+  auto project = recover();
+  auto recovered = project.get_graph(graph->get_uuid());
+  EXPECT_EQ(recovered->get_nodes().size(), 4);
+  EXPECT_EQ(recovered->get_links().size(), 2);
+  EXPECT_EQ(get_value(*recovered, first->get_uuid()), 0.5F);
+  EXPECT_EQ(recovered->get_node_by_uuid(nodes[1]->get_uuid())->position.x,
+            4.0F);
+  EXPECT_NO_THROW(recovered->get_link_by_uuid(link.get_uuid()));
+  EXPECT_EQ(recovered->get_output_node(), added->get_uuid());
+}
+
+TEST_F(AutosaveTest, journal_is_compacted) {
+  auto data = store::Data();
+  auto graph = make_graph(3);
+  data.material_graphs.push_back(graph);
+  // Compacts after every capture.
+  auto autosave = io::Autosave({make_dummy_definition()}, directory, 1);
+  autosave.startup();
+  autosave.capture(data);
+  auto node = dynamic_pointer_cast<MaterialNode>(graph->get_nodes()[2]);
+  node->get_property("value").set_value(0.25F);
+  autosave.capture(data);
+  autosave.flush();
+
+  EXPECT_TRUE(fs::exists(directory / io::Autosave::PROJECT_NAME));
+  EXPECT_EQ(fs::file_size(directory / io::Autosave::JOURNAL_NAME), 0);
+  auto project = recover();
+  EXPECT_EQ(get_value(*project.get_graph(graph->get_uuid()), node->get_uuid()),
+            0.25F);
+}
+
+TEST_F(AutosaveTest, captures_record_only_changes) {
+  auto data = store::Data();
+  auto graph = make_graph(1000);
+  data.material_graphs.push_back(graph);
+  auto autosave = io::Autosave({make_dummy_definition()}, directory);
+  autosave.startup();
+  do {
+    autosave.capture(data);
+  } while (autosave.is_recording_graphs());
+  autosave.flush();
+  const auto journal = directory / io::Autosave::JOURNAL_NAME;
+  const auto size = fs::file_size(journal);
+
+  // Nothing changed.
+  autosave.capture(data);
+  autosave.flush();
+  EXPECT_EQ(fs::file_size(journal), size);
+
+  auto node = dynamic_pointer_cast<MaterialNode>(graph->get_nodes()[500]);
+  node->get_property("value").set_value(1.0F);
+  autosave.capture(data);
+  autosave.flush();
+  EXPECT_GT(fs::file_size(journal), size);
+  EXPECT_LT(fs::file_size(journal), size + 512);
+}
+
+TEST_F(AutosaveTest, new_graphs_are_recorded_over_captures) {
+  auto data = store::Data();
+  auto graph = make_graph(600);
+  data.material_graphs.push_back(graph);
+  auto autosave = io::Autosave({make_dummy_definition()}, directory);
+  autosave.startup();
+  autosave.capture(data);
+  EXPECT_TRUE(autosave.is_recording_graphs());
+
+  // Edits of recorded and unrecorded nodes and links meanwhile.
+  auto first = dynamic_pointer_cast<MaterialNode>(graph->get_nodes()[0]);
+  auto last = dynamic_pointer_cast<MaterialNode>(graph->get_nodes()[599]);
+  first->get_property("value").set_value(0.5F);
+  last->get_property("value").set_value(0.25F);
+  graph->remove_node_by_uuid(graph->get_nodes()[598]->get_uuid());
+  graph->remove_node_by_uuid(graph->get_nodes()[300]->get_uuid());
+  auto added = MaterialNode::create(make_dummy_definition());
+  graph->add_node(added);
+  connect(*graph, *first, *added);
+  auto captures = 1;
+  while (autosave.is_recording_graphs()) {
+    autosave.capture(data);
+    ++captures;
+  }
+  autosave.flush();
+
+  EXPECT_GT(captures, 2);
+  auto project = recover();
+  auto recovered = project.get_graph(graph->get_uuid());
+  EXPECT_EQ(recovered->get_nodes().size(), graph->get_nodes().size());
+  EXPECT_EQ(recovered->get_links().size(), graph->get_links().size());
+  EXPECT_EQ(get_value(*recovered, first->get_uuid()), 0.5F);
+  EXPECT_EQ(get_value(*recovered, last->get_uuid()), 0.25F);
+  EXPECT_NE(recovered->get_node_by_uuid(added->get_uuid()), nullptr);
+}
+
+TEST_F(AutosaveTest, removed_graphs_are_dropped) {
+  auto data = store::Data();
+  auto graph1 = make_graph(2);
+  auto graph2 = make_graph(2);
+  data.material_graphs = {graph1, graph2};
+  auto autosave = io::Autosave({make_dummy_definition()}, directory);
+  autosave.startup();
+  autosave.capture(data);
+  data.material_graphs.pop_back();
+  autosave.capture(data);
+  autosave.shutdown();
+
+  auto project = recover();
+  EXPECT_EQ(project.get_graph_uuids(), vector<UUID>{graph1->get_uuid()});
+}
+
+TEST_F(AutosaveTest, interrupted_capture_is_skipped) {
+  auto data = store::Data();
+  auto graph = make_graph(2);
+  data.material_graphs.push_back(graph);
+  auto autosave = io::Autosave({make_dummy_definition()}, directory);
+  autosave.startup();
+  autosave.capture(data);
+  autosave.flush();
+  {
+    // The start of a capture that was never finished.
+    auto out = ofstream(directory / io::Autosave::JOURNAL_NAME,
+                        ios::binary | ios::app);
+    const auto size = uint64_t{1000};
+    out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    out << "garbage";
+  }
+
+  auto project = recover();
+  EXPECT_EQ(project.get_graph(graph->get_uuid())->get_nodes().size(), 2);
+}
+
+TEST_F(AutosaveTest, nothing_to_recover) {
+  EXPECT_FALSE(
+      io::Autosave::recover(directory, {make_dummy_definition()}).has_value());
+}
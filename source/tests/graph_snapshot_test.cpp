@@ -0,0 +1,196 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "common/persistent_map.h"
+#include "graph/data/graph.h"
+#include "utils/log.h"
+
+using namespace afro;
+using namespace afro::graph;
+using namespace std;
+
+namespace {
+auto make_node() -> shared_ptr<Node> {
+  auto props = vector<property::Property>();
+  props.emplace_back(property::PropertyDefinition(
+      "value", "Value", "Empty desc", property::Type::INPUT,
+      property::ValueType::FLOAT, property::ValueUnit::NONE, false, true,
+      0.0F));
+  return make_shared<Node>(std::move(props), "Node");
+}
+
+auto connect(Graph& graph, Node& from, Node& to) -> Link {
+  auto link = Link({from.get_uuid(), from.get_properties()[0].get_uuid()},
+                   {to.get_uuid(), to.get_properties()[0].get_uuid()});
+  graph.add_link(link);
+  return link;
+}
+
+// Every key has the same hash, so they all end up in one collision node.
+struct SameHash {
+  auto operator()(int /*key*/) const -> size_t { return 1; }
+};
+
+class GraphSnapshotTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    log::init_log(log::get_logger(), log::LogLevel::warn);
+  }
+};
+}  // namespace
+
+TEST(PersistentMapTest, set_and_erase_keep_old_versions) {
+  auto empty = core::PersistentMap<int, int>();
+  auto map = empty;
+  for (int i = 0; i < 10000; ++i) {
+    map = map.set(i, i * 2);
+  }
+  const auto full = map;
+  for (int i = 0; i < 10000; i += 2) {
+    map = map.erase(i);
+  }
+  map = map.set(1, -1);
+
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(full.size(), 10000);
+  EXPECT_EQ(map.size(), 5000);
+  for (int i = 0; i < 10000; ++i) {
+    ASSERT_NE(full.find(i), nullptr);
+    EXPECT_EQ(*full.find(i), i * 2);
+    EXPECT_EQ(map.contains(i), i % 2 == 1);
+  }
+  EXPECT_EQ(*map.find(1), -1);
+  EXPECT_EQ(map.find(10000), nullptr);
+
+  auto sum = 0;
+  map.for_each([&sum](int /*key*/, int value) { sum += value; });
+  EXPECT_EQ(sum, 5000 * 5000 * 2 - 2 - 1);
+}
+
+TEST(PersistentMapTest, unchanged_maps_are_shared) {
+  const auto map = core::PersistentMap<int, int>().set(1, 1).set(2, 2);
+  EXPECT_TRUE(map.erase(3).is_same(map));
+  EXPECT_FALSE(map.set(1, 1).is_same(map));
+  EXPECT_TRUE(map.erase(1).erase(2).empty());
+}
+
+TEST(PersistentMapTest, keys_with_the_same_hash) {
+  auto map = core::PersistentMap<int, int, SameHash>();
+  for (int i = 0; i < 10; ++i) {
+    map = map.set(i, i);
+  }
+  map = map.erase(4).set(5, 50);
+  EXPECT_EQ(map.size(), 9);
+  EXPECT_FALSE(map.contains(4));
+  EXPECT_EQ(*map.find(5), 50);
+  EXPECT_EQ(*map.find(9), 9);
+}
+
+TEST_F(GraphSnapshotTest, snapshot_matches_graph) {
+  auto graph = Graph();
+  auto first = make_node();
+  auto second = make_node();
+  graph.add_node(first);
+  graph.add_node(second);
+  const auto link = connect(graph, *first, *second);
+  first->get_properties()[0].set_value(0.5F);
+  first->set_position({1.0F, 2.0F});
+
+  const auto snapshot = graph.snapshot();
+  EXPECT_EQ(snapshot->get_uuid(), graph.get_uuid());
+  EXPECT_EQ(snapshot->get_version(), graph.get_version());
+  EXPECT_EQ(snapshot->get_nodes().size(), 2);
+  const auto node = snapshot->get_node(first->get_uuid());
+  ASSERT_NE(node, nullptr);
+  EXPECT_EQ(node->position.x, 1.0F);
+  EXPECT_EQ(get<float>(node->values[0]), 0.5F);
+  EXPECT_EQ(snapshot->get_links().size(), 1);
+  EXPECT_TRUE(snapshot->get_links_to_node(second->get_uuid())
+                  .contains(link.get_uuid()));
+  EXPECT_TRUE(snapshot->get_links_from_node(first->get_uuid())
+                  .contains(link.get_uuid()));
+  EXPECT_TRUE(snapshot->get_links_to_node(first->get_uuid()).empty());
+}
+
+TEST_F(GraphSnapshotTest, snapshots_share_what_did_not_change) {
+  auto graph = Graph();
+  auto nodes = vector<shared_ptr<Node>>();
+  for (int i = 0; i < 100; ++i) {
+    nodes.push_back(make_node());
+    graph.add_node(nodes.back());
+  }
+  const auto link = connect(graph, *nodes[0], *nodes[1]);
+  const auto before = graph.snapshot();
+  EXPECT_EQ(graph.snapshot(), before);
+
+  nodes[5]->get_properties()[0].set_value(1.0F);
+  const auto after = graph.snapshot();
+  EXPECT_NE(after, before);
+  EXPECT_EQ(get<float>(before->get_node(nodes[5]->get_uuid())->values[0]),
+            0.0F);
+  EXPECT_EQ(get<float>(after->get_node(nodes[5]->get_uuid())->values[0]),
+            1.0F);
+  EXPECT_EQ(after->get_node(nodes[6]->get_uuid()),
+            before->get_node(nodes[6]->get_uuid()));
+  EXPECT_TRUE(after->get_links().is_same(before->get_links()));
+
+  graph.remove_link(link);
+  graph.remove_node_by_uuid(nodes[0]->get_uuid());
+  const auto removed = graph.snapshot();
+  EXPECT_EQ(removed->get_nodes().size(), 99);
+  EXPECT_EQ(removed->get_node(nodes[0]->get_uuid()), nullptr);
+  EXPECT_TRUE(removed->get_links().empty());
+  EXPECT_TRUE(removed->get_links_to_node(nodes[1]->get_uuid()).empty());
+  EXPECT_EQ(after->get_links().size(), 1);
+}
+
+TEST_F(GraphSnapshotTest, changes_undone_before_a_snapshot) {
+  auto graph = Graph();
+  auto first = make_node();
+  graph.add_node(first);
+  const auto before = graph.snapshot();
+
+  auto added = make_node();
+  graph.add_node(added);
+  const auto link = connect(graph, *first, *added);
+  graph.remove_link(link);
+  graph.remove_node_by_uuid(added->get_uuid());
+  EXPECT_EQ(graph.snapshot(), before);
+}
+
+TEST_F(GraphSnapshotTest, snapshots_are_read_while_the_graph_changes) {
+  auto graph = Graph();
+  auto nodes = vector<shared_ptr<Node>>();
+  for (int i = 0; i < 100; ++i) {
+    nodes.push_back(make_node());
+    graph.add_node(nodes.back());
+  }
+  auto snapshot = graph.snapshot();
+  auto done = atomic<bool>(false);
+  auto reader = thread([snapshot, &done]() {
+    while (!done) {
+      auto sum = 0.0F;
+      snapshot->get_nodes().for_each([&sum](UUID, const auto& node) {
+        sum += get<float>(node->values[0]);
+      });
+      EXPECT_EQ(sum, 0.0F);
+    }
+  });
+  for (int i = 0; i < 1000; ++i) {
+    nodes[i % nodes.size()]->get_properties()[0].set_value(1.0F);
+    graph.snapshot();
+  }
+  done = true;
+  reader.join();
+  EXPECT_EQ(snapshot->get_nodes().size(), 100);
+}
@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "headless_gl_context.h"
+
+#include <glbinding/gl43core/gl.h>
+#include <glbinding/glbinding.h>
+
+#include <array>
+
+namespace afro::tests {
+namespace {
+class SharedEglContext : public ui::GlContext {
+ private:
+  EGLDisplay display;
+  EGLContext context;
+
+ public:
+  SharedEglContext(EGLDisplay display, EGLContext context)
+      : display(display), context(context) {}
+
+  auto make_current() -> void override {
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+    glbinding::initialize(
+        reinterpret_cast<glbinding::ContextHandle>(context),
+        [](const char *name) { return eglGetProcAddress(name); });
+  }
+
+  auto release_current() -> void override {
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  }
+
+  SharedEglContext(SharedEglContext &) = delete;
+  auto operator=(const SharedEglContext &) -> SharedEglContext & = delete;
+  ~SharedEglContext() override { eglDestroyContext(display, context); }
+};
+
+const auto CONTEXT_ATTRIBS = std::array<EGLint, 7>{
+    EGL_CONTEXT_MAJOR_VERSION,
+    4,
+    EGL_CONTEXT_MINOR_VERSION,
+    3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK,
+    EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE};
+}  // namespace
+
+auto HeadlessGlContext::init() -> bool {
+  display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display == EGL_NO_DISPLAY) {
+    error = "No EGL display";
+    return false;
+  }
+
+  EGLint major = 0;
+  EGLint minor = 0;
+  if (eglInitialize(display, &major, &minor) == EGL_FALSE) {
+    error = "Failed to initialize EGL";
+    display = EGL_NO_DISPLAY;
+    return false;
+  }
+
+  if (eglBindAPI(EGL_OPENGL_API) == EGL_FALSE) {
+    error = "EGL doesn't support desktop OpenGL";
+    deinit();
+    return false;
+  }
+
+  const auto config_attribs = std::array<EGLint, 5>{
+      EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_NONE};
+  EGLint num_configs = 0;
+  if (eglChooseConfig(display, config_attribs.data(), &config, 1,
+                      &num_configs) == EGL_FALSE ||
+      num_configs == 0) {
+    error = "No EGL config with OpenGL support";
+    deinit();
+    return false;
+  }
+
+  context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+                             CONTEXT_ATTRIBS.data());
+  if (context == EGL_NO_CONTEXT) {
+    error = "Failed to create an OpenGL 4.3 core context";
+    deinit();
+    return false;
+  }
+
+  // Requires EGL_KHR_surfaceless_context, render targets are FBOs anyway.
+  if (eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) ==
+      EGL_FALSE) {
+    error = "Failed to make the context current";
+    deinit();
+    return false;
+  }
+
+  glbinding::initialize(
+      [](const char *name) { return eglGetProcAddress(name); });
+  return true;
+}
+
+auto HeadlessGlContext::deinit() -> void {
+  if (display == EGL_NO_DISPLAY) {
+    return;
+  }
+  eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (context != EGL_NO_CONTEXT) {
+    eglDestroyContext(display, context);
+    context = EGL_NO_CONTEXT;
+  }
+  eglTerminate(display);
+  display = EGL_NO_DISPLAY;
+}
+
+auto HeadlessGlContext::create_shared() -> std::unique_ptr<ui::GlContext> {
+  auto *shared =
+      eglCreateContext(display, config, context, CONTEXT_ATTRIBS.data());
+  if (shared == EGL_NO_CONTEXT) {
+    return nullptr;
+  }
+  return std::make_unique<SharedEglContext>(display, shared);
+}
+
+auto HeadlessGlContext::get_renderer() const -> std::string {
+  const auto *renderer = gl::glGetString(gl::GL_RENDERER);
+  return renderer != nullptr ? reinterpret_cast<const char *>(renderer) : "";
+}
+
+HeadlessGlContext::~HeadlessGlContext() { deinit(); }
+}  // namespace afro::tests
@@ -0,0 +1,50 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#pragma once
+
+#include <EGL/egl.h>
+
+#include <memory>
+#include <string>
+
+#include "ui/interfaces/gl_context.h"
+
+namespace afro::tests {
+/**
+ * @brief An OpenGL 4.3 core context without a window. Tests run it on Mesa's
+ * llvmpipe by setting LIBGL_ALWAYS_SOFTWARE and EGL_PLATFORM=surfaceless.
+ */
+class HeadlessGlContext {
+ private:
+  EGLDisplay display = EGL_NO_DISPLAY;
+  EGLConfig config = nullptr;
+  EGLContext context = EGL_NO_CONTEXT;
+  std::string error;
+
+ public:
+  HeadlessGlContext() = default;
+
+  /**
+   * @brief Creates the context, makes it current and initializes glbinding.
+   *
+   * @return false if no suitable EGL display or context could be created.
+   */
+  auto init() -> bool;
+  auto deinit() -> void;
+  /**
+   * @brief A context sharing objects with this one, to render on another
+   * thread. It must be destroyed before this one.
+   */
+  auto create_shared() -> std::unique_ptr<ui::GlContext>;
+  [[nodiscard]] auto get_error() const -> const std::string& { return error; }
+  [[nodiscard]] auto get_renderer() const -> std::string;
+
+  HeadlessGlContext(HeadlessGlContext&) = delete;
+  auto operator=(const HeadlessGlContext&) -> HeadlessGlContext& = delete;
+  ~HeadlessGlContext();
+};
+}  // namespace afro::tests
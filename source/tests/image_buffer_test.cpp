@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+#include "common/image_texture.h"
+#include "common/pixel_convert.h"
+#include "utils/paths.h"
+
+using namespace afro::core;
+
+namespace {
+// A 4x3 R8 image whose pixels are their index.
+auto make_image() -> ImageBuffer {
+  auto image = ImageBuffer(formats::r8, 4, 3);
+  auto* data = image.get_mutable_data();
+  for (uint8_t i = 0; i < 12; ++i) {
+    data[i] = i;
+  }
+  return image;
+}
+}  // namespace
+
+TEST(ImageBufferTest, storage_is_aligned) {
+  const auto image = ImageBuffer(formats::rgb8, 7, 5);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(image.get_data()) %
+                AlignedStorage::ALIGNMENT,
+            0);
+  EXPECT_TRUE(image.is_packed());
+  EXPECT_EQ(image.get_stride(), 21);
+  EXPECT_EQ(image.get_byte_size(), 105);
+}
+
+TEST(ImageBufferTest, copies_share_pixels_until_written) {
+  const auto image = make_image();
+  auto copy = image;
+  EXPECT_EQ(copy.get_data(), image.get_data());
+
+  copy.get_mutable_data()[0] = 100;
+  EXPECT_NE(copy.get_data(), image.get_data());
+  EXPECT_EQ(image.get_data()[0], 0);
+  EXPECT_EQ(copy.get_data()[0], 100);
+  EXPECT_EQ(copy.get_data()[11], 11);
+
+  // The only view writes in place.
+  const auto* data = copy.get_data();
+  copy.get_mutable_data()[1] = 101;
+  EXPECT_EQ(copy.get_data(), data);
+}
+
+TEST(ImageBufferTest, regions_view_the_image) {
+  const auto image = make_image();
+  const auto region = image.get_region(1, 1, 2, 2);
+  EXPECT_EQ(region.get_storage(), image.get_storage());
+  EXPECT_FALSE(region.is_packed());
+  EXPECT_EQ(region.get_stride(), 4);
+  EXPECT_EQ(region.get_row(0)[0], 5);
+  EXPECT_EQ(region.get_row(1)[1], 10);
+
+  // Writing copies only the region.
+  auto written = region;
+  written.get_mutable_row(1)[0] = 0;
+  EXPECT_TRUE(written.is_packed());
+  EXPECT_EQ(written.get_storage()->get_size(), 4);
+  EXPECT_EQ((std::array<uint8_t, 4>{written.get_data()[0],
+                                    written.get_data()[1],
+                                    written.get_data()[2],
+                                    written.get_data()[3]}),
+            (std::array<uint8_t, 4>{5, 6, 0, 10}));
+  EXPECT_EQ(image.get_data()[9], 9);
+}
+
+TEST(ImageBufferTest, mapped_files_are_copied_before_writing) {
+  const auto path = afro::paths::temp_dir() / "image_buffer_test.raw";
+  {
+    auto file = std::ofstream(path, std::ios::binary);
+    const auto pixels = std::array<char, 8>{1, 2, 3, 4, 5, 6, 7, 8};
+    file.write(pixels.data(), pixels.size());
+  }
+  auto image = ImageBuffer(formats::r8, 4, 2,
+                           std::make_shared<MappedFileStorage>(path));
+  EXPECT_FALSE(image.get_storage()->is_writable());
+  EXPECT_EQ(image.get_row(1)[3], 8);
+
+  image.get_mutable_data()[0] = 9;
+  EXPECT_TRUE(image.get_storage()->is_writable());
+  EXPECT_EQ(image.get_data()[0], 9);
+  EXPECT_EQ(image.get_data()[7], 8);
+  std::filesystem::remove(path);
+}
+
+TEST(ImageBufferTest, converting_regions_packs_them) {
+  const auto image = make_image();
+  EXPECT_EQ(convert_image(image, formats::r8).get_storage(),
+            image.get_storage());
+
+  const auto converted =
+      convert_image(image.get_region(2, 0, 2, 3), formats::rgba8);
+  EXPECT_TRUE(converted.is_packed());
+  EXPECT_EQ(converted.get_width(), 2);
+  EXPECT_EQ(converted.get_row(2)[4], 11);
+  EXPECT_EQ(converted.get_row(2)[7], 255);
+}
@@ -1,178 +1,545 @@
-#include "core/material_graph.h"
+#include "material_graph/data/material_graph.h"
 
+#include <fmt/format.h>
 #include <gtest/gtest.h>
 
 #include <algorithm>
-#include <iostream>
-#include <utility>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
 
-using namespace afro::core;
+#include "material_graph/definitions/subgraph_definition.h"
+#include "material_graph/engine/batch_renderer.h"
+#include "material_graph/engine/material_engine.h"
+#include "utils/log.h"
+
+using namespace afro;
+using namespace afro::graph;
+using namespace afro::graph::material;
 using namespace std;
 
+namespace {
+auto make_dummy_definition(int inputs, MaterialNodeExecFun on_execute = {})
+    -> MaterialNodeDefinition {
+  auto props = vector<property::PropertyDefinition>();
+  for (int i = 0; i < inputs; ++i) {
+    props.emplace_back(fmt::format("socket{}", i), "Socket", "Empty desc",
+                       property::Type::INPUT, property::ValueType::FLOAT_4,
+                       property::ValueUnit::COLOR, true, false, FVec4{});
+  }
+  props.emplace_back("value", "Value", "Empty desc", property::Type::INPUT,
+                     property::ValueType::FLOAT, property::ValueUnit::NONE,
+                     false, true, 0.0F);
+  props.emplace_back("_output", "Output", "Empty desc", property::Type::OUTPUT,
+                     property::ValueType::FLOAT_4, property::ValueUnit::COLOR,
+                     true, false, FVec4{});
+  if (on_execute) {
+    return {"dummy_node", "Dummy Node", props, "", ui::Icon::NONE,
+            on_execute};
+  }
+  return {"dummy_node", "Dummy Node", props, "", ui::Icon::NONE};
+}
+
+auto output_of(MaterialNode& node) -> UUID {
+  return node.get_properties().back().get_uuid();
+}
+
+auto input_of(MaterialNode& node, int idx) -> UUID {
+  return node.get_properties()[idx].get_uuid();
+}
+
+auto connect(Graph& graph, MaterialNode& from, MaterialNode& to, int idx = 0)
+    -> Link {
+  auto link = Link({from.get_uuid(), output_of(from)},
+                   {to.get_uuid(), input_of(to, idx)});
+  graph.add_link(link);
+  return link;
+}
+
+auto sorted_uuids(MaterialEngine& engine) -> vector<UUID> {
+  auto ids = vector<UUID>();
+  for (auto& node : engine.get_nodes_topologically_sorted()) {
+    ids.push_back(node->get_uuid());
+  }
+  return ids;
+}
+}  // namespace
+
 TEST(MaterialGraphTest, add_link) {
-  MaterialGraph graph = MaterialGraph(generate_uuid());
-  auto node1 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node1", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto node2 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node1", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto uid1 = node1->uuid;
-  auto sock_1 = node1->outputs[0].uid;
-  auto uid2 = node2->uuid;
-  auto sock_2 = node2->inputs[0].uid;
-  graph.add_node(move(node1));
-  graph.add_node(move(node2));
-  auto lk_id = graph.create_link(uid1, sock_1, uid2, sock_2);
-  EXPECT_TRUE(!graph.nodes[uid1]->outputs[0].links.empty());
-  EXPECT_TRUE(graph.nodes[uid1]->outputs[0].links[0] == lk_id);
-  EXPECT_TRUE(graph.nodes[uid2]->inputs[0].link.has_value());
-  EXPECT_TRUE(graph.nodes[uid2]->inputs[0].link.value() == lk_id);
-  auto link = graph.links.at(lk_id);
-  EXPECT_TRUE(link.from_node == uid1 && link.from_socket == sock_1 && link.to_node == uid2 &&
-              link.to_socket == sock_2);
+  auto graph = MaterialGraph();
+  auto node1 = MaterialNode::create(make_dummy_definition(1));
+  auto node2 = MaterialNode::create(make_dummy_definition(1));
+  graph.add_node(node1);
+  graph.add_node(node2);
+  auto link = connect(graph, *node1, *node2);
+
+  EXPECT_EQ(graph.get_links_from_node(node1->get_uuid()).size(), 1);
+  EXPECT_EQ(graph.get_links_to_node(node2->get_uuid()).size(), 1);
+  auto found = graph.get_link_by_uuid(link.get_uuid());
+  EXPECT_TRUE(found.get_from_node() == node1->get_uuid() &&
+              found.get_from_property() == output_of(*node1) &&
+              found.get_to_node() == node2->get_uuid() &&
+              found.get_to_property() == input_of(*node2, 0));
 }
 
 TEST(MaterialGraphTest, delete_link) {
-  MaterialGraph graph = MaterialGraph(generate_uuid());
-  auto node1 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node1", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto node2 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node1", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto uid1 = node1->uuid;
-  auto sock_1 = node1->outputs[0].uid;
-  auto uid2 = node2->uuid;
-  auto sock_2 = node2->inputs[0].uid;
-  graph.add_node(move(node1));
-  graph.add_node(move(node2));
-  auto lk_id = graph.create_link(uid1, sock_1, uid2, sock_2);
-  graph.delete_link(lk_id);
-  EXPECT_TRUE(graph.nodes[uid1]->outputs[0].links.empty());
-  EXPECT_FALSE(graph.nodes[uid2]->inputs[0].link.has_value());
-  EXPECT_TRUE(graph.links.empty());
+  auto graph = MaterialGraph();
+  auto node1 = MaterialNode::create(make_dummy_definition(1));
+  auto node2 = MaterialNode::create(make_dummy_definition(1));
+  graph.add_node(node1);
+  graph.add_node(node2);
+  auto link = connect(graph, *node1, *node2);
+  graph.remove_link(link);
+
+  EXPECT_TRUE(graph.get_links_from_node(node1->get_uuid()).empty());
+  EXPECT_TRUE(graph.get_links_to_node(node2->get_uuid()).empty());
+  EXPECT_TRUE(graph.get_links().empty());
 }
 
 TEST(MaterialGraphTest, delete_node) {
-  MaterialGraph graph = MaterialGraph(generate_uuid());
-  auto node1 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node1", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto node2 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node1", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto uid1 = node1->uuid;
-  auto sock_1 = node1->outputs[0].uid;
-  auto uid2 = node2->uuid;
-  auto sock_2 = node2->inputs[0].uid;
-  graph.add_node(move(node1));
-  graph.add_node(move(node2));
-  auto lk_id = graph.create_link(uid1, sock_1, uid2, sock_2);
-  graph.delete_node(uid2);
-  EXPECT_TRUE(graph.nodes[uid1]->outputs[0].links.empty());
-  EXPECT_TRUE(graph.links.empty());
-  EXPECT_TRUE(graph.nodes.size() == 1);
+  auto graph = MaterialGraph();
+  auto node1 = MaterialNode::create(make_dummy_definition(1));
+  auto node2 = MaterialNode::create(make_dummy_definition(1));
+  graph.add_node(node1);
+  graph.add_node(node2);
+  connect(graph, *node1, *node2);
+  graph.remove_node_by_uuid(node2->get_uuid());
+
+  EXPECT_TRUE(graph.get_links_from_node(node1->get_uuid()).empty());
+  EXPECT_TRUE(graph.get_links().empty());
+  EXPECT_EQ(graph.get_nodes().size(), 1);
 }
 
 TEST(MaterialGraphTest, flatten_linear) {
-  MaterialGraph graph = MaterialGraph(generate_uuid());
-  auto node1 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node1", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto node2 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node2", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto node3 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node3", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto node4 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node4", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto nodes = vector<MaterialNode*>{node4.get(), node3.get(), node2.get(), node1.get()};
-  graph.add_node(move(node1));
-  graph.add_node(move(node2));
-  graph.add_node(move(node3));
-  graph.add_node(move(node4));
-  graph.create_link(nodes[0]->uuid, nodes[0]->outputs[0].uuid, nodes[1]->uid,
-                    nodes[1]->inputs[0].uid);
-  graph.create_link(nodes[1]->uuid, nodes[1]->outputs[0].uuid, nodes[2]->uid,
-                    nodes[2]->inputs[0].uid);
-  graph.create_link(nodes[2]->uuid, nodes[2]->outputs[0].uuid, nodes[3]->uid,
-                    nodes[3]->inputs[0].uid);
-  auto flattened = graph.flatten();
-  auto node_ids = vector<UUID>();
-  for_each(flattened.begin(), flattened.end(),
-           [&node_ids](MaterialNode* node) { node_ids.push_back(node->uuid); });
-  EXPECT_TRUE(node_ids[0] == nodes[0]->uuid && node_ids[1] == nodes[1]->uuid &&
-              node_ids[2] == nodes[2]->uuid && node_ids[3] == nodes[3]->uuid);
+  auto graph = make_shared<MaterialGraph>();
+  auto nodes = vector<shared_ptr<MaterialNode>>();
+  for (int i = 0; i < 4; ++i) {
+    nodes.push_back(MaterialNode::create(make_dummy_definition(1)));
+  }
+  // Insert in reverse so the order of insertion doesn't match the result
+  for (auto it = nodes.rbegin(); it != nodes.rend(); ++it) {
+    graph->add_node(*it);
+  }
+  connect(*graph, *nodes[0], *nodes[1]);
+  connect(*graph, *nodes[1], *nodes[2]);
+  connect(*graph, *nodes[2], *nodes[3]);
+
+  MaterialEngine engine;
+  engine.set_graph(graph);
+  auto ids = sorted_uuids(engine);
+  ASSERT_EQ(ids.size(), 4);
+  EXPECT_TRUE(ids[0] == nodes[0]->get_uuid() &&
+              ids[1] == nodes[1]->get_uuid() &&
+              ids[2] == nodes[2]->get_uuid() && ids[3] == nodes[3]->get_uuid());
 }
 
 TEST(MaterialGraphTest, flatten_complex) {
-  MaterialGraph graph = MaterialGraph(generate_uuid());
-  auto node1 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node1", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto node2 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node2",
-      {MaterialInSocket(generate_uuid(), "socket1"), MaterialInSocket(generate_uuid(), "socket2")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto node3 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node3", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto node4 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node4", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto nodes = vector<MaterialNode*>{node1.get(), node2.get(), node3.get(), node4.get()};
-  graph.add_node(move(node1));
-  graph.add_node(move(node2));
-  graph.add_node(move(node3));
-  graph.add_node(move(node4));
-  graph.create_link(nodes[3]->uuid, nodes[3]->outputs[0].uuid, nodes[2]->uid,
-                    nodes[2]->inputs[0].uid);  // node 4 to node 3
-  graph.create_link(nodes[3]->uuid, nodes[3]->outputs[0].uid, nodes[1]->uuid,
-                    nodes[1]->inputs[0].uid);  // node 4 to node 2
-  graph.create_link(nodes[2]->uuid, nodes[2]->outputs[0].uid, nodes[1]->uuid,
-                    nodes[1]->inputs[1].uid);  // node 3 to node 2
-  graph.create_link(nodes[1]->uuid, nodes[1]->outputs[0].uid, nodes[0]->uuid,
-                    nodes[0]->inputs[0].uid);  // node 2 to node 1
-  auto flatten = graph.flatten();
-  auto flatten_ids = vector<UUID>();
-  for (auto p : flatten) {
-    flatten_ids.push_back(p->uuid);
-  }
-  EXPECT_TRUE(flatten_ids[0] == nodes[3]->uuid && flatten_ids[1] == nodes[2]->uuid &&
-              flatten_ids[2] == nodes[1]->uuid && flatten_ids[3] == nodes[0]->uuid);
+  auto graph = make_shared<MaterialGraph>();
+  auto node1 = MaterialNode::create(make_dummy_definition(1));
+  auto node2 = MaterialNode::create(make_dummy_definition(2));
+  auto node3 = MaterialNode::create(make_dummy_definition(1));
+  auto node4 = MaterialNode::create(make_dummy_definition(1));
+  graph->add_node(node1);
+  graph->add_node(node2);
+  graph->add_node(node3);
+  graph->add_node(node4);
+  connect(*graph, *node4, *node3);     // node 4 to node 3
+  connect(*graph, *node4, *node2, 0);  // node 4 to node 2
+  connect(*graph, *node3, *node2, 1);  // node 3 to node 2
+  connect(*graph, *node2, *node1);     // node 2 to node 1
+
+  MaterialEngine engine;
+  engine.set_graph(graph);
+  auto ids = sorted_uuids(engine);
+  ASSERT_EQ(ids.size(), 4);
+  EXPECT_TRUE(ids[0] == node4->get_uuid() && ids[1] == node3->get_uuid() &&
+              ids[2] == node2->get_uuid() && ids[3] == node1->get_uuid());
 }
 
 TEST(MaterialGraphTest, dectect_cycle) {
-  MaterialGraph graph = MaterialGraph(generate_uuid());
-  /// Create 4 dummy nodes
-  auto node1 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node1", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto node2 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node2", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto node3 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node3", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-  auto node4 = unique_ptr<MaterialNode>(new MaterialNode(
-      generate_uuid(), "Dummy Node4", {MaterialInSocket(generate_uuid(), "socket1")},
-      {MaterialOutSocket(generate_uuid(), "socket out 1")}, nullptr));
-
-  auto nodes = vector<MaterialNode*>{nullptr, node1.get(), node2.get(), node3.get(), node4.get()};
-  graph.add_node(move(node1));
-  graph.add_node(move(node2));
-  graph.add_node(move(node3));
-  graph.add_node(move(node4));
-  /// Create links from node 4 to 3 to 2 to 1
-  graph.create_link(nodes[4]->uuid, nodes[4]->outputs[0].uid, nodes[3]->uuid,
-                    nodes[3]->inputs[0].uid);  // node 4 to node 3
-  graph.create_link(nodes[3]->uuid, nodes[3]->outputs[0].uid, nodes[2]->uuid,
-                    nodes[2]->inputs[0].uid);  // node 3 to node 2
-  graph.create_link(nodes[2]->uuid, nodes[2]->outputs[0].uid, nodes[1]->uuid,
-                    nodes[1]->inputs[0].uid);  // node 2 to node 1
-  auto has_cycle = graph.dectect_cycle(nodes[2]->uuid, nodes[4]->uuid);
-  EXPECT_TRUE(has_cycle);
-}
\ No newline at end of file
+  auto graph = make_shared<MaterialGraph>();
+  auto nodes = vector<shared_ptr<MaterialNode>>();
+  for (int i = 0; i < 4; ++i) {
+    nodes.push_back(MaterialNode::create(make_dummy_definition(1)));
+    graph->add_node(nodes.back());
+  }
+  /// Create links from node 4 to 3 to 2 to 1 and close the cycle from 2 to 4
+  connect(*graph, *nodes[3], *nodes[2]);
+  connect(*graph, *nodes[2], *nodes[1]);
+  connect(*graph, *nodes[1], *nodes[0]);
+  connect(*graph, *nodes[1], *nodes[3]);
+
+  MaterialEngine engine;
+  engine.set_graph(graph);
+  EXPECT_LT(engine.get_nodes_topologically_sorted().size(), nodes.size());
+}
+
+TEST(MaterialGraphTest, batch_executes_invariant_nodes_once) {
+  log::init_log(log::get_logger(), log::LogLevel::warn);
+  auto executions = unordered_map<UUID, int>();
+  auto values = vector<float>();
+  auto count = [&](MaterialEngine*, MaterialGraph*, MaterialNode* node) {
+    ++executions[node->get_uuid()];
+  };
+  // a -> b -> d <- c, only c is overridden
+  auto graph = make_shared<MaterialGraph>();
+  auto a = MaterialNode::create(make_dummy_definition(0, count));
+  auto b = MaterialNode::create(make_dummy_definition(1, count));
+  auto record = [&](MaterialEngine*, MaterialGraph*, MaterialNode* node) {
+    ++executions[node->get_uuid()];
+    values.push_back(node->get_property("value").get<float>());
+  };
+  auto c = MaterialNode::create(make_dummy_definition(0, record));
+  auto d = MaterialNode::create(make_dummy_definition(2, count));
+  for (auto& node : {a, b, c, d}) {
+    graph->add_node(node);
+  }
+  connect(*graph, *a, *b);
+  connect(*graph, *b, *d, 0);
+  connect(*graph, *c, *d, 1);
+
+  MaterialEngine engine;
+  engine.set_graph(graph);
+  auto variants = vector<OverrideSet>();
+  for (float value : {1.0F, 2.0F, 3.0F}) {
+    variants.push_back({{c->get_uuid(), "value", value}});
+  }
+  const auto version = graph->get_version();
+  auto invalidations = 0;
+  c->on_invalidate.connect([&invalidations]() { ++invalidations; });
+  auto stats = BatchRenderer(engine).render(variants, {d->get_uuid()}, {});
+
+  EXPECT_EQ(stats.invariant_nodes, 2);
+  EXPECT_EQ(stats.varying_nodes, 2);
+  EXPECT_EQ(stats.executions, 8);
+  EXPECT_EQ(executions[a->get_uuid()], 1);
+  EXPECT_EQ(executions[b->get_uuid()], 1);
+  EXPECT_EQ(executions[c->get_uuid()], 3);
+  EXPECT_EQ(executions[d->get_uuid()], 3);
+  EXPECT_EQ(values, vector<float>({1.0F, 2.0F, 3.0F}));
+  // The graph itself was never changed.
+  EXPECT_EQ(c->get_property("value").get<float>(), 0.0F);
+  EXPECT_EQ(graph->get_version(), version);
+  EXPECT_EQ(invalidations, 0);
+  EXPECT_EQ(engine.get_graph(), graph);
+}
+
+TEST(MaterialGraphTest, inactive_graphs_keep_their_state) {
+  log::init_log(log::get_logger(), log::LogLevel::warn);
+  auto executions = unordered_map<UUID, int>();
+  auto count = [&](MaterialEngine*, MaterialGraph*, MaterialNode* node) {
+    ++executions[node->get_uuid()];
+  };
+  auto first = make_shared<MaterialGraph>();
+  auto a = MaterialNode::create(make_dummy_definition(0, count));
+  auto b = MaterialNode::create(make_dummy_definition(1, count));
+  first->add_node(a);
+  first->add_node(b);
+  connect(*first, *a, *b);
+  auto second = make_shared<MaterialGraph>();
+  auto c = MaterialNode::create(make_dummy_definition(0, count));
+  second->add_node(c);
+
+  MaterialEngine engine;
+  engine.set_graph(first);
+  engine.update();
+  engine.set_graph(second);
+  engine.update();
+  engine.set_graph(first);
+  engine.update();
+  EXPECT_EQ(engine.get_stats().executions, 3);
+
+  // Edits made while a graph was active survive a switch.
+  engine.on_node_changed(b->get_uuid());
+  engine.clear_graph();
+  engine.set_graph(second);
+  engine.update();
+  engine.set_graph(first);
+  engine.update();
+  EXPECT_EQ(executions[a->get_uuid()], 1);
+  EXPECT_EQ(executions[b->get_uuid()], 2);
+  EXPECT_EQ(executions[c->get_uuid()], 1);
+
+  // A removed graph starts from scratch when attached again.
+  engine.remove_graph(second);
+  engine.set_graph(second);
+  engine.update();
+  EXPECT_EQ(executions[c->get_uuid()], 2);
+}
+
+TEST(MaterialGraphTest, edits_rerun_downstream_nodes_once) {
+  log::init_log(log::get_logger(), log::LogLevel::warn);
+  auto executions = unordered_map<UUID, int>();
+  auto count = [&](MaterialEngine*, MaterialGraph*, MaterialNode* node) {
+    ++executions[node->get_uuid()];
+  };
+  // a -> b -> d, a -> c -> d
+  auto graph = make_shared<MaterialGraph>();
+  auto a = MaterialNode::create(make_dummy_definition(0, count));
+  auto b = MaterialNode::create(make_dummy_definition(1, count));
+  auto c = MaterialNode::create(make_dummy_definition(1, count));
+  auto d = MaterialNode::create(make_dummy_definition(2, count));
+  for (auto& node : {a, b, c, d}) {
+    graph->add_node(node);
+  }
+  connect(*graph, *a, *b);
+  connect(*graph, *a, *c);
+  connect(*graph, *b, *d, 0);
+  connect(*graph, *c, *d, 1);
+
+  MaterialEngine engine;
+  engine.set_graph(graph);
+  engine.update();
+  engine.update();
+  EXPECT_EQ(engine.get_stats().executions, 4);
+
+  engine.on_node_changed(a->get_uuid());
+  engine.on_node_changed(a->get_uuid());
+  engine.update();
+  for (auto& node : {a, b, c, d}) {
+    EXPECT_EQ(executions[node->get_uuid()], 2);
+  }
+
+  engine.on_node_changed(c->get_uuid());
+  engine.update();
+  EXPECT_EQ(executions[b->get_uuid()], 2);
+  EXPECT_EQ(executions[c->get_uuid()], 3);
+  EXPECT_EQ(executions[d->get_uuid()], 3);
+}
+
+TEST(MaterialGraphTest, interactive_edits_render_at_preview_resolution) {
+  log::init_log(log::get_logger(), log::LogLevel::warn);
+  auto sizes = unordered_map<UUID, vector<IVec2>>();
+  auto record = [&](MaterialEngine* engine, MaterialGraph*,
+                    MaterialNode* node) {
+    sizes[node->get_uuid()].push_back(engine->get_output_size(*node));
+  };
+  auto graph = make_shared<MaterialGraph>();
+  auto a = MaterialNode::create(make_dummy_definition(0, record));
+  auto b = MaterialNode::create(make_dummy_definition(1, record));
+  a->set_buffer_size({1024, 512});
+  graph->add_node(a);
+  graph->add_node(b);
+  connect(*graph, *a, *b);
+
+  MaterialEngine engine;
+  engine.set_graph(graph);
+  engine.update();
+  engine.set_preview_resolution(256);
+  engine.set_interactive(true);
+  engine.on_node_changed(a->get_uuid());
+  engine.update();
+  engine.update();
+  ASSERT_EQ(sizes[a->get_uuid()].size(), 2);
+  EXPECT_EQ(sizes[a->get_uuid()][1].x, 256);
+  EXPECT_EQ(sizes[a->get_uuid()][1].y, 128);
+  EXPECT_EQ(sizes[b->get_uuid()][1].x, 256);
+
+  // Released, both render once more at full size.
+  engine.set_interactive(false);
+  engine.update();
+  engine.update();
+  ASSERT_EQ(sizes[a->get_uuid()].size(), 3);
+  ASSERT_EQ(sizes[b->get_uuid()].size(), 3);
+  EXPECT_EQ(sizes[a->get_uuid()][2].x, 1024);
+  EXPECT_EQ(sizes[b->get_uuid()][2].x, 1024);
+}
+
+TEST(MaterialGraphTest, cancelled_updates_resume_where_they_stopped) {
+  log::init_log(log::get_logger(), log::LogLevel::warn);
+  auto order = vector<UUID>();
+  auto record = [&](MaterialEngine*, MaterialGraph*, MaterialNode* node) {
+    order.push_back(node->get_uuid());
+  };
+  auto graph = make_shared<MaterialGraph>();
+  auto nodes = vector<shared_ptr<MaterialNode>>();
+  for (int i = 0; i < 4; ++i) {
+    nodes.push_back(MaterialNode::create(make_dummy_definition(1, record)));
+    graph->add_node(nodes.back());
+    if (i > 0) {
+      connect(*graph, *nodes[i - 1], *nodes[i]);
+    }
+  }
+
+  MaterialEngine engine;
+  engine.set_graph(graph);
+  EXPECT_FALSE(engine.update([&]() { return order.size() == 2; }));
+  EXPECT_EQ(order.size(), 2);
+  EXPECT_EQ(engine.get_stats().cancelled_updates, 1);
+
+  // An edit upstream of the remaining nodes while cancelled.
+  engine.on_node_changed(nodes[1]->get_uuid());
+  EXPECT_TRUE(engine.update([]() { return false; }));
+  EXPECT_EQ(order, vector<UUID>({nodes[0]->get_uuid(), nodes[1]->get_uuid(),
+                                 nodes[1]->get_uuid(), nodes[2]->get_uuid(),
+                                 nodes[3]->get_uuid()}));
+}
+
+TEST(MaterialGraphTest, plans_are_only_compiled_for_structure_changes) {
+  log::init_log(log::get_logger(), log::LogLevel::warn);
+  auto executions = 0;
+  auto count = [&](MaterialEngine*, MaterialGraph*, MaterialNode*) {
+    ++executions;
+  };
+  auto graph = make_shared<MaterialGraph>();
+  auto a = MaterialNode::create(make_dummy_definition(0, count));
+  auto b = MaterialNode::create(make_dummy_definition(1, count));
+  auto c = MaterialNode::create(make_dummy_definition(1, count));
+  graph->add_node(a);
+  graph->add_node(b);
+  graph->add_node(c);
+  connect(*graph, *a, *b);
+
+  MaterialEngine engine;
+  engine.set_graph(graph);
+  engine.update();
+  EXPECT_EQ(engine.get_stats().compiled_plans, 1);
+
+  a->get_property("value") = 0.5F;
+  engine.on_node_changed(a->get_uuid());
+  engine.update();
+  EXPECT_EQ(engine.get_stats().compiled_plans, 1);
+  EXPECT_EQ(executions, 5);
+
+  // c now reads b, so it runs after it.
+  auto link = connect(*graph, *b, *c);
+  engine.on_link_created(link);
+  engine.update();
+  EXPECT_EQ(engine.get_stats().compiled_plans, 2);
+  EXPECT_EQ(executions, 6);
+  a->get_property("value") = 1.0F;
+  engine.on_node_changed(a->get_uuid());
+  engine.update();
+  EXPECT_EQ(executions, 9);
+}
+
+TEST(MaterialGraphTest, identical_subgraph_instances_evaluate_once) {
+  log::init_log(log::get_logger(), log::LogLevel::warn);
+  auto executions = 0;
+  auto values = vector<float>();
+  auto record = [&](MaterialEngine*, MaterialGraph*, MaterialNode* node) {
+    ++executions;
+    values.push_back(node->get_property("value").get<float>());
+  };
+  auto count = [&](MaterialEngine*, MaterialGraph*, MaterialNode*) {
+    ++executions;
+  };
+  // source -> filter, source.value is exposed
+  auto subgraph = make_shared<MaterialGraph>();
+  auto source = MaterialNode::create(make_dummy_definition(0, record));
+  auto filter = MaterialNode::create(make_dummy_definition(1, count));
+  subgraph->add_node(source);
+  subgraph->add_node(filter);
+  connect(*subgraph, *source, *filter);
+  subgraph->expose_property(source->get_uuid(), "value");
+  subgraph->set_output_node(filter->get_uuid());
+  EXPECT_THROW(subgraph->expose_property(filter->get_uuid(), "socket0"),
+               std::runtime_error);
+
+  const auto definition = make_subgraph_definition(subgraph, "Bricks");
+  const auto value_id =
+      subgraph->get_exposed_properties().front().get_instance_property_id();
+  auto graph = make_shared<MaterialGraph>();
+  auto instances = vector<shared_ptr<MaterialNode>>();
+  for (int i = 0; i < 10; ++i) {
+    auto& instance = instances.emplace_back(MaterialNode::create(definition));
+    instance->get_property(value_id) = 0.5F;
+    graph->add_node(instance);
+  }
+
+  MaterialEngine engine;
+  engine.set_graph(graph);
+  engine.update();
+  EXPECT_EQ(executions, 2);
+  EXPECT_EQ(values, vector<float>({0.5F}));
+  EXPECT_EQ(source->get_property("value").get<float>(), 0.0F);
+
+  // Editing the subgraph re-runs its instances.
+  filter->get_property("value") = 1.0F;
+  engine.update();
+  EXPECT_EQ(executions, 4);
+  EXPECT_EQ(engine.get_graph(), graph);
+
+  instances.back()->get_property(value_id) = 0.25F;
+  engine.on_node_changed(instances.back()->get_uuid());
+  engine.update();
+  EXPECT_EQ(values, vector<float>({0.5F, 0.5F, 0.25F}));
+}
+
+TEST(MaterialGraphTest, subgraphs_resolve_through_the_engine) {
+  log::init_log(log::get_logger(), log::LogLevel::warn);
+  auto live_executions = 0;
+  auto resolved_executions = 0;
+  auto subgraph = make_shared<MaterialGraph>();
+  auto live = MaterialNode::create(make_dummy_definition(
+      0, [&](MaterialEngine*, MaterialGraph*, MaterialNode*) {
+        ++live_executions;
+      }));
+  subgraph->add_node(live);
+  subgraph->set_output_node(live->get_uuid());
+  // Stands in for the copy of the subgraph the engine thread owns.
+  auto copy = make_shared<MaterialGraph>();
+  auto resolved = MaterialNode::create(make_dummy_definition(
+      0, [&](MaterialEngine*, MaterialGraph*, MaterialNode*) {
+        ++resolved_executions;
+      }));
+  copy->add_node(resolved);
+  copy->set_output_node(resolved->get_uuid());
+
+  auto graph = make_shared<MaterialGraph>();
+  graph->add_node(
+      MaterialNode::create(make_subgraph_definition(subgraph, "Copied")));
+  MaterialEngine engine;
+  engine.set_subgraph_resolver(
+      [&](UUID uuid) -> shared_ptr<MaterialGraph> {
+        return uuid == subgraph->get_uuid() ? copy : nullptr;
+      });
+  engine.set_graph(graph);
+  engine.update();
+  EXPECT_EQ(live_executions, 0);
+  EXPECT_EQ(resolved_executions, 1);
+
+  // Only edits of the copy re-run the instance.
+  live->get_property("value") = 1.0F;
+  engine.update();
+  EXPECT_EQ(resolved_executions, 1);
+  resolved->get_property("value") = 1.0F;
+  engine.update();
+  EXPECT_EQ(live_executions, 0);
+  EXPECT_EQ(resolved_executions, 2);
+}
+
+TEST(MaterialGraphTest, precision_changes_reallocate_the_output) {
+  log::init_log(log::get_logger(), log::LogLevel::warn);
+  auto formats = vector<gl::GLenum>();
+  auto graph = make_shared<MaterialGraph>();
+  auto node = MaterialNode::create(make_dummy_definition(
+      0, [&](MaterialEngine* engine, MaterialGraph*, MaterialNode* node) {
+        const auto output = node->get_property("_output").get_uuid();
+        engine->create_or_get_buffer(output, 4, 4, node->get_buffer_format());
+        formats.push_back(engine->get_buffer_format(output));
+      }));
+  graph->add_node(node);
+
+  MaterialEngine engine;
+  engine.set_graph(graph);
+  // Follows the node like the async engine follows the graph.
+  node->on_invalidate.connect(
+      [&]() { engine.on_node_changed(node->get_uuid()); });
+  engine.update();
+  const auto version = graph->get_version();
+  node->set_high_precision(true);
+  EXPECT_NE(graph->get_version(), version);
+  engine.update();
+  EXPECT_EQ(formats, vector<gl::GLenum>({gl::GL_RGBA8, gl::GL_RGBA16F}));
+
+  // Setting the same precision or size doesn't re-run it.
+  node->set_high_precision(true);
+  node->set_buffer_size(node->get_buffer_size());
+  engine.update();
+  EXPECT_EQ(formats.size(), 2);
+  node->set_buffer_size({512, 512});
+  engine.update();
+  EXPECT_EQ(formats.size(), 3);
+}
@@ -0,0 +1,961 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ *
+ * Renders every material node definition headlessly across a matrix of
+ * property values and resolutions, compares the results with the reference
+ * images in data/golden and the execution times with
+ * data/shader_timings.json. Set AFRO_UPDATE_GOLDEN=1 to (re)generate both.
+ */
+
+#include <OpenImageIO/imageio.h>
+#include <fmt/format.h>
+#include <glbinding/gl43core/gl.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <cereal/archives/json.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "headless_gl_context.h"
+#include "io/image_cache.h"
+#include "material_graph/data/material_graph.h"
+#include "material_graph/definitions/definitions.h"
+#include "material_graph/definitions/subgraph_definition.h"
+#include "material_graph/engine/async_engine.h"
+#include "material_graph/engine/material_engine.h"
+#include "utils/log.h"
+#include "utils/paths.h"
+
+namespace fs = std::filesystem;
+using namespace afro;
+using namespace afro::graph;
+using namespace afro::graph::material;
+
+namespace {
+constexpr std::array<int, 2> RESOLUTIONS = {64, 256};
+// Largest per channel difference that isn't counted as a mismatch.
+constexpr int CHANNEL_TOLERANCE = 2;
+// Ratio of mismatching pixels allowed before an image is considered changed.
+constexpr double MAX_MISMATCH_RATIO = 0.001;
+constexpr int TIMING_RUNS = 7;
+constexpr double DEFAULT_PERF_TOLERANCE = 1.5;
+// Absolute slack so timer noise on tiny images doesn't fail the suite.
+constexpr double PERF_SLACK_MS = 0.5;
+
+const std::array<FVec4, 3> SOCKET_COLORS = {FVec4{0.8F, 0.3F, 0.1F, 1.0F},
+                                            FVec4{0.2F, 0.6F, 0.9F, 1.0F},
+                                            FVec4{0.5F, 0.5F, 0.5F, 1.0F}};
+
+struct ShaderCase {
+  std::string id;
+  std::vector<std::pair<std::string, property::PropertyValue>> values;
+};
+
+struct ShaderTiming {
+  std::string id;
+  double milliseconds = 0;
+
+  template <class Archive>
+  void serialize(Archive &archive) {
+    archive(cereal::make_nvp("id", id), cereal::make_nvp("ms", milliseconds));
+  }
+};
+
+auto is_update_mode() -> bool {
+  const auto *value = std::getenv("AFRO_UPDATE_GOLDEN");
+  return value != nullptr && std::string_view(value) == "1";
+}
+
+auto get_perf_tolerance() -> double {
+  const auto *value = std::getenv("AFRO_PERF_TOLERANCE");
+  return value != nullptr ? std::atof(value) : DEFAULT_PERF_TOLERANCE;
+}
+
+/**
+ * @brief Property values to render besides the defaults. Each property is
+ * varied on its own so the matrix grows linearly with the property count.
+ */
+auto get_variations(const property::PropertyDefinition &prop_def)
+    -> std::vector<property::PropertyValue> {
+  auto values = std::vector<property::PropertyValue>();
+  switch (prop_def.value_type) {
+    case property::ValueType::ENUM:
+      for (const auto &preset :
+           prop_def.presets.value_or(std::vector<property::PropertyValue>())) {
+        const auto value = std::get<property::EnumItem>(preset).value;
+        if (value != std::get<int>(prop_def.default_value)) {
+          values.emplace_back(value);
+        }
+      }
+      break;
+    case property::ValueType::INTEGER:
+    case property::ValueType::FLOAT:
+      if (prop_def.min_value.has_value()) {
+        values.push_back(prop_def.min_value.value());
+      }
+      if (prop_def.max_value.has_value()) {
+        values.push_back(prop_def.max_value.value());
+      }
+      break;
+    case property::ValueType::BOOLEAN:
+      values.emplace_back(!std::get<bool>(prop_def.default_value));
+      break;
+    case property::ValueType::FLOAT_4:
+      values.emplace_back(FVec4{0.0F, 0.0F, 0.0F, 1.0F});
+      values.emplace_back(FVec4{0.25F, 0.5F, 0.75F, 0.5F});
+      break;
+    default:
+      break;
+  }
+  return values;
+}
+
+auto get_cases(const MaterialNodeDefinition &node_def)
+    -> std::vector<ShaderCase> {
+  auto cases = std::vector<ShaderCase>{{"default", {}}};
+  for (const auto &prop_def : node_def.get_prop_definitions()) {
+    if (prop_def.type != property::Type::INPUT || prop_def.is_socket ||
+        prop_def.id[0] == '_') {
+      continue;
+    }
+    auto idx = 0;
+    for (auto &value : get_variations(prop_def)) {
+      cases.push_back(
+          {fmt::format("{}_{}", prop_def.id, idx++), {{prop_def.id, value}}});
+    }
+  }
+  return cases;
+}
+
+auto find_definition(const NodeDefinitions &definitions, std::string_view id)
+    -> const MaterialNodeDefinition & {
+  auto iter = std::find_if(
+      definitions.begin(), definitions.end(),
+      [&](const MaterialNodeDefinition &def) { return def.get_id() == id; });
+  if (iter == definitions.end()) {
+    throw std::runtime_error("Node definition not found");
+  }
+  return *iter;
+}
+
+auto read_image(const fs::path &path, int width, int height)
+    -> std::optional<std::vector<uint8_t>> {
+  auto input = OIIO::ImageInput::open(path.string());
+  if (!input) {
+    return std::nullopt;
+  }
+  const auto &spec = input->spec();
+  if (spec.width != width || spec.height != height) {
+    return std::nullopt;
+  }
+  auto pixels = std::vector<uint8_t>(static_cast<size_t>(width) * height * 4);
+  input->read_image(0, 0, 0, 4, OIIO::TypeDesc::UINT8, pixels.data());
+  input->close();
+  return pixels;
+}
+
+auto write_image(const fs::path &path, int width, int height,
+                 const std::vector<uint8_t> &pixels) -> bool {
+  fs::create_directories(path.parent_path());
+  auto output = OIIO::ImageOutput::create(path.string());
+  if (!output) {
+    return false;
+  }
+  const auto spec = OIIO::ImageSpec(width, height, 4, OIIO::TypeDesc::UINT8);
+  if (!output->open(path.string(), spec)) {
+    return false;
+  }
+  output->write_image(OIIO::TypeDesc::UINT8, pixels.data());
+  output->close();
+  return true;
+}
+
+auto get_mismatch_ratio(const std::vector<uint8_t> &expected,
+                        const std::vector<uint8_t> &actual) -> double {
+  size_t mismatches = 0;
+  for (size_t i = 0; i < expected.size(); i += 4) {
+    for (size_t c = 0; c < 4; ++c) {
+      if (std::abs(expected[i + c] - actual[i + c]) > CHANNEL_TOLERANCE) {
+        ++mismatches;
+        break;
+      }
+    }
+  }
+  return static_cast<double>(mismatches) / (expected.size() / 4.0);
+}
+
+auto load_timings(const fs::path &path) -> std::vector<ShaderTiming> {
+  auto timings = std::vector<ShaderTiming>();
+  std::ifstream ifs(path);
+  if (!ifs.is_open()) {
+    return timings;
+  }
+  cereal::JSONInputArchive archive(ifs);
+  archive(cereal::make_nvp("timings", timings));
+  return timings;
+}
+
+auto save_timings(const fs::path &path,
+                  const std::vector<ShaderTiming> &timings) -> void {
+  std::ofstream ofs(path);
+  cereal::JSONOutputArchive archive(ofs);
+  archive(cereal::make_nvp("timings", timings));
+}
+}  // namespace
+
+class MaterialShaderTest : public ::testing::Test {
+ protected:
+  static std::unique_ptr<tests::HeadlessGlContext> context;
+  static bool has_context;
+  static std::unordered_map<std::string, double> baseline;
+  static std::vector<ShaderTiming> timings;
+  NodeDefinitions definitions;
+
+  static void SetUpTestSuite() {
+    log::init_log(log::get_logger(), log::LogLevel::warn);
+    context = std::make_unique<tests::HeadlessGlContext>();
+    has_context = context->init();
+    for (auto &timing :
+         load_timings(fs::path(AFRO_TEST_DATA_DIR) / "shader_timings.json")) {
+      baseline[timing.id] = timing.milliseconds;
+    }
+  }
+
+  static void TearDownTestSuite() {
+    if (!timings.empty()) {
+      save_timings("shader_timings.json", timings);
+      if (is_update_mode()) {
+        save_timings(fs::path(AFRO_TEST_DATA_DIR) / "shader_timings.json",
+                     timings);
+      }
+    }
+    context.reset();
+  }
+
+  void SetUp() override {
+    if (!has_context) {
+      GTEST_SKIP() << "No headless OpenGL context: " << context->get_error();
+    }
+  }
+
+  /**
+   * @brief Renders @a node_def with socket inputs fed by solid colors and
+   * returns the RGBA8 pixels of its output.
+   *
+   * @param milliseconds out median time of re-executing the node alone.
+   */
+  auto render(const MaterialNodeDefinition &node_def,
+              const ShaderCase &shader_case, int resolution,
+              double &milliseconds) -> std::vector<uint8_t> {
+    const auto &solid_color_def =
+        find_definition(definitions, "solid_color_node");
+    auto graph = std::make_shared<MaterialGraph>();
+    auto node = MaterialNode::create(node_def);
+    node->set_buffer_size({resolution, resolution});
+    for (const auto &[prop_id, value] : shader_case.values) {
+      node->get_property(prop_id).set_value(value);
+    }
+    graph->add_node(node);
+
+    size_t socket_idx = 0;
+    for (auto &prop : node->get_properties()) {
+      const auto &prop_def = prop.get_property_definition();
+      if (prop_def.type != property::Type::INPUT || !prop_def.is_socket) {
+        continue;
+      }
+      auto source = MaterialNode::create(solid_color_def);
+      source->set_buffer_size({resolution, resolution});
+      source->get_property("color") =
+          SOCKET_COLORS[socket_idx++ % SOCKET_COLORS.size()];
+      graph->add_node(source);
+      graph->add_link(
+          Link({source->get_uuid(), source->get_property("_output").get_uuid()},
+               {node->get_uuid(), prop.get_uuid()}));
+    }
+
+    MaterialEngine engine;
+    // Constant inputs would otherwise reduce most cases to a single pixel.
+    engine.set_constant_folding(false);
+    engine.set_graph(graph);
+    engine.update();
+    gl::glFinish();
+
+    auto runs = std::vector<double>();
+    for (int i = 0; i < TIMING_RUNS; ++i) {
+      engine.on_node_changed(node->get_uuid());
+      const auto start = std::chrono::steady_clock::now();
+      engine.update();
+      gl::glFinish();
+      runs.push_back(std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start)
+                         .count());
+    }
+    std::sort(runs.begin(), runs.end());
+    milliseconds = runs[runs.size() / 2];
+
+    auto pixels =
+        std::vector<uint8_t>(static_cast<size_t>(resolution) * resolution * 4);
+    gl::glBindTexture(gl::GL_TEXTURE_2D, engine.get_preview_texture(*node));
+    gl::glPixelStorei(gl::GL_PACK_ALIGNMENT, 1);
+    // Swizzles don't apply to readbacks, grayscale outputs are expanded.
+    if (is_grayscale_format(engine.get_buffer_format(
+            node->get_property("_output").get_uuid()))) {
+      gl::glGetTexImage(gl::GL_TEXTURE_2D, 0, gl::GL_RED,
+                        gl::GL_UNSIGNED_BYTE, pixels.data());
+      for (auto i = pixels.size() / 4; i-- > 0;) {
+        const auto gray = pixels[i];
+        std::fill_n(pixels.begin() + static_cast<ptrdiff_t>(i * 4), 3, gray);
+        pixels[i * 4 + 3] = std::numeric_limits<uint8_t>::max();
+      }
+    } else {
+      gl::glGetTexImage(gl::GL_TEXTURE_2D, 0, gl::GL_RGBA,
+                        gl::GL_UNSIGNED_BYTE, pixels.data());
+    }
+    gl::glBindTexture(gl::GL_TEXTURE_2D, 0);
+
+    for (auto &graph_node : graph->get_nodes()) {
+      engine.on_node_deleted(std::dynamic_pointer_cast<MaterialNode>(graph_node));
+    }
+    engine.clear_graph();
+    engine.shutdown();
+    return pixels;
+  }
+};
+
+std::unique_ptr<tests::HeadlessGlContext> MaterialShaderTest::context;
+bool MaterialShaderTest::has_context = false;
+std::unordered_map<std::string, double> MaterialShaderTest::baseline;
+std::vector<ShaderTiming> MaterialShaderTest::timings;
+
+TEST_F(MaterialShaderTest, matches_golden_images_and_timings) {
+  const auto update = is_update_mode();
+  const auto perf_tolerance = get_perf_tolerance();
+
+  for (const auto &node_def : definitions) {
+    for (const auto &shader_case : get_cases(node_def)) {
+      for (const auto resolution : RESOLUTIONS) {
+        const auto case_id = fmt::format("{}/{}_{}", node_def.get_id(),
+                                         shader_case.id, resolution);
+        SCOPED_TRACE(case_id);
+
+        double milliseconds = 0;
+        const auto pixels =
+            render(node_def, shader_case, resolution, milliseconds);
+        timings.push_back({case_id, milliseconds});
+
+        const auto golden_path =
+            fs::path(AFRO_TEST_DATA_DIR) / "golden" / (case_id + ".png");
+        if (update) {
+          EXPECT_TRUE(write_image(golden_path, resolution, resolution, pixels));
+          continue;
+        }
+
+        const auto expected = read_image(golden_path, resolution, resolution);
+        if (!expected.has_value()) {
+          write_image(fs::path("golden_candidates") / (case_id + ".png"),
+                      resolution, resolution, pixels);
+          ADD_FAILURE() << "Missing reference image " << golden_path
+                        << ", rerun with AFRO_UPDATE_GOLDEN=1 to create it";
+          continue;
+        }
+        const auto mismatch = get_mismatch_ratio(expected.value(), pixels);
+        if (mismatch > MAX_MISMATCH_RATIO) {
+          write_image(fs::path("golden_failures") / (case_id + ".png"),
+                      resolution, resolution, pixels);
+        }
+        EXPECT_LE(mismatch, MAX_MISMATCH_RATIO);
+
+        auto base = baseline.find(case_id);
+        if (base == baseline.end()) {
+          ADD_FAILURE() << "Missing timing baseline, rerun with "
+                           "AFRO_UPDATE_GOLDEN=1 to record it";
+          continue;
+        }
+        EXPECT_LE(milliseconds, base->second * perf_tolerance + PERF_SLACK_MS)
+            << "Node became slower than the recorded baseline of "
+            << base->second << "ms";
+      }
+    }
+  }
+}
+
+TEST_F(MaterialShaderTest, identical_nodes_share_results_across_graphs) {
+  const auto &solid_color_def =
+      find_definition(definitions, "solid_color_node");
+  auto make_source = [&](const FVec4 &color) {
+    auto node = MaterialNode::create(solid_color_def);
+    node->set_buffer_size({64, 64});
+    node->get_property("color") = color;
+    return node;
+  };
+  auto first = std::make_shared<MaterialGraph>();
+  auto shared = make_source(SOCKET_COLORS[0]);
+  first->add_node(shared);
+  auto second = std::make_shared<MaterialGraph>();
+  auto same = make_source(SOCKET_COLORS[0]);
+  auto other = make_source(SOCKET_COLORS[1]);
+  second->add_node(same);
+  second->add_node(other);
+
+  MaterialEngine engine;
+  engine.set_graph(first);
+  engine.update();
+  engine.set_graph(second);
+  engine.update();
+  EXPECT_EQ(engine.get_stats().executions, 2);
+  EXPECT_EQ(engine.get_stats().reused_results, 1);
+  EXPECT_EQ(engine.get_preview_texture(*same),
+            engine.get_preview_texture(*shared));
+  EXPECT_NE(engine.get_preview_texture(*other),
+            engine.get_preview_texture(*shared));
+
+  // Evicting the inactive graph keeps the buffer the active one still uses.
+  const auto shared_texture = engine.get_preview_texture(*shared);
+  engine.set_memory_budget(0);
+  EXPECT_EQ(engine.get_stats().evicted_graphs, 1);
+  engine.set_memory_budget(std::numeric_limits<size_t>::max());
+  engine.set_graph(first);
+  engine.update();
+  EXPECT_EQ(engine.get_stats().executions, 2);
+  EXPECT_EQ(engine.get_stats().reused_results, 2);
+  EXPECT_EQ(engine.get_preview_texture(*shared), shared_texture);
+
+  // Changing one of them gives it a buffer of its own.
+  shared->get_property("color") = SOCKET_COLORS[2];
+  engine.on_node_changed(shared->get_uuid());
+  engine.update();
+  EXPECT_EQ(engine.get_stats().executions, 3);
+  EXPECT_NE(engine.get_preview_texture(*shared), shared_texture);
+  EXPECT_EQ(engine.get_preview_texture(*same), shared_texture);
+  engine.shutdown();
+}
+
+TEST_F(MaterialShaderTest, identical_subgraph_instances_render_once) {
+  auto subgraph = std::make_shared<MaterialGraph>();
+  auto source =
+      MaterialNode::create(find_definition(definitions, "solid_color_node"));
+  subgraph->add_node(source);
+  subgraph->expose_property(source->get_uuid(), "color");
+  subgraph->set_output_node(source->get_uuid());
+  const auto definition = make_subgraph_definition(subgraph, "Color");
+  const auto color_id =
+      subgraph->get_exposed_properties().front().get_instance_property_id();
+
+  auto graph = std::make_shared<MaterialGraph>();
+  auto instances = std::vector<std::shared_ptr<MaterialNode>>();
+  for (int i = 0; i < 10; ++i) {
+    auto &instance = instances.emplace_back(MaterialNode::create(definition));
+    instance->set_buffer_size({64, 64});
+    instance->get_property(color_id) = SOCKET_COLORS[0];
+    graph->add_node(instance);
+  }
+
+  MaterialEngine engine;
+  engine.set_graph(graph);
+  engine.update();
+  // The first instance and the node inside it.
+  EXPECT_EQ(engine.get_stats().executions, 2);
+  EXPECT_EQ(engine.get_stats().reused_results, 9);
+  const auto texture = engine.get_preview_texture(*instances.front());
+  for (auto &instance : instances) {
+    EXPECT_EQ(engine.get_preview_texture(*instance), texture);
+  }
+
+  gl::glBindTexture(gl::GL_TEXTURE_2D, texture);
+  gl::glPixelStorei(gl::GL_PACK_ALIGNMENT, 1);
+  auto pixels = std::vector<uint8_t>(static_cast<size_t>(64) * 64 * 4);
+  gl::glGetTexImage(gl::GL_TEXTURE_2D, 0, gl::GL_RGBA, gl::GL_UNSIGNED_BYTE,
+                    pixels.data());
+  gl::glBindTexture(gl::GL_TEXTURE_2D, 0);
+  EXPECT_NEAR(pixels[0], SOCKET_COLORS[0].x * 255, CHANNEL_TOLERANCE);
+  EXPECT_NEAR(pixels[1], SOCKET_COLORS[0].y * 255, CHANNEL_TOLERANCE);
+  EXPECT_NEAR(pixels[2], SOCKET_COLORS[0].z * 255, CHANNEL_TOLERANCE);
+  engine.shutdown();
+}
+
+TEST_F(MaterialShaderTest, constant_nodes_are_folded_to_a_pixel) {
+  constexpr int RESOLUTION = 64;
+  auto graph = std::make_shared<MaterialGraph>();
+  auto add_node = [&](std::string_view id) {
+    auto node = MaterialNode::create(find_definition(definitions, id));
+    node->set_buffer_size({RESOLUTION, RESOLUTION});
+    graph->add_node(node);
+    return node;
+  };
+  auto link = [&](MaterialNode &from, MaterialNode &to, std::string_view id) {
+    graph->add_link(
+        Link({from.get_uuid(), from.get_property("_output").get_uuid()},
+             {to.get_uuid(), to.get_property(id).get_uuid()}));
+  };
+  // solid -> mix <- solid with an unlinked mask, then circle -> mix
+  auto foreground = add_node("solid_color_node");
+  foreground->get_property("color") = SOCKET_COLORS[0];
+  auto background = add_node("solid_color_node");
+  background->get_property("color") = SOCKET_COLORS[1];
+  auto constant_mix = add_node("mix_node");
+  link(*foreground, *constant_mix, "Foreground");
+  link(*background, *constant_mix, "Background");
+  auto circle = add_node("circle_node");
+  auto mix = add_node("mix_node");
+  link(*constant_mix, *mix, "Foreground");
+  link(*circle, *mix, "Background");
+
+  auto render = [&](bool folding) {
+    MaterialEngine engine;
+    engine.set_constant_folding(folding);
+    engine.set_graph(graph);
+    engine.update();
+    auto outputs = std::vector<std::vector<uint8_t>>();
+    for (const auto &node : {constant_mix, mix}) {
+      auto &pixels = outputs.emplace_back(
+          static_cast<size_t>(RESOLUTION) * RESOLUTION * 4);
+      const auto size =
+          engine.get_buffer_size(node->get_property("_output").get_uuid());
+      gl::glBindTexture(gl::GL_TEXTURE_2D, engine.get_preview_texture(*node));
+      gl::glPixelStorei(gl::GL_PACK_ALIGNMENT, 1);
+      gl::glGetTexImage(gl::GL_TEXTURE_2D, 0, gl::GL_RGBA,
+                        gl::GL_UNSIGNED_BYTE, pixels.data());
+      gl::glBindTexture(gl::GL_TEXTURE_2D, 0);
+      if (size.x == 1 && size.y == 1) {
+        for (size_t i = 4; i < pixels.size(); ++i) {
+          pixels[i] = pixels[i % 4];
+        }
+      }
+    }
+    if (folding) {
+      EXPECT_EQ(engine.get_stats().constant_nodes, 2);
+      const auto size = engine.get_buffer_size(
+          constant_mix->get_property("_output").get_uuid());
+      EXPECT_EQ(size.x, 1);
+      EXPECT_EQ(size.y, 1);
+      EXPECT_EQ(
+          engine.get_buffer_size(mix->get_property("_output").get_uuid()).x,
+          RESOLUTION);
+    }
+    engine.shutdown();
+    return outputs;
+  };
+
+  const auto folded = render(true);
+  const auto full = render(false);
+  for (size_t i = 0; i < folded.size(); ++i) {
+    EXPECT_LE(get_mismatch_ratio(full[i], folded[i]), MAX_MISMATCH_RATIO);
+  }
+}
+
+TEST_F(MaterialShaderTest, redundant_gl_calls_are_skipped) {
+  constexpr int RESOLUTION = 64;
+  const auto &solid_color_def =
+      find_definition(definitions, "solid_color_node");
+  const auto &channel_select_def =
+      find_definition(definitions, "channel_select_node");
+  auto graph = std::make_shared<MaterialGraph>();
+  auto source = MaterialNode::create(solid_color_def);
+  source->get_property("color") = SOCKET_COLORS[0];
+  graph->add_node(source);
+  // Each node samples the last one's output with the same program.
+  auto chain = std::vector<std::shared_ptr<MaterialNode>>{source};
+  for (int i = 0; i < 3; ++i) {
+    auto node = MaterialNode::create(channel_select_def);
+    graph->add_node(node);
+    graph->add_link(Link(
+        {chain.back()->get_uuid(),
+         chain.back()->get_property("_output").get_uuid()},
+        {node->get_uuid(), node->get_property("input1").get_uuid()}));
+    chain.push_back(node);
+  }
+  for (auto &node : chain) {
+    node->set_buffer_size({RESOLUTION, RESOLUTION});
+  }
+
+  MaterialEngine engine;
+  engine.set_constant_folding(false);
+  engine.set_graph(graph);
+  engine.update();
+  const auto first = engine.get_gl_state().get_stats();
+  engine.on_node_changed(source->get_uuid());
+  engine.update();
+  const auto second = engine.get_gl_state().get_stats();
+  RecordProperty("gl_calls_per_frame",
+                 static_cast<int>(second.calls - first.calls));
+  RecordProperty("skipped_gl_calls_per_frame",
+                 static_cast<int>(second.skipped_calls - first.skipped_calls));
+  EXPECT_GT(second.skipped_calls - first.skipped_calls, chain.size());
+
+  gl::glBindTexture(gl::GL_TEXTURE_2D,
+                    engine.get_preview_texture(*chain.back()));
+  gl::glPixelStorei(gl::GL_PACK_ALIGNMENT, 1);
+  auto pixels =
+      std::vector<uint8_t>(static_cast<size_t>(RESOLUTION) * RESOLUTION * 4);
+  gl::glGetTexImage(gl::GL_TEXTURE_2D, 0, gl::GL_RGBA, gl::GL_UNSIGNED_BYTE,
+                    pixels.data());
+  gl::glBindTexture(gl::GL_TEXTURE_2D, 0);
+  EXPECT_NEAR(pixels[0], SOCKET_COLORS[0].x * 255, CHANNEL_TOLERANCE);
+  EXPECT_NEAR(pixels[1], SOCKET_COLORS[0].y * 255, CHANNEL_TOLERANCE);
+  EXPECT_NEAR(pixels[2], SOCKET_COLORS[0].z * 255, CHANNEL_TOLERANCE);
+  engine.shutdown();
+}
+
+TEST_F(MaterialShaderTest, compute_nodes_run_passes_with_scratch_images) {
+  constexpr int RESOLUTION = 64;
+  // Copies the input with the x coordinate in red, then mirrors it through
+  // a second scratch image, so a pass reads pixels others wrote before it.
+  constexpr auto SHADER = R"(#version 430
+layout(local_size_x = 8, local_size_y = 8) in;
+layout(binding = 0, rgba8) uniform image2D output_image;
+layout(binding = 1, rgba32f) uniform image2D copied;
+layout(binding = 2, rgba32f) uniform image2D mirrored;
+uniform sampler2D input1;
+uniform int pass;
+
+void main() {
+  ivec2 size = imageSize(output_image);
+  ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+  if (any(greaterThanEqual(pixel, size))) {
+    return;
+  }
+  if (pass == 0) {
+    vec4 color = texture(input1, (vec2(pixel) + 0.5) / vec2(size));
+    color.r = float(pixel.x) / float(size.x - 1);
+    imageStore(copied, pixel, color);
+  } else if (pass == 1) {
+    ivec2 source = ivec2(size.x - 1 - pixel.x, pixel.y);
+    imageStore(mirrored, pixel, imageLoad(copied, source));
+  } else {
+    imageStore(output_image, pixel, imageLoad(mirrored, pixel));
+  }
+})";
+  auto mirror_def = MaterialNodeDefinition(
+      "mirror_node", "Mirror",
+      {{"input1", "Input 1", "Empty desc", property::Type::INPUT,
+        property::ValueType::FLOAT_4, property::ValueUnit::COLOR, true, false,
+        FVec4{1.0F, 1.0F, 1.0F, 1.0F}},
+       {"_output", "Output", "Empty desc", property::Type::OUTPUT,
+        property::ValueType::FLOAT_4, property::ValueUnit::COLOR, true, false,
+        FVec4{0.0F, 0.0F, 0.0F, 0.0F}}},
+      "", ui::Icon::BLEND_NODE);
+  mirror_def.set_compute_shader(
+      {SHADER, 2, [](IVec2 /*size*/) { return 3; }});
+
+  auto graph = std::make_shared<MaterialGraph>();
+  auto source =
+      MaterialNode::create(find_definition(definitions, "solid_color_node"));
+  source->get_property("color") = SOCKET_COLORS[1];
+  source->set_buffer_size({RESOLUTION, RESOLUTION});
+  graph->add_node(source);
+  auto mirror = MaterialNode::create(mirror_def);
+  mirror->set_buffer_size({RESOLUTION, RESOLUTION});
+  graph->add_node(mirror);
+  graph->add_link(
+      Link({source->get_uuid(), source->get_property("_output").get_uuid()},
+           {mirror->get_uuid(), mirror->get_property("input1").get_uuid()}));
+
+  MaterialEngine engine;
+  engine.set_graph(graph);
+  engine.update();
+  const auto memory_usage = engine.get_memory_usage();
+  // The scratch images of the first run are taken from the pool.
+  engine.on_node_changed(mirror->get_uuid());
+  engine.update();
+  EXPECT_EQ(engine.get_memory_usage(), memory_usage);
+
+  auto pixels =
+      std::vector<uint8_t>(static_cast<size_t>(RESOLUTION) * RESOLUTION * 4);
+  gl::glBindTexture(gl::GL_TEXTURE_2D, engine.get_preview_texture(*mirror));
+  gl::glPixelStorei(gl::GL_PACK_ALIGNMENT, 1);
+  gl::glGetTexImage(gl::GL_TEXTURE_2D, 0, gl::GL_RGBA, gl::GL_UNSIGNED_BYTE,
+                    pixels.data());
+  gl::glBindTexture(gl::GL_TEXTURE_2D, 0);
+  for (int y = 0; y < RESOLUTION; y += RESOLUTION / 4) {
+    for (int x = 0; x < RESOLUTION; ++x) {
+      const auto *pixel =
+          &pixels[(static_cast<size_t>(y) * RESOLUTION + x) * 4];
+      const auto mirrored_x =
+          static_cast<float>(RESOLUTION - 1 - x) / (RESOLUTION - 1);
+      EXPECT_NEAR(pixel[0], mirrored_x * 255, CHANNEL_TOLERANCE);
+      EXPECT_NEAR(pixel[1], SOCKET_COLORS[1].y * 255, CHANNEL_TOLERANCE);
+      EXPECT_NEAR(pixel[2], SOCKET_COLORS[1].z * 255, CHANNEL_TOLERANCE);
+    }
+  }
+  engine.shutdown();
+}
+
+TEST_F(MaterialShaderTest, grayscale_outputs_are_stored_in_one_channel) {
+  constexpr int RESOLUTION = 64;
+  auto graph = std::make_shared<MaterialGraph>();
+  auto add_node = [&](std::string_view id) {
+    auto node = MaterialNode::create(find_definition(definitions, id));
+    node->set_buffer_size({RESOLUTION, RESOLUTION});
+    graph->add_node(node);
+    return node;
+  };
+  auto link = [&](MaterialNode &from, MaterialNode &to, std::string_view id) {
+    graph->add_link(
+        Link({from.get_uuid(), from.get_property("_output").get_uuid()},
+             {to.get_uuid(), to.get_property(id).get_uuid()}));
+  };
+  // The grayscale circle is sampled by a color socket and the solid color
+  // by the grayscale mask.
+  auto circle = add_node("circle_node");
+  auto background = add_node("solid_color_node");
+  background->get_property("color") = SOCKET_COLORS[1];
+  auto mask = add_node("solid_color_node");
+  mask->get_property("color") = SOCKET_COLORS[0];
+  auto mix = add_node("mix_node");
+  mix->get_property("blendMode") = 1;
+  link(*circle, *mix, "Foreground");
+  link(*background, *mix, "Background");
+  link(*mask, *mix, "Mask");
+
+  MaterialEngine engine;
+  engine.set_graph(graph);
+  engine.update();
+  const auto circle_output = circle->get_property("_output").get_uuid();
+  EXPECT_EQ(engine.get_buffer_format(circle_output), gl::GL_R8);
+  EXPECT_EQ(engine.get_buffer_format(mix->get_property("_output").get_uuid()),
+            gl::GL_RGBA8);
+  EXPECT_EQ(engine.get_stats().grayscale_conversions, 1);
+
+  // The center is inside the circle, the mask is the average of its color.
+  const auto weight =
+      (SOCKET_COLORS[0].x + SOCKET_COLORS[0].y + SOCKET_COLORS[0].z) / 3;
+  auto pixels =
+      std::vector<uint8_t>(static_cast<size_t>(RESOLUTION) * RESOLUTION * 4);
+  gl::glBindTexture(gl::GL_TEXTURE_2D, engine.get_preview_texture(*mix));
+  gl::glPixelStorei(gl::GL_PACK_ALIGNMENT, 1);
+  gl::glGetTexImage(gl::GL_TEXTURE_2D, 0, gl::GL_RGBA, gl::GL_UNSIGNED_BYTE,
+                    pixels.data());
+  gl::glBindTexture(gl::GL_TEXTURE_2D, 0);
+  const auto *center =
+      &pixels[(static_cast<size_t>(RESOLUTION / 2) * RESOLUTION +
+               RESOLUTION / 2) *
+              4];
+  EXPECT_NEAR(center[0],
+              (SOCKET_COLORS[1].x * (1 - weight) + weight) * 255,
+              CHANNEL_TOLERANCE);
+  EXPECT_NEAR(center[1],
+              (SOCKET_COLORS[1].y * (1 - weight) + weight) * 255,
+              CHANNEL_TOLERANCE);
+  EXPECT_NEAR(center[2],
+              (SOCKET_COLORS[1].z * (1 - weight) + weight) * 255,
+              CHANNEL_TOLERANCE);
+
+  circle->set_high_precision(true);
+  engine.on_node_changed(circle->get_uuid());
+  engine.update();
+  EXPECT_EQ(engine.get_buffer_format(circle_output), gl::GL_R16F);
+  engine.shutdown();
+}
+
+TEST_F(MaterialShaderTest, specialized_variants_match_the_generic_shader) {
+  constexpr int RESOLUTION = 64;
+  constexpr int BLEND_MODES = 25;
+  auto graph = std::make_shared<MaterialGraph>();
+  auto circle =
+      MaterialNode::create(find_definition(definitions, "circle_node"));
+  auto background =
+      MaterialNode::create(find_definition(definitions, "solid_color_node"));
+  background->get_property("color") = SOCKET_COLORS[1];
+  auto mix = MaterialNode::create(find_definition(definitions, "mix_node"));
+  for (const auto &node : {circle, background, mix}) {
+    node->set_buffer_size({RESOLUTION, RESOLUTION});
+    graph->add_node(node);
+  }
+  for (const auto &[from, socket] :
+       {std::pair{circle, "Foreground"}, std::pair{background, "Background"}}) {
+    graph->add_link(
+        Link({from->get_uuid(), from->get_property("_output").get_uuid()},
+             {mix->get_uuid(), mix->get_property(socket).get_uuid()}));
+  }
+
+  MaterialEngine engine;
+  engine.set_graph(graph);
+  auto read_mix = [&]() {
+    engine.on_node_changed(mix->get_uuid());
+    engine.update();
+    auto pixels =
+        std::vector<uint8_t>(static_cast<size_t>(RESOLUTION) * RESOLUTION * 4);
+    gl::glBindTexture(gl::GL_TEXTURE_2D, engine.get_preview_texture(*mix));
+    gl::glPixelStorei(gl::GL_PACK_ALIGNMENT, 1);
+    gl::glGetTexImage(gl::GL_TEXTURE_2D, 0, gl::GL_RGBA, gl::GL_UNSIGNED_BYTE,
+                      pixels.data());
+    gl::glBindTexture(gl::GL_TEXTURE_2D, 0);
+    return pixels;
+  };
+  for (int mode = 0; mode < BLEND_MODES; ++mode) {
+    mix->get_property("blendMode") = mode;
+    mix->get_property("alphaMode") = mode % 6;
+    // The first draw of each mode uses the generic shader while its
+    // variant is compiled after the update.
+    const auto draws = engine.get_stats().specialized_draws;
+    const auto generic = read_mix();
+    EXPECT_EQ(engine.get_stats().specialized_draws, draws);
+    const auto specialized = read_mix();
+    EXPECT_EQ(engine.get_stats().specialized_draws, draws + 1);
+    EXPECT_LE(get_mismatch_ratio(generic, specialized), MAX_MISMATCH_RATIO)
+        << "blendMode " << mode;
+  }
+  EXPECT_EQ(engine.get_stats().compiled_variants, BLEND_MODES);
+  engine.shutdown();
+}
+
+TEST_F(MaterialShaderTest, image_node_uploads_the_decoded_image) {
+  constexpr int WIDTH = 16;
+  constexpr int HEIGHT = 8;
+  // Red on the left half and blue on the right.
+  auto image = std::vector<uint8_t>(static_cast<size_t>(WIDTH) * HEIGHT * 4);
+  for (size_t i = 0; i < image.size() / 4; ++i) {
+    const auto is_left = i % WIDTH < WIDTH / 2;
+    image[i * 4] = is_left ? 255 : 0;
+    image[i * 4 + 2] = is_left ? 0 : 255;
+    image[i * 4 + 3] = 255;
+  }
+  const auto path = paths::temp_dir() / "image_node_test.png";
+  ASSERT_TRUE(write_image(path, WIDTH, HEIGHT, image));
+
+  auto graph = std::make_shared<MaterialGraph>();
+  auto node =
+      MaterialNode::create(find_definition(definitions, "image_node"));
+  node->get_property("file_path").set_value(path.string());
+  node->set_buffer_size({WIDTH, HEIGHT});
+  graph->add_node(node);
+
+  MaterialEngine engine;
+  engine.set_graph(graph);
+  // Shows a placeholder, or the image if it was decoded already.
+  engine.update();
+  ASSERT_NE(io::ImageCache::get().request(path).get(), nullptr);
+  engine.on_node_changed(node->get_uuid());
+  engine.update();
+
+  auto pixels = std::vector<uint8_t>(image.size());
+  gl::glBindTexture(gl::GL_TEXTURE_2D, engine.get_preview_texture(*node));
+  gl::glPixelStorei(gl::GL_PACK_ALIGNMENT, 1);
+  gl::glGetTexImage(gl::GL_TEXTURE_2D, 0, gl::GL_RGBA, gl::GL_UNSIGNED_BYTE,
+                    pixels.data());
+  gl::glBindTexture(gl::GL_TEXTURE_2D, 0);
+  EXPECT_LE(get_mismatch_ratio(image, pixels), MAX_MISMATCH_RATIO);
+  engine.shutdown();
+  io::ImageCache::get().clear();
+  fs::remove(path);
+}
+
+TEST_F(MaterialShaderTest, lent_textures_keep_their_result) {
+  constexpr int RESOLUTION = 64;
+  auto graph = std::make_shared<MaterialGraph>();
+  auto node =
+      MaterialNode::create(find_definition(definitions, "circle_node"));
+  node->set_buffer_size({RESOLUTION, RESOLUTION});
+  graph->add_node(node);
+  const auto output = node->get_property("_output").get_uuid();
+
+  auto read = [](gl::GLuint texture) {
+    auto pixels =
+        std::vector<uint8_t>(static_cast<size_t>(RESOLUTION) * RESOLUTION * 4);
+    gl::glBindTexture(gl::GL_TEXTURE_2D, texture);
+    gl::glPixelStorei(gl::GL_PACK_ALIGNMENT, 1);
+    gl::glGetTexImage(gl::GL_TEXTURE_2D, 0, gl::GL_RGBA, gl::GL_UNSIGNED_BYTE,
+                      pixels.data());
+    gl::glBindTexture(gl::GL_TEXTURE_2D, 0);
+    return pixels;
+  };
+
+  MaterialEngine engine;
+  engine.set_graph(graph);
+  engine.update();
+  const auto lent = engine.lend_texture(output);
+  const auto first = read(lent);
+
+  // The node renders into another texture while the first one is lent.
+  node->get_property("radius") = 0.25F;
+  engine.on_node_changed(node->get_uuid());
+  engine.update();
+  const auto second = engine.get_buffer(output).texture_id;
+  EXPECT_NE(second, lent);
+  EXPECT_EQ(read(lent), first);
+  EXPECT_GT(get_mismatch_ratio(first, read(second)), MAX_MISMATCH_RATIO);
+
+  // Once returned, the next run reuses it instead of a new texture.
+  engine.return_texture(lent);
+  engine.lend_texture(output);
+  node->get_property("radius") = 0.5F;
+  engine.on_node_changed(node->get_uuid());
+  engine.update();
+  EXPECT_EQ(engine.get_buffer(output).texture_id, lent);
+  engine.return_texture(second);
+  engine.shutdown();
+}
+
+TEST_F(MaterialShaderTest, async_engine_swaps_in_complete_results) {
+  constexpr int RESOLUTION = 64;
+  constexpr auto TIMEOUT = std::chrono::seconds(30);
+  auto graph = std::make_shared<MaterialGraph>();
+  auto node =
+      MaterialNode::create(find_definition(definitions, "circle_node"));
+  node->set_buffer_size({RESOLUTION, RESOLUTION});
+  graph->add_node(node);
+
+  auto read = [](gl::GLuint texture) {
+    auto pixels =
+        std::vector<uint8_t>(static_cast<size_t>(RESOLUTION) * RESOLUTION * 4);
+    gl::glBindTexture(gl::GL_TEXTURE_2D, texture);
+    gl::glPixelStorei(gl::GL_PACK_ALIGNMENT, 1);
+    gl::glGetTexImage(gl::GL_TEXTURE_2D, 0, gl::GL_RGBA, gl::GL_UNSIGNED_BYTE,
+                      pixels.data());
+    gl::glBindTexture(gl::GL_TEXTURE_2D, 0);
+    return pixels;
+  };
+  auto render = [&]() {
+    MaterialEngine engine;
+    engine.set_graph(graph);
+    engine.update();
+    auto pixels = read(engine.get_preview_texture(*node));
+    engine.shutdown();
+    return pixels;
+  };
+  auto async_engine = AsyncEngine();
+  // Waits for a front buffer other than @a previous.
+  auto wait_for_result = [&](gl::GLuint previous) {
+    const auto deadline = std::chrono::steady_clock::now() + TIMEOUT;
+    auto texture = async_engine.get_preview_texture(*node);
+    while ((texture == 0 || texture == previous) &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      async_engine.begin_frame();
+      texture = async_engine.get_preview_texture(*node);
+    }
+    return texture;
+  };
+
+  auto shared_context = context->create_shared();
+  ASSERT_NE(shared_context, nullptr);
+  async_engine.startup(std::move(shared_context));
+  async_engine.set_graph(graph);
+  const auto first = wait_for_result(0);
+  ASSERT_NE(first, 0);
+  EXPECT_LE(get_mismatch_ratio(render(), read(first)), MAX_MISMATCH_RATIO);
+
+  // The edit reaches the engine thread as a copy, the preview keeps the old
+  // result until the new one is complete.
+  node->get_property("radius") = 0.25F;
+  async_engine.on_node_changed(*node);
+  const auto second = wait_for_result(first);
+  ASSERT_NE(second, first);
+  EXPECT_LE(get_mismatch_ratio(render(), read(second)), MAX_MISMATCH_RATIO);
+  async_engine.shutdown();
+}
@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "common/packed_file.h"
+
+using namespace afro::core;
+
+namespace {
+// Bytes that compress a little, like image data.
+auto make_bytes(size_t size, uint32_t seed) -> std::vector<uint8_t> {
+  auto random = std::mt19937(seed);
+  auto bytes = std::vector<uint8_t>(size);
+  for (size_t i = 0; i < size; ++i) {
+    bytes[i] = static_cast<uint8_t>(i / 7 + random() % 4);
+  }
+  return bytes;
+}
+}  // namespace
+
+TEST(PackedFileTest, bytes_survive_packing) {
+  const auto bytes = make_bytes(PackedFile::CHUNK_SIZE * 3 + 1000, 1);
+  const auto file = PackedFile(bytes);
+  EXPECT_EQ(file.get_size(), bytes.size());
+  EXPECT_EQ(file.get_chunks().size(), 4);
+  EXPECT_LT(file.get_compressed_size(), bytes.size());
+  EXPECT_EQ(file.unpack(), bytes);
+
+  EXPECT_EQ(PackedFile(std::vector<uint8_t>()).unpack(),
+            std::vector<uint8_t>());
+}
+
+TEST(PackedFileTest, reads_span_chunks) {
+  const auto bytes = make_bytes(PackedFile::CHUNK_SIZE * 3, 2);
+  const auto file = PackedFile(bytes);
+  PackedChunkStore::get().clear();
+  auto read = std::vector<uint8_t>(PackedFile::CHUNK_SIZE + 20);
+  const auto offset = PackedFile::CHUNK_SIZE - 10;
+  file.read(offset, read);
+  EXPECT_TRUE(std::equal(read.begin(), read.end(), bytes.begin() + offset));
+  // Only the chunks that were read are decompressed.
+  EXPECT_EQ(PackedChunkStore::get().get_memory_usage(),
+            PackedFile::CHUNK_SIZE * 3);
+  PackedChunkStore::get().clear();
+  file.read(0, {read.data(), 10});
+  EXPECT_EQ(PackedChunkStore::get().get_memory_usage(),
+            PackedFile::CHUNK_SIZE);
+
+  EXPECT_THROW(file.read(bytes.size() - 5, {read.data(), 10}),
+               std::out_of_range);
+}
+
+TEST(PackedFileTest, identical_chunks_are_shared) {
+  const auto count = PackedChunkStore::get().get_chunk_count();
+  auto bytes = make_bytes(PackedFile::CHUNK_SIZE * 2, 3);
+  const auto file = PackedFile(bytes);
+  EXPECT_EQ(PackedChunkStore::get().get_chunk_count(), count + 2);
+  // Changing the second chunk only adds that one.
+  bytes.back() ^= 1;
+  auto changed = PackedFile(bytes);
+  EXPECT_EQ(changed.get_chunks()[0], file.get_chunks()[0]);
+  EXPECT_NE(changed.get_chunks()[1], file.get_chunks()[1]);
+  EXPECT_EQ(PackedChunkStore::get().get_chunk_count(), count + 3);
+
+  changed = PackedFile();
+  EXPECT_EQ(PackedChunkStore::get().get_chunk_count(), count + 2);
+}
+
+TEST(PackedFileTest, decompressed_chunks_stay_in_budget) {
+  const auto file = PackedFile(make_bytes(PackedFile::CHUNK_SIZE * 4, 4));
+  auto& store = PackedChunkStore::get();
+  store.clear();
+  store.set_memory_budget(PackedFile::CHUNK_SIZE * 2);
+  const auto first = store.decompress(*file.get_chunks()[0]);
+  store.decompress(*file.get_chunks()[1]);
+  // Using the first chunk again keeps it over the second.
+  EXPECT_EQ(store.decompress(*file.get_chunks()[0]), first);
+  store.decompress(*file.get_chunks()[2]);
+  EXPECT_EQ(store.get_memory_usage(), PackedFile::CHUNK_SIZE * 2);
+  EXPECT_EQ(store.decompress(*file.get_chunks()[0]), first);
+  store.set_memory_budget(PackedChunkStore::DEFAULT_MEMORY_BUDGET);
+}
+
+TEST(PackedFileTest, corrupt_chunks_throw) {
+  const auto bytes = make_bytes(1000, 5);
+  const auto chunk = PackedFile(bytes).get_chunks()[0];
+  auto compressed = std::vector<uint8_t>(chunk->get_compressed().begin(),
+                                         chunk->get_compressed().end());
+  compressed.resize(compressed.size() / 2);
+  const auto file = PackedFile(
+      {PackedChunkStore::get().add_compressed(compressed, bytes.size())});
+  EXPECT_THROW(file.unpack(), std::runtime_error);
+}
+
+TEST(PackedFileTest, chunk_sizes_are_bounded) {
+  const auto bytes = make_bytes(1000, 6);
+  const auto chunk = PackedFile(bytes).get_chunks()[0];
+  const auto compressed = std::vector<uint8_t>(
+      chunk->get_compressed().begin(), chunk->get_compressed().end());
+  auto& store = PackedChunkStore::get();
+  EXPECT_THROW(PackedFile({store.add_compressed(compressed, 0)}),
+               std::runtime_error);
+  EXPECT_THROW(
+      PackedFile({store.add_compressed(compressed,
+                                       PackedFile::CHUNK_SIZE + 1)}),
+      std::runtime_error);
+  EXPECT_THROW(PackedFile({chunk, chunk}), std::runtime_error);
+  EXPECT_EQ(PackedFile({chunk}).get_size(), bytes.size());
+}
@@ -0,0 +1,193 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "common/pixel_convert.h"
+
+using namespace afro::core;
+
+namespace {
+constexpr size_t PIXEL_COUNT = 1000;
+
+// Bytes of @a count pixels of @a format with values in [-0.25, 1.25].
+auto make_pixels(const PixelFormat& format, size_t count)
+    -> std::vector<uint8_t> {
+  auto random = std::mt19937(42);
+  auto distribution = std::uniform_real_distribution<float>(-0.25F, 1.25F);
+  auto values = std::vector<float>(count * format.channels);
+  for (auto& value : values) {
+    value = distribution(random);
+  }
+  auto bytes = std::vector<uint8_t>(count * format.get_pixel_size());
+  convert_pixels(values.data(),
+                 PixelFormat{format.channels, ChannelType::FLOAT32},
+                 bytes.data(), PixelFormat{format.channels, format.type},
+                 count);
+  return bytes;
+}
+
+// Values of @a bytes as floats, without any other conversion.
+auto to_values(const std::vector<uint8_t>& bytes, const PixelFormat& format)
+    -> std::vector<float> {
+  const auto count = bytes.size() / format.get_pixel_size();
+  auto values = std::vector<float>(count * format.channels);
+  convert_pixels(bytes.data(), PixelFormat{format.channels, format.type},
+                 values.data(),
+                 PixelFormat{format.channels, ChannelType::FLOAT32}, count);
+  return values;
+}
+
+auto get_tolerance(ChannelType type) -> float {
+  switch (type) {
+    case ChannelType::UINT8:
+      return 1.01F / 255.0F;
+    case ChannelType::UINT16:
+      return 1.01F / 65535.0F;
+    case ChannelType::FLOAT16:
+      return 1e-3F;
+    case ChannelType::FLOAT32:
+      break;
+  }
+  return 1e-5F;
+}
+
+auto srgb_to_linear(double value) -> double {
+  return value <= 0.04045 ? value / 12.92
+                          : std::pow((value + 0.055) / 1.055, 2.4);
+}
+}  // namespace
+
+TEST(PixelConvertTest, formats_describe_their_pixels) {
+  EXPECT_NE(formats::r16, formats::r16f);
+  EXPECT_NE(formats::rgba8, formats::srgba8);
+  EXPECT_EQ(formats::rgba16.get_pixel_size(), 8);
+  EXPECT_EQ(formats::rgb32f.get_pixel_size(), 12);
+  EXPECT_EQ(formats::r16f.get_bit_depth(), 16);
+  EXPECT_TRUE(formats::rgba16f.is_float());
+  EXPECT_FALSE(formats::rgb8.has_alpha());
+}
+
+TEST(PixelConvertTest, halfs_round_to_nearest_even) {
+  for (uint32_t half = 0; half <= UINT16_MAX; ++half) {
+    const auto value = half_to_float(static_cast<uint16_t>(half));
+    if (std::isnan(value)) {
+      EXPECT_TRUE(std::isnan(half_to_float(float_to_half(value))));
+    } else {
+      EXPECT_EQ(float_to_half(value), half) << value;
+    }
+  }
+  EXPECT_EQ(float_to_half(1.0F), 0x3c00);
+  EXPECT_EQ(float_to_half(65504.0F), 0x7bff);
+  EXPECT_EQ(float_to_half(65520.0F), 0x7c00);
+  EXPECT_EQ(float_to_half(-0.0F), 0x8000);
+  // Halfway between subnormals rounds to the even one.
+  EXPECT_EQ(float_to_half(0x1p-25F), 0);
+  EXPECT_EQ(float_to_half(0x1.8p-24F), 2);
+  EXPECT_EQ(float_to_half(1.0F + 0x1p-11F), 0x3c00);
+  EXPECT_EQ(float_to_half(1.0F + 0x1.8p-10F), 0x3c02);
+}
+
+TEST(PixelConvertTest, every_simd_level_matches_scalar) {
+  const auto conversions = std::vector<std::pair<PixelFormat, PixelFormat>>{
+      {formats::srgba8, formats::rgba32f},
+      {formats::rgba32f, formats::srgba8},
+      {formats::rgb8, formats::rgba16f},
+      {formats::rgba16f, formats::r32f},
+      {formats::r16, formats::rgba8},
+      {PixelFormat{2, ChannelType::UINT16}, formats::rgba16},
+      {formats::rgba32f, formats::rgb16},
+      {formats::rgba32f,
+       PixelFormat{4, ChannelType::UINT8, ColorSpace::LINEAR, true}},
+      {PixelFormat{4, ChannelType::FLOAT16, ColorSpace::SRGB, true},
+       formats::rgba32f}};
+  const auto supported = get_supported_simd_level();
+  for (const auto& [from, to] : conversions) {
+    const auto source = make_pixels(from, PIXEL_COUNT);
+    auto expected = std::vector<uint8_t>(PIXEL_COUNT * to.get_pixel_size());
+    set_simd_level(SimdLevel::SCALAR);
+    convert_pixels(source.data(), from, expected.data(), to, PIXEL_COUNT);
+    const auto expected_values = to_values(expected, to);
+    for (auto level = SimdLevel::SSE4; level <= supported;
+         level = static_cast<SimdLevel>(static_cast<int>(level) + 1)) {
+      set_simd_level(level);
+      auto actual = std::vector<uint8_t>(expected.size());
+      convert_pixels(source.data(), from, actual.data(), to, PIXEL_COUNT);
+      set_simd_level(SimdLevel::SCALAR);
+      const auto actual_values = to_values(actual, to);
+      for (size_t i = 0; i < expected_values.size(); ++i) {
+        ASSERT_NEAR(actual_values[i], expected_values[i],
+                    get_tolerance(to.type))
+            << "level " << static_cast<int>(level) << " value " << i;
+      }
+    }
+  }
+  set_simd_level(supported);
+}
+
+TEST(PixelConvertTest, srgb_follows_the_transfer_function) {
+  auto encoded = std::vector<uint8_t>(256 * 4);
+  for (size_t i = 0; i < encoded.size(); ++i) {
+    encoded[i] = static_cast<uint8_t>(i / 4);
+  }
+  auto linear = std::vector<float>(encoded.size());
+  convert_pixels(encoded.data(), formats::srgba8, linear.data(),
+                 formats::rgba32f, 256);
+  for (size_t i = 0; i < 256; ++i) {
+    EXPECT_NEAR(linear[i * 4], srgb_to_linear(i / 255.0), 1e-5);
+    EXPECT_NEAR(linear[i * 4 + 3], i / 255.0, 1e-6);
+  }
+  // 8 bits survive the round trip.
+  auto round_trip = std::vector<uint8_t>(encoded.size());
+  convert_pixels(linear.data(), formats::rgba32f, round_trip.data(),
+                 formats::srgba8, 256);
+  EXPECT_EQ(round_trip, encoded);
+}
+
+TEST(PixelConvertTest, channels_are_expanded_and_dropped) {
+  const auto gray = std::array<uint8_t, 2>{10, 200};
+  auto rgba = std::array<uint8_t, 8>();
+  convert_pixels(gray.data(), formats::r8, rgba.data(), formats::rgba8, 2);
+  EXPECT_EQ(rgba, (std::array<uint8_t, 8>{10, 10, 10, 255, 200, 200, 200,
+                                          255}));
+
+  const auto gray_alpha = std::array<float, 2>{0.5F, 0.25F};
+  auto expanded = std::array<float, 4>();
+  convert_pixels(gray_alpha.data(), PixelFormat{2, ChannelType::FLOAT32},
+                 expanded.data(), formats::rgba32f, 1);
+  EXPECT_EQ(expanded, (std::array<float, 4>{0.5F, 0.5F, 0.5F, 0.25F}));
+
+  // Gray takes the red channel.
+  auto red = std::array<uint8_t, 2>();
+  convert_pixels(rgba.data(), formats::rgba8, red.data(), formats::r8, 2);
+  EXPECT_EQ(red, gray);
+}
+
+TEST(PixelConvertTest, premultiplication_is_undone) {
+  const auto straight =
+      std::array<float, 8>{1.0F, 0.5F, 0.0F, 0.5F, 1.0F, 1.0F, 1.0F, 0.0F};
+  const auto premultiplied_format =
+      PixelFormat{4, ChannelType::FLOAT32, ColorSpace::LINEAR, true};
+  auto premultiplied = std::array<float, 8>();
+  convert_pixels(straight.data(), formats::rgba32f, premultiplied.data(),
+                 premultiplied_format, 2);
+  EXPECT_EQ(premultiplied, (std::array<float, 8>{0.5F, 0.25F, 0.0F, 0.5F,
+                                                 0.0F, 0.0F, 0.0F, 0.0F}));
+
+  auto restored = std::array<float, 8>();
+  convert_pixels(premultiplied.data(), premultiplied_format, restored.data(),
+                 formats::rgba32f, 2);
+  // Colors of transparent pixels are lost.
+  EXPECT_EQ(restored, (std::array<float, 8>{1.0F, 0.5F, 0.0F, 0.5F, 0.0F,
+                                            0.0F, 0.0F, 0.0F}));
+}
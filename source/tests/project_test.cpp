@@ -0,0 +1,248 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ */
+
+#include "io/project.h"
+
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "material_graph/definitions/subgraph_definition.h"
+#include "utils/log.h"
+
+using namespace afro;
+using namespace afro::graph;
+using namespace afro::graph::material;
+using namespace std;
+
+namespace fs = std::filesystem;
+
+namespace {
+auto make_dummy_definition() -> MaterialNodeDefinition {
+  auto props = vector<property::PropertyDefinition>();
+  props.emplace_back("socket0", "Socket", "Empty desc", property::Type::INPUT,
+                     property::ValueType::FLOAT_4, property::ValueUnit::COLOR,
+                     true, false, FVec4{});
+  props.emplace_back("value", "Value", "Empty desc", property::Type::INPUT,
+                     property::ValueType::FLOAT, property::ValueUnit::NONE,
+                     false, true, 0.0F);
+  props.emplace_back("_output", "Output", "Empty desc", property::Type::OUTPUT,
+                     property::ValueType::FLOAT_4, property::ValueUnit::COLOR,
+                     true, false, FVec4{});
+  return {"dummy_node", "Dummy Node", props, "", ui::Icon::NONE};
+}
+
+auto make_project() -> io::Project {
+  return io::Project({make_dummy_definition()});
+}
+
+auto open_project(const fs::path& path) -> io::Project {
+  return io::Project::open(path, {make_dummy_definition()});
+}
+
+// Two connected nodes, the second is the output and its value is exposed.
+auto make_graph(float value) -> shared_ptr<MaterialGraph> {
+  auto graph = make_shared<MaterialGraph>();
+  auto node1 = MaterialNode::create(make_dummy_definition());
+  auto node2 = MaterialNode::create(make_dummy_definition());
+  node1->position = {10.0F, 20.0F};
+  node1->get_property("value").set_value(value);
+  node2->set_high_precision(true);
+  graph->add_node(node1);
+  graph->add_node(node2);
+  graph->add_link(Link({node1->get_uuid(),
+                        node1->get_property("_output").get_uuid()},
+                       {node2->get_uuid(),
+                        node2->get_property("socket0").get_uuid()}));
+  graph->expose_property(node2->get_uuid(), "value");
+  graph->set_output_node(node2->get_uuid());
+  graph->set_name("Bricks");
+  return graph;
+}
+
+auto make_asset(size_t size) -> io::Project::Asset {
+  auto bytes = vector<uint8_t>(size);
+  for (size_t i = 0; i < size; ++i) {
+    bytes[i] = static_cast<uint8_t>((i * 2654435761U) >> 13);
+  }
+  return {"texture.png", core::PackedFile(bytes)};
+}
+
+class ProjectTest : public testing::Test {
+ protected:
+  fs::path path;
+
+  void SetUp() override {
+    log::init_log(log::get_logger(), log::LogLevel::warn);
+    const auto* test = testing::UnitTest::GetInstance()->current_test_info();
+    path = fs::temp_directory_path() /
+           fmt::format("afro_project_test_{}.afro", test->name());
+    fs::remove(path);
+  }
+  void TearDown() override { fs::remove(path); }
+};
+}  // namespace
+
+TEST_F(ProjectTest, graphs_and_assets_round_trip) {
+  auto graph = make_graph(0.5F);
+  const auto asset = make_asset(core::PackedFile::CHUNK_SIZE + 100);
+  {
+    auto project = make_project();
+    project.add_graph(graph);
+    project.add_asset(7, asset);
+    project.save_as(path);
+  }
+
+  auto project = open_project(path);
+  EXPECT_EQ(project.get_graph_uuids(), vector<UUID>{graph->get_uuid()});
+  EXPECT_EQ(project.get_asset_uuids(), vector<UUID>{7});
+  auto loaded = project.get_graph(graph->get_uuid());
+  ASSERT_EQ(loaded->get_nodes().size(), 2);
+  EXPECT_EQ(loaded->get_links().size(), 1);
+  EXPECT_EQ(loaded->get_name(), "Bricks");
+  EXPECT_EQ(loaded->get_output_node(), graph->get_output_node());
+  ASSERT_EQ(loaded->get_exposed_properties().size(), 1);
+  EXPECT_EQ(loaded->get_exposed_properties()[0].property_id, "value");
+  for (const auto& node : graph->get_nodes()) {
+    auto original = dynamic_pointer_cast<MaterialNode>(node);
+    auto copy = dynamic_pointer_cast<MaterialNode>(
+        loaded->get_node_by_uuid(node->get_uuid()));
+    ASSERT_NE(copy, nullptr);
+    EXPECT_EQ(copy->position.x, original->position.x);
+    EXPECT_EQ(copy->get_high_precision(), original->get_high_precision());
+    EXPECT_EQ(get<float>(copy->get_property("value").get_value()),
+              get<float>(original->get_property("value").get_value()));
+  }
+  const auto link = loaded->get_links()[0];
+  EXPECT_EQ(link.get_from_node(), graph->get_links()[0].get_from_node());
+  EXPECT_EQ(link.get_to_node(), graph->get_links()[0].get_to_node());
+
+  auto loaded_asset = project.get_asset(7);
+  EXPECT_EQ(loaded_asset->name, asset.name);
+  EXPECT_EQ(loaded_asset->file.unpack(), asset.file.unpack());
+}
+
+TEST_F(ProjectTest, sections_load_when_accessed) {
+  auto graph = make_graph(0.5F);
+  {
+    auto project = make_project();
+    project.add_graph(graph);
+    project.add_asset(7, make_asset(1000));
+    project.save_as(path);
+    EXPECT_TRUE(project.is_loaded(graph->get_uuid()));
+  }
+
+  auto project = open_project(path);
+  EXPECT_FALSE(project.is_loaded(graph->get_uuid()));
+  EXPECT_FALSE(project.is_loaded(7));
+  project.get_graph(graph->get_uuid());
+  EXPECT_TRUE(project.is_loaded(graph->get_uuid()));
+  EXPECT_FALSE(project.is_loaded(7));
+  EXPECT_THROW(project.get_graph(8), std::out_of_range);
+}
+
+TEST_F(ProjectTest, save_appends_only_changed_sections) {
+  auto graph1 = make_graph(0.5F);
+  auto graph2 = make_graph(0.5F);
+  {
+    auto project = make_project();
+    project.add_graph(graph1);
+    project.add_graph(graph2);
+    project.add_asset(7, make_asset(100000));
+    project.save_as(path);
+  }
+
+  auto project = open_project(path);
+  const auto size = project.get_file_size();
+  project.get_graph(graph1->get_uuid());
+  project.save();
+  // Loading doesn't change a graph.
+  EXPECT_EQ(project.get_file_size(), size);
+
+  auto node = dynamic_pointer_cast<MaterialNode>(
+      project.get_graph(graph1->get_uuid())->get_nodes()[0]);
+  node->get_property("value").set_value(0.25F);
+  project.save();
+  // The graph and a new table of contents are appended, not the asset.
+  EXPECT_GT(project.get_file_size(), size);
+  EXPECT_LT(project.get_file_size(), size + 4096);
+  EXPECT_FALSE(project.is_loaded(graph2->get_uuid()));
+  EXPECT_FALSE(project.is_loaded(7));
+
+  auto reopened = open_project(path);
+  auto reloaded = dynamic_pointer_cast<MaterialNode>(
+      reopened.get_graph(graph1->get_uuid())->get_node_by_uuid(
+          node->get_uuid()));
+  EXPECT_EQ(get<float>(reloaded->get_property("value").get_value()), 0.25F);
+  EXPECT_EQ(reopened.get_graph(graph2->get_uuid())->get_nodes().size(), 2);
+  EXPECT_EQ(reopened.get_asset(7)->file.get_size(), 100000);
+}
+
+TEST_F(ProjectTest, removed_sections_are_dropped) {
+  auto graph = make_graph(0.5F);
+  {
+    auto project = make_project();
+    project.add_graph(graph);
+    project.add_asset(7, make_asset(1000));
+    project.save_as(path);
+  }
+  {
+    auto project = open_project(path);
+    project.remove_asset(7);
+    project.save();
+  }
+
+  auto project = open_project(path);
+  EXPECT_TRUE(project.get_asset_uuids().empty());
+  EXPECT_EQ(project.get_graph_uuids(), vector<UUID>{graph->get_uuid()});
+}
+
+TEST_F(ProjectTest, subgraph_instances_are_resolved) {
+  auto subgraph = make_graph(0.5F);
+  auto graph = make_shared<MaterialGraph>();
+  auto instance =
+      MaterialNode::create(make_subgraph_definition(subgraph, "Sub"));
+  graph->add_node(instance);
+  {
+    auto project = make_project();
+    project.add_graph(subgraph);
+    project.add_graph(graph);
+    project.save_as(path);
+  }
+
+  auto project = open_project(path);
+  auto loaded = project.get_graph(graph->get_uuid());
+  EXPECT_TRUE(project.is_loaded(subgraph->get_uuid()));
+  auto node = dynamic_pointer_cast<MaterialNode>(
+      loaded->get_node_by_uuid(instance->get_uuid()));
+  ASSERT_NE(node, nullptr);
+  EXPECT_EQ(node->get_definition().get_id(),
+            instance->get_definition().get_id());
+}
+
+TEST_F(ProjectTest, rejects_other_files) {
+  {
+    auto out = ofstream(path, ios::binary);
+    out << string(128, 'x');
+  }
+  EXPECT_THROW(open_project(path), std::runtime_error);
+
+  make_project().save_as(path);
+  {
+    // Bump the version after the magic.
+    auto out = fstream(path, ios::binary | ios::in | ios::out);
+    out.seekp(8);
+    const auto version = io::Project::VERSION + 1;
+    out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+  }
+  EXPECT_THROW(open_project(path), std::runtime_error);
+}
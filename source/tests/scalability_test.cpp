@@ -0,0 +1,309 @@
+/**
+ * Copyright (c) 2023 The Afro Authors. All rights reserved.
+ * Use of this source code is governed by the GPL-2.0 license that can be
+ * found in the LICENSE file.
+ *
+ * Runs the engine, editor and serialization data paths on generated graphs
+ * of BASE_NODES and SCALE times as many nodes, and fails if the time or
+ * memory grows clearly faster than the node count.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <sstream>
+
+#include "graph/commands/add_link_command.h"
+#include "graph/commands/delete_links_command.h"
+#include "graph/ui/id_map.h"
+#include "graph_generator.h"
+#include "material_graph/definitions/definitions.h"
+#include "material_graph/engine/material_engine.h"
+#include "undo/data/undo_stack_impl.h"
+#include "utils/log.h"
+
+using namespace afro;
+using namespace afro::graph;
+using namespace afro::graph::material;
+using afro::graph::generator::Shape;
+
+namespace {
+std::atomic<int64_t> live_bytes{0};
+// Keeps operator new's alignment guarantee for the size header.
+constexpr size_t HEADER_SIZE = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+}  // namespace
+
+auto operator new(size_t size) -> void* {
+  auto* block = static_cast<char*>(std::malloc(size + HEADER_SIZE));
+  if (block == nullptr) {
+    throw std::bad_alloc();
+  }
+  *reinterpret_cast<size_t*>(block) = size;
+  live_bytes += static_cast<int64_t>(size);
+  return block + HEADER_SIZE;
+}
+
+auto operator delete(void* ptr) noexcept -> void {
+  if (ptr == nullptr) {
+    return;
+  }
+  auto* block = static_cast<char*>(ptr) - HEADER_SIZE;
+  live_bytes -= static_cast<int64_t>(*reinterpret_cast<size_t*>(block));
+  std::free(block);
+}
+
+auto operator delete(void* ptr, size_t /*size*/) noexcept -> void {
+  operator delete(ptr);
+}
+
+namespace {
+constexpr int BASE_NODES = 2000;
+constexpr int SCALE = 8;
+// Linear work may take up to this many times longer on the larger graph,
+// quadratic work takes around SCALE * SCALE.
+constexpr double MAX_TIME_GROWTH = 2.5 * SCALE;
+constexpr double MAX_MEMORY_GROWTH = 1.25 * SCALE;
+// Times below this are mostly noise.
+constexpr double MIN_MEASURABLE_MS = 0.1;
+constexpr int RUNS = 3;
+// The built in definitions copy their shader code into every node.
+constexpr int64_t MAX_BYTES_PER_NODE = 40 * 1024;
+constexpr uint64_t SEED = 1234;
+
+auto get_definitions() -> const std::vector<MaterialNodeDefinition>& {
+  static const auto definitions = NodeDefinitions();
+  return definitions;
+}
+
+auto make_description(int count, Shape shape)
+    -> generator::GraphDescription {
+  auto options = generator::GeneratorOptions();
+  options.shape = shape;
+  options.node_count = count;
+  options.seed = SEED;
+  return generator::generate(options, get_definitions());
+}
+
+auto make_realistic_description(int count) -> generator::GraphDescription {
+  return make_description(count, Shape::REALISTIC);
+}
+
+auto make_graph(int count, Shape shape)
+    -> generator::GeneratedGraph {
+  return generator::build_graph(make_description(count, shape),
+                                get_definitions());
+}
+
+auto make_realistic_graph(int count) -> generator::GeneratedGraph {
+  return make_graph(count, Shape::REALISTIC);
+}
+
+/**
+ * @brief The fastest of RUNS runs of @a work, each on a fresh result of
+ * @a setup.
+ */
+template <typename Setup, typename Work>
+auto measure_ms(int count, Setup setup, Work work) -> double {
+  auto best = std::numeric_limits<double>::max();
+  for (int i = 0; i < RUNS; ++i) {
+    auto state = setup(count);
+    const auto start = std::chrono::steady_clock::now();
+    work(state);
+    const auto end = std::chrono::steady_clock::now();
+    best = std::min(
+        best, std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  return best;
+}
+
+template <typename Setup, typename Work>
+auto expect_linear_time(Setup setup, Work work) -> void {
+  const auto small_ms = measure_ms(BASE_NODES, setup, work);
+  const auto large_ms = measure_ms(BASE_NODES * SCALE, setup, work);
+  EXPECT_LT(large_ms, std::max(small_ms, MIN_MEASURABLE_MS) * MAX_TIME_GROWTH)
+      << BASE_NODES << " nodes took " << small_ms << "ms, "
+      << BASE_NODES * SCALE << " nodes took " << large_ms << "ms";
+}
+
+class LogEnvironment : public testing::Environment {
+ public:
+  void SetUp() override {
+    log::init_log(log::get_logger(), log::LogLevel::warn);
+  }
+};
+
+const auto* const log_environment =
+    testing::AddGlobalTestEnvironment(new LogEnvironment());
+
+auto bytes_to_build(int count) -> int64_t {
+  const auto description = make_realistic_description(count);
+  const auto before = live_bytes.load();
+  auto graph = generator::build_graph(description, get_definitions());
+  return live_bytes.load() - before;
+}
+}  // namespace
+
+TEST(GraphGeneratorTest, is_reproducible) {
+  for (auto shape : {Shape::RANDOM_DAG, Shape::REALISTIC}) {
+    auto options = generator::GeneratorOptions();
+    options.shape = shape;
+    options.node_count = 500;
+    options.seed = SEED;
+    const auto first = generator::generate(options, get_definitions());
+    const auto second = generator::generate(options, get_definitions());
+    options.seed = SEED + 1;
+    const auto other = generator::generate(options, get_definitions());
+
+    ASSERT_EQ(first.nodes.size(), second.nodes.size());
+    ASSERT_EQ(first.links.size(), second.links.size());
+    for (size_t i = 0; i < first.nodes.size(); ++i) {
+      EXPECT_EQ(first.nodes[i].definition_id, second.nodes[i].definition_id);
+      EXPECT_EQ(first.nodes[i].float_values, second.nodes[i].float_values);
+    }
+    for (size_t i = 0; i < first.links.size(); ++i) {
+      EXPECT_EQ(first.links[i].from_node, second.links[i].from_node);
+      EXPECT_EQ(first.links[i].to_node, second.links[i].to_node);
+      EXPECT_EQ(first.links[i].to_property, second.links[i].to_property);
+    }
+
+    auto differs = first.links.size() != other.links.size();
+    for (size_t i = 0; !differs && i < first.links.size(); ++i) {
+      differs = first.links[i].from_node != other.links[i].from_node;
+    }
+    EXPECT_TRUE(differs) << "Seed has no effect on "
+                         << generator::to_string(shape);
+  }
+}
+
+TEST(GraphGeneratorTest, shapes_are_acyclic) {
+  constexpr int NODES = 301;
+  for (auto shape :
+       {Shape::CHAIN, Shape::FAN,
+        Shape::DIAMONDS, Shape::RANDOM_DAG,
+        Shape::REALISTIC}) {
+    auto generated = make_graph(NODES, shape);
+    ASSERT_EQ(generated.graph->get_nodes().size(), NODES);
+
+    MaterialEngine engine;
+    engine.set_graph(generated.graph);
+    EXPECT_EQ(engine.get_nodes_topologically_sorted().size(), NODES)
+        << generator::to_string(shape);
+  }
+  EXPECT_EQ(make_graph(NODES, Shape::CHAIN).graph->get_links().size(),
+            NODES - 1);
+  EXPECT_EQ(make_graph(NODES, Shape::FAN).graph->get_links().size(),
+            NODES - 1);
+  // 100 diamonds of 4 links each
+  EXPECT_EQ(
+      make_graph(NODES, Shape::DIAMONDS).graph->get_links().size(),
+      400);
+}
+
+TEST(ScalabilityTest, build_graph) {
+  expect_linear_time(make_realistic_description, [](const auto& description) {
+    auto graph = generator::build_graph(description, get_definitions());
+  });
+}
+
+TEST(ScalabilityTest, graph_memory) {
+  const auto small_bytes = bytes_to_build(BASE_NODES);
+  const auto large_bytes = bytes_to_build(BASE_NODES * SCALE);
+  const auto bytes_per_node = large_bytes / (BASE_NODES * SCALE);
+  RecordProperty("bytes_per_node", std::to_string(bytes_per_node));
+  EXPECT_LT(bytes_per_node, MAX_BYTES_PER_NODE);
+  EXPECT_LT(large_bytes, small_bytes * MAX_MEMORY_GROWTH);
+}
+
+TEST(ScalabilityTest, topological_sort) {
+  expect_linear_time(
+      [](int count) {
+        auto engine = std::make_shared<MaterialEngine>();
+        engine->set_graph(make_realistic_graph(count).graph);
+        return engine;
+      },
+      [](auto& engine) { engine->get_nodes_topologically_sorted(); });
+}
+
+TEST(ScalabilityTest, mark_nodes_dirty) {
+  struct State {
+    generator::GeneratedGraph generated;
+    std::shared_ptr<MaterialEngine> engine;
+  };
+  expect_linear_time(
+      [](int count) {
+        auto state = State{make_graph(count, Shape::DIAMONDS),
+                           std::make_shared<MaterialEngine>()};
+        state.engine->set_graph(state.generated.graph);
+        return state;
+      },
+      [](auto& state) {
+        const auto root = state.generated.nodes.front()->get_uuid();
+        state.engine->on_node_changed(root);
+      });
+}
+
+// What GraphEditor does for every node, socket and link on each frame.
+TEST(ScalabilityTest, editor_id_maps) {
+  expect_linear_time(make_realistic_graph, [](auto& generated) {
+    auto node_ids = IDMap();
+    auto attr_ids = IDMap();
+    auto link_ids = IDMap();
+    for (int frame = 0; frame < 2; ++frame) {
+      for (auto& node : generated.graph->get_nodes()) {
+        node_ids.create_or_get_imnodes_id(node->get_uuid());
+        for (auto& prop : node->get_properties()) {
+          attr_ids.create_or_get_imnodes_id(prop.get_uuid());
+        }
+      }
+      for (const auto& link : generated.graph->get_links()) {
+        link_ids.create_or_get_imnodes_id(link.get_uuid());
+        attr_ids.create_or_get_imnodes_id(link.get_from_property());
+        attr_ids.create_or_get_imnodes_id(link.get_to_property());
+      }
+    }
+  });
+}
+
+TEST(ScalabilityTest, add_links_through_undo_stack) {
+  struct State {
+    std::shared_ptr<MaterialGraph> graph;
+    std::vector<Link> links;
+  };
+  expect_linear_time(
+      [](int count) {
+        auto generated = make_realistic_graph(count);
+        auto graph = std::make_shared<MaterialGraph>();
+        for (auto& node : generated.nodes) {
+          graph->add_node(node);
+        }
+        return State{graph, generated.graph->get_links()};
+      },
+      [](auto& state) {
+        auto stack = undo::UndoStackImpl();
+        for (const auto& link : state.links) {
+          stack.enqueue(std::make_unique<AddLinkCommand>(state.graph, link));
+        }
+        stack.execute_pending();
+      });
+}
+
+TEST(ScalabilityTest, delete_links) {
+  expect_linear_time(make_realistic_graph, [](auto& generated) {
+    auto command = DeleteLinks(generated.graph, generated.graph->get_links());
+    command.execute();
+  });
+}
+
+TEST(ScalabilityTest, serialization_round_trip) {
+  expect_linear_time(make_realistic_description, [](const auto& description) {
+    auto stream = std::stringstream();
+    generator::save_description(stream, description);
+    auto loaded = generator::load_description(stream);
+    EXPECT_EQ(loaded.links.size(), description.links.size());
+  });
+}
@@ -1,45 +1,338 @@
-#include "undo/undo.h"
-
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <chrono>
 #include <memory>
 #include <string>
+#include <vector>
 
-#include "undo/operator.h"
+#include "common/interfaces/command.h"
+#include "graph/commands/add_link_command.h"
+#include "graph/data/graph.h"
+#include "property/commands/set_property_value_command.h"
+#include "undo/data/undo_stack_impl.h"
+#include "utils/log.h"
 
-using namespace afro::core;
+using namespace afro;
 
-struct UndoMock : Operator {
+struct UndoMock : Command {
   std::string& buf;
   int u;
-  UndoMock(std::string& output, int i) : Operator("Mock", "Mock"), buf(output), u(i) {}
-  void undo() override {
+  UndoMock(std::string& output, int i) : Command("Mock"), buf(output), u(i) {}
+  auto undo() -> void override {
     std::for_each(buf.begin(), buf.end(), [this](char& i) { i -= u; });
   }
-  void redo() override {
-    std::for_each(buf.begin(), buf.end(), [this](char& i) { i += u; });
-  }
-  void execute() override {
+  auto execute() -> void override {
     std::for_each(buf.begin(), buf.end(), [this](char& i) { i += u; });
   }
 };
 
 TEST(Undo, complex) {
-  constexpr int max_undo = 100;
-  afro::core::UndoStack undo{max_undo};
+  undo::UndoStackImpl undo;
   std::string o = {"Hello World"};
-  auto op = std::unique_ptr<Operator>(new UndoMock(o, 1));
-  auto op1 = std::unique_ptr<Operator>(new UndoMock(o, -1));
-  op->execute();
-  undo.push_operation(std::move(op));
-  undo.undo();
+  undo.enqueue(std::make_unique<UndoMock>(o, 1));
+  undo.execute_pending();
+  undo.undo(1);
+  undo.execute_pending();
   EXPECT_TRUE(o == "Hello World");
-  undo.redo();
+  undo.redo(1);
+  undo.execute_pending();
   EXPECT_TRUE(o == "Ifmmp!Xpsme");
-  undo.undo();
-  op1->execute();
-  undo.push_operation(std::move(op1));
-  undo.undo();
+  undo.undo(1);
+  undo.execute_pending();
+  undo.enqueue(std::make_unique<UndoMock>(o, -1));
+  undo.execute_pending();
+  undo.undo(1);
+  undo.execute_pending();
   EXPECT_TRUE(o == "Hello World");
-}
\ No newline at end of file
+}
+
+namespace {
+struct SizedMock : Command {
+  int& counter;
+  size_t size;
+  SizedMock(int& counter, size_t size)
+      : Command("SizedMock"), counter(counter), size(size) {}
+  auto execute() -> void override { ++counter; }
+  auto undo() -> void override { --counter; }
+  [[nodiscard]] auto get_memory_usage() const -> size_t override {
+    return size;
+  }
+};
+
+auto make_object() -> std::shared_ptr<AfObject> {
+  auto props = std::vector<property::Property>();
+  for (const auto* id : {"first", "second"}) {
+    props.emplace_back(property::PropertyDefinition(
+        id, id, "Empty desc", property::Type::INPUT,
+        property::ValueType::FLOAT, property::ValueUnit::NONE, false, true,
+        0.0F));
+  }
+  return std::make_shared<AfObject>(std::move(props));
+}
+
+auto set_value(undo::UndoStackImpl& undo, std::shared_ptr<AfObject> object,
+               int index, float value) -> void {
+  const auto property = object->get_properties()[index].get_uuid();
+  undo.enqueue(std::make_unique<property::SetPropertyValue>(
+      std::move(object), property, value));
+  undo.execute_pending();
+}
+
+auto get_value(AfObject& object, int index) -> float {
+  return object.get_properties()[index].get<float>();
+}
+
+class UndoMergeTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    log::init_log(log::get_logger(), log::LogLevel::warn);
+  }
+};
+}  // namespace
+
+TEST_F(UndoMergeTest, consecutive_changes_are_merged) {
+  auto undo = undo::UndoStackImpl();
+  undo.set_merge_window(std::chrono::hours(1));
+  auto object = make_object();
+  for (int i = 1; i <= 10; ++i) {
+    set_value(undo, object, 0, static_cast<float>(i));
+  }
+  set_value(undo, object, 1, 1.0F);
+  EXPECT_EQ(undo.get_operations().size(), 2);
+
+  undo.undo(1);
+  undo.execute_pending();
+  EXPECT_EQ(get_value(*object, 0), 10.0F);
+  EXPECT_EQ(get_value(*object, 1), 0.0F);
+  undo.undo(1);
+  undo.execute_pending();
+  EXPECT_EQ(get_value(*object, 0), 0.0F);
+  undo.redo(1);
+  undo.execute_pending();
+  EXPECT_EQ(get_value(*object, 0), 10.0F);
+}
+
+TEST_F(UndoMergeTest, changes_are_not_merged_across_undo) {
+  auto undo = undo::UndoStackImpl();
+  undo.set_merge_window(std::chrono::hours(1));
+  auto object = make_object();
+  set_value(undo, object, 0, 1.0F);
+  set_value(undo, object, 1, 1.0F);
+  undo.undo(1);
+  undo.execute_pending();
+  set_value(undo, object, 0, 2.0F);
+  EXPECT_EQ(undo.get_operations().size(), 2);
+}
+
+TEST_F(UndoMergeTest, no_merge_window) {
+  auto undo = undo::UndoStackImpl();
+  undo.set_merge_window({});
+  auto object = make_object();
+  set_value(undo, object, 0, 1.0F);
+  set_value(undo, object, 0, 2.0F);
+  EXPECT_EQ(undo.get_operations().size(), 2);
+}
+
+TEST(Undo, history_is_trimmed_by_bytes) {
+  auto undo = undo::UndoStackImpl();
+  undo.set_memory_budget(10000);
+  auto counter = 0;
+  for (int i = 0; i < 100; ++i) {
+    undo.enqueue(std::make_unique<SizedMock>(counter, 1000));
+    undo.execute_pending();
+    EXPECT_LE(undo.get_memory_usage(), 10000);
+  }
+  const auto kept = static_cast<int>(undo.get_operations().size());
+  EXPECT_GE(kept, 7);
+  EXPECT_LE(kept, 10);
+  EXPECT_EQ(undo.get_next_undo_idx(), kept - 1);
+
+  undo.undo(100);
+  undo.execute_pending();
+  EXPECT_EQ(counter, 100 - kept);
+  EXPECT_FALSE(undo.has_undo());
+}
+
+TEST(Undo, most_recent_operation_is_kept) {
+  auto undo = undo::UndoStackImpl();
+  undo.set_memory_budget(10);
+  auto counter = 0;
+  undo.enqueue(std::make_unique<SizedMock>(counter, 1000));
+  undo.enqueue(std::make_unique<SizedMock>(counter, 1000));
+  undo.execute_pending();
+  EXPECT_EQ(undo.get_operations().size(), 1);
+  EXPECT_EQ(undo.get_memory_usage(), 1000);
+  EXPECT_TRUE(undo.has_undo());
+}
+
+namespace {
+auto make_node() -> std::shared_ptr<graph::Node> {
+  auto props = std::vector<property::Property>();
+  props.emplace_back(property::PropertyDefinition(
+      "value", "Value", "Empty desc", property::Type::INPUT,
+      property::ValueType::FLOAT, property::ValueUnit::NONE, false, true,
+      0.0F));
+  return std::make_shared<graph::Node>(std::move(props), "Node");
+}
+
+auto make_link(graph::Node& from, graph::Node& to) -> graph::Link {
+  return {{from.get_uuid(), from.get_properties()[0].get_uuid()},
+          {to.get_uuid(), to.get_properties()[0].get_uuid()}};
+}
+
+class TransactionTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    log::init_log(log::get_logger(), log::LogLevel::warn);
+  }
+};
+}  // namespace
+
+TEST_F(TransactionTest, graph_notifies_once_per_transaction) {
+  auto graph = graph::Graph();
+  auto notifications = std::vector<graph::GraphChanges>();
+  auto connection = graph.changed.connect(
+      [&](const graph::GraphChanges& changes) {
+        notifications.push_back(changes);
+      });
+  auto first = make_node();
+  auto second = make_node();
+  graph.add_node(first);
+  EXPECT_EQ(notifications.size(), 1);
+
+  graph.begin_transaction();
+  graph.add_node(second);
+  const auto kept = make_link(*first, *second);
+  const auto dropped = make_link(*second, *first);
+  graph.add_link(kept);
+  graph.add_link(dropped);
+  graph.begin_transaction();
+  first->get_properties()[0].set_value(1.0F);
+  second->get_properties()[0].set_value(1.0F);
+  graph.remove_link(dropped);
+  graph.commit_transaction();
+  EXPECT_EQ(graph.get_links().size(), 1);
+  EXPECT_EQ(notifications.size(), 1);
+  graph.commit_transaction();
+
+  ASSERT_EQ(notifications.size(), 2);
+  const auto& changes = notifications.back();
+  ASSERT_EQ(changes.added_nodes.size(), 1);
+  EXPECT_EQ(changes.added_nodes[0], second);
+  ASSERT_EQ(changes.changed_nodes.size(), 1);
+  EXPECT_EQ(changes.changed_nodes[0], first);
+  ASSERT_EQ(changes.added_links.size(), 1);
+  EXPECT_EQ(changes.added_links[0].get_uuid(), kept.get_uuid());
+  EXPECT_TRUE(changes.removed_links.empty());
+}
+
+TEST_F(TransactionTest, graph_reports_removed_nodes) {
+  auto graph = graph::Graph();
+  auto nodes = std::vector<std::shared_ptr<graph::Node>>();
+  for (int i = 0; i < 3; ++i) {
+    nodes.push_back(make_node());
+    graph.add_node(nodes.back());
+  }
+  auto removed = std::shared_ptr<graph::Node>();
+  auto notifications = std::vector<graph::GraphChanges>();
+  auto removed_connection = graph.node_removed.connect(
+      [&removed](const std::shared_ptr<graph::Node>& node) {
+        removed = node;
+      });
+  auto changed_connection = graph.changed.connect(
+      [&notifications](const graph::GraphChanges& changes) {
+        notifications.push_back(changes);
+      });
+
+  graph.remove_node_by_uuid(nodes[0]->get_uuid());
+  EXPECT_EQ(removed, nodes[0]);
+  ASSERT_EQ(notifications.size(), 1);
+  ASSERT_EQ(notifications[0].removed_nodes.size(), 1);
+  EXPECT_EQ(notifications[0].removed_nodes[0], nodes[0]);
+  ASSERT_EQ(graph.get_nodes().size(), 2);
+  EXPECT_EQ(graph.get_nodes()[0], nodes[1]);
+  EXPECT_EQ(graph.get_node_by_uuid(nodes[0]->get_uuid()), nullptr);
+}
+
+TEST_F(TransactionTest, graph_removes_links_in_bulk) {
+  auto graph = graph::Graph();
+  auto nodes = std::vector<std::shared_ptr<graph::Node>>();
+  for (int i = 0; i < 10; ++i) {
+    nodes.push_back(make_node());
+    graph.add_node(nodes.back());
+  }
+  auto links = std::vector<graph::Link>();
+  for (int i = 0; i + 1 < 10; ++i) {
+    links.push_back(make_link(*nodes[i], *nodes[i + 1]));
+  }
+  graph.add_links(links);
+  auto removed = 0;
+  auto connection = graph.link_removed.connect(
+      [&removed](const graph::Link& /*link*/) { ++removed; });
+
+  graph.begin_transaction();
+  graph.remove_links({links[2], links[5]});
+  // Removed and added back within the transaction, it's left alone.
+  graph.remove_link(links[7]);
+  graph.add_link(links[7]);
+  EXPECT_TRUE(graph.get_links_to_node(nodes[3]->get_uuid()).empty());
+  EXPECT_EQ(graph.get_links_by_uuids({links[7].get_uuid()}).size(), 1);
+  EXPECT_THROW(graph.get_link_by_uuid(links[2].get_uuid()),
+               std::runtime_error);
+  EXPECT_EQ(removed, 0);
+  graph.commit_transaction();
+
+  EXPECT_EQ(removed, 2);
+  EXPECT_EQ(graph.get_links().size(), 7);
+  EXPECT_EQ(graph.get_links_to_node(nodes[8]->get_uuid()).size(), 1);
+}
+
+TEST_F(TransactionTest, operations_are_undone_as_one) {
+  auto graph = std::make_shared<graph::Graph>();
+  auto first = make_node();
+  auto second = make_node();
+  graph->add_node(first);
+  graph->add_node(second);
+  auto notifications = 0;
+  auto connection = graph->changed.connect(
+      [&notifications](const graph::GraphChanges& /*changes*/) {
+        ++notifications;
+      });
+
+  auto undo = undo::UndoStackImpl();
+  undo.begin_transaction("CONNECT", {graph});
+  undo.enqueue(std::make_unique<graph::AddLinkCommand>(
+      graph, make_link(*first, *second)));
+  undo.begin_transaction("NESTED");
+  undo.enqueue(std::make_unique<graph::AddLinkCommand>(
+      graph, make_link(*second, *first)));
+  undo.commit_transaction();
+  undo.execute_pending();
+  EXPECT_TRUE(graph->get_links().empty());
+  undo.commit_transaction();
+  undo.execute_pending();
+
+  ASSERT_EQ(undo.get_operations().size(), 1);
+  EXPECT_EQ(undo.get_operations()[0]->id_name, "CONNECT");
+  EXPECT_EQ(graph->get_links().size(), 2);
+  EXPECT_EQ(notifications, 1);
+
+  undo.undo(1);
+  undo.execute_pending();
+  EXPECT_TRUE(graph->get_links().empty());
+  EXPECT_EQ(notifications, 2);
+  undo.redo(1);
+  undo.execute_pending();
+  EXPECT_EQ(graph->get_links().size(), 2);
+  EXPECT_EQ(notifications, 3);
+}
+
+TEST(Undo, empty_transaction_is_dropped) {
+  auto undo = undo::UndoStackImpl();
+  undo.begin_transaction("EMPTY");
+  undo.commit_transaction();
+  undo.execute_pending();
+  EXPECT_TRUE(undo.get_operations().empty());
+  EXPECT_FALSE(undo.has_undo());
+}